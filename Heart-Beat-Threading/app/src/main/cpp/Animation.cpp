@@ -0,0 +1,128 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace navs {
+
+static glm::quat ToQuat(const glm::vec4& xyzw) {
+  return glm::quat(xyzw.w, xyzw.x, xyzw.y, xyzw.z);
+}
+
+// Hermite spline between two keys, tangents are scaled by the key interval as glTF requires
+static glm::vec4 CubicSpline(const glm::vec4* values, size_t key, float t, float interval) {
+  const glm::vec4& p0 = values[3 * key + 1];
+  const glm::vec4 m0 = values[3 * key + 2] * interval;
+  const glm::vec4& p1 = values[3 * key + 4];
+  const glm::vec4 m1 = values[3 * key + 3] * interval;
+  const float t2 = t * t;
+  const float t3 = t2 * t;
+  return p0 * (2.0f * t3 - 3.0f * t2 + 1.0f) + m0 * (t3 - 2.0f * t2 + t) +
+         p1 * (-2.0f * t3 + 3.0f * t2) + m1 * (t3 - t2);
+}
+
+// Value of a channel at time, clamped to its first and last key
+static glm::vec4 SampleChannel(const AnimationChannel& channel, float time) {
+  const std::vector<float>& times = channel.times;
+  const bool cubic = channel.interpolation == ANIMATION_INTERPOLATION_CUBIC_SPLINE;
+  const size_t valueOffset = cubic ? 1 : 0;
+  const size_t valueStride = cubic ? 3 : 1;
+
+  // First key after time, keys are few enough that a binary search beats keeping a cursor
+  const size_t next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+  if (next == 0) {
+    return channel.values[valueOffset];
+  }
+  if (next == times.size()) {
+    return channel.values[(next - 1) * valueStride + valueOffset];
+  }
+
+  const size_t key = next - 1;
+  const float interval = times[next] - times[key];
+  const float t = interval > 0.0f ? (time - times[key]) / interval : 0.0f;
+  switch (channel.interpolation) {
+    case ANIMATION_INTERPOLATION_STEP:
+      return channel.values[key];
+    case ANIMATION_INTERPOLATION_CUBIC_SPLINE:
+      return CubicSpline(channel.values.data(), key, t, interval);
+    default:
+      break;
+  }
+  if (channel.path == ANIMATION_PATH_ROTATION) {
+    const glm::quat q = glm::slerp(ToQuat(channel.values[key]), ToQuat(channel.values[next]), t);
+    return glm::vec4(q.x, q.y, q.z, q.w);
+  }
+  return glm::mix(channel.values[key], channel.values[next], t);
+}
+
+void SampleAnimation(const Skeleton& skeleton, const AnimationClip& clip, float time,
+                     JointPose* pose) {
+  for (size_t j = 0; j < skeleton.joints.size(); j++) {
+    pose[j] = skeleton.joints[j].rest;
+  }
+  if (clip.duration > 0.0f) {
+    time = std::fmod(time, clip.duration);
+    time = time < 0.0f ? time + clip.duration : time;
+  }
+
+  for (const AnimationChannel& channel : clip.channels) {
+    const glm::vec4 value = SampleChannel(channel, time);
+    JointPose& joint = pose[channel.joint];
+    switch (channel.path) {
+      case ANIMATION_PATH_TRANSLATION:
+        joint.translation = glm::vec3(value);
+        break;
+      case ANIMATION_PATH_ROTATION:
+        joint.rotation = glm::normalize(ToQuat(value));
+        break;
+      case ANIMATION_PATH_SCALE:
+        joint.scale = glm::vec3(value);
+        break;
+    }
+  }
+}
+
+void ComputeJointPalette(const Skeleton& skeleton, const JointPose* pose, glm::mat4* palette) {
+  // World matrices first, parents are always done before their children
+  for (size_t j = 0; j < skeleton.joints.size(); j++) {
+    const Joint& joint = skeleton.joints[j];
+    glm::mat4 local = glm::mat4_cast(pose[j].rotation);
+    local[0] *= pose[j].scale.x;
+    local[1] *= pose[j].scale.y;
+    local[2] *= pose[j].scale.z;
+    local[3] = glm::vec4(pose[j].translation, 1.0f);
+    const glm::mat4 parent = joint.parent < 0 ? joint.parentMatrix
+                                              : palette[joint.parent] * joint.parentMatrix;
+    palette[j] = parent * local;
+  }
+  for (size_t j = 0; j < skeleton.joints.size(); j++) {
+    palette[j] = palette[j] * skeleton.joints[j].inverseBind;
+  }
+}
+
+void SkinVertices(const MeshVertex* vertices, const SkinVertex* skin, size_t count,
+                  const glm::mat4* palette, MeshVertex* dst) {
+  const float kWeightScale = 1.0f / 65535.0f;
+  for (size_t v = 0; v < count; v++) {
+    const SkinVertex& influence = skin[v];
+    dst[v] = vertices[v];
+    if ((influence.weights[0] | influence.weights[1] | influence.weights[2] |
+         influence.weights[3]) == 0) {
+      continue;
+    }
+
+    glm::mat4 blended(0.0f);
+    for (int i = 0; i < 4; i++) {
+      if (influence.weights[i] != 0) {
+        blended = blended + palette[influence.joints[i]] * (influence.weights[i] * kWeightScale);
+      }
+    }
+    const glm::mat3 rotation(blended);
+    dst[v].pos = glm::vec3(blended * glm::vec4(vertices[v].pos, 1.0f));
+    dst[v].normal = glm::normalize(rotation * vertices[v].normal);
+    dst[v].tangent = glm::vec4(glm::normalize(rotation * glm::vec3(vertices[v].tangent)),
+                               vertices[v].tangent.w);
+  }
+}
+
+} // navs namespace
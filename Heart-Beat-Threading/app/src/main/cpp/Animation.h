@@ -0,0 +1,86 @@
+#ifndef __ANIMATION_HPP__
+#define __ANIMATION_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "MeshData.h"
+
+// Skeletal animation without Vulkan: keyframes are sampled into a pose per frame, the pose is
+// turned into a palette of skinning matrices and the palette blends the bind pose vertices,
+// either on the CPU with SkinVertices() or in shaders/skin.comp.
+
+namespace navs {
+
+// Four joint influences per vertex, kept next to the MeshVertex array with the same indices
+struct SkinVertex {
+  uint16_t joints[4];
+  uint16_t weights[4];  // unorm16 summing to 65535, all zero leaves the vertex where it is
+};
+
+struct JointPose {
+  glm::vec3 translation;
+  glm::quat rotation;
+  glm::vec3 scale;
+};
+
+struct Joint {
+  int32_t parent;          // always lower than the joint's own index, -1 for roots
+  glm::mat4 parentMatrix;  // static nodes between the parent joint (or the scene root) and this
+  glm::mat4 inverseBind;
+  JointPose rest;
+};
+
+// Joints are sorted parents first. The mesh transform of the importer is folded into the root
+// parent matrices and the inverse bind matrices, so palettes apply to decoded vertices as is.
+struct Skeleton {
+  std::vector<Joint> joints;
+};
+
+typedef enum AnimationPath {
+  ANIMATION_PATH_TRANSLATION = 0,
+  ANIMATION_PATH_ROTATION = 1,
+  ANIMATION_PATH_SCALE = 2
+} AnimationPath;
+
+typedef enum AnimationInterpolation {
+  ANIMATION_INTERPOLATION_STEP = 0,
+  ANIMATION_INTERPOLATION_LINEAR = 1,
+  ANIMATION_INTERPOLATION_CUBIC_SPLINE = 2
+} AnimationInterpolation;
+
+struct AnimationChannel {
+  uint32_t joint;
+  AnimationPath path;
+  AnimationInterpolation interpolation;
+  std::vector<float> times;
+  // xyz, or a quaternion as xyzw. Cubic splines store in tangent, value and out tangent per key.
+  std::vector<glm::vec4> values;
+};
+
+struct AnimationClip {
+  std::string name;
+  float duration;
+  std::vector<AnimationChannel> channels;
+};
+
+// Poses every joint at time, which wraps around the clip duration. Joints no channel targets
+// keep their rest pose.
+void SampleAnimation(const Skeleton& skeleton, const AnimationClip& clip, float time,
+                     JointPose* pose);
+
+// palette[j] = world matrix of joint j * its inverse bind matrix
+void ComputeJointPalette(const Skeleton& skeleton, const JointPose* pose, glm::mat4* palette);
+
+// Linear blend skinning of count vertices into dst, the reference for shaders/skin.comp.
+// Normals and tangents go through the upper 3x3 of the blended matrix and are renormalized.
+void SkinVertices(const MeshVertex* vertices, const SkinVertex* skin, size_t count,
+                  const glm::mat4* palette, MeshVertex* dst);
+
+} // navs namespace
+#endif // __ANIMATION_HPP__
@@ -0,0 +1,188 @@
+#include "AssetIO.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+namespace navs {
+
+namespace {
+
+#ifdef __ANDROID__
+AAssetManager* gAssetManager = nullptr;
+#else
+std::string gAssetRoot = "app/src/main/assets";
+#endif
+
+int GetAdvice(AssetAccess access) {
+  switch (access) {
+    case ASSET_ACCESS_SEQUENTIAL:
+      return MADV_SEQUENTIAL;
+    case ASSET_ACCESS_RANDOM:
+      return MADV_RANDOM;
+    case ASSET_ACCESS_WILLNEED:
+      return MADV_WILLNEED;
+    default:
+      return MADV_NORMAL;
+  }
+}
+
+// Maps length bytes at offset of fd, offset does not have to be page aligned
+bool MapFile(int fd, off_t offset, size_t length, AssetAccess access, void** mapBase,
+             size_t* mapLength, const uint8_t** data) {
+  const off_t pageSize = sysconf(_SC_PAGESIZE);
+  const off_t alignedOffset = offset / pageSize * pageSize;
+  const size_t padding = static_cast<size_t>(offset - alignedOffset);
+
+  void* base = mmap(nullptr, length + padding, PROT_READ, MAP_PRIVATE, fd, alignedOffset);
+  if (base == MAP_FAILED) {
+    return false;
+  }
+  if (access != ASSET_ACCESS_DEFAULT) {
+    madvise(base, length + padding, GetAdvice(access));
+  }
+  *mapBase = base;
+  *mapLength = length + padding;
+  *data = static_cast<const uint8_t*>(base) + padding;
+  return true;
+}
+
+} // anonymous namespace
+
+AssetView::~AssetView() {
+  Close();
+}
+
+AssetView::AssetView(AssetView&& other) {
+  *this = std::move(other);
+}
+
+AssetView& AssetView::operator=(AssetView&& other) {
+  if (this != &other) {
+    Close();
+    mData = other.mData;
+    mSize = other.mSize;
+    mMapBase = other.mMapBase;
+    mMapLength = other.mMapLength;
+    mCopy = other.mCopy;
+    mAsset = other.mAsset;
+    other.mData = nullptr;
+    other.mSize = 0;
+    other.mMapBase = nullptr;
+    other.mMapLength = 0;
+    other.mCopy = nullptr;
+    other.mAsset = nullptr;
+  }
+  return *this;
+}
+
+void AssetView::Close(void) {
+  if (mMapBase != nullptr) {
+    munmap(mMapBase, mMapLength);
+  }
+#ifdef __ANDROID__
+  if (mAsset != nullptr) {
+    AAsset_close(mAsset);
+  }
+#endif
+  free(mCopy);
+
+  mData = nullptr;
+  mSize = 0;
+  mMapBase = nullptr;
+  mMapLength = 0;
+  mCopy = nullptr;
+  mAsset = nullptr;
+}
+
+#ifdef __ANDROID__
+
+void SetAssetManager(AAssetManager* assetManager) {
+  gAssetManager = assetManager;
+}
+
+bool OpenAsset(const char* path, AssetView* view, AssetAccess access) {
+  view->Close();
+  if (gAssetManager == nullptr) {
+    return false;
+  }
+
+  AAsset* asset = AAssetManager_open(gAssetManager, path,
+                                     access == ASSET_ACCESS_RANDOM ? AASSET_MODE_RANDOM
+                                                                   : AASSET_MODE_BUFFER);
+  if (asset == nullptr) {
+    return false;
+  }
+  view->mSize = static_cast<size_t>(AAsset_getLength(asset));
+
+  // Uncompressed assets sit in the APK as is, map them through its file descriptor
+  off_t start, length;
+  int fd = AAsset_openFileDescriptor(asset, &start, &length);
+  if (fd >= 0) {
+    bool mapped = MapFile(fd, start, static_cast<size_t>(length), access, &view->mMapBase,
+                          &view->mMapLength, &view->mData);
+    close(fd);
+    if (mapped) {
+      AAsset_close(asset);
+      return true;
+    }
+  }
+
+  // Compressed assets are inflated by the asset manager, keep the asset open to keep its buffer
+  view->mData = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+  if (view->mData != nullptr) {
+    view->mAsset = asset;
+    return true;
+  }
+
+  view->mCopy = static_cast<uint8_t*>(malloc(view->mSize));
+  AAsset_read(asset, view->mCopy, view->mSize);
+  AAsset_close(asset);
+  view->mData = view->mCopy;
+  return true;
+}
+
+#else
+
+void SetAssetRoot(const char* directory) {
+  gAssetRoot = directory;
+}
+
+bool OpenAsset(const char* path, AssetView* view, AssetAccess access) {
+  view->Close();
+
+  const std::string fullPath = gAssetRoot + "/" + path;
+  int fd = open(fullPath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  view->mSize = static_cast<size_t>(fileStat.st_size);
+
+  bool mapped = MapFile(fd, 0, view->mSize, access, &view->mMapBase, &view->mMapLength,
+                        &view->mData);
+  if (!mapped) {
+    view->mCopy = static_cast<uint8_t*>(malloc(view->mSize));
+    mapped = pread(fd, view->mCopy, view->mSize, 0) == static_cast<ssize_t>(view->mSize);
+    view->mData = view->mCopy;
+  }
+  close(fd);
+  if (!mapped) {
+    view->Close();
+  }
+  return mapped;
+}
+
+#endif // __ANDROID__
+
+} // navs namespace
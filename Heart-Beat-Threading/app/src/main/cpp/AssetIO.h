@@ -0,0 +1,70 @@
+#ifndef __ASSET_IO_HPP__
+#define __ASSET_IO_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif
+
+namespace navs {
+
+// How an asset is about to be read, forwarded to the kernel as a readahead hint
+typedef enum AssetAccess {
+  ASSET_ACCESS_DEFAULT = 0,
+  ASSET_ACCESS_SEQUENTIAL,  // read front to back once (shaders, textures)
+  ASSET_ACCESS_RANDOM,      // accessors jump around (binary glTF)
+  ASSET_ACCESS_WILLNEED,    // start paging the whole file in now
+} AssetAccess;
+
+// Read-only view of a whole asset. Memory mapped whenever the platform allows it, copied into
+// a heap buffer only as a last resort. The view owns its mapping and releases it when destroyed,
+// so it can be moved but not copied.
+class AssetView {
+ public:
+  AssetView() {}
+  ~AssetView();
+  AssetView(AssetView&& other);
+  AssetView& operator=(AssetView&& other);
+  AssetView(const AssetView&) = delete;
+  AssetView& operator=(const AssetView&) = delete;
+
+  const uint8_t* data(void) const { return mData; }
+  size_t size(void) const { return mSize; }
+  bool valid(void) const { return mData != nullptr; }
+  // False when the view had to fall back to a heap copy
+  bool mapped(void) const { return mMapBase != nullptr || mAsset != nullptr; }
+
+  void Close(void);
+
+ private:
+  friend bool OpenAsset(const char* path, AssetView* view, AssetAccess access);
+
+  const uint8_t* mData = nullptr;
+  size_t mSize = 0;
+
+  // Exactly one of these backs mData
+  void* mMapBase = nullptr;
+  size_t mMapLength = 0;
+  uint8_t* mCopy = nullptr;
+#ifdef __ANDROID__
+  AAsset* mAsset = nullptr;
+#else
+  void* mAsset = nullptr;
+#endif
+};
+
+// Asset paths are relative to the APK assets folder on Android and to the root directory on the
+// host (the app's assets folder by default)
+#ifdef __ANDROID__
+void SetAssetManager(AAssetManager* assetManager);
+#else
+void SetAssetRoot(const char* directory);
+#endif
+
+// Opens path and maps all of it into view, returns false if the asset does not exist
+bool OpenAsset(const char* path, AssetView* view, AssetAccess access = ASSET_ACCESS_DEFAULT);
+
+} // navs namespace
+#endif // __ASSET_IO_HPP__
@@ -0,0 +1,109 @@
+#include "AssetStreamer.h"
+
+#include "VulkanUtil.h"
+
+AssetStreamer::AssetStreamer(UploadQueue* uploadQueue) :
+    mUploadQueue(uploadQueue)
+{
+  mThread = std::thread(&AssetStreamer::ThreadLoop, this);
+}
+
+AssetStreamer::~AssetStreamer() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mStop = true;
+  mWorkReady.notify_all();
+  // The load in progress may be waiting for ring space that only submissions from this thread
+  // free up
+  while (mLoading) {
+    lock.unlock();
+    mUploadQueue->Submit();
+    lock.lock();
+    mLoadDone.wait_for(lock, std::chrono::milliseconds(1), [&]() { return !mLoading; });
+  }
+  lock.unlock();
+  mThread.join();
+
+  // Nothing may still be copying into what gets discarded
+  mUploadQueue->Flush();
+  for (Job& job : mLoaded) {
+    job.discard();
+  }
+  for (Job& job : mQueued) {
+    job.discard();
+  }
+}
+
+void AssetStreamer::Request(const char* name, std::function<bool()> load,
+                            std::function<void()> publish, std::function<void()> discard) {
+  Job job;
+  job.name = name;
+  job.load = std::move(load);
+  job.publish = std::move(publish);
+  job.discard = std::move(discard);
+  job.loaded = false;
+  job.ticket = 0;
+  job.requested = std::chrono::steady_clock::now();
+  job.loadMs = 0.0;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueued.push_back(std::move(job));
+  }
+  mWorkReady.notify_one();
+}
+
+void AssetStreamer::Poll(void) {
+  mUploadQueue->Submit();
+
+  for (;;) {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (mLoaded.empty() || !mUploadQueue->IsComplete(mLoaded.front().ticket)) {
+        return;
+      }
+      job = std::move(mLoaded.front());
+      mLoaded.pop_front();
+    }
+    // A failed load may have staged uploads before it gave up, they have completed as well
+    if (!job.loaded) {
+      LOGE("%s: failed to load, keeping what was there", job.name.c_str());
+      job.discard();
+      continue;
+    }
+    job.publish();
+    LOGI("%s: streamed in %.2f ms, %.2f ms of it loading", job.name.c_str(),
+         std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                   job.requested).count(), job.loadMs);
+  }
+}
+
+size_t AssetStreamer::Pending(void) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mQueued.size() + mLoaded.size() + (mLoading ? 1 : 0);
+}
+
+void AssetStreamer::ThreadLoop(void) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  for (;;) {
+    mWorkReady.wait(lock, [&]() { return mStop || !mQueued.empty(); });
+    if (mStop) {
+      return;
+    }
+    Job job = std::move(mQueued.front());
+    mQueued.pop_front();
+    mLoading = true;
+    lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    job.loaded = job.load();
+    // Taken after the load, so it covers every upload the load staged
+    job.ticket = mUploadQueue->GetTicket();
+    job.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                           start).count();
+
+    lock.lock();
+    mLoaded.push_back(std::move(job));
+    mLoading = false;
+    mLoadDone.notify_all();
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef __ASSET_STREAMER_HPP__
+#define __ASSET_STREAMER_HPP__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "UploadQueue.h"
+
+// Loads assets on a background thread so the first frame never waits for them. A request is
+// loaded on the streaming thread, which decodes it and stages its uploads on the UploadQueue,
+// then published on the render thread once those uploads have executed. Requests load one at a
+// time in the order they were made; the renderer draws whatever it had before until then.
+class AssetStreamer {
+ public:
+  // uploadQueue must have been created on the thread that calls Poll()
+  explicit AssetStreamer(UploadQueue* uploadQueue);
+  // Waits for the request being loaded, then discards every request not published yet
+  ~AssetStreamer();
+
+  // load runs on the streaming thread, publish later on the thread calling Poll(). discard runs
+  // there instead when load returns false or the streamer is destroyed first, whether or not
+  // load has run, and frees anything load or the request itself allocated.
+  void Request(const char* name, std::function<bool()> load, std::function<void()> publish,
+               std::function<void()> discard);
+
+  // Submits the uploads staged since the last call and publishes every loaded request whose
+  // uploads have completed. Call once per frame, between frames.
+  void Poll(void);
+
+  // Requests not published yet
+  size_t Pending(void);
+
+ private:
+  struct Job {
+    std::string name;
+    std::function<bool()> load;
+    std::function<void()> publish;
+    std::function<void()> discard;
+    bool loaded;
+    uint64_t ticket;
+    std::chrono::steady_clock::time_point requested;
+    double loadMs;
+  };
+
+  void ThreadLoop(void);
+
+  UploadQueue* mUploadQueue;
+  std::thread mThread;
+
+  // Guarded by mMutex. Jobs move from mQueued to the streaming thread and on to mLoaded.
+  std::mutex mMutex;
+  std::condition_variable mWorkReady;
+  std::condition_variable mLoadDone;
+  std::deque<Job> mQueued;
+  std::deque<Job> mLoaded;
+  bool mLoading = false;
+  bool mStop = false;
+};
+
+#endif // __ASSET_STREAMER_HPP__
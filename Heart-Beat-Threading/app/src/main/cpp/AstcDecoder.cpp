@@ -0,0 +1,805 @@
+#include "AstcDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "KtxFile.h"
+#include "WorkerPool.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ASTC_SIMD_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ASTC_SIMD_SSE
+#endif
+
+namespace navs {
+
+namespace {
+
+// VkFormat values used below
+const uint32_t kFormatR8G8B8A8Unorm = 37;
+const uint32_t kFormatR8G8B8A8Srgb = 43;
+const uint32_t kFormatAstc4x4Unorm = 157;
+const uint32_t kFormatAstc12x12Srgb = 184;
+
+const uint32_t kMaxTexels = 12 * 12;
+const uint32_t kMaxWeights = 64;
+const uint32_t kMaxColorValues = 18;
+// Blocks decoded per job, 16K texels of 8x8 blocks
+const uint32_t kBlocksPerJob = 256;
+
+const uint8_t kErrorColor[4] = {255, 0, 255, 255};
+
+// Integer sequence encoding ranges, values are 0 to levels - 1 made of a trit or quint, or
+// neither, above some bits
+struct IseRange {
+  uint16_t levels;
+  uint8_t trits;
+  uint8_t quints;
+  uint8_t bits;
+};
+
+const uint32_t kRangeCount = 21;
+const IseRange kRanges[kRangeCount] = {
+    {2, 0, 0, 1},   {3, 1, 0, 0},   {4, 0, 0, 2},   {5, 0, 1, 0},   {6, 1, 0, 1},
+    {8, 0, 0, 3},   {10, 0, 1, 1},  {12, 1, 0, 2},  {16, 0, 0, 4},  {20, 0, 1, 2},
+    {24, 1, 0, 3},  {32, 0, 0, 5},  {40, 0, 1, 3},  {48, 1, 0, 4},  {64, 0, 0, 6},
+    {80, 0, 1, 4},  {96, 1, 0, 5},  {128, 0, 0, 7}, {160, 0, 1, 5}, {192, 1, 0, 6},
+    {256, 0, 0, 8},
+};
+// Weights only go up to 32 levels, colors need at least 6
+const uint32_t kWeightRangeCount = 12;
+const uint32_t kMinColorRange = 4;
+
+uint32_t GetIseBitCount(uint32_t range, uint32_t count) {
+  const IseRange& r = kRanges[range];
+  return count * r.bits + (r.trits ? (8 * count + 4) / 5 : 0) +
+         (r.quints ? (7 * count + 2) / 3 : 0);
+}
+
+// Repeats the bits of value until toBits are filled
+uint32_t Replicate(uint32_t value, uint32_t fromBits, uint32_t toBits) {
+  uint32_t result = 0;
+  int shift = static_cast<int>(toBits);
+  while (shift > 0) {
+    shift -= fromBits;
+    result |= shift >= 0 ? value << shift : value >> -shift;
+  }
+  return result & ((1u << toBits) - 1);
+}
+
+// Unquantized value of a trit or quint d above bits m, the scheme both weights and colors use
+uint32_t Unquantize(const IseRange& r, uint32_t d, uint32_t m, uint32_t c, uint32_t b,
+                    uint32_t topBit) {
+  const uint32_t a = (m & 1) ? (topBit << 1) - 1 : 0;
+  uint32_t t = d * c + b;
+  t ^= a;
+  return (a & (topBit >> 1)) | (t >> 2);
+}
+
+// Decoding tables, built once
+struct Tables {
+  uint8_t trits[256][5];
+  uint8_t quints[128][3];
+  // Weights to 0..64 and colors to 0..255 by range and encoded value
+  uint8_t weights[kWeightRangeCount][32];
+  uint8_t colors[kRangeCount][256];
+
+  Tables() {
+    for (uint32_t t = 0; t < 256; t++) {
+      DecodeTrits(t, trits[t]);
+    }
+    for (uint32_t q = 0; q < 128; q++) {
+      DecodeQuints(q, quints[q]);
+    }
+    for (uint32_t range = 0; range < kWeightRangeCount; range++) {
+      for (uint32_t v = 0; v < kRanges[range].levels; v++) {
+        weights[range][v] = UnquantizeWeight(range, v);
+      }
+    }
+    for (uint32_t range = 0; range < kRangeCount; range++) {
+      for (uint32_t v = 0; v < kRanges[range].levels; v++) {
+        colors[range][v] = UnquantizeColor(range, v);
+      }
+    }
+  }
+
+  static uint32_t Bit(uint32_t value, uint32_t bit) { return (value >> bit) & 1; }
+
+  // Five trits packed into 8 bits
+  static void DecodeTrits(uint32_t t, uint8_t* out) {
+    uint32_t c;
+    if (((t >> 2) & 7) == 7) {
+      c = ((t >> 5) & 7) << 2 | (t & 3);
+      out[4] = 2;
+      out[3] = 2;
+    } else {
+      c = t & 0x1F;
+      if (((t >> 5) & 3) == 3) {
+        out[4] = 2;
+        out[3] = Bit(t, 7);
+      } else {
+        out[4] = Bit(t, 7);
+        out[3] = (t >> 5) & 3;
+      }
+    }
+    if ((c & 3) == 3) {
+      out[2] = 2;
+      out[1] = Bit(c, 4);
+      out[0] = Bit(c, 3) << 1 | (Bit(c, 2) & ~Bit(c, 3) & 1);
+    } else if (((c >> 2) & 3) == 3) {
+      out[2] = 2;
+      out[1] = 2;
+      out[0] = c & 3;
+    } else {
+      out[2] = Bit(c, 4);
+      out[1] = (c >> 2) & 3;
+      out[0] = Bit(c, 1) << 1 | (Bit(c, 0) & ~Bit(c, 1) & 1);
+    }
+  }
+
+  // Three quints packed into 7 bits
+  static void DecodeQuints(uint32_t q, uint8_t* out) {
+    if (((q >> 1) & 3) == 3 && ((q >> 5) & 3) == 0) {
+      const uint32_t notBit0 = ~q & 1;
+      out[2] = Bit(q, 0) << 2 | (Bit(q, 4) & notBit0) << 1 | (Bit(q, 3) & notBit0);
+      out[1] = 4;
+      out[0] = 4;
+      return;
+    }
+    uint32_t c;
+    if (((q >> 1) & 3) == 3) {
+      out[2] = 4;
+      c = ((q >> 3) & 3) << 3 | (~(q >> 5) & 3) << 1 | (q & 1);
+    } else {
+      out[2] = (q >> 5) & 3;
+      c = q & 0x1F;
+    }
+    if ((c & 7) == 5) {
+      out[1] = 4;
+      out[0] = (c >> 3) & 3;
+    } else {
+      out[1] = (c >> 3) & 3;
+      out[0] = c & 7;
+    }
+  }
+
+  static uint8_t UnquantizeWeight(uint32_t range, uint32_t v) {
+    const IseRange& r = kRanges[range];
+    const uint32_t d = v >> r.bits;
+    const uint32_t m = v & ((1u << r.bits) - 1);
+    uint32_t w;
+    if (!r.trits && !r.quints) {
+      w = Replicate(v, r.bits, 6);
+    } else if (r.bits == 0) {
+      static const uint8_t kTrit[3] = {0, 32, 63};
+      static const uint8_t kQuint[5] = {0, 16, 32, 47, 63};
+      w = r.trits ? kTrit[d] : kQuint[d];
+    } else {
+      const uint32_t h = m >> 1;
+      switch (r.levels) {
+        case 6: w = Unquantize(r, d, m, 50, 0, 0x40); break;
+        case 10: w = Unquantize(r, d, m, 28, 0, 0x40); break;
+        case 12: w = Unquantize(r, d, m, 23, h * 0x45, 0x40); break;
+        case 20: w = Unquantize(r, d, m, 13, h * 0x42, 0x40); break;
+        default: w = Unquantize(r, d, m, 11, h << 5 | h, 0x40); break;  // 24
+      }
+    }
+    return static_cast<uint8_t>(w > 32 ? w + 1 : w);
+  }
+
+  static uint8_t UnquantizeColor(uint32_t range, uint32_t v) {
+    const IseRange& r = kRanges[range];
+    if (!r.trits && !r.quints) {
+      return static_cast<uint8_t>(Replicate(v, r.bits, 8));
+    }
+    if (r.bits == 0) {
+      // Below the ranges colors can use
+      return static_cast<uint8_t>(v * 255 / (r.levels - 1));
+    }
+    const uint32_t d = v >> r.bits;
+    const uint32_t m = v & ((1u << r.bits) - 1);
+    // Bits above the lowest, spread over the 9 bit pattern of the range
+    const uint32_t h = m >> 1;
+    uint32_t b, c;
+    switch (r.levels) {
+      case 6: b = 0; c = 204; break;
+      case 10: b = 0; c = 113; break;
+      case 12: b = h * 0x116; c = 93; break;
+      case 20: b = h * 0x10C; c = 54; break;
+      case 24: b = h << 7 | h << 2 | h; c = 44; break;
+      case 40: b = h << 7 | h << 1 | h >> 1; c = 26; break;
+      case 48: b = h << 6 | h; c = 22; break;
+      case 80: b = h << 6 | h >> 1; c = 13; break;
+      case 96: b = h << 5 | h >> 2; c = 11; break;
+      case 160: b = h << 5 | h >> 3; c = 6; break;
+      default: b = h << 4 | h >> 4; c = 5; break;  // 192
+    }
+    return static_cast<uint8_t>(Unquantize(r, d, m, c, b, 0x100));
+  }
+};
+
+const Tables& GetTables(void) {
+  static const Tables tables;
+  return tables;
+}
+
+// Bilinear infill of a weight grid over the block's texels: the grid weight to the top left of
+// every texel and the 1/16ths of it and its right, lower and lower right neighbors
+struct Infill {
+  uint8_t index[kMaxTexels];
+  uint8_t factors[kMaxTexels][4];
+};
+
+void BuildInfill(uint32_t blockWidth, uint32_t blockHeight, uint32_t gridWidth,
+                 uint32_t gridHeight, Infill* infill) {
+  const uint32_t ds = (1024 + blockWidth / 2) / (blockWidth - 1);
+  const uint32_t dt = (1024 + blockHeight / 2) / (blockHeight - 1);
+  for (uint32_t t = 0; t < blockHeight; t++) {
+    for (uint32_t s = 0; s < blockWidth; s++) {
+      const uint32_t gs = (ds * s * (gridWidth - 1) + 32) >> 6;
+      const uint32_t gt = (dt * t * (gridHeight - 1) + 32) >> 6;
+      const uint32_t fs = gs & 0xF;
+      const uint32_t ft = gt & 0xF;
+      const uint32_t w11 = (fs * ft + 8) >> 4;
+      const uint32_t texel = t * blockWidth + s;
+      infill->index[texel] = static_cast<uint8_t>((gs >> 4) + (gt >> 4) * gridWidth);
+      infill->factors[texel][0] = static_cast<uint8_t>(16 - fs - ft + w11);
+      infill->factors[texel][1] = static_cast<uint8_t>(fs - w11);
+      infill->factors[texel][2] = static_cast<uint8_t>(ft - w11);
+      infill->factors[texel][3] = static_cast<uint8_t>(w11);
+    }
+  }
+}
+
+// Per DecodeAstc() call, shared by every block
+struct Context {
+  uint32_t blockWidth;
+  uint32_t blockHeight;
+  bool srgb;
+  // For every grid size up to the block's, indexed by GetInfillIndex()
+  std::vector<Infill> infills;
+
+  uint32_t GetInfillIndex(uint32_t gridWidth, uint32_t gridHeight) const {
+    return (gridHeight - 2) * (blockWidth - 1) + gridWidth - 2;
+  }
+};
+
+struct Block {
+  uint64_t bits[2];
+
+  uint32_t Read(uint32_t offset, uint32_t count) const {
+    if (count == 0 || offset >= 128) {
+      return 0;
+    }
+    uint64_t value = offset < 64 ? bits[0] >> offset : bits[1] >> (offset - 64);
+    if (offset < 64 && offset + count > 64) {
+      value |= bits[1] << (64 - offset);
+    }
+    return static_cast<uint32_t>(value & ((1ull << count) - 1));
+  }
+};
+
+uint64_t ReverseBits(uint64_t v) {
+  v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+  v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+  v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+  v = ((v >> 8) & 0x00FF00FF00FF00FFull) | ((v & 0x00FF00FF00FF00FFull) << 8);
+  v = ((v >> 16) & 0x0000FFFF0000FFFFull) | ((v & 0x0000FFFF0000FFFFull) << 16);
+  return (v >> 32) | (v << 32);
+}
+
+// Reads count values of range from offset on. Trits and quints are packed in groups of five
+// and three between the bits of each value, only the packed bits of values present are read.
+void DecodeIse(const Block& block, uint32_t offset, uint32_t range, uint32_t count,
+               uint8_t* out) {
+  static const uint8_t kTritBits[5] = {2, 2, 1, 2, 1};
+  static const uint8_t kTritShifts[5] = {0, 2, 4, 5, 7};
+  static const uint8_t kQuintBits[3] = {3, 2, 2};
+  static const uint8_t kQuintShifts[3] = {0, 3, 5};
+  const IseRange& r = kRanges[range];
+  const Tables& tables = GetTables();
+  const uint32_t group = r.trits ? 5 : r.quints ? 3 : 1;
+  for (uint32_t i = 0; i < count; i += group) {
+    const uint32_t n = std::min(group, count - i);
+    uint32_t packed = 0;
+    for (uint32_t j = 0; j < n; j++) {
+      out[i + j] = static_cast<uint8_t>(block.Read(offset, r.bits));
+      offset += r.bits;
+      if (r.trits) {
+        packed |= block.Read(offset, kTritBits[j]) << kTritShifts[j];
+        offset += kTritBits[j];
+      } else if (r.quints) {
+        packed |= block.Read(offset, kQuintBits[j]) << kQuintShifts[j];
+        offset += kQuintBits[j];
+      }
+    }
+    for (uint32_t j = 0; r.trits && j < n; j++) {
+      out[i + j] |= tables.trits[packed][j] << r.bits;
+    }
+    for (uint32_t j = 0; r.quints && j < n; j++) {
+      out[i + j] |= tables.quints[packed][j] << r.bits;
+    }
+  }
+}
+
+// Grid size, planes and weight range of a block mode, false for reserved modes
+bool DecodeBlockMode(uint32_t mode, uint32_t* gridWidth, uint32_t* gridHeight, bool* dualPlane,
+                     uint32_t* weightRange) {
+  uint32_t range = (mode >> 4) & 1;
+  uint32_t h = (mode >> 9) & 1;
+  uint32_t d = (mode >> 10) & 1;
+  const uint32_t a = (mode >> 5) & 3;
+  if ((mode & 3) != 0) {
+    range |= (mode & 3) << 1;
+    uint32_t b = (mode >> 7) & 3;
+    switch ((mode >> 2) & 3) {
+      case 0: *gridWidth = b + 4; *gridHeight = a + 2; break;
+      case 1: *gridWidth = b + 8; *gridHeight = a + 2; break;
+      case 2: *gridWidth = a + 2; *gridHeight = b + 8; break;
+      default:
+        b &= 1;
+        if (mode & 0x100) {
+          *gridWidth = b + 2;
+          *gridHeight = a + 2;
+        } else {
+          *gridWidth = a + 2;
+          *gridHeight = b + 6;
+        }
+        break;
+    }
+  } else {
+    range |= ((mode >> 2) & 3) << 1;
+    if (((mode >> 2) & 3) == 0) {
+      return false;
+    }
+    const uint32_t b = (mode >> 9) & 3;
+    switch ((mode >> 7) & 3) {
+      case 0: *gridWidth = 12; *gridHeight = a + 2; break;
+      case 1: *gridWidth = a + 2; *gridHeight = 12; break;
+      case 2:
+        *gridWidth = a + 6;
+        *gridHeight = b + 6;
+        d = 0;
+        h = 0;
+        break;
+      default:
+        if (a == 0) {
+          *gridWidth = 6;
+          *gridHeight = 10;
+        } else if (a == 1) {
+          *gridWidth = 10;
+          *gridHeight = 6;
+        } else {
+          return false;
+        }
+        break;
+    }
+  }
+  *dualPlane = d != 0;
+  *weightRange = range - 2 + 6 * h;
+  const uint32_t weightCount = *gridWidth * *gridHeight * (d + 1);
+  const uint32_t weightBits = GetIseBitCount(*weightRange, weightCount);
+  return weightCount <= kMaxWeights && weightBits >= 24 && weightBits <= 96;
+}
+
+// Moves the top bit of b to a and turns b into a signed 6 bit offset
+void BitTransferSigned(int* a, int* b) {
+  *a >>= 1;
+  *a |= *b & 0x80;
+  *b >>= 1;
+  *b &= 0x3F;
+  if (*b & 0x20) {
+    *b -= 0x40;
+  }
+}
+
+uint8_t Clamp(int v) { return static_cast<uint8_t>(std::min(255, std::max(0, v))); }
+
+void SetColor(uint8_t* e, int r, int g, int b, int a) {
+  e[0] = Clamp(r);
+  e[1] = Clamp(g);
+  e[2] = Clamp(b);
+  e[3] = Clamp(a);
+}
+
+// Averages red and green with blue, what endpoints stored swapped encode
+void SetBlueContracted(uint8_t* e, int r, int g, int b, int a) {
+  SetColor(e, (r + b) >> 1, (g + b) >> 1, b, a);
+}
+
+// LDR endpoint pair of a color endpoint mode, false for HDR modes
+bool DecodeEndpoints(uint32_t mode, const uint8_t* values, uint8_t* e0, uint8_t* e1) {
+  int v[8];
+  for (uint32_t i = 0; i < ((mode >> 2) + 1) * 2; i++) {
+    v[i] = values[i];
+  }
+  switch (mode) {
+    case 0:  // Luminance
+      SetColor(e0, v[0], v[0], v[0], 255);
+      SetColor(e1, v[1], v[1], v[1], 255);
+      return true;
+    case 1: {  // Luminance, base and offset
+      const int l0 = (v[0] >> 2) | (v[1] & 0xC0);
+      const int l1 = std::min(255, l0 + (v[1] & 0x3F));
+      SetColor(e0, l0, l0, l0, 255);
+      SetColor(e1, l1, l1, l1, 255);
+      return true;
+    }
+    case 4:  // Luminance and alpha
+      SetColor(e0, v[0], v[0], v[0], v[2]);
+      SetColor(e1, v[1], v[1], v[1], v[3]);
+      return true;
+    case 5:  // Luminance and alpha, base and offset
+      BitTransferSigned(&v[0], &v[1]);
+      BitTransferSigned(&v[2], &v[3]);
+      SetColor(e0, v[0], v[0], v[0], v[2]);
+      SetColor(e1, v[0] + v[1], v[0] + v[1], v[0] + v[1], v[2] + v[3]);
+      return true;
+    case 6:  // RGB, base and scale
+      SetColor(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, 255);
+      SetColor(e1, v[0], v[1], v[2], 255);
+      return true;
+    case 8:  // RGB
+    case 12: {  // RGBA
+      const int a0 = mode == 12 ? v[6] : 255;
+      const int a1 = mode == 12 ? v[7] : 255;
+      if (v[1] + v[3] + v[5] >= v[0] + v[2] + v[4]) {
+        SetColor(e0, v[0], v[2], v[4], a0);
+        SetColor(e1, v[1], v[3], v[5], a1);
+      } else {
+        SetBlueContracted(e0, v[1], v[3], v[5], a1);
+        SetBlueContracted(e1, v[0], v[2], v[4], a0);
+      }
+      return true;
+    }
+    case 9:  // RGB, base and offset
+    case 13: {  // RGBA, base and offset
+      BitTransferSigned(&v[0], &v[1]);
+      BitTransferSigned(&v[2], &v[3]);
+      BitTransferSigned(&v[4], &v[5]);
+      int a0 = 255;
+      int a1 = 255;
+      if (mode == 13) {
+        BitTransferSigned(&v[6], &v[7]);
+        a0 = v[6];
+        a1 = v[6] + v[7];
+      }
+      if (v[1] + v[3] + v[5] >= 0) {
+        SetColor(e0, v[0], v[2], v[4], a0);
+        SetColor(e1, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+      } else {
+        SetBlueContracted(e0, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+        SetBlueContracted(e1, v[0], v[2], v[4], a0);
+      }
+      return true;
+    }
+    case 10:  // RGB, base and scale, plus two alphas
+      SetColor(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, v[4]);
+      SetColor(e1, v[0], v[1], v[2], v[5]);
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint32_t Hash52(uint32_t v) {
+  v ^= v >> 15;
+  v *= 0xEEDE0891;
+  v ^= v >> 5;
+  v += v << 16;
+  v ^= v >> 7;
+  v ^= v >> 3;
+  v ^= v << 6;
+  v ^= v >> 17;
+  return v;
+}
+
+// Partition of texel x, y in a block with seed for its partition index
+uint32_t SelectPartition(uint32_t seed, uint32_t x, uint32_t y, uint32_t partitionCount,
+                         bool smallBlock) {
+  if (smallBlock) {
+    x <<= 1;
+    y <<= 1;
+  }
+  seed += (partitionCount - 1) * 1024;
+  const uint32_t rnum = Hash52(seed);
+  uint32_t seeds[8];
+  for (uint32_t i = 0; i < 8; i++) {
+    seeds[i] = (rnum >> (4 * i)) & 0xF;
+    seeds[i] *= seeds[i];
+  }
+  const uint32_t shift1 = (seed & 1) ? ((seed & 2) ? 4 : 5) : (partitionCount == 3 ? 6 : 5);
+  const uint32_t shift2 = (seed & 1) ? (partitionCount == 3 ? 6 : 5) : ((seed & 2) ? 4 : 5);
+  for (uint32_t i = 0; i < 8; i++) {
+    seeds[i] >>= (i & 1) ? shift2 : shift1;
+  }
+  // z is 0 in 2D, the seeds it would be scaled by don't matter
+  const uint32_t a = (seeds[0] * x + seeds[1] * y + (rnum >> 14)) & 0x3F;
+  const uint32_t b = (seeds[2] * x + seeds[3] * y + (rnum >> 10)) & 0x3F;
+  const uint32_t c = partitionCount < 3 ? 0 : (seeds[4] * x + seeds[5] * y + (rnum >> 6)) & 0x3F;
+  const uint32_t d = partitionCount < 4 ? 0 : (seeds[6] * x + seeds[7] * y + (rnum >> 2)) & 0x3F;
+  if (a >= b && a >= c && a >= d) {
+    return 0;
+  } else if (b >= c && b >= d) {
+    return 1;
+  } else if (c >= d) {
+    return 2;
+  }
+  return 3;
+}
+
+// Two texels: endpoints e0 and e1 of each, 16 bit per channel, interpolated by their weights w
+// out of 64. The top 8 bits of every channel go to out.
+#if defined(ASTC_SIMD_NEON)
+inline void Interpolate2(const uint16_t* e0a, const uint16_t* e1a, const uint16_t* e0b,
+                         const uint16_t* e1b, const uint16_t* w, uint8_t* out) {
+  const uint16x8_t c0 = vcombine_u16(vld1_u16(e0a), vld1_u16(e0b));
+  const uint16x8_t c1 = vcombine_u16(vld1_u16(e1a), vld1_u16(e1b));
+  const uint16x8_t w1 = vld1q_u16(w);
+  const uint16x8_t w0 = vsubq_u16(vdupq_n_u16(64), w1);
+  const uint32x4_t round = vdupq_n_u32(32);
+  const uint32x4_t lo = vmlal_u16(vmull_u16(vget_low_u16(c0), vget_low_u16(w0)),
+                                  vget_low_u16(c1), vget_low_u16(w1));
+  const uint32x4_t hi = vmlal_u16(vmull_u16(vget_high_u16(c0), vget_high_u16(w0)),
+                                  vget_high_u16(c1), vget_high_u16(w1));
+  const uint16x8_t c = vcombine_u16(vshrn_n_u32(vaddq_u32(lo, round), 14),
+                                    vshrn_n_u32(vaddq_u32(hi, round), 14));
+  vst1_u8(out, vmovn_u16(c));
+}
+#elif defined(ASTC_SIMD_SSE)
+inline void Interpolate2(const uint16_t* e0a, const uint16_t* e1a, const uint16_t* e0b,
+                         const uint16_t* e1b, const uint16_t* w, uint8_t* out) {
+  const __m128i c0 = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(e0a)),
+                                        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(e0b)));
+  const __m128i c1 = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(e1a)),
+                                        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(e1b)));
+  const __m128i w1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+  const __m128i w0 = _mm_sub_epi16(_mm_set1_epi16(64), w1);
+  // 32 bit products out of the low and high halves SSE2 multiplies 16 bit lanes into
+  const __m128i lo0 = _mm_mullo_epi16(c0, w0);
+  const __m128i hi0 = _mm_mulhi_epu16(c0, w0);
+  const __m128i lo1 = _mm_mullo_epi16(c1, w1);
+  const __m128i hi1 = _mm_mulhi_epu16(c1, w1);
+  const __m128i round = _mm_set1_epi32(32);
+  __m128i lo = _mm_add_epi32(_mm_unpacklo_epi16(lo0, hi0), _mm_unpacklo_epi16(lo1, hi1));
+  __m128i hi = _mm_add_epi32(_mm_unpackhi_epi16(lo0, hi0), _mm_unpackhi_epi16(lo1, hi1));
+  lo = _mm_srli_epi32(_mm_add_epi32(lo, round), 14);
+  hi = _mm_srli_epi32(_mm_add_epi32(hi, round), 14);
+  const __m128i c = _mm_packs_epi32(lo, hi);
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(c, c));
+}
+#else
+inline void Interpolate2(const uint16_t* e0a, const uint16_t* e1a, const uint16_t* e0b,
+                         const uint16_t* e1b, const uint16_t* w, uint8_t* out) {
+  for (int i = 0; i < 8; i++) {
+    const uint32_t c0 = i < 4 ? e0a[i] : e0b[i - 4];
+    const uint32_t c1 = i < 4 ? e1a[i] : e1b[i - 4];
+    out[i] = static_cast<uint8_t>((c0 * (64 - w[i]) + c1 * w[i] + 32) >> 14);
+  }
+}
+#endif
+
+void FillBlock(const Context& context, const uint8_t color[4], uint8_t* texels) {
+  for (uint32_t i = 0; i < context.blockWidth * context.blockHeight; i++) {
+    memcpy(texels + 4 * i, color, 4);
+  }
+}
+
+// Decodes the 16 bytes of a block into its texels, RGBA8 rows of blockWidth
+void DecodeBlock(const Context& context, const uint8_t* data, uint8_t* texels) {
+  const Tables& tables = GetTables();
+  const uint32_t texelCount = context.blockWidth * context.blockHeight;
+  Block block;
+  memcpy(block.bits, data, sizeof(block.bits));
+
+  const uint32_t mode = block.Read(0, 11);
+  if ((mode & 0x1FF) == 0x1FC) {
+    // Void extent, a constant color in 16 bit channels. HDR is an error in the LDR profile.
+    if (mode & 0x200) {
+      FillBlock(context, kErrorColor, texels);
+      return;
+    }
+    const uint8_t color[4] = {
+        static_cast<uint8_t>(block.Read(72, 8)), static_cast<uint8_t>(block.Read(88, 8)),
+        static_cast<uint8_t>(block.Read(104, 8)), static_cast<uint8_t>(block.Read(120, 8))};
+    FillBlock(context, color, texels);
+    return;
+  }
+
+  uint32_t gridWidth, gridHeight, weightRange;
+  bool dualPlane;
+  const uint32_t partitionCount = block.Read(11, 2) + 1;
+  if (!DecodeBlockMode(mode, &gridWidth, &gridHeight, &dualPlane, &weightRange) ||
+      gridWidth > context.blockWidth || gridHeight > context.blockHeight ||
+      (dualPlane && partitionCount == 4)) {
+    FillBlock(context, kErrorColor, texels);
+    return;
+  }
+  const uint32_t planeCount = dualPlane ? 2 : 1;
+  const uint32_t weightCount = gridWidth * gridHeight * planeCount;
+  uint32_t belowWeights = 128 - GetIseBitCount(weightRange, weightCount);
+
+  // Color endpoint mode of every partition, those of more than one share a base class and
+  // keep the bits that don't fit right below the weights
+  uint32_t endpointModes[4];
+  uint32_t partitionIndex = 0;
+  uint32_t colorOffset = 17;
+  if (partitionCount == 1) {
+    endpointModes[0] = block.Read(13, 4);
+  } else {
+    partitionIndex = block.Read(13, 10);
+    colorOffset = 29;
+    const uint32_t selector = block.Read(23, 2);
+    if (selector == 0) {
+      for (uint32_t i = 0; i < partitionCount; i++) {
+        endpointModes[i] = block.Read(25, 4);
+      }
+    } else {
+      const uint32_t extraBits = 3 * partitionCount - 4;
+      belowWeights -= extraBits;
+      const uint32_t encoded = block.Read(23, 6) | block.Read(belowWeights, extraBits) << 6;
+      for (uint32_t i = 0; i < partitionCount; i++) {
+        endpointModes[i] = (((encoded >> (2 + i)) & 1) + selector - 1) << 2 |
+                           ((encoded >> (2 + partitionCount + 2 * i)) & 3);
+      }
+    }
+  }
+  uint32_t plane2Component = 4;
+  if (dualPlane) {
+    belowWeights -= 2;
+    plane2Component = block.Read(belowWeights, 2);
+  }
+
+  uint32_t colorValueCount = 0;
+  for (uint32_t i = 0; i < partitionCount; i++) {
+    colorValueCount += ((endpointModes[i] >> 2) + 1) * 2;
+  }
+  // Colors take the largest range that fits the bits left between the header and the weights
+  uint32_t colorRange = 0;
+  for (uint32_t range = kRangeCount; colorValueCount <= kMaxColorValues && range-- > 0;) {
+    if (GetIseBitCount(range, colorValueCount) <= belowWeights - colorOffset) {
+      colorRange = range;
+      break;
+    }
+  }
+  if (colorRange < kMinColorRange) {
+    FillBlock(context, kErrorColor, texels);
+    return;
+  }
+
+  uint8_t values[kMaxColorValues];
+  DecodeIse(block, colorOffset, colorRange, colorValueCount, values);
+  for (uint32_t i = 0; i < colorValueCount; i++) {
+    values[i] = tables.colors[colorRange][values[i]];
+  }
+  // 16 bit endpoints, the 8 bit ones repeated or, for sRGB, above 0x80
+  uint16_t endpoints[4][2][4];
+  const uint8_t* partitionValues = values;
+  for (uint32_t i = 0; i < partitionCount; i++) {
+    uint8_t e[2][4];
+    if (!DecodeEndpoints(endpointModes[i], partitionValues, e[0], e[1])) {
+      FillBlock(context, kErrorColor, texels);
+      return;
+    }
+    for (uint32_t j = 0; j < 2; j++) {
+      for (uint32_t c = 0; c < 4; c++) {
+        endpoints[i][j][c] = context.srgb ? static_cast<uint16_t>(e[j][c] << 8 | 0x80)
+                                          : static_cast<uint16_t>(e[j][c] * 257);
+      }
+    }
+    partitionValues += ((endpointModes[i] >> 2) + 1) * 2;
+  }
+
+  // Weights are stored from the top of the block down, planes interleaved. Each plane is
+  // padded for the neighbors the infill reads past the grid's last row and column.
+  Block reversed = {{ReverseBits(block.bits[1]), ReverseBits(block.bits[0])}};
+  uint8_t encoded[kMaxWeights];
+  DecodeIse(reversed, 0, weightRange, weightCount, encoded);
+  uint8_t planes[2][kMaxWeights + 16] = {};
+  for (uint32_t i = 0; i < weightCount; i++) {
+    planes[i % planeCount][i / planeCount] = tables.weights[weightRange][encoded[i]];
+  }
+
+  // Weights of every texel's channels, a spare texel for the pairs of odd sized blocks
+  const Infill& infill = context.infills[context.GetInfillIndex(gridWidth, gridHeight)];
+  uint16_t weights[(kMaxTexels + 1) * 4] = {};
+  uint8_t partitions[kMaxTexels + 1] = {};
+  for (uint32_t i = 0; i < texelCount; i++) {
+    const uint32_t index = infill.index[i];
+    const uint8_t* f = infill.factors[i];
+    for (uint32_t p = 0; p < planeCount; p++) {
+      const uint8_t* w = planes[p];
+      const uint32_t weight = (w[index] * f[0] + w[index + 1] * f[1] +
+                               w[index + gridWidth] * f[2] + w[index + gridWidth + 1] * f[3] +
+                               8) >> 4;
+      for (uint32_t c = 0; c < 4; c++) {
+        if (p == 0 || c == plane2Component) {
+          weights[4 * i + c] = static_cast<uint16_t>(weight);
+        }
+      }
+    }
+    if (partitionCount > 1) {
+      partitions[i] = static_cast<uint8_t>(
+          SelectPartition(partitionIndex, i % context.blockWidth, i / context.blockWidth,
+                          partitionCount, texelCount < 31));
+    }
+  }
+
+  for (uint32_t i = 0; i < texelCount; i += 2) {
+    const uint16_t(*a)[4] = endpoints[partitions[i]];
+    const uint16_t(*b)[4] = endpoints[partitions[i + 1]];
+    if (i + 1 < texelCount) {
+      Interpolate2(a[0], a[1], b[0], b[1], &weights[4 * i], &texels[4 * i]);
+    } else {
+      uint8_t pair[8];
+      Interpolate2(a[0], a[1], b[0], b[1], &weights[4 * i], pair);
+      memcpy(&texels[4 * i], pair, 4);
+    }
+  }
+}
+
+} // anonymous namespace
+
+bool IsAstcFormat(uint32_t vkFormat) {
+  return vkFormat >= kFormatAstc4x4Unorm && vkFormat <= kFormatAstc12x12Srgb;
+}
+
+uint32_t GetAstcDecodedFormat(uint32_t vkFormat) {
+  return (vkFormat - kFormatAstc4x4Unorm) % 2 == 1 ? kFormatR8G8B8A8Srgb
+                                                    : kFormatR8G8B8A8Unorm;
+}
+
+bool DecodeAstc(uint32_t vkFormat, const uint8_t* blocks, uint32_t width, uint32_t height,
+                uint8_t* rgba, WorkerPool* workers) {
+  Context context;
+  uint32_t blockBytes;
+  if (!IsAstcFormat(vkFormat) ||
+      !GetKtxBlockInfo(vkFormat, &context.blockWidth, &context.blockHeight, &blockBytes)) {
+    return false;
+  }
+  context.srgb = GetAstcDecodedFormat(vkFormat) == kFormatR8G8B8A8Srgb;
+  context.infills.resize((context.blockWidth - 1) * (context.blockHeight - 1));
+  for (uint32_t gridHeight = 2; gridHeight <= context.blockHeight; gridHeight++) {
+    for (uint32_t gridWidth = 2; gridWidth <= context.blockWidth; gridWidth++) {
+      BuildInfill(context.blockWidth, context.blockHeight, gridWidth, gridHeight,
+                  &context.infills[context.GetInfillIndex(gridWidth, gridHeight)]);
+    }
+  }
+
+  const uint32_t blocksX = (width + context.blockWidth - 1) / context.blockWidth;
+  const uint32_t blocksY = (height + context.blockHeight - 1) / context.blockHeight;
+  const size_t blockCount = size_t(blocksX) * blocksY;
+  const size_t jobCount = (blockCount + kBlocksPerJob - 1) / kBlocksPerJob;
+  const std::function<void(size_t)> job = [&](size_t j) {
+    uint8_t texels[(kMaxTexels + 1) * 4];
+    const size_t end = std::min(blockCount, (j + 1) * kBlocksPerJob);
+    for (size_t i = j * kBlocksPerJob; i < end; i++) {
+      DecodeBlock(context, blocks + 16 * i, texels);
+      // Blocks on the right and bottom edges may reach past the level
+      const uint32_t x = static_cast<uint32_t>(i % blocksX) * context.blockWidth;
+      const uint32_t y = static_cast<uint32_t>(i / blocksX) * context.blockHeight;
+      const uint32_t rowBytes = 4 * std::min(context.blockWidth, width - x);
+      const uint32_t rows = std::min(context.blockHeight, height - y);
+      for (uint32_t row = 0; row < rows; row++) {
+        memcpy(rgba + 4 * (size_t(y + row) * width + x),
+               texels + 4 * row * context.blockWidth, rowBytes);
+      }
+    }
+  };
+  GetTables();
+  if (workers && jobCount > 1) {
+    workers->ParallelFor(jobCount, job);
+  } else {
+    for (size_t j = 0; j < jobCount; j++) {
+      job(j);
+    }
+  }
+  return true;
+}
+
+} // navs namespace
@@ -0,0 +1,29 @@
+#ifndef __ASTC_DECODER_HPP__
+#define __ASTC_DECODER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+class WorkerPool;
+
+// Software decoder of ASTC textures for devices that can't sample them. Decodes the 2D LDR
+// profile, every block size, partitioning, endpoint mode and dual plane, into RGBA8 texels
+// matching what the hardware returns with an 8 bit decode mode. HDR and malformed blocks decode
+// to the error color, magenta. Endpoints are interpolated two texels at a time with SIMD, blocks
+// are split across the threads of a pool when given one.
+
+namespace navs {
+
+// True for the ASTC VkFormats DecodeAstc() takes
+bool IsAstcFormat(uint32_t vkFormat);
+
+// R8G8B8A8 VkFormat, UNORM or SRGB like vkFormat, that it decodes to
+uint32_t GetAstcDecodedFormat(uint32_t vkFormat);
+
+// Decodes a width x height level of ASTC blocks into 4 * width * height bytes of rgba. False
+// if vkFormat isn't an ASTC format.
+bool DecodeAstc(uint32_t vkFormat, const uint8_t* blocks, uint32_t width, uint32_t height,
+                uint8_t* rgba, WorkerPool* workers = nullptr);
+
+} // navs namespace
+#endif // __ASTC_DECODER_HPP__
@@ -0,0 +1,84 @@
+#include "BakedMesh.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace navs {
+
+static uint64_t AlignSection(uint64_t offset) {
+  return (offset + kBakedMeshAlignment - 1) / kBakedMeshAlignment * kBakedMeshAlignment;
+}
+
+const BakedMeshHeader* ReadBakedMesh(const uint8_t* data, size_t size) {
+  if (!IsBakedMesh(data, size)) {
+    return nullptr;
+  }
+  const BakedMeshHeader* header = reinterpret_cast<const BakedMeshHeader*>(data);
+  if (header->version != kBakedMeshVersion || header->fileSize > size ||
+      header->componentCount > kBakedMeshMaxComponents || header->lodCount == 0 ||
+      (header->indexSize != sizeof(uint16_t) && header->indexSize != sizeof(uint32_t))) {
+    return nullptr;
+  }
+
+  // Every section has to lie inside the file
+  const uint64_t partEnd = header->partOffset + uint64_t(header->partCount) * sizeof(MeshPart);
+  const uint64_t lodEnd = header->lodOffset + uint64_t(header->lodCount) * sizeof(MeshLod);
+  const uint64_t vertexEnd =
+      header->vertexOffset + uint64_t(header->vertexCount) * header->vertexStride;
+  const uint64_t indexEnd = header->indexOffset + uint64_t(header->indexCount) * header->indexSize;
+  if (partEnd > header->fileSize || lodEnd > header->fileSize || vertexEnd > header->fileSize ||
+      indexEnd > header->fileSize) {
+    return nullptr;
+  }
+  return header;
+}
+
+void WriteBakedMesh(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices,
+                    size_t indexCount, const std::vector<MeshPart>& parts,
+                    const std::vector<MeshLod>& lods, const MeshBounds& bounds, const VertexComponent* components,
+                    size_t componentCount, std::vector<uint8_t>* out) {
+  assert(componentCount <= kBakedMeshMaxComponents && !lods.empty());
+
+  BakedMeshHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kBakedMeshMagic;
+  header.version = kBakedMeshVersion;
+  header.componentCount = static_cast<uint32_t>(componentCount);
+  header.vertexStride = 0;
+  for (size_t i = 0; i < componentCount; i++) {
+    header.components[i] = components[i];
+    header.vertexStride += GetComponentSize(components[i]);
+  }
+  header.vertexCount = static_cast<uint32_t>(vertexCount);
+  header.indexCount = static_cast<uint32_t>(indexCount);
+  // Same rule as NarrowIndices at runtime, primitive restart is never enabled
+  header.indexSize = vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+  header.partCount = static_cast<uint32_t>(parts.size());
+  header.lodCount = static_cast<uint32_t>(lods.size());
+  memcpy(header.boundsMin, &bounds.min, sizeof(header.boundsMin));
+  memcpy(header.boundsMax, &bounds.max, sizeof(header.boundsMax));
+
+  header.partOffset = AlignSection(sizeof(BakedMeshHeader));
+  header.lodOffset = AlignSection(header.partOffset + parts.size() * sizeof(MeshPart));
+  header.vertexOffset = AlignSection(header.lodOffset + lods.size() * sizeof(MeshLod));
+  header.indexOffset = AlignSection(header.vertexOffset + vertexCount * header.vertexStride);
+  header.fileSize = header.indexOffset + indexCount * header.indexSize;
+
+  out->assign(header.fileSize, 0);
+  uint8_t* dst = out->data();
+  memcpy(dst, &header, sizeof(header));
+  memcpy(dst + header.partOffset, parts.data(), parts.size() * sizeof(MeshPart));
+  memcpy(dst + header.lodOffset, lods.data(), lods.size() * sizeof(MeshLod));
+  InterleaveVertices(vertices, vertexCount, components, componentCount,
+                     GetQuantizationScale(bounds), dst + header.vertexOffset);
+  if (header.indexSize == sizeof(uint32_t)) {
+    memcpy(dst + header.indexOffset, indices, indexCount * header.indexSize);
+  } else {
+    uint16_t* narrow = reinterpret_cast<uint16_t*>(dst + header.indexOffset);
+    for (size_t i = 0; i < indexCount; i++) {
+      narrow[i] = static_cast<uint16_t>(indices[i]);
+    }
+  }
+}
+
+} // navs namespace
@@ -0,0 +1,60 @@
+#ifndef __BAKED_MESH_HPP__
+#define __BAKED_MESH_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshData.h"
+
+// Versioned GPU ready mesh blob written by tools/MeshBaker. Vertices are already interleaved in
+// the layout recorded in the header, so at runtime the file is mapped and its vertex and index
+// sections are copied into staging memory as is. Every section starts kBakedMeshAlignment
+// aligned. Bump kBakedMeshVersion whenever the layout of the file changes.
+
+namespace navs {
+
+const uint32_t kBakedMeshMagic = 0x4853454D;  // "MESH"
+const uint32_t kBakedMeshVersion = 4;
+const uint32_t kBakedMeshAlignment = 64;
+const uint32_t kBakedMeshMaxComponents = 8;
+
+struct BakedMeshHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t componentCount;
+  uint32_t components[kBakedMeshMaxComponents];  // VertexComponent
+  uint32_t vertexStride;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t indexSize;  // bytes per index, 2 whenever the vertex count allows
+  uint32_t partCount;
+  uint32_t lodCount;  // at least one, the full mesh
+  float boundsMin[3];
+  float boundsMax[3];
+  uint32_t reserved;
+  uint64_t partOffset;  // MeshPart[partCount]
+  uint64_t lodOffset;   // MeshLod[lodCount]
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t fileSize;
+};
+static_assert(sizeof(BakedMeshHeader) == 136, "BakedMeshHeader layout changed, bump the version");
+
+inline bool IsBakedMesh(const uint8_t* data, size_t size) {
+  return size >= sizeof(BakedMeshHeader) &&
+         reinterpret_cast<const BakedMeshHeader*>(data)->magic == kBakedMeshMagic;
+}
+
+// Returns the header if data holds a complete mesh of the current version, nullptr otherwise
+const BakedMeshHeader* ReadBakedMesh(const uint8_t* data, size_t size);
+
+// Interleaves vertices into components and lays out the whole file in out. Indices are stored
+// as 16 bit when every vertex can be addressed that way.
+void WriteBakedMesh(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices,
+                    size_t indexCount, const std::vector<MeshPart>& parts,
+                    const std::vector<MeshLod>& lods, const MeshBounds& bounds, const VertexComponent* components,
+                    size_t componentCount, std::vector<uint8_t>* out);
+
+} // navs namespace
+#endif // __BAKED_MESH_HPP__
@@ -0,0 +1,82 @@
+#include "DeletionQueue.h"
+
+#include "MemoryTracker.h"
+
+using namespace navs;
+
+DeletionQueue::DeletionQueue(VkDevice lDevice) :
+    mLogicDevice(lDevice)
+{
+}
+
+DeletionQueue::~DeletionQueue() {
+  Flush();
+}
+
+void DeletionQueue::Push(std::function<void(VkDevice)>&& destroy) {
+  mEntries.push_back({mFrame, std::move(destroy)});
+}
+
+void DeletionQueue::DestroyBuffer(VkBuffer buffer) {
+  if (buffer == VK_NULL_HANDLE) return;
+  Push([buffer](VkDevice device) { vkDestroyBuffer(device, buffer, nullptr); });
+}
+
+void DeletionQueue::DestroyImage(VkImage image) {
+  if (image == VK_NULL_HANDLE) return;
+  Push([image](VkDevice device) { vkDestroyImage(device, image, nullptr); });
+}
+
+void DeletionQueue::DestroyImageView(VkImageView view) {
+  if (view == VK_NULL_HANDLE) return;
+  Push([view](VkDevice device) { vkDestroyImageView(device, view, nullptr); });
+}
+
+void DeletionQueue::DestroySampler(VkSampler sampler) {
+  if (sampler == VK_NULL_HANDLE) return;
+  Push([sampler](VkDevice device) { vkDestroySampler(device, sampler, nullptr); });
+}
+
+void DeletionQueue::DestroyPipeline(VkPipeline pipeline) {
+  if (pipeline == VK_NULL_HANDLE) return;
+  Push([pipeline](VkDevice device) { vkDestroyPipeline(device, pipeline, nullptr); });
+}
+
+void DeletionQueue::DestroyPipelineLayout(VkPipelineLayout layout) {
+  if (layout == VK_NULL_HANDLE) return;
+  Push([layout](VkDevice device) { vkDestroyPipelineLayout(device, layout, nullptr); });
+}
+
+void DeletionQueue::DestroyPipelineCache(VkPipelineCache cache) {
+  if (cache == VK_NULL_HANDLE) return;
+  Push([cache](VkDevice device) { vkDestroyPipelineCache(device, cache, nullptr); });
+}
+
+void DeletionQueue::DestroyDescriptorPool(VkDescriptorPool pool) {
+  if (pool == VK_NULL_HANDLE) return;
+  Push([pool](VkDevice device) { vkDestroyDescriptorPool(device, pool, nullptr); });
+}
+
+void DeletionQueue::DestroyDescriptorSetLayout(VkDescriptorSetLayout layout) {
+  if (layout == VK_NULL_HANDLE) return;
+  Push([layout](VkDevice device) { vkDestroyDescriptorSetLayout(device, layout, nullptr); });
+}
+
+void DeletionQueue::FreeMemory(VkDeviceMemory memory) {
+  if (memory == VK_NULL_HANDLE) return;
+  Push([memory](VkDevice device) { FreeTrackedMemory(device, memory); });
+}
+
+void DeletionQueue::Collect(uint64_t completedFrame) {
+  while (!mEntries.empty() && mEntries.front().frame <= completedFrame) {
+    mEntries.front().destroy(mLogicDevice);
+    mEntries.pop_front();
+  }
+}
+
+void DeletionQueue::Flush(void) {
+  while (!mEntries.empty()) {
+    mEntries.front().destroy(mLogicDevice);
+    mEntries.pop_front();
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef __DELETION_QUEUE_HPP__
+#define __DELETION_QUEUE_HPP__
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "vulkan_wrapper.h"
+
+// Defers destruction of Vulkan objects until the GPU is done with them. Every object queued is
+// tagged with the frame it was last used in and only released once Collect() is told that frame
+// has retired, so resources can be dropped mid-frame without waiting on the queue.
+class DeletionQueue {
+ public:
+  explicit DeletionQueue(VkDevice lDevice);
+  ~DeletionQueue();
+
+  // Frame recorded from now on, objects queued after this are tagged with it
+  void SetFrame(uint64_t frame) { mFrame = frame; }
+  uint64_t GetFrame(void) const { return mFrame; }
+
+  void DestroyBuffer(VkBuffer buffer);
+  void DestroyImage(VkImage image);
+  void DestroyImageView(VkImageView view);
+  void DestroySampler(VkSampler sampler);
+  void DestroyPipeline(VkPipeline pipeline);
+  void DestroyPipelineLayout(VkPipelineLayout layout);
+  void DestroyPipelineCache(VkPipelineCache cache);
+  void DestroyDescriptorPool(VkDescriptorPool pool);
+  void DestroyDescriptorSetLayout(VkDescriptorSetLayout layout);
+  void FreeMemory(VkDeviceMemory memory);
+
+  // Anything not covered above, run once the current frame has retired
+  void Push(std::function<void(VkDevice)>&& destroy);
+
+  // Releases everything last used in or before completedFrame
+  void Collect(uint64_t completedFrame);
+
+  // Releases everything, the caller must have waited for the device to go idle
+  void Flush(void);
+
+  size_t Pending(void) const { return mEntries.size(); }
+
+ private:
+  VkDevice mLogicDevice;
+  uint64_t mFrame = 0;
+
+  struct Entry {
+    uint64_t frame;
+    std::function<void(VkDevice)> destroy;
+  };
+  // Entries are pushed with a non decreasing frame, so the front is always the oldest
+  std::deque<Entry> mEntries;
+};
+
+#endif // __DELETION_QUEUE_HPP__
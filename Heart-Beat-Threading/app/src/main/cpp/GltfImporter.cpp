@@ -0,0 +1,842 @@
+#include "GltfImporter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "tiny_gltf.h"
+
+#include "TangentGenerator.h"
+#include "WorkerPool.h"
+
+namespace navs {
+
+typedef std::vector<const unsigned char*> BufferList;
+
+// GLB container: 12 byte header, a JSON chunk and an optional BIN chunk, all little endian
+static const uint32_t kGlbMagic = 0x46546C67;      // "glTF"
+static const uint32_t kGlbChunkJson = 0x4E4F534A;  // "JSON"
+static const uint32_t kGlbChunkBin = 0x004E4942;   // "BIN\0"
+
+static bool IsGlb(const unsigned char* data, size_t size) {
+  uint32_t magic;
+  if (size < 20) return false;
+  memcpy(&magic, data, sizeof(magic));
+  return magic == kGlbMagic;
+}
+
+// Renames key of the top level JSON object in text to one of the same length nothing reads, so
+// it is skipped without reformatting the text. [*valueBegin, *valueEnd) is left around its
+// value; false if text has no such key.
+static bool HideTopLevelKey(std::string* text, const char* key, size_t* valueBegin,
+                            size_t* valueEnd) {
+  const size_t keyLength = strlen(key);
+  int depth = 0;
+  size_t found = std::string::npos;
+  for (size_t i = 0; i < text->size(); i++) {
+    const char c = (*text)[i];
+    if (c == '"') {
+      const size_t begin = i;
+      for (i++; i < text->size() && (*text)[i] != '"'; i++) {
+        i += (*text)[i] == '\\' ? 1 : 0;
+      }
+      if (depth == 1 && found == std::string::npos && i - begin - 1 == keyLength &&
+          text->compare(begin + 1, keyLength, key) == 0) {
+        size_t colon = text->find_first_not_of(" \t\r\n", i + 1);
+        if (colon != std::string::npos && (*text)[colon] == ':') {
+          (*text)[begin + 1] = '_';
+          found = colon + 1;
+          i = colon;
+        }
+      }
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']' || c == ',') {
+      if (found != std::string::npos && depth == 1) {
+        *valueBegin = found;
+        *valueEnd = i;
+        return true;
+      }
+      depth -= c == ',' ? 0 : 1;
+    }
+  }
+  return false;
+}
+
+// Parses only the JSON chunk of a GLB. tinygltf would copy the BIN chunk into Buffer::data, so
+// the buffers are hidden from it and their base pointers returned instead, pointing straight
+// into data. data has to outlive every use of the accessors.
+static bool LoadGlb(const unsigned char* data, size_t size, tinygltf::Model* gltfModel,
+                    BufferList* buffers, std::string* error) {
+  uint32_t header[3];
+  memcpy(header, data, sizeof(header));
+  if (header[1] != 2 || header[2] > size) {
+    *error = "Unsupported GLB version or truncated file";
+    return false;
+  }
+  const size_t length = header[2];
+
+  uint32_t jsonChunk[2];
+  memcpy(jsonChunk, data + 12, sizeof(jsonChunk));
+  if (jsonChunk[1] != kGlbChunkJson || 20 + static_cast<size_t>(jsonChunk[0]) > length) {
+    *error = "GLB is missing its JSON chunk";
+    return false;
+  }
+  const char* jsonText = reinterpret_cast<const char*>(data + 20);
+  const size_t jsonLength = jsonChunk[0];
+
+  // Chunks start 4 byte aligned
+  const unsigned char* binData = nullptr;
+  size_t binLength = 0;
+  size_t binOffset = 20 + ((jsonLength + 3) & ~static_cast<size_t>(3));
+  if (binOffset + 8 <= length) {
+    uint32_t binChunk[2];
+    memcpy(binChunk, data + binOffset, sizeof(binChunk));
+    if (binChunk[1] == kGlbChunkBin && binOffset + 8 + binChunk[0] <= length) {
+      binData = data + binOffset + 8;
+      binLength = binChunk[0];
+    }
+  }
+
+  // The text is copied once, not parsed: the buffers are hidden and so are embedded images,
+  // which would be decoded out of them. Textures are loaded from KTX files instead.
+  std::string json(jsonText, jsonLength);
+  size_t buffersBegin = 0, buffersEnd = 0, imagesBegin, imagesEnd;
+  const bool hasBuffers = HideTopLevelKey(&json, "buffers", &buffersBegin, &buffersEnd);
+  HideTopLevelKey(&json, "images", &imagesBegin, &imagesEnd);
+  // Only the embedded BIN chunk can be referenced without a copy
+  if (hasBuffers && json.find("\"uri\"", buffersBegin) < buffersEnd) {
+    *error = "GLB buffers must live in the BIN chunk";
+    return false;
+  }
+
+  tinygltf::TinyGLTF gltfContext;
+  if (!gltfContext.LoadASCIIFromString(gltfModel, error, json.c_str(),
+                                       static_cast<unsigned int>(json.size()), "",
+                                       tinygltf::REQUIRE_ALL & ~tinygltf::REQUIRE_BUFFERS)) {
+    return false;
+  }
+
+  // A GLB's only buffer without a uri is its BIN chunk, every view has to lie within it
+  for (const tinygltf::BufferView& view : gltfModel->bufferViews) {
+    if (!hasBuffers || binData == nullptr || view.buffer != 0 ||
+        view.byteOffset + view.byteLength > binLength) {
+      *error = "GLB buffer views must lie within the BIN chunk";
+      return false;
+    }
+  }
+  if (hasBuffers) {
+    buffers->push_back(binData);
+  }
+  return true;
+}
+
+// Returns the start of the accessor data and the stride between elements
+static const unsigned char* GetAccessorData(const tinygltf::Model& model,
+                                            const BufferList& buffers, int accessorIndex,
+                                            size_t* stride) {
+  const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+  const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+  *stride = static_cast<size_t>(accessor.ByteStride(view));
+  return buffers[view.buffer] + view.byteOffset + accessor.byteOffset;
+}
+
+static glm::mat4 GetNodeMatrix(const tinygltf::Node& node) {
+  if (node.matrix.size() == 16) {
+    glm::mat4 matrix;
+    for (int i = 0; i < 16; i++) {
+      matrix[i / 4][i % 4] = static_cast<float>(node.matrix[i]);
+    }
+    return matrix;
+  }
+
+  glm::mat4 matrix(1.0f);
+  if (node.translation.size() == 3) {
+    matrix = glm::translate(matrix, glm::vec3(node.translation[0], node.translation[1],
+                                              node.translation[2]));
+  }
+  if (node.rotation.size() == 4) {
+    glm::quat q(static_cast<float>(node.rotation[3]), static_cast<float>(node.rotation[0]),
+                static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2]));
+    matrix *= glm::mat4_cast(q);
+  }
+  if (node.scale.size() == 3) {
+    matrix = glm::scale(matrix, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+  }
+  return matrix;
+}
+
+static bool IsTrianglePrimitive(const tinygltf::Primitive& primitive) {
+  return primitive.indices >= 0 && primitive.mode == TINYGLTF_MODE_TRIANGLES;
+}
+
+// Reads element i of a float or normalized integer accessor into out, components at most 4
+static void ReadFloats(const tinygltf::Accessor& accessor, const unsigned char* data,
+                       size_t stride, size_t i, uint32_t components, float* out) {
+  const unsigned char* src = data + i * stride;
+  // Float is what nearly every attribute uses, keep it out of the per component switch
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+    memcpy(out, src, components * sizeof(float));
+    return;
+  }
+  for (uint32_t c = 0; c < components; c++) {
+    switch (accessor.componentType) {
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        out[c] = reinterpret_cast<const uint16_t*>(src)[c] / 65535.0f;
+        break;
+      case TINYGLTF_COMPONENT_TYPE_SHORT:
+        out[c] = std::max(reinterpret_cast<const int16_t*>(src)[c] / 32767.0f, -1.0f);
+        break;
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        out[c] = src[c] / 255.0f;
+        break;
+      default:
+        out[c] = std::max(reinterpret_cast<const int8_t*>(src)[c] / 127.0f, -1.0f);
+    }
+  }
+}
+
+// True when ReadFloats() can read count elements of the given type from accessor
+static bool IsFloatAttribute(const tinygltf::Accessor& accessor, int type, size_t count) {
+  if (accessor.bufferView < 0 || accessor.type != type || accessor.count < count) {
+    return false;
+  }
+  switch (accessor.componentType) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+      return true;
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      return accessor.normalized;
+    default:
+      return false;
+  }
+}
+
+// Rest pose of a joint node. Nodes given as a matrix are split assuming they have no shear.
+static JointPose GetNodePose(const tinygltf::Node& node) {
+  JointPose pose = {glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f)};
+  if (node.matrix.size() == 16) {
+    const glm::mat4 matrix = GetNodeMatrix(node);
+    glm::mat3 rotation(matrix);
+    pose.translation = glm::vec3(matrix[3]);
+    pose.scale = glm::vec3(glm::length(rotation[0]), glm::length(rotation[1]),
+                           glm::length(rotation[2]));
+    if (glm::determinant(rotation) < 0.0f) {
+      pose.scale.x = -pose.scale.x;
+    }
+    for (int i = 0; i < 3; i++) {
+      rotation[i] = rotation[i] / pose.scale[i];
+    }
+    pose.rotation = glm::normalize(glm::quat_cast(rotation));
+    return pose;
+  }
+  if (node.translation.size() == 3) {
+    pose.translation = glm::vec3(node.translation[0], node.translation[1], node.translation[2]);
+  }
+  if (node.rotation.size() == 4) {
+    pose.rotation = glm::quat(static_cast<float>(node.rotation[3]),
+                              static_cast<float>(node.rotation[0]),
+                              static_cast<float>(node.rotation[1]),
+                              static_cast<float>(node.rotation[2]));
+  }
+  if (node.scale.size() == 3) {
+    pose.scale = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+  }
+  return pose;
+}
+
+// Output elements per decode job, large primitives are split so they don't keep one thread busy
+static const uint32_t kDecodeChunkSize = 16384;
+
+struct DecodeChunk {
+  uint32_t primitive;  // index into the importer's primitive list
+  uint32_t first;      // first vertex or index within the primitive
+  uint32_t count;
+  bool indices;
+};
+
+struct DecodeState {
+  const tinygltf::Model& gltfModel;
+  const BufferList& buffers;
+  const MeshTransform& transform;
+  MeshVertex* vertices;
+  uint32_t* indices;
+};
+
+// Decodes vertices [first, first + count) of a primitive into its part of the vertex array and
+// returns their bounds. Attribute types were checked by CollectNode().
+static MeshBounds decodeVertices(const tinygltf::Primitive& primitive,
+                                 const glm::mat4& nodeMatrix, const MeshPart& part,
+                                 uint32_t first, uint32_t count, const DecodeState& state) {
+  const glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(nodeMatrix)));
+  // A mirroring node flips the handedness of the tangent frame
+  const float handedness = glm::determinant(glm::mat3(nodeMatrix)) < 0.0f ? -1.0f : 1.0f;
+  const tinygltf::Model& gltfModel = state.gltfModel;
+  const MeshTransform& transform = state.transform;
+
+  auto positionIt = primitive.attributes.find("POSITION");
+  const tinygltf::Accessor& positionAccessor = gltfModel.accessors[positionIt->second];
+  size_t positionStride, normalStride = 0, uvStride = 0, tangentStride = 0;
+  const unsigned char* positions = GetAccessorData(gltfModel, state.buffers, positionIt->second,
+                                                   &positionStride);
+  const unsigned char* normals = nullptr;
+  const unsigned char* uvs = nullptr;
+  const unsigned char* tangents = nullptr;
+  const tinygltf::Accessor* normalAccessor = nullptr;
+  const tinygltf::Accessor* uvAccessor = nullptr;
+  const tinygltf::Accessor* tangentAccessor = nullptr;
+
+  auto normalIt = primitive.attributes.find("NORMAL");
+  if (normalIt != primitive.attributes.end()) {
+    normalAccessor = &gltfModel.accessors[normalIt->second];
+    normals = GetAccessorData(gltfModel, state.buffers, normalIt->second, &normalStride);
+  }
+  auto uvIt = primitive.attributes.find("TEXCOORD_0");
+  if (uvIt != primitive.attributes.end()) {
+    uvAccessor = &gltfModel.accessors[uvIt->second];
+    uvs = GetAccessorData(gltfModel, state.buffers, uvIt->second, &uvStride);
+  }
+  auto tangentIt = primitive.attributes.find("TANGENT");
+  if (tangentIt != primitive.attributes.end()) {
+    tangentAccessor = &gltfModel.accessors[tangentIt->second];
+    tangents = GetAccessorData(gltfModel, state.buffers, tangentIt->second, &tangentStride);
+  }
+
+  MeshBounds bounds;
+  bounds.min = glm::vec3(std::numeric_limits<float>::max());
+  bounds.max = glm::vec3(-std::numeric_limits<float>::max());
+  MeshVertex* vertex = state.vertices + part.vertexBase + first;
+  for (uint32_t v = first; v < first + count; v++, vertex++) {
+    float p[3];
+    ReadFloats(positionAccessor, positions, positionStride, v, 3, p);
+    vertex->pos = glm::vec3(nodeMatrix * glm::vec4(p[0], p[1], p[2], 1.0f));
+    vertex->pos = vertex->pos * transform.scale + transform.center;
+    bounds.min = glm::min(bounds.min, vertex->pos);
+    bounds.max = glm::max(bounds.max, vertex->pos);
+
+    vertex->normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    if (normals) {
+      float n[3];
+      ReadFloats(*normalAccessor, normals, normalStride, v, 3, n);
+      vertex->normal = glm::normalize(normalMatrix * glm::vec3(n[0], n[1], n[2]));
+    }
+
+    vertex->uv = glm::vec2(0.0f);
+    if (uvs) {
+      float t[2];
+      ReadFloats(*uvAccessor, uvs, uvStride, v, 2, t);
+      vertex->uv = glm::vec2(t[0], t[1]) * transform.uvscale;
+    }
+
+    // glTF tangents are xyz plus the bitangent sign in w, like MeshVertex. Without them they
+    // are generated once the whole primitive is decoded.
+    vertex->tangent = glm::vec4(0.0f);
+    if (tangents) {
+      float t[4];
+      ReadFloats(*tangentAccessor, tangents, tangentStride, v, 4, t);
+      const glm::vec3 tangent = glm::mat3(nodeMatrix) * glm::vec3(t[0], t[1], t[2]);
+      vertex->tangent = glm::vec4(glm::normalize(tangent), t[3] < 0.0f ? -handedness : handedness);
+    }
+  }
+  return bounds;
+}
+
+// Decodes indices [first, first + count) of a primitive, rebased onto the shared vertex array.
+// Index types were checked by CollectNode().
+static void decodeIndices(const tinygltf::Primitive& primitive, const MeshPart& part,
+                          uint32_t first, uint32_t count, const DecodeState& state) {
+  const tinygltf::Accessor& indexAccessor = state.gltfModel.accessors[primitive.indices];
+  size_t indexStride;
+  const unsigned char* indices = GetAccessorData(state.gltfModel, state.buffers,
+                                                 primitive.indices, &indexStride);
+  uint32_t* index = state.indices + part.indexBase;
+  for (uint32_t i = first; i < first + count; i++) {
+    const unsigned char* src = indices + i * indexStride;
+    switch (indexAccessor.componentType) {
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        index[i] = *reinterpret_cast<const uint32_t*>(src);
+        break;
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        index[i] = *reinterpret_cast<const uint16_t*>(src);
+        break;
+      default:
+        index[i] = *reinterpret_cast<const uint8_t*>(src);
+    }
+    index[i] += part.vertexBase;
+  }
+}
+
+GltfImporter::GltfImporter() :
+    mModel(new tinygltf::Model())
+{
+}
+
+GltfImporter::~GltfImporter() {
+}
+
+bool GltfImporter::Parse(const uint8_t* data, size_t size, std::string* error) {
+  mModel.reset(new tinygltf::Model());
+  mBuffers.clear();
+  mPrimitives.clear();
+  mVertexCount = 0;
+  mIndexCount = 0;
+  mSkin = -1;
+  mNodeParents.clear();
+  mJointOrder.clear();
+  mMeshTargetBase.clear();
+  mTargetCount = 0;
+
+  bool loaded;
+  if (IsGlb(data, size)) {
+    loaded = LoadGlb(data, size, mModel.get(), &mBuffers, error);
+  } else {
+    tinygltf::TinyGLTF gltfContext;
+    loaded = gltfContext.LoadASCIIFromString(mModel.get(), error,
+                                             reinterpret_cast<const char*>(data),
+                                             static_cast<unsigned int>(size), "");
+    for (const tinygltf::Buffer& buffer : mModel->buffers) {
+      mBuffers.push_back(buffer.data.data());
+    }
+  }
+  if (!loaded) {
+    return false;
+  }
+  if (mModel->scenes.empty()) {
+    *error = "glTF has no scene";
+    return false;
+  }
+
+  mMeshTargetBase.assign(mModel->meshes.size(), -1);
+  const tinygltf::Scene& scene = mModel->scenes[std::max(mModel->defaultScene, 0)];
+  for (int node : scene.nodes) {
+    if (!CollectNode(node, glm::mat4(1.0f), error)) {
+      return false;
+    }
+  }
+  if (mSkin < 0) {
+    return true;
+  }
+
+  const tinygltf::Skin& skin = mModel->skins[mSkin];
+  if (skin.joints.empty() || skin.joints.size() > 0x10000) {
+    *error = "Skin has " + std::to_string(skin.joints.size()) + " joints";
+    return false;
+  }
+  if (skin.inverseBindMatrices > -1) {
+    const tinygltf::Accessor& accessor = mModel->accessors[skin.inverseBindMatrices];
+    if (accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+        accessor.type != TINYGLTF_TYPE_MAT4 || accessor.count < skin.joints.size()) {
+      *error = "Skin inverse bind matrices must be one float MAT4 per joint";
+      return false;
+    }
+  }
+  mNodeParents.assign(mModel->nodes.size(), -1);
+  for (size_t n = 0; n < mModel->nodes.size(); n++) {
+    for (int child : mModel->nodes[n].children) {
+      mNodeParents[child] = static_cast<int>(n);
+    }
+  }
+  SortJoints();
+  return true;
+}
+
+// Skins list their joints in any order, the skeleton wants parents before children. Sorting by
+// depth in the node hierarchy does that and keeps siblings in skin order.
+void GltfImporter::SortJoints(void) {
+  const std::vector<int>& joints = mModel->skins[mSkin].joints;
+  std::vector<uint32_t> depths(joints.size(), 0);
+  std::vector<uint32_t> sorted(joints.size());
+  for (size_t j = 0; j < joints.size(); j++) {
+    for (int node = mNodeParents[joints[j]]; node > -1; node = mNodeParents[node]) {
+      depths[j]++;
+    }
+    sorted[j] = static_cast<uint32_t>(j);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [&](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+  mJointOrder.resize(joints.size());
+  for (size_t j = 0; j < sorted.size(); j++) {
+    mJointOrder[sorted[j]] = static_cast<uint32_t>(j);
+  }
+}
+
+// Walks the node hierarchy giving every triangle primitive the next range of vertices and
+// indices. Fails on primitives the decoder can't read.
+bool GltfImporter::CollectNode(int nodeIndex, const glm::mat4& parentMatrix,
+                               std::string* error) {
+  const tinygltf::Node& node = mModel->nodes[nodeIndex];
+  const glm::mat4 nodeMatrix = parentMatrix * GetNodeMatrix(node);
+
+  if (node.mesh > -1 && node.skin > -1) {
+    if (mSkin > -1 && mSkin != node.skin) {
+      *error = "Only one skin per model is supported";
+      return false;
+    }
+    mSkin = node.skin;
+  }
+  if (node.mesh > -1 && mMeshTargetBase[node.mesh] < 0) {
+    mMeshTargetBase[node.mesh] = static_cast<int>(mTargetCount);
+    size_t targetCount = mModel->meshes[node.mesh].weights.size();
+    for (const tinygltf::Primitive& primitive : mModel->meshes[node.mesh].primitives) {
+      targetCount = std::max(targetCount, primitive.targets.size());
+    }
+    mTargetCount += static_cast<uint32_t>(targetCount);
+  }
+  if (node.mesh > -1) {
+    for (const tinygltf::Primitive& primitive : mModel->meshes[node.mesh].primitives) {
+      if (!IsTrianglePrimitive(primitive)) {
+        continue;
+      }
+      auto positionIt = primitive.attributes.find("POSITION");
+      if (positionIt == primitive.attributes.end()) {
+        *error = "Primitive without POSITION attribute";
+        return false;
+      }
+      const tinygltf::Accessor& indexAccessor = mModel->accessors[primitive.indices];
+      if (indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT &&
+          indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+          indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+        *error = "Index component type " + std::to_string(indexAccessor.componentType) +
+                 " not supported";
+        return false;
+      }
+      // Vertex attributes are read as floats or normalized integers
+      static const struct {
+        const char* name;
+        int type;
+      } kAttributes[4] = {{"POSITION", TINYGLTF_TYPE_VEC3}, {"NORMAL", TINYGLTF_TYPE_VEC3},
+                          {"TEXCOORD_0", TINYGLTF_TYPE_VEC2}, {"TANGENT", TINYGLTF_TYPE_VEC4}};
+      const size_t vertexCount = mModel->accessors[positionIt->second].count;
+      for (const auto& attribute : kAttributes) {
+        auto it = primitive.attributes.find(attribute.name);
+        if (it != primitive.attributes.end() &&
+            !IsFloatAttribute(mModel->accessors[it->second], attribute.type, vertexCount)) {
+          *error = std::string("Attribute ") + attribute.name +
+                   " must be float or normalized integer, one per vertex";
+          return false;
+        }
+      }
+
+      PrimitiveRange range;
+      range.primitive = &primitive;
+      // Joints place skinned vertices, their node transform is ignored
+      range.skinned = node.skin > -1;
+      range.nodeMatrix = range.skinned ? glm::mat4(1.0f) : nodeMatrix;
+      range.part.vertexBase = static_cast<uint32_t>(mVertexCount);
+      range.part.indexBase = static_cast<uint32_t>(mIndexCount);
+      range.part.vertexCount = static_cast<uint32_t>(mModel->accessors[positionIt->second].count);
+      range.part.indexCount = static_cast<uint32_t>(indexAccessor.count);
+      range.hasTangents = primitive.attributes.find("TANGENT") != primitive.attributes.end();
+      range.targetBase = static_cast<uint32_t>(mMeshTargetBase[node.mesh]);
+      for (const std::map<std::string, int>& target : primitive.targets) {
+        for (const std::pair<const std::string, int>& attribute : target) {
+          const tinygltf::Accessor& accessor = mModel->accessors[attribute.second];
+          if (accessor.count != range.part.vertexCount || accessor.bufferView < 0 ||
+              accessor.type != TINYGLTF_TYPE_VEC3) {
+            *error = "Morph target " + attribute.first + " must be a VEC3 per vertex";
+            return false;
+          }
+        }
+      }
+      mPrimitives.push_back(range);
+      mVertexCount += range.part.vertexCount;
+      mIndexCount += range.part.indexCount;
+    }
+  }
+
+  for (int child : node.children) {
+    if (!CollectNode(child, nodeMatrix, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GltfImporter::Decode(const MeshTransform& transform, MeshVertex* vertices,
+                          uint32_t* indices, std::vector<MeshPart>* parts,
+                          MeshBounds* bounds, WorkerPool* workers) const {
+  const DecodeState state = {*mModel, mBuffers, transform, vertices, indices};
+
+  // Every chunk writes a disjoint range of the output, only the bounds need merging afterwards
+  std::vector<DecodeChunk> chunks;
+  parts->clear();
+  for (uint32_t p = 0; p < mPrimitives.size(); p++) {
+    const MeshPart& part = mPrimitives[p].part;
+    for (uint32_t first = 0; first < part.vertexCount; first += kDecodeChunkSize) {
+      chunks.push_back({p, first, std::min(kDecodeChunkSize, part.vertexCount - first), false});
+    }
+    for (uint32_t first = 0; first < part.indexCount; first += kDecodeChunkSize) {
+      chunks.push_back({p, first, std::min(kDecodeChunkSize, part.indexCount - first), true});
+    }
+    parts->push_back(part);
+  }
+
+  std::vector<MeshBounds> chunkBounds(chunks.size());
+  auto decodeChunk = [&](size_t c) {
+    const DecodeChunk& chunk = chunks[c];
+    const PrimitiveRange& range = mPrimitives[chunk.primitive];
+    if (chunk.indices) {
+      decodeIndices(*range.primitive, range.part, chunk.first, chunk.count, state);
+      chunkBounds[c].min = glm::vec3(std::numeric_limits<float>::max());
+      chunkBounds[c].max = glm::vec3(-std::numeric_limits<float>::max());
+    } else {
+      chunkBounds[c] = decodeVertices(*range.primitive, range.nodeMatrix, range.part,
+                                      chunk.first, chunk.count, state);
+    }
+  };
+  if (workers) {
+    workers->ParallelFor(chunks.size(), decodeChunk);
+  } else {
+    for (size_t c = 0; c < chunks.size(); c++) {
+      decodeChunk(c);
+    }
+  }
+
+  for (const PrimitiveRange& range : mPrimitives) {
+    if (!range.hasTangents) {
+      GenerateTangents(vertices, range.part.vertexBase, range.part.vertexCount,
+                       indices + range.part.indexBase, range.part.indexCount, workers);
+    }
+  }
+
+  bounds->min = glm::vec3(std::numeric_limits<float>::max());
+  bounds->max = glm::vec3(-std::numeric_limits<float>::max());
+  for (const MeshBounds& chunk : chunkBounds) {
+    bounds->min = glm::min(bounds->min, chunk.min);
+    bounds->max = glm::max(bounds->max, chunk.max);
+  }
+}
+
+void GltfImporter::DecodeSkin(SkinVertex* skin) const {
+  memset(skin, 0, mVertexCount * sizeof(SkinVertex));
+  for (const PrimitiveRange& range : mPrimitives) {
+    const tinygltf::Primitive& primitive = *range.primitive;
+    auto jointIt = primitive.attributes.find("JOINTS_0");
+    auto weightIt = primitive.attributes.find("WEIGHTS_0");
+    if (!range.skinned || jointIt == primitive.attributes.end() ||
+        weightIt == primitive.attributes.end()) {
+      continue;
+    }
+    const tinygltf::Accessor& jointAccessor = mModel->accessors[jointIt->second];
+    const tinygltf::Accessor& weightAccessor = mModel->accessors[weightIt->second];
+    size_t jointStride, weightStride;
+    const unsigned char* joints = GetAccessorData(*mModel, mBuffers, jointIt->second,
+                                                  &jointStride);
+    const unsigned char* weights = GetAccessorData(*mModel, mBuffers, weightIt->second,
+                                                   &weightStride);
+
+    SkinVertex* vertex = skin + range.part.vertexBase;
+    for (uint32_t v = 0; v < range.part.vertexCount; v++, vertex++) {
+      float weight[4];
+      ReadFloats(weightAccessor, weights, weightStride, v, 4, weight);
+      const float sum = weight[0] + weight[1] + weight[2] + weight[3];
+      if (sum <= 0.0f) {
+        continue;
+      }
+      // Rounded weights can miss the total by a few units, the largest one takes the difference
+      const bool shortJoints =
+          jointAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+      int total = 0, largest = 0;
+      for (int i = 0; i < 4; i++) {
+        const uint32_t joint = shortJoints
+            ? reinterpret_cast<const uint16_t*>(joints + v * jointStride)[i]
+            : joints[v * jointStride + i];
+        vertex->joints[i] = joint < mJointOrder.size() ? mJointOrder[joint] : 0;
+        vertex->weights[i] = static_cast<uint16_t>(weight[i] / sum * 65535.0f + 0.5f);
+        total += vertex->weights[i];
+        largest = vertex->weights[i] > vertex->weights[largest] ? i : largest;
+      }
+      vertex->weights[largest] = static_cast<uint16_t>(vertex->weights[largest] + 65535 - total);
+    }
+  }
+}
+
+void GltfImporter::ImportAnimations(const MeshTransform& transform, Skeleton* skeleton,
+                                    std::vector<AnimationClip>* clips) const {
+  skeleton->joints.clear();
+  clips->clear();
+  if (mSkin < 0) {
+    return;
+  }
+  const tinygltf::Skin& skin = mModel->skins[mSkin];
+
+  // Decoded vertices are scaled and moved by transform, which the palette has to undo before
+  // the inverse bind matrices and redo after the joints
+  const glm::mat4 meshTransform = glm::scale(glm::translate(glm::mat4(1.0f), transform.center),
+                                             transform.scale);
+  const glm::mat4 inverseTransform = glm::inverse(meshTransform);
+
+  std::vector<int> nodeJoints(mModel->nodes.size(), -1);
+  for (size_t j = 0; j < skin.joints.size(); j++) {
+    nodeJoints[skin.joints[j]] = static_cast<int>(mJointOrder[j]);
+  }
+
+  size_t matrixStride = 0;
+  const unsigned char* inverseBinds = nullptr;
+  if (skin.inverseBindMatrices > -1) {
+    inverseBinds = GetAccessorData(*mModel, mBuffers, skin.inverseBindMatrices, &matrixStride);
+  }
+
+  skeleton->joints.resize(skin.joints.size());
+  for (size_t j = 0; j < skin.joints.size(); j++) {
+    Joint& joint = skeleton->joints[mJointOrder[j]];
+    joint.rest = GetNodePose(mModel->nodes[skin.joints[j]]);
+    glm::mat4 inverseBind(1.0f);
+    if (inverseBinds) {
+      memcpy(&inverseBind[0][0], inverseBinds + j * matrixStride, sizeof(inverseBind));
+    }
+    joint.inverseBind = inverseBind * inverseTransform;
+
+    // Nodes up to the next joint or the root are static, their transforms are folded together
+    joint.parentMatrix = glm::mat4(1.0f);
+    int node = mNodeParents[skin.joints[j]];
+    while (node > -1 && nodeJoints[node] < 0) {
+      joint.parentMatrix = GetNodeMatrix(mModel->nodes[node]) * joint.parentMatrix;
+      node = mNodeParents[node];
+    }
+    joint.parent = node > -1 ? nodeJoints[node] : -1;
+    if (joint.parent < 0) {
+      joint.parentMatrix = meshTransform * joint.parentMatrix;
+    }
+  }
+
+  for (const tinygltf::Animation& animation : mModel->animations) {
+    AnimationClip clip;
+    clip.name = animation.name;
+    clip.duration = 0.0f;
+    for (const tinygltf::AnimationChannel& source : animation.channels) {
+      if (source.target_node < 0 || nodeJoints[source.target_node] < 0 ||
+          source.sampler < 0 || source.sampler >= static_cast<int>(animation.samplers.size())) {
+        continue;
+      }
+      AnimationChannel channel;
+      channel.joint = static_cast<uint32_t>(nodeJoints[source.target_node]);
+      uint32_t components = 3;
+      if (source.target_path == "translation") {
+        channel.path = ANIMATION_PATH_TRANSLATION;
+      } else if (source.target_path == "rotation") {
+        channel.path = ANIMATION_PATH_ROTATION;
+        components = 4;
+      } else if (source.target_path == "scale") {
+        channel.path = ANIMATION_PATH_SCALE;
+      } else {
+        continue;  // morph target weights
+      }
+
+      const tinygltf::AnimationSampler& sampler = animation.samplers[source.sampler];
+      channel.interpolation = sampler.interpolation == "STEP" ? ANIMATION_INTERPOLATION_STEP
+          : sampler.interpolation == "CUBICSPLINE" ? ANIMATION_INTERPOLATION_CUBIC_SPLINE
+          : ANIMATION_INTERPOLATION_LINEAR;
+      const tinygltf::Accessor& input = mModel->accessors[sampler.input];
+      const tinygltf::Accessor& output = mModel->accessors[sampler.output];
+      const size_t valuesPerKey =
+          channel.interpolation == ANIMATION_INTERPOLATION_CUBIC_SPLINE ? 3 : 1;
+      if (input.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || input.count == 0 ||
+          output.count != input.count * valuesPerKey) {
+        continue;
+      }
+
+      size_t inputStride, outputStride;
+      const unsigned char* times = GetAccessorData(*mModel, mBuffers, sampler.input,
+                                                   &inputStride);
+      const unsigned char* values = GetAccessorData(*mModel, mBuffers, sampler.output,
+                                                    &outputStride);
+      channel.times.resize(input.count);
+      for (size_t k = 0; k < input.count; k++) {
+        memcpy(&channel.times[k], times + k * inputStride, sizeof(float));
+      }
+      channel.values.resize(output.count, glm::vec4(0.0f));
+      for (size_t k = 0; k < output.count; k++) {
+        ReadFloats(output, values, outputStride, k, components, &channel.values[k][0]);
+      }
+      clip.duration = std::max(clip.duration, channel.times.back());
+      clip.channels.push_back(std::move(channel));
+    }
+    if (!clip.channels.empty()) {
+      clips->push_back(std::move(clip));
+    }
+  }
+}
+
+void GltfImporter::DecodeMorphTargets(const MeshTransform& transform,
+                                      MorphTargets* targets) const {
+  // Attributes a target can move, in MorphDelta order
+  static const char* const kAttributes[3] = {"POSITION", "NORMAL", "TANGENT"};
+  struct TargetData {
+    const tinygltf::Accessor* accessors[3];
+    const unsigned char* data[3];
+    size_t strides[3];
+  };
+
+  targets->targetCount = mTargetCount;
+  targets->vertices.clear();
+  targets->deltas.clear();
+  targets->defaultWeights.assign(mTargetCount, 0.0f);
+  for (size_t m = 0; m < mModel->meshes.size(); m++) {
+    const std::vector<double>& weights = mModel->meshes[m].weights;
+    for (size_t t = 0; mMeshTargetBase[m] > -1 && t < weights.size(); t++) {
+      targets->defaultWeights[mMeshTargetBase[m] + t] = static_cast<float>(weights[t]);
+    }
+  }
+
+  std::vector<TargetData> targetData;
+  for (const PrimitiveRange& range : mPrimitives) {
+    const tinygltf::Primitive& primitive = *range.primitive;
+    if (primitive.targets.empty()) {
+      continue;
+    }
+    targetData.assign(primitive.targets.size(), TargetData());
+    for (size_t t = 0; t < primitive.targets.size(); t++) {
+      for (int a = 0; a < 3; a++) {
+        auto attributeIt = primitive.targets[t].find(kAttributes[a]);
+        targetData[t].accessors[a] = nullptr;
+        if (attributeIt != primitive.targets[t].end()) {
+          targetData[t].accessors[a] = &mModel->accessors[attributeIt->second];
+          targetData[t].data[a] = GetAccessorData(*mModel, mBuffers, attributeIt->second,
+                                                  &targetData[t].strides[a]);
+        }
+      }
+    }
+
+    // Deltas are directions, they take the linear part of what Decode() applies to vertices
+    const glm::mat3 linear = glm::mat3(range.nodeMatrix);
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+    for (uint32_t v = 0; v < range.part.vertexCount; v++) {
+      const size_t firstDelta = targets->deltas.size();
+      for (size_t t = 0; t < targetData.size(); t++) {
+        glm::vec3 delta[3] = {glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+        for (int a = 0; a < 3; a++) {
+          if (targetData[t].accessors[a] != nullptr) {
+            ReadFloats(*targetData[t].accessors[a], targetData[t].data[a],
+                       targetData[t].strides[a], v, 3, &delta[a][0]);
+          }
+        }
+        delta[0] = linear * delta[0] * transform.scale;
+        delta[1] = normalMatrix * delta[1];
+        delta[2] = linear * delta[2];
+        if (glm::dot(delta[0], delta[0]) < 1e-12f && glm::dot(delta[1], delta[1]) < 1e-12f &&
+            glm::dot(delta[2], delta[2]) < 1e-12f) {
+          continue;
+        }
+        const MorphDelta morphDelta = {delta[0], range.targetBase + static_cast<uint32_t>(t),
+                                       delta[1], 0.0f, delta[2], 0.0f};
+        targets->deltas.push_back(morphDelta);
+      }
+      if (targets->deltas.size() > firstDelta) {
+        targets->vertices.push_back({range.part.vertexBase + v,
+                                     static_cast<uint32_t>(firstDelta)});
+      }
+    }
+  }
+  targets->vertices.push_back({~0u, static_cast<uint32_t>(targets->deltas.size())});
+}
+
+} // navs namespace
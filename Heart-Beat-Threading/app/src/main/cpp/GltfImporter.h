@@ -0,0 +1,97 @@
+#ifndef __GLTF_IMPORTER_HPP__
+#define __GLTF_IMPORTER_HPP__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+#include "MeshData.h"
+#include "MorphTargets.h"
+
+class WorkerPool;
+
+namespace tinygltf {
+class Model;
+struct Primitive;
+}
+
+namespace navs {
+
+// Decodes the triangle primitives of a glTF or binary glTF into flat vertex and index arrays.
+// Has no Vulkan or Android dependency so the offline tools share it with the runtime loader.
+class GltfImporter {
+ public:
+  GltfImporter();
+  ~GltfImporter();
+
+  // Parses the document, data must stay valid until Decode() returns. A .glb is read in place,
+  // its accessors point straight into data. Also walks the scene once to give every primitive
+  // its own range of the output arrays.
+  bool Parse(const uint8_t* data, size_t size, std::string* error);
+
+  // Totals over every triangle primitive reachable from the default scene
+  size_t GetVertexCount(void) const { return mVertexCount; }
+  size_t GetIndexCount(void) const { return mIndexCount; }
+
+  // Fills GetVertexCount() vertices and GetIndexCount() indices, one part per primitive.
+  // Indices are rebased onto the shared vertex array. Primitives without tangents get them
+  // from GenerateTangents(). With a pool, primitives are cut into
+  // chunks that are decoded concurrently, the output is the same as without.
+  void Decode(const MeshTransform& transform, MeshVertex* vertices, uint32_t* indices,
+              std::vector<MeshPart>* parts, MeshBounds* bounds,
+              WorkerPool* workers = nullptr) const;
+
+  // True when a mesh in the scene is skinned. Only one skin per document is supported, the
+  // nodes of skinned meshes are ignored as glTF requires, their joints place them instead.
+  bool HasSkin(void) const { return mSkin >= 0; }
+
+  // Fills GetVertexCount() influences matching the vertices of Decode(), vertices outside of
+  // the skinned primitives get none and stay static
+  void DecodeSkin(SkinVertex* skin) const;
+
+  // Builds the skeleton of the skin and every animation's translation, rotation and scale
+  // channels that target its joints. transform has to match the one given to Decode().
+  void ImportAnimations(const MeshTransform& transform, Skeleton* skeleton,
+                        std::vector<AnimationClip>* clips) const;
+
+  // Morph targets over every mesh in the scene, each mesh gets its own range of them. Nodes
+  // sharing a mesh share its targets and weights.
+  uint32_t GetMorphTargetCount(void) const { return mTargetCount; }
+
+  // Gathers the position, normal and tangent deltas of every target in sparse form, indexed
+  // like the vertices of Decode(). Deltas too small to move anything are dropped, the default
+  // weights are the meshes' own. transform has to match the one given to Decode().
+  void DecodeMorphTargets(const MeshTransform& transform, MorphTargets* targets) const;
+
+ private:
+  struct PrimitiveRange {
+    const tinygltf::Primitive* primitive;
+    glm::mat4 nodeMatrix;
+    MeshPart part;
+    bool hasTangents;
+    bool skinned;
+    uint32_t targetBase;  // first morph target of the primitive's mesh
+  };
+
+  bool CollectNode(int nodeIndex, const glm::mat4& parentMatrix, std::string* error);
+  void SortJoints(void);
+
+  std::unique_ptr<tinygltf::Model> mModel;
+  // Base pointer of every glTF buffer, either tinygltf's own copy or memory inside the file
+  std::vector<const unsigned char*> mBuffers;
+  // Triangle primitives in scene traversal order
+  std::vector<PrimitiveRange> mPrimitives;
+  size_t mVertexCount = 0;
+  size_t mIndexCount = 0;
+  int mSkin = -1;
+  // Parent of every node or -1, and the skeleton joint each joint of the skin became
+  std::vector<int> mNodeParents;
+  std::vector<uint32_t> mJointOrder;
+  // First morph target of every mesh or -1 until a node instances it
+  std::vector<int> mMeshTargetBase;
+  uint32_t mTargetCount = 0;
+};
+
+} // navs namespace
+#endif // __GLTF_IMPORTER_HPP__
@@ -0,0 +1,120 @@
+#include "IndirectDraws.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "VulkanUtil.h"
+
+using namespace navs;
+
+IndirectDraws::IndirectDraws(VkPhysicalDevice pDevice, VkDevice lDevice,
+                             uint32_t queueFamilyIndex, uint32_t capacity,
+                             const VkPhysicalDeviceFeatures& features) :
+    mLogicDevice(lDevice),
+    mMultiDraw(features.multiDrawIndirect == VK_TRUE),
+    mFirstInstance(features.drawIndirectFirstInstance == VK_TRUE),
+    mCapacity(std::max(capacity, 1u))
+{
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(pDevice, &properties);
+  mMaxDrawCount = mMultiDraw ? std::max(properties.limits.maxDrawIndirectCount, 1u) : 1;
+
+  const VkDeviceSize commandSize = VkDeviceSize(mCapacity) * sizeof(VkDrawIndexedIndirectCommand);
+  const VkDeviceSize dataSize = VkDeviceSize(mCapacity) * sizeof(DrawData);
+  CreateBuffer(pDevice, queueFamilyIndex, commandSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+               &mCommandBuffer, &mCommandMemory);
+  CreateBuffer(pDevice, queueFamilyIndex, dataSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               &mDataBuffer, &mDataMemory);
+  CALL_VK(vkMapMemory(mLogicDevice, mCommandMemory, 0, commandSize, 0,
+                      (void**)&mMappedCommands));
+  CALL_VK(vkMapMemory(mLogicDevice, mDataMemory, 0, dataSize, 0, (void**)&mMappedData));
+  mCommands.reserve(mCapacity);
+
+  LOGI("IndirectDraws: %s, %s", mMultiDraw ? "multi draw indirect" : "one indirect draw per part",
+       mFirstInstance ? "draw data by first instance" : "direct draws (no first instance)");
+}
+
+IndirectDraws::~IndirectDraws() {
+  vkUnmapMemory(mLogicDevice, mCommandMemory);
+  vkUnmapMemory(mLogicDevice, mDataMemory);
+  vkDestroyBuffer(mLogicDevice, mCommandBuffer, nullptr);
+  FreeTrackedMemory(mLogicDevice, mCommandMemory);
+  vkDestroyBuffer(mLogicDevice, mDataBuffer, nullptr);
+  FreeTrackedMemory(mLogicDevice, mDataMemory);
+}
+
+IndirectDraws::DrawData* IndirectDraws::Add(const MeshPart& part, int32_t vertexOffset,
+                                            uint32_t instanceCount) {
+  assert(mCommands.size() < mCapacity && mDataCount + instanceCount <= mCapacity);
+  const VkDrawIndexedIndirectCommand command{
+      .indexCount = part.indexCount,
+      .instanceCount = instanceCount,
+      .firstIndex = part.indexBase,
+      .vertexOffset = vertexOffset,
+      .firstInstance = mDataCount,
+  };
+  mMappedCommands[mCommands.size()] = command;
+  mCommands.push_back(command);
+
+  DrawData* data = mMappedData + mDataCount;
+  for (uint32_t i = 0; i < instanceCount; i++) {
+    data[i] = {glm::mat4(1.0f), glm::vec4(1.0f)};
+  }
+  mDataCount += instanceCount;
+  return data;
+}
+
+VkDescriptorBufferInfo IndirectDraws::GetDrawDataDescriptor(void) const {
+  return {mDataBuffer, 0, VK_WHOLE_SIZE};
+}
+
+void IndirectDraws::Record(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count) const {
+  assert(first + count <= mCommands.size());
+  if (!mFirstInstance) {
+    for (uint32_t i = first; i < first + count; i++) {
+      const VkDrawIndexedIndirectCommand& command = mCommands[i];
+      vkCmdDrawIndexed(cmdBuffer, command.indexCount, command.instanceCount, command.firstIndex,
+                       command.vertexOffset, command.firstInstance);
+    }
+    return;
+  }
+
+  const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  for (uint32_t done = 0; done < count;) {
+    const uint32_t drawCount = std::min(count - done, mMaxDrawCount);
+    vkCmdDrawIndexedIndirect(cmdBuffer, mCommandBuffer, VkDeviceSize(first + done) * stride,
+                             drawCount, stride);
+    done += drawCount;
+  }
+}
+
+void IndirectDraws::CreateBuffer(VkPhysicalDevice pDevice, uint32_t queueFamilyIndex,
+                                 VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer* buffer,
+                                 VkDeviceMemory* memory) {
+  VkBufferCreateInfo bufferInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .size = size,
+      .usage = usage,
+      .flags = 0,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .pQueueFamilyIndices = &queueFamilyIndex,
+      .queueFamilyIndexCount = 1,
+  };
+  CALL_VK(vkCreateBuffer(mLogicDevice, &bufferInfo, nullptr, buffer));
+
+  VkMemoryRequirements memReq;
+  vkGetBufferMemoryRequirements(mLogicDevice, *buffer, &memReq);
+  VkMemoryAllocateInfo memAllocInfo{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .allocationSize = memReq.size,
+      .memoryTypeIndex = 0,
+  };
+  assert(MapMemoryTypeToIndex(pDevice, memReq.memoryTypeBits,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &memAllocInfo.memoryTypeIndex));
+  CALL_VK(AllocateTrackedMemory(mLogicDevice, &memAllocInfo, MEMORY_CATEGORY_GEOMETRY, memory));
+  CALL_VK(vkBindBufferMemory(mLogicDevice, *buffer, *memory, 0));
+}
@@ -0,0 +1,69 @@
+#ifndef __INDIRECT_DRAWS_HPP__
+#define __INDIRECT_DRAWS_HPP__
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vulkan_wrapper.h"
+#include "MemoryTracker.h"
+#include "MeshData.h"
+
+// Draws model parts from a buffer of VkDrawIndexedIndirectCommand, one per part and vertex range,
+// issued with a single vkCmdDrawIndexedIndirect when multiDrawIndirect is enabled. Every
+// instance of a draw has a DrawData entry in a storage buffer; the draw's firstInstance points
+// at its first entry, so shaders find theirs at gl_InstanceIndex without needing
+// VK_KHR_shader_draw_parameters. Draws are written once up front and recorded as ranges, so
+// neither a frame nor a re-record costs more CPU with more parts.
+class IndirectDraws {
+ public:
+  // Matches DrawData in shaders/heart.vert, std430
+  struct DrawData {
+    glm::mat4 transform;  // applied before the model matrix, no non-uniform scale
+    glm::vec4 tint;       // multiplies the color map
+  };
+
+  // Room for capacity draws and as many DrawData entries. features are the enabled device
+  // features, of which multiDrawIndirect and drawIndirectFirstInstance are used when set.
+  IndirectDraws(VkPhysicalDevice pDevice, VkDevice lDevice, uint32_t queueFamilyIndex,
+                uint32_t capacity, const VkPhysicalDeviceFeatures& features);
+  ~IndirectDraws();
+
+  // Appends a draw of instanceCount instances of part, its indices offset by vertexOffset, and
+  // returns its instanceCount DrawData entries for the caller to fill
+  DrawData* Add(const navs::MeshPart& part, int32_t vertexOffset, uint32_t instanceCount);
+
+  uint32_t GetDrawCount(void) const { return static_cast<uint32_t>(mCommands.size()); }
+
+  // DrawData of every draw, bound as a storage buffer for the vertex shader
+  VkDescriptorBufferInfo GetDrawDataDescriptor(void) const;
+
+  // Records draws [first, first + count) with the pipeline and buffers already bound. Without
+  // drawIndirectFirstInstance the draws can't carry their DrawData index and are recorded one
+  // by one from the host copy instead.
+  void Record(VkCommandBuffer cmdBuffer, uint32_t first, uint32_t count) const;
+
+ private:
+  VkDevice mLogicDevice;
+  bool mMultiDraw;
+  bool mFirstInstance;
+  uint32_t mMaxDrawCount;
+  uint32_t mCapacity;
+
+  // Host visible and coherent, which is device local on the unified memory of mobile GPUs
+  VkBuffer mCommandBuffer;
+  VkDeviceMemory mCommandMemory;
+  VkDrawIndexedIndirectCommand* mMappedCommands;
+  VkBuffer mDataBuffer;
+  VkDeviceMemory mDataMemory;
+  DrawData* mMappedData;
+  uint32_t mDataCount = 0;
+
+  // Host copy of the commands, reading them back from uncached memory would be slow
+  std::vector<VkDrawIndexedIndirectCommand> mCommands;
+
+  void CreateBuffer(VkPhysicalDevice pDevice, uint32_t queueFamilyIndex, VkDeviceSize size,
+                    VkBufferUsageFlags usage, VkBuffer* buffer, VkDeviceMemory* memory);
+};
+
+#endif // __INDIRECT_DRAWS_HPP__
@@ -0,0 +1,413 @@
+#include "KtxFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef NAVS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace navs {
+
+static const uint8_t kKtx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB,
+                                            '\r', '\n', 0x1A, '\n'};
+static const uint8_t kKtx1Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB,
+                                            '\r', '\n', 0x1A, '\n'};
+static const uint32_t kKtx1Endianness = 0x04030201;
+
+// VkFormat values used below
+static const uint32_t kFormatR8G8B8A8Unorm = 37;
+static const uint32_t kFormatR8G8B8A8Srgb = 43;
+static const uint32_t kFormatBc7Unorm = 145;
+static const uint32_t kFormatBc7Srgb = 146;
+static const uint32_t kFormatEtc2R8G8B8A8Unorm = 151;
+static const uint32_t kFormatEtc2R8G8B8A8Srgb = 152;
+static const uint32_t kFormatAstc4x4Unorm = 157;
+static const uint32_t kFormatAstc12x12Srgb = 184;
+
+// Block sizes of the 14 ASTC 2D footprints, in VkFormat order
+static const uint8_t kAstcBlocks[14][2] = {{4, 4},  {5, 4},  {5, 5},   {6, 5},   {6, 6},
+                                           {8, 5},  {8, 6},  {8, 8},   {10, 5},  {10, 6},
+                                           {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+
+struct Ktx2Header {
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == kKtx2HeaderSize, "KTX2 header layout");
+
+struct Ktx2LevelIndex {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+struct Ktx1Header {
+  uint8_t identifier[12];
+  uint32_t endianness;
+  uint32_t glType;
+  uint32_t glTypeSize;
+  uint32_t glFormat;
+  uint32_t glInternalFormat;
+  uint32_t glBaseInternalFormat;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t numberOfArrayElements;
+  uint32_t numberOfFaces;
+  uint32_t numberOfMipmapLevels;
+  uint32_t bytesOfKeyValueData;
+};
+
+bool GetKtxBlockInfo(uint32_t vkFormat, uint32_t* blockWidth, uint32_t* blockHeight,
+                     uint32_t* blockBytes) {
+  if (vkFormat >= kFormatAstc4x4Unorm && vkFormat <= kFormatAstc12x12Srgb) {
+    const uint8_t* block = kAstcBlocks[(vkFormat - kFormatAstc4x4Unorm) / 2];
+    *blockWidth = block[0];
+    *blockHeight = block[1];
+    *blockBytes = 16;
+    return true;
+  }
+  switch (vkFormat) {
+    case kFormatR8G8B8A8Unorm:
+    case kFormatR8G8B8A8Srgb:
+      *blockWidth = 1;
+      *blockHeight = 1;
+      *blockBytes = 4;
+      return true;
+    case kFormatBc7Unorm:
+    case kFormatBc7Srgb:
+    case kFormatEtc2R8G8B8A8Unorm:
+    case kFormatEtc2R8G8B8A8Srgb:
+      *blockWidth = 4;
+      *blockHeight = 4;
+      *blockBytes = 16;
+      return true;
+    default:
+      return false;
+  }
+}
+
+static uint64_t GetLevelSize(uint32_t vkFormat, uint32_t width, uint32_t height) {
+  uint32_t blockWidth = 1, blockHeight = 1, blockBytes = 1;
+  GetKtxBlockInfo(vkFormat, &blockWidth, &blockHeight, &blockBytes);
+  return uint64_t((width + blockWidth - 1) / blockWidth) *
+         ((height + blockHeight - 1) / blockHeight) * blockBytes;
+}
+
+static bool IsSrgb(uint32_t vkFormat) {
+  if (vkFormat >= kFormatAstc4x4Unorm && vkFormat <= kFormatAstc12x12Srgb) {
+    return (vkFormat - kFormatAstc4x4Unorm) % 2 == 1;
+  }
+  return vkFormat == kFormatR8G8B8A8Srgb || vkFormat == kFormatBc7Srgb ||
+         vkFormat == kFormatEtc2R8G8B8A8Srgb;
+}
+
+// VkFormat of the glInternalFormat of a KTX1 file, 0 when not supported here
+static uint32_t GetKtx1Format(uint32_t glInternalFormat) {
+  // GL_COMPRESSED_RGBA_ASTC_4x4_KHR and GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR on
+  if (glInternalFormat >= 0x93B0 && glInternalFormat <= 0x93BD) {
+    return kFormatAstc4x4Unorm + 2 * (glInternalFormat - 0x93B0);
+  }
+  if (glInternalFormat >= 0x93D0 && glInternalFormat <= 0x93DD) {
+    return kFormatAstc4x4Unorm + 2 * (glInternalFormat - 0x93D0) + 1;
+  }
+  switch (glInternalFormat) {
+    case 0x8058:  // GL_RGBA8
+      return kFormatR8G8B8A8Unorm;
+    case 0x8C43:  // GL_SRGB8_ALPHA8
+      return kFormatR8G8B8A8Srgb;
+    case 0x8E8C:  // GL_COMPRESSED_RGBA_BPTC_UNORM
+      return kFormatBc7Unorm;
+    case 0x8E8D:  // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+      return kFormatBc7Srgb;
+    case 0x9278:  // GL_COMPRESSED_RGBA8_ETC2_EAC
+      return kFormatEtc2R8G8B8A8Unorm;
+    case 0x9279:  // GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+      return kFormatEtc2R8G8B8A8Srgb;
+    default:
+      return 0;
+  }
+}
+
+bool IsKtx2(const void* data, size_t size) {
+  return size >= kKtx2HeaderSize && memcmp(data, kKtx2Identifier, 12) == 0;
+}
+
+bool IsKtx1(const void* data, size_t size) {
+  return size >= sizeof(Ktx1Header) && memcmp(data, kKtx1Identifier, 12) == 0;
+}
+
+bool ReadKtx2(const void* data, size_t size, KtxTexture* texture) {
+  if (!IsKtx2(data, size)) {
+    return false;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  Ktx2Header header;
+  memcpy(&header, bytes, sizeof(header));
+
+  uint32_t blockWidth = 1, blockHeight = 1, blockBytes = 1;
+  if (!GetKtxBlockInfo(header.vkFormat, &blockWidth, &blockHeight, &blockBytes) ||
+      header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+      header.layerCount > 1 || header.faceCount != 1) {
+    return false;
+  }
+  const bool zstd = header.supercompressionScheme == KTX_SUPERCOMPRESSION_ZSTD;
+#ifndef NAVS_HAVE_ZSTD
+  if (zstd) {
+    return false;
+  }
+#endif
+  if (header.supercompressionScheme != KTX_SUPERCOMPRESSION_NONE && !zstd) {
+    return false;
+  }
+
+  // 0 asks the loader to generate the mips, there is only the first level in the file then
+  const uint32_t levelCount = std::max(1u, header.levelCount);
+  if (levelCount > 32 || kKtx2HeaderSize + levelCount * sizeof(Ktx2LevelIndex) > size) {
+    return false;
+  }
+
+  texture->vkFormat = header.vkFormat;
+  texture->width = header.pixelWidth;
+  texture->height = header.pixelHeight;
+  texture->supercompression = header.supercompressionScheme;
+  texture->levels.resize(levelCount);
+  for (uint32_t i = 0; i < levelCount; i++) {
+    Ktx2LevelIndex index;
+    memcpy(&index, bytes + kKtx2HeaderSize + i * sizeof(index), sizeof(index));
+    KtxLevel& level = texture->levels[i];
+    level.offset = index.byteOffset;
+    level.size = index.byteLength;
+    level.uncompressedSize = index.uncompressedByteLength;
+    level.width = std::max(1u, header.pixelWidth >> i);
+    level.height = std::max(1u, header.pixelHeight >> i);
+
+    if (level.offset > size || level.size > size - level.offset ||
+        level.uncompressedSize != GetLevelSize(header.vkFormat, level.width, level.height) ||
+        (!zstd && level.size != level.uncompressedSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReadKtx1(const void* data, size_t size, KtxTexture* texture) {
+  if (!IsKtx1(data, size)) {
+    return false;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  Ktx1Header header;
+  memcpy(&header, bytes, sizeof(header));
+
+  const uint32_t vkFormat = GetKtx1Format(header.glInternalFormat);
+  if (header.endianness != kKtx1Endianness || vkFormat == 0 || header.pixelWidth == 0 ||
+      header.pixelHeight == 0 || header.pixelDepth != 0 || header.numberOfArrayElements != 0 ||
+      header.numberOfFaces != 1) {
+    return false;
+  }
+  const uint32_t levelCount = std::max(1u, header.numberOfMipmapLevels);
+  if (levelCount > 32) {
+    return false;
+  }
+
+  texture->vkFormat = vkFormat;
+  texture->width = header.pixelWidth;
+  texture->height = header.pixelHeight;
+  texture->supercompression = KTX_SUPERCOMPRESSION_NONE;
+  texture->levels.resize(levelCount);
+
+  // Every level is its size followed by its data, padded to 4 bytes
+  uint64_t offset = sizeof(header) + uint64_t(header.bytesOfKeyValueData);
+  for (uint32_t i = 0; i < levelCount; i++) {
+    uint32_t imageSize;
+    if (offset + sizeof(imageSize) > size) {
+      return false;
+    }
+    memcpy(&imageSize, bytes + offset, sizeof(imageSize));
+    offset += sizeof(imageSize);
+
+    KtxLevel& level = texture->levels[i];
+    level.offset = offset;
+    level.size = imageSize;
+    level.uncompressedSize = imageSize;
+    level.width = std::max(1u, header.pixelWidth >> i);
+    level.height = std::max(1u, header.pixelHeight >> i);
+    if (level.size > size - offset ||
+        level.size != GetLevelSize(vkFormat, level.width, level.height)) {
+      return false;
+    }
+    offset += (uint64_t(imageSize) + 3) & ~uint64_t(3);
+  }
+  return true;
+}
+
+const uint8_t* GetKtxLevel(const void* data, const KtxTexture& texture, uint32_t level,
+                           std::vector<uint8_t>* storage) {
+  const KtxLevel& info = texture.levels[level];
+  const uint8_t* stored = static_cast<const uint8_t*>(data) + info.offset;
+  if (texture.supercompression == KTX_SUPERCOMPRESSION_NONE) {
+    return stored;
+  }
+#ifdef NAVS_HAVE_ZSTD
+  storage->resize(info.uncompressedSize);
+  const size_t decompressed = ZSTD_decompress(storage->data(), storage->size(), stored,
+                                              info.size);
+  if (ZSTD_isError(decompressed) || decompressed != info.uncompressedSize) {
+    return nullptr;
+  }
+  return storage->data();
+#else
+  return nullptr;
+#endif
+}
+
+// Basic data format descriptor block, see the Khronos Data Format Specification. Returns the
+// words after dfdTotalSize, empty for formats not described here.
+static std::vector<uint32_t> BuildDataFormatDescriptor(uint32_t vkFormat) {
+  const uint32_t kModelRgbsda = 1;
+  const uint32_t kModelAstc = 162;
+  const uint32_t kPrimariesBt709 = 1;
+  const uint32_t transfer = IsSrgb(vkFormat) ? 2 : 1;  // sRGB or linear
+
+  struct Sample {
+    uint32_t bitOffset;
+    uint32_t bitLength;
+    uint32_t channel;  // with the datatype qualifiers in the upper 4 bits
+    uint32_t upper;
+  };
+  std::vector<Sample> samples;
+  uint32_t model;
+  uint32_t blockWidth = 1, blockHeight = 1, blockBytes = 1;
+  GetKtxBlockInfo(vkFormat, &blockWidth, &blockHeight, &blockBytes);
+  if (vkFormat >= kFormatAstc4x4Unorm && vkFormat <= kFormatAstc12x12Srgb) {
+    model = kModelAstc;
+    samples.push_back({0, 128, 0, 0xFFFFFFFF});
+  } else if (vkFormat == kFormatR8G8B8A8Unorm || vkFormat == kFormatR8G8B8A8Srgb) {
+    model = kModelRgbsda;
+    // Alpha stays linear in sRGB formats
+    const uint32_t alpha = 15 | (transfer == 2 ? 0x10 : 0);
+    const uint32_t channels[4] = {0, 1, 2, alpha};
+    for (uint32_t i = 0; i < 4; i++) {
+      samples.push_back({i * 8, 8, channels[i], 255});
+    }
+  } else {
+    return std::vector<uint32_t>();
+  }
+
+  std::vector<uint32_t> words;
+  const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+  words.push_back(0);                        // vendor Khronos, basic descriptor type
+  words.push_back(2 | (blockSize << 16));    // version 1.3
+  words.push_back(model | (kPrimariesBt709 << 8) | (transfer << 16));
+  words.push_back((blockWidth - 1) | ((blockHeight - 1) << 8));
+  words.push_back(blockBytes);               // bytes of plane 0
+  words.push_back(0);
+  for (const Sample& sample : samples) {
+    words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+    words.push_back(0);                      // sample position
+    words.push_back(0);                      // lower
+    words.push_back(sample.upper);
+  }
+  return words;
+}
+
+static void Append(std::vector<uint8_t>* out, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  out->insert(out->end(), bytes, bytes + size);
+}
+
+static void PadTo(std::vector<uint8_t>* out, size_t alignment) {
+  out->resize((out->size() + alignment - 1) / alignment * alignment, 0);
+}
+
+bool WriteKtx2(const KtxTexture& texture, const void* data, int zstdLevel,
+               std::vector<uint8_t>* out) {
+#ifndef NAVS_HAVE_ZSTD
+  if (zstdLevel != 0) {
+    return false;
+  }
+#endif
+  const std::vector<uint32_t> dfd = BuildDataFormatDescriptor(texture.vkFormat);
+  if (dfd.empty() || texture.supercompression != KTX_SUPERCOMPRESSION_NONE) {
+    return false;
+  }
+  uint32_t blockWidth = 1, blockHeight = 1, blockBytes = 1;
+  GetKtxBlockInfo(texture.vkFormat, &blockWidth, &blockHeight, &blockBytes);
+
+  const uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+  Ktx2Header header = {};
+  memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+  header.vkFormat = texture.vkFormat;
+  header.typeSize = 1;
+  header.pixelWidth = texture.width;
+  header.pixelHeight = texture.height;
+  header.faceCount = 1;
+  header.levelCount = levelCount;
+  header.supercompressionScheme = zstdLevel != 0 ? KTX_SUPERCOMPRESSION_ZSTD
+                                                 : KTX_SUPERCOMPRESSION_NONE;
+
+  out->assign(kKtx2HeaderSize + levelCount * sizeof(Ktx2LevelIndex), 0);
+  header.dfdByteOffset = static_cast<uint32_t>(out->size());
+  const uint32_t dfdTotalSize = static_cast<uint32_t>(4 + dfd.size() * 4);
+  Append(out, &dfdTotalSize, sizeof(dfdTotalSize));
+  Append(out, dfd.data(), dfd.size() * 4);
+  header.dfdByteLength = dfdTotalSize;
+
+  const char kWriterKey[] = "KTXwriter";
+  const char kWriter[] = "HeartBeat KtxConvert";
+  header.kvdByteOffset = static_cast<uint32_t>(out->size());
+  const uint32_t keyValueLength = sizeof(kWriterKey) + sizeof(kWriter);
+  Append(out, &keyValueLength, sizeof(keyValueLength));
+  Append(out, kWriterKey, sizeof(kWriterKey));
+  Append(out, kWriter, sizeof(kWriter));
+  PadTo(out, 4);
+  header.kvdByteLength = static_cast<uint32_t>(out->size()) - header.kvdByteOffset;
+
+  // Smallest level first, so a loader reading front to back has a complete mip tail early.
+  // Uncompressed levels start at a multiple of the block size and of 4.
+  const size_t alignment = zstdLevel != 0 ? 1 : std::max<size_t>(blockBytes, 4);
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  std::vector<Ktx2LevelIndex> indices(levelCount);
+  for (uint32_t i = levelCount; i-- > 0;) {
+    const KtxLevel& level = texture.levels[i];
+    PadTo(out, alignment);
+    indices[i].byteOffset = out->size();
+    indices[i].uncompressedByteLength = level.size;
+    if (zstdLevel == 0) {
+      Append(out, bytes + level.offset, level.size);
+    } else {
+#ifdef NAVS_HAVE_ZSTD
+      const size_t start = out->size();
+      out->resize(start + ZSTD_compressBound(level.size));
+      const size_t compressed = ZSTD_compress(out->data() + start, out->size() - start,
+                                              bytes + level.offset, level.size, zstdLevel);
+      if (ZSTD_isError(compressed)) {
+        return false;
+      }
+      out->resize(start + compressed);
+#endif
+    }
+    indices[i].byteLength = out->size() - indices[i].byteOffset;
+  }
+
+  memcpy(out->data(), &header, sizeof(header));
+  memcpy(out->data() + kKtx2HeaderSize, indices.data(), indices.size() * sizeof(indices[0]));
+  return true;
+}
+
+} // navs namespace
@@ -0,0 +1,63 @@
+#ifndef __KTX_FILE_HPP__
+#define __KTX_FILE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Native reader and writer of KTX2 texture containers (2D, one layer and face). The header and
+// level index are read in place, so loading any one mip level only touches those bytes and the
+// level itself. Levels are stored smallest first. Supercompression with zstd is supported when
+// built with NAVS_HAVE_ZSTD, uncompressed files work everywhere. KTX1 files, as written by the
+// ASTC tools, can be read for conversion.
+
+namespace navs {
+
+const uint32_t kKtx2HeaderSize = 80;
+
+typedef enum KtxSupercompression {
+  KTX_SUPERCOMPRESSION_NONE = 0,
+  KTX_SUPERCOMPRESSION_ZSTD = 2,
+} KtxSupercompression;
+
+struct KtxLevel {
+  uint64_t offset;  // in the file
+  uint64_t size;    // stored, supercompressed if the file is
+  uint64_t uncompressedSize;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct KtxTexture {
+  uint32_t vkFormat;  // VkFormat
+  uint32_t width;
+  uint32_t height;
+  uint32_t supercompression;  // KtxSupercompression
+  std::vector<KtxLevel> levels;  // level 0 is the largest
+};
+
+// Block dimensions and bytes per block of the formats read and written here, false otherwise
+bool GetKtxBlockInfo(uint32_t vkFormat, uint32_t* blockWidth, uint32_t* blockHeight,
+                     uint32_t* blockBytes);
+
+bool IsKtx2(const void* data, size_t size);
+bool IsKtx1(const void* data, size_t size);
+
+// Reads the header and level index, the only bytes of data touched. size is that of the whole
+// file, which every level is checked to lie within.
+bool ReadKtx2(const void* data, size_t size, KtxTexture* texture);
+bool ReadKtx1(const void* data, size_t size, KtxTexture* texture);
+
+// Returns the contents of a level of data, decompressed into storage when supercompressed and
+// pointing into data otherwise, or nullptr if it can't be decompressed
+const uint8_t* GetKtxLevel(const void* data, const KtxTexture& texture, uint32_t level,
+                           std::vector<uint8_t>* storage);
+
+// Writes the levels of texture, read from data, as a KTX2 file. Compresses every level with
+// zstd at zstdLevel unless it is 0. False for formats without a data format descriptor here
+// (ASTC and RGBA8) or when zstd is unavailable.
+bool WriteKtx2(const KtxTexture& texture, const void* data, int zstdLevel,
+               std::vector<uint8_t>* out);
+
+} // navs namespace
+#endif // __KTX_FILE_HPP__
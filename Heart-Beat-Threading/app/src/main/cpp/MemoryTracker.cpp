@@ -0,0 +1,161 @@
+#include "MemoryTracker.h"
+
+#include <cassert>
+#include <map>
+#include <mutex>
+
+#include "VulkanUtil.h"
+
+namespace navs {
+
+namespace {
+
+struct Allocation {
+  VkDeviceSize size;
+  MemoryCategory category;
+};
+
+struct Tracker {
+  std::mutex mutex;
+  std::map<VkDeviceMemory, Allocation> deviceAllocations;
+  MemoryUsage device[MEMORY_CATEGORY_COUNT];
+  MemoryUsage host[MEMORY_CATEGORY_COUNT];
+};
+
+Tracker& GetTracker() {
+  static Tracker tracker;
+  return tracker;
+}
+
+void Add(MemoryUsage* usage, uint64_t bytes) {
+  usage->currentBytes += bytes;
+  usage->allocationCount++;
+  if (usage->currentBytes > usage->peakBytes) {
+    usage->peakBytes = usage->currentBytes;
+  }
+}
+
+void Remove(MemoryUsage* usage, uint64_t bytes) {
+  assert(usage->currentBytes >= bytes && usage->allocationCount > 0);
+  usage->currentBytes -= bytes;
+  usage->allocationCount--;
+}
+
+} // anonymous namespace
+
+const char* GetMemoryCategoryName(MemoryCategory category) {
+  switch (category) {
+    case MEMORY_CATEGORY_GEOMETRY:
+      return "geometry";
+    case MEMORY_CATEGORY_TEXTURE:
+      return "texture";
+    case MEMORY_CATEGORY_UNIFORM:
+      return "uniform";
+    case MEMORY_CATEGORY_ATTACHMENT:
+      return "attachment";
+    case MEMORY_CATEGORY_STAGING:
+      return "staging";
+    default:
+      return "unknown";
+  }
+}
+
+VkResult AllocateTrackedMemory(VkDevice device, const VkMemoryAllocateInfo* allocInfo,
+                               MemoryCategory category, VkDeviceMemory* memory) {
+  VkResult result = vkAllocateMemory(device, allocInfo, nullptr, memory);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  Tracker& tracker = GetTracker();
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  tracker.deviceAllocations[*memory] = {allocInfo->allocationSize, category};
+  Add(&tracker.device[category], allocInfo->allocationSize);
+  return result;
+}
+
+void FreeTrackedMemory(VkDevice device, VkDeviceMemory memory) {
+  if (memory == VK_NULL_HANDLE) {
+    return;
+  }
+  {
+    Tracker& tracker = GetTracker();
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    auto it = tracker.deviceAllocations.find(memory);
+    if (it != tracker.deviceAllocations.end()) {
+      Remove(&tracker.device[it->second.category], it->second.size);
+      tracker.deviceAllocations.erase(it);
+    } else {
+      LOGW("Freeing device memory that was not tracked");
+    }
+  }
+  vkFreeMemory(device, memory, nullptr);
+}
+
+void TrackHostAllocation(MemoryCategory category, size_t bytes) {
+  Tracker& tracker = GetTracker();
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  Add(&tracker.host[category], bytes);
+}
+
+void UntrackHostAllocation(MemoryCategory category, size_t bytes) {
+  Tracker& tracker = GetTracker();
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  Remove(&tracker.host[category], bytes);
+}
+
+MemoryUsage GetDeviceMemoryUsage(MemoryCategory category) {
+  Tracker& tracker = GetTracker();
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  return tracker.device[category];
+}
+
+MemoryUsage GetHostMemoryUsage(MemoryCategory category) {
+  Tracker& tracker = GetTracker();
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  return tracker.host[category];
+}
+
+void DumpMemoryUsage(void) {
+  Tracker& tracker = GetTracker();
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+
+  uint64_t deviceTotal = 0, hostTotal = 0;
+  LOGI("Memory usage        device current/peak (allocs)     host current/peak (allocs)");
+  for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+    const MemoryUsage& device = tracker.device[i];
+    const MemoryUsage& host = tracker.host[i];
+    LOGI("  %-10s  %10llu / %10llu (%3u)  %10llu / %10llu (%3u)",
+         GetMemoryCategoryName(static_cast<MemoryCategory>(i)),
+         (unsigned long long)device.currentBytes, (unsigned long long)device.peakBytes,
+         device.allocationCount,
+         (unsigned long long)host.currentBytes, (unsigned long long)host.peakBytes,
+         host.allocationCount);
+    deviceTotal += device.currentBytes;
+    hostTotal += host.currentBytes;
+  }
+  LOGI("  total       %10llu device bytes, %10llu host bytes",
+       (unsigned long long)deviceTotal, (unsigned long long)hostTotal);
+}
+
+uint32_t ReportMemoryLeaks(void) {
+  Tracker& tracker = GetTracker();
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+
+  for (auto& allocation : tracker.deviceAllocations) {
+    LOGW("Leaked %llu bytes of %s device memory",
+         (unsigned long long)allocation.second.size,
+         GetMemoryCategoryName(allocation.second.category));
+  }
+  for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+    if (tracker.host[i].currentBytes > 0) {
+      LOGW("Leaked %llu bytes of %s host memory in %u allocations",
+           (unsigned long long)tracker.host[i].currentBytes,
+           GetMemoryCategoryName(static_cast<MemoryCategory>(i)),
+           tracker.host[i].allocationCount);
+    }
+  }
+  return static_cast<uint32_t>(tracker.deviceAllocations.size());
+}
+
+} // navs namespace
@@ -0,0 +1,48 @@
+#ifndef __MEMORY_TRACKER_HPP__
+#define __MEMORY_TRACKER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vulkan_wrapper.h"
+
+namespace navs {
+
+typedef enum MemoryCategory {
+  MEMORY_CATEGORY_GEOMETRY = 0,
+  MEMORY_CATEGORY_TEXTURE,
+  MEMORY_CATEGORY_UNIFORM,
+  MEMORY_CATEGORY_ATTACHMENT,
+  MEMORY_CATEGORY_STAGING,
+  MEMORY_CATEGORY_COUNT
+} MemoryCategory;
+
+struct MemoryUsage {
+  uint64_t currentBytes;
+  uint64_t peakBytes;
+  uint32_t allocationCount;
+};
+
+const char* GetMemoryCategoryName(MemoryCategory category);
+
+// vkAllocateMemory/vkFreeMemory replacements that account every device allocation under
+// a category. All functions here are thread safe.
+VkResult AllocateTrackedMemory(VkDevice device, const VkMemoryAllocateInfo* allocInfo,
+                               MemoryCategory category, VkDeviceMemory* memory);
+void FreeTrackedMemory(VkDevice device, VkDeviceMemory memory);
+
+// Large host side allocations (file contents, decoded geometry) are reported by the owner
+void TrackHostAllocation(MemoryCategory category, size_t bytes);
+void UntrackHostAllocation(MemoryCategory category, size_t bytes);
+
+MemoryUsage GetDeviceMemoryUsage(MemoryCategory category);
+MemoryUsage GetHostMemoryUsage(MemoryCategory category);
+
+// Logs current and peak bytes of every category
+void DumpMemoryUsage(void);
+
+// Logs every device allocation that was never freed, returns how many there are
+uint32_t ReportMemoryLeaks(void);
+
+} // navs namespace
+#endif // __MEMORY_TRACKER_HPP__
@@ -0,0 +1,203 @@
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace navs {
+
+QuantizationScale GetQuantizationScale(const MeshBounds& bounds) {
+  QuantizationScale quantization;
+  quantization.offset = (bounds.min + bounds.max) * 0.5f;
+  // Flat axes still need a non zero scale to divide by
+  quantization.scale = glm::max((bounds.max - bounds.min) * 0.5f, glm::vec3(1e-6f));
+  return quantization;
+}
+
+int16_t EncodeSnorm16(float value) {
+  return static_cast<int16_t>(std::round(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+float DecodeSnorm16(int16_t value) {
+  return std::max(value / 32767.0f, -1.0f);
+}
+
+// Round to nearest even is not needed here, mantissa bits are rounded half up
+uint16_t EncodeHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7C00);  // overflow and inf/nan clamp to inf
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    // Denormal, shift the implicit leading one in
+    mantissa |= 0x800000;
+    const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    return static_cast<uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+  }
+  // A mantissa carry correctly bumps the exponent
+  return static_cast<uint16_t>((sign | (exponent << 10) | (mantissa >> 13)) +
+                               ((mantissa >> 12) & 1));
+}
+
+float DecodeHalf(uint16_t value) {
+  const uint32_t sign = (value & 0x8000u) << 16;
+  uint32_t exponent = (value >> 10) & 0x1F;
+  uint32_t mantissa = value & 0x3FF;
+  uint32_t bits;
+
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    } else {
+      // Normalize the denormal
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x400) == 0) {
+        mantissa <<= 1;
+        exponent--;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+  } else if (exponent == 31) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+glm::vec2 EncodeOctahedral(const glm::vec3& direction) {
+  const float sum = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+  if (sum == 0.0f) {
+    return glm::vec2(0.0f);
+  }
+  glm::vec3 n = direction / sum;
+  if (n.z >= 0.0f) {
+    return glm::vec2(n.x, n.y);
+  }
+  // Fold the lower hemisphere over the diagonals
+  return glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                   (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded) {
+  glm::vec3 n(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+  const float t = std::max(-n.z, 0.0f);
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return glm::normalize(n);
+}
+
+float GetBitangentSign(const MeshVertex& vertex) {
+  return vertex.tangent.w < 0.0f ? -1.0f : 1.0f;
+}
+
+glm::vec3 GetBitangent(const MeshVertex& vertex) {
+  return glm::cross(vertex.normal, glm::vec3(vertex.tangent)) * GetBitangentSign(vertex);
+}
+
+static float AngleDegrees(const glm::vec3& a, const glm::vec3& b) {
+  return std::acos(std::min(std::max(glm::dot(a, b), -1.0f), 1.0f)) * 57.2957795f;
+}
+
+QuantizationError MeasureQuantizationError(const MeshVertex* vertices, size_t count,
+                                           const QuantizationScale& quantization) {
+  QuantizationError error = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (size_t i = 0; i < count; i++) {
+    const MeshVertex& vertex = vertices[i];
+
+    const glm::vec3 q = (vertex.pos - quantization.offset) / quantization.scale;
+    const glm::vec3 pos(DecodeSnorm16(EncodeSnorm16(q.x)), DecodeSnorm16(EncodeSnorm16(q.y)),
+                        DecodeSnorm16(EncodeSnorm16(q.z)));
+    error.position = std::max(error.position,
+                              glm::length(pos * quantization.scale + quantization.offset -
+                                          vertex.pos));
+
+    const glm::vec2 normal = EncodeOctahedral(vertex.normal);
+    error.normalDegrees = std::max(error.normalDegrees, AngleDegrees(vertex.normal,
+        DecodeOctahedral(glm::vec2(DecodeSnorm16(EncodeSnorm16(normal.x)),
+                                   DecodeSnorm16(EncodeSnorm16(normal.y))))));
+
+    const glm::vec3 direction(vertex.tangent);
+    if (glm::dot(direction, direction) > 0.0f) {
+      const glm::vec2 tangent = EncodeOctahedral(direction);
+      error.tangentDegrees = std::max(error.tangentDegrees, AngleDegrees(direction,
+          DecodeOctahedral(glm::vec2(DecodeSnorm16(EncodeSnorm16(tangent.x)),
+                                     DecodeSnorm16(EncodeSnorm16(tangent.y))))));
+    }
+
+    const glm::vec2 uv(DecodeHalf(EncodeHalf(vertex.uv.x)), DecodeHalf(EncodeHalf(vertex.uv.y)));
+    error.uv = std::max(error.uv, glm::length(uv - vertex.uv));
+  }
+  return error;
+}
+
+void InterleaveVertices(const MeshVertex* vertices, size_t count,
+                        const VertexComponent* components, size_t componentCount,
+                        const QuantizationScale& quantization, uint8_t* dst) {
+  for (size_t v = 0; v < count; v++) {
+    const MeshVertex& vertex = vertices[v];
+    for (size_t c = 0; c < componentCount; c++) {
+      const uint32_t size = GetComponentSize(components[c]);
+      int16_t packed[4];
+      switch (components[c]) {
+        case VERTEX_COMPONENT_POSITION:
+          memcpy(dst, &vertex.pos, size);
+          break;
+        case VERTEX_COMPONENT_NORMAL:
+          memcpy(dst, &vertex.normal, size);
+          break;
+        case VERTEX_COMPONENT_UV:
+          memcpy(dst, &vertex.uv, size);
+          break;
+        case VERTEX_COMPONENT_TANGENT:
+        case VERTEX_COMPONENT_TANGENT_SIGNED:
+          memcpy(dst, &vertex.tangent, size);
+          break;
+        case VERTEX_COMPONENT_BITANGENT: {
+          const glm::vec3 bitangent = GetBitangent(vertex);
+          memcpy(dst, &bitangent, size);
+          break;
+        }
+        case VERTEX_COMPONENT_POSITION_SNORM16: {
+          const glm::vec3 q = (vertex.pos - quantization.offset) / quantization.scale;
+          packed[0] = EncodeSnorm16(q.x);
+          packed[1] = EncodeSnorm16(q.y);
+          packed[2] = EncodeSnorm16(q.z);
+          packed[3] = EncodeSnorm16(GetBitangentSign(vertex));
+          memcpy(dst, packed, size);
+          break;
+        }
+        case VERTEX_COMPONENT_NORMAL_OCT16:
+        case VERTEX_COMPONENT_TANGENT_OCT16: {
+          const glm::vec2 oct = EncodeOctahedral(components[c] == VERTEX_COMPONENT_NORMAL_OCT16
+                                                     ? vertex.normal
+                                                     : glm::vec3(vertex.tangent));
+          packed[0] = EncodeSnorm16(oct.x);
+          packed[1] = EncodeSnorm16(oct.y);
+          memcpy(dst, packed, size);
+          break;
+        }
+        case VERTEX_COMPONENT_UV_HALF: {
+          const uint16_t half[2] = {EncodeHalf(vertex.uv.x), EncodeHalf(vertex.uv.y)};
+          memcpy(dst, half, size);
+          break;
+        }
+        default:
+          memset(dst, 0, size);
+      }
+      dst += size;
+    }
+  }
+}
+
+} // navs namespace
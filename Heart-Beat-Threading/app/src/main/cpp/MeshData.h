@@ -0,0 +1,135 @@
+#ifndef __MESH_DATA_HPP__
+#define __MESH_DATA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Vulkan free geometry types shared by the runtime loader and the offline tools
+
+namespace navs {
+
+typedef enum VertexComponent {
+  VERTEX_COMPONENT_POSITION = 0x0,
+  VERTEX_COMPONENT_NORMAL = 0x1,
+  VERTEX_COMPONENT_COLOR = 0x2,
+  VERTEX_COMPONENT_UV = 0x3,
+  VERTEX_COMPONENT_TANGENT = 0x4,
+  VERTEX_COMPONENT_BITANGENT = 0x5,
+  VERTEX_COMPONENT_DUMMY_FLOAT = 0x6,
+  VERTEX_COMPONENT_DUMMY_VEC4 = 0x7,
+  // Quantized components, see the encode functions below
+  VERTEX_COMPONENT_POSITION_SNORM16 = 0x8,  // xyz relative to the bounds, w bitangent sign
+  VERTEX_COMPONENT_NORMAL_OCT16 = 0x9,
+  VERTEX_COMPONENT_TANGENT_OCT16 = 0xA,
+  VERTEX_COMPONENT_UV_HALF = 0xB,
+  VERTEX_COMPONENT_TANGENT_SIGNED = 0xC  // xyz plus the bitangent sign in w
+} VertexComponent;
+
+inline uint32_t GetComponentSize(VertexComponent component) {
+  switch (component) {
+    case VERTEX_COMPONENT_UV:
+      return 2 * sizeof(float);
+    case VERTEX_COMPONENT_DUMMY_FLOAT:
+      return sizeof(float);
+    case VERTEX_COMPONENT_DUMMY_VEC4:
+    case VERTEX_COMPONENT_TANGENT_SIGNED:
+      return 4 * sizeof(float);
+    case VERTEX_COMPONENT_POSITION_SNORM16:
+      return 4 * sizeof(int16_t);
+    case VERTEX_COMPONENT_NORMAL_OCT16:
+    case VERTEX_COMPONENT_TANGENT_OCT16:
+    case VERTEX_COMPONENT_UV_HALF:
+      return 2 * sizeof(int16_t);
+    default:
+      // All components except the ones listed above are made up of 3 floats
+      return 3 * sizeof(float);
+  }
+}
+
+// Components that only decode with the mesh bounds or in the shader, everything else is floats
+inline bool IsQuantizedComponent(VertexComponent component) {
+  return component >= VERTEX_COMPONENT_POSITION_SNORM16 &&
+         component != VERTEX_COMPONENT_TANGENT_SIGNED;
+}
+
+// Decoded vertex, packed into a VertexLayout (or a runtime component list by
+// InterleaveVertices()) before upload
+struct MeshVertex {
+  glm::vec3 pos;
+  glm::vec3 normal;
+  glm::vec2 uv;
+  glm::vec4 tangent;  // w is the bitangent sign, bitangent = cross(normal, tangent) * w
+};
+
+struct MeshPart {
+  uint32_t vertexBase;
+  uint32_t vertexCount;
+  uint32_t indexBase;
+  uint32_t indexCount;
+};
+
+// One level of detail, its parts and their indices are contiguous. Every level draws from the
+// same vertices.
+struct MeshLod {
+  uint32_t partBase;
+  uint32_t partCount;
+  uint32_t indexBase;
+  uint32_t indexCount;
+  float error;  // largest simplification error in model units, 0 for the full mesh
+};
+
+struct MeshBounds {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// Applied to every decoded vertex
+struct MeshTransform {
+  glm::vec3 scale;
+  glm::vec3 center;
+  glm::vec2 uvscale;
+};
+
+// Maps positions inside the mesh bounds onto [-1, 1] for snorm16 storage, the shader restores
+// them as pos = quantized * scale + offset
+struct QuantizationScale {
+  glm::vec3 scale;
+  glm::vec3 offset;
+};
+
+QuantizationScale GetQuantizationScale(const MeshBounds& bounds);
+
+int16_t EncodeSnorm16(float value);
+float DecodeSnorm16(int16_t value);
+uint16_t EncodeHalf(float value);
+float DecodeHalf(uint16_t value);
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2
+glm::vec2 EncodeOctahedral(const glm::vec3& direction);
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded);
+
+// -1 when the bitangent points against cross(normal, tangent)
+float GetBitangentSign(const MeshVertex& vertex);
+glm::vec3 GetBitangent(const MeshVertex& vertex);
+
+// Largest error each quantized component introduces over a set of vertices
+struct QuantizationError {
+  float position;       // object space units
+  float normalDegrees;
+  float tangentDegrees;
+  float uv;
+};
+
+QuantizationError MeasureQuantizationError(const MeshVertex* vertices, size_t count,
+                                           const QuantizationScale& quantization);
+
+// Writes count vertices into dst following components, dst must hold count * stride bytes.
+// Components the decoder does not produce (color, dummies) are zeroed.
+void InterleaveVertices(const MeshVertex* vertices, size_t count,
+                        const VertexComponent* components, size_t componentCount,
+                        const QuantizationScale& quantization, uint8_t* dst);
+
+} // navs namespace
+#endif // __MESH_DATA_HPP__
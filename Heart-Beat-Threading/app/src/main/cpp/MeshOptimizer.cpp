@@ -0,0 +1,473 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace navs {
+
+namespace {
+
+// Forsyth's scoring constants, the cache modelled here is larger than the hardware one on purpose
+const uint32_t kScoreCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriangleScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+
+const uint32_t kUnusedVertex = ~0u;
+
+float GetVertexScore(int32_t cachePosition, uint32_t remainingTriangles) {
+  if (remainingTriangles == 0) {
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // The last triangle's vertices score a fixed amount so strips don't get favoured
+      score = kLastTriangleScore;
+    } else {
+      const float scaler = 1.0f / (kScoreCacheSize - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+    }
+  }
+  // Vertices with few triangles left are finished first so they don't strand lone triangles
+  return score + kValenceBoostScale * std::pow(static_cast<float>(remainingTriangles),
+                                               -kValenceBoostPower);
+}
+
+// FIFO cache simulation with timestamps, a vertex is cached while fewer than cacheSize misses
+// happened since it was loaded
+struct CacheSimulation {
+  std::vector<uint32_t> timestamps;
+  uint32_t time;
+  uint32_t cacheSize;
+
+  CacheSimulation(size_t vertexCount, uint32_t size) :
+      timestamps(vertexCount, 0), time(size + 1), cacheSize(size) {}
+
+  bool Miss(uint32_t vertex) {
+    if (time - timestamps[vertex] > cacheSize) {
+      timestamps[vertex] = time++;
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t MissTriangle(const uint32_t* triangle) {
+    // Evaluated separately, a single expression would not pin the order of the lookups
+    uint32_t misses = Miss(triangle[0]);
+    misses += Miss(triangle[1]);
+    misses += Miss(triangle[2]);
+    return misses;
+  }
+
+  void Flush() { time += cacheSize + 1; }
+};
+
+glm::vec3 GetTriangleNormal(const MeshVertex* vertices, const uint32_t* triangle) {
+  const glm::vec3& a = vertices[triangle[0]].pos;
+  return glm::cross(vertices[triangle[1]].pos - a, vertices[triangle[2]].pos - a);
+}
+
+float GetEdge(const glm::vec3& a, const glm::vec3& b, float x, float y) {
+  return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+} // anonymous namespace
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles around each vertex, packed. The live ones are kept at the front of each list.
+  std::vector<uint32_t> remaining(vertexCount, 0);
+  for (size_t i = 0; i < indexCount; i++) {
+    assert(indices[i] < vertexCount);
+    remaining[indices[i]]++;
+  }
+  std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+  }
+  std::vector<uint32_t> adjacency(indexCount);
+  {
+    std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < indexCount; i++) {
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<float> vertexScore(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    vertexScore[v] = GetVertexScore(-1, remaining[v]);
+  }
+
+  std::vector<float> triangleScore(triangleCount);
+  std::vector<uint8_t> emitted(triangleCount, 0);
+  for (size_t t = 0; t < triangleCount; t++) {
+    const uint32_t* triangle = indices + t * 3;
+    triangleScore[t] =
+        vertexScore[triangle[0]] + vertexScore[triangle[1]] + vertexScore[triangle[2]];
+  }
+
+  std::vector<uint32_t> output(indices, indices + triangleCount * 3);
+  uint32_t cache[kScoreCacheSize + 3];
+  uint32_t newCache[kScoreCacheSize + 3];
+  uint32_t cacheSize = 0;
+
+  size_t inputCursor = 0;
+  int64_t best = -1;
+  for (size_t outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++) {
+    if (best < 0) {
+      // Nothing in the cache touches a live triangle, carry on in input order
+      while (emitted[inputCursor]) {
+        inputCursor++;
+      }
+      best = static_cast<int64_t>(inputCursor);
+    }
+
+    const uint32_t* triangle = &output[best * 3];
+    memcpy(indices + outputTriangle * 3, triangle, sizeof(uint32_t) * 3);
+    emitted[best] = 1;
+
+    // The emitted triangle moves to the front of the LRU cache
+    uint32_t newCacheSize = 0;
+    for (int k = 0; k < 3; k++) {
+      const uint32_t vertex = triangle[k];
+      if (std::find(newCache, newCache + newCacheSize, vertex) == newCache + newCacheSize) {
+        newCache[newCacheSize++] = vertex;
+      }
+
+      // Drop the triangle from the vertex's live list
+      uint32_t* list = &adjacency[adjacencyOffset[vertex]];
+      uint32_t* last = list + remaining[vertex] - 1;
+      uint32_t* found = std::find(list, last + 1, static_cast<uint32_t>(best));
+      assert(found <= last);
+      std::swap(*found, *last);
+      remaining[vertex]--;
+    }
+    for (uint32_t i = 0; i < cacheSize; i++) {
+      const uint32_t vertex = cache[i];
+      if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+        newCache[newCacheSize++] = vertex;
+      }
+    }
+
+    // Rescore everything that was or is in the cache and pick the best live triangle around it
+    best = -1;
+    float bestScore = -FLT_MAX;
+    for (uint32_t i = 0; i < newCacheSize; i++) {
+      const uint32_t vertex = newCache[i];
+      const int32_t position = i < kScoreCacheSize ? static_cast<int32_t>(i) : -1;
+
+      const float score = GetVertexScore(position, remaining[vertex]);
+      const float delta = score - vertexScore[vertex];
+      vertexScore[vertex] = score;
+
+      const uint32_t* list = &adjacency[adjacencyOffset[vertex]];
+      for (uint32_t j = 0; j < remaining[vertex]; j++) {
+        const uint32_t t = list[j];
+        triangleScore[t] += delta;
+      }
+    }
+    for (uint32_t i = 0; i < std::min(newCacheSize, kScoreCacheSize); i++) {
+      const uint32_t vertex = newCache[i];
+      const uint32_t* list = &adjacency[adjacencyOffset[vertex]];
+      for (uint32_t j = 0; j < remaining[vertex]; j++) {
+        const uint32_t t = list[j];
+        if (triangleScore[t] > bestScore) {
+          bestScore = triangleScore[t];
+          best = t;
+        }
+      }
+    }
+
+    cacheSize = std::min(newCacheSize, kScoreCacheSize);
+    memcpy(cache, newCache, sizeof(uint32_t) * cacheSize);
+  }
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices,
+                      size_t vertexCount, float threshold) {
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+  const VertexCacheStats before = AnalyzeVertexCache(indices, indexCount, vertexCount);
+
+  // Hard boundaries are triangles that miss on all three vertices, the cache starts over there
+  // anyway so moving the run after it costs nothing
+  std::vector<uint32_t> hardClusters;
+  {
+    CacheSimulation cache(vertexCount, 16);
+    for (size_t t = 0; t < triangleCount; t++) {
+      if (cache.MissTriangle(indices + t * 3) == 3) {
+        hardClusters.push_back(static_cast<uint32_t>(t));
+      }
+    }
+  }
+  hardClusters.push_back(static_cast<uint32_t>(triangleCount));
+
+  // Soft boundaries split a hard cluster wherever starting over keeps its ACMR within threshold
+  std::vector<uint32_t> clusters;
+  for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+    const uint32_t start = hardClusters[c];
+    const uint32_t end = hardClusters[c + 1];
+
+    CacheSimulation cache(vertexCount, 16);
+    uint32_t misses = 0;
+    for (uint32_t t = start; t < end; t++) {
+      misses += cache.MissTriangle(indices + t * 3);
+    }
+    const float target = threshold * misses / (end - start);
+
+    cache.Flush();
+    clusters.push_back(start);
+    uint32_t clusterStart = start;
+    uint32_t clusterMisses = 0;
+    for (uint32_t t = start; t < end; t++) {
+      clusterMisses += cache.MissTriangle(indices + t * 3);
+      const uint32_t clusterTriangles = t + 1 - clusterStart;
+      if (t + 1 < end && static_cast<float>(clusterMisses) / clusterTriangles <= target) {
+        clusters.push_back(t + 1);
+        clusterStart = t + 1;
+        clusterMisses = 0;
+        cache.Flush();
+      }
+    }
+  }
+  clusters.push_back(static_cast<uint32_t>(triangleCount));
+
+  // Area weighted centroid of the whole range and of each cluster
+  const size_t clusterCount = clusters.size() - 1;
+  std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+  std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+  std::vector<float> clusterArea(clusterCount, 0.0f);
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+  for (size_t c = 0; c < clusterCount; c++) {
+    for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+      const uint32_t* triangle = indices + t * 3;
+      const glm::vec3 normal = GetTriangleNormal(vertices, triangle);
+      const float area = glm::length(normal);
+      const glm::vec3 centroid = (vertices[triangle[0]].pos + vertices[triangle[1]].pos +
+                                  vertices[triangle[2]].pos) * (1.0f / 3.0f);
+      clusterCentroid[c] += centroid * area;
+      clusterNormal[c] += normal;
+      clusterArea[c] += area;
+    }
+    meshCentroid += clusterCentroid[c];
+    meshArea += clusterArea[c];
+  }
+  if (meshArea > 0.0f) {
+    meshCentroid /= meshArea;
+  }
+
+  // Clusters facing away from the centre are likely in front of the rest, draw them first
+  std::vector<float> sortKey(clusterCount, 0.0f);
+  std::vector<uint32_t> order(clusterCount);
+  for (size_t c = 0; c < clusterCount; c++) {
+    order[c] = static_cast<uint32_t>(c);
+    const float normalLength = glm::length(clusterNormal[c]);
+    if (clusterArea[c] > 0.0f && normalLength > 0.0f) {
+      const glm::vec3 centroid = clusterCentroid[c] / clusterArea[c];
+      sortKey[c] = glm::dot(centroid - meshCentroid, clusterNormal[c] / normalLength);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&sortKey](uint32_t a, uint32_t b) {
+    return sortKey[a] > sortKey[b];
+  });
+
+  std::vector<uint32_t> original(indices, indices + triangleCount * 3);
+  uint32_t* dst = indices;
+  for (uint32_t c : order) {
+    const size_t count = (clusters[c + 1] - clusters[c]) * 3;
+    memcpy(dst, &original[clusters[c] * 3], sizeof(uint32_t) * count);
+    dst += count;
+  }
+
+  const VertexCacheStats after = AnalyzeVertexCache(indices, indexCount, vertexCount);
+  if (after.acmr > before.acmr * threshold) {
+    memcpy(indices, original.data(), sizeof(uint32_t) * original.size());
+  }
+}
+
+size_t OptimizeVertexFetch(MeshVertex* dst, uint32_t* indices, size_t indexCount,
+                           const MeshVertex* vertices, size_t vertexCount, uint32_t* remap) {
+  assert(dst != vertices);
+  std::vector<uint32_t> localRemap;
+  if (remap == nullptr) {
+    localRemap.resize(vertexCount);
+    remap = localRemap.data();
+  }
+  std::fill(remap, remap + vertexCount, kUnusedVertex);
+  uint32_t nextVertex = 0;
+  for (size_t i = 0; i < indexCount; i++) {
+    const uint32_t vertex = indices[i];
+    assert(vertex < vertexCount);
+    if (remap[vertex] == kUnusedVertex) {
+      remap[vertex] = nextVertex;
+      dst[nextVertex++] = vertices[vertex];
+    }
+    indices[i] = remap[vertex];
+  }
+  return nextVertex;
+}
+
+size_t OptimizeMesh(MeshVertex* dst, uint32_t* indices, size_t indexCount,
+                    const MeshVertex* vertices, size_t vertexCount, std::vector<MeshPart>* parts,
+                    uint32_t* remap) {
+  for (const MeshPart& part : *parts) {
+    uint32_t* partIndices = indices + part.indexBase;
+    OptimizeVertexCache(partIndices, part.indexCount, vertexCount);
+    OptimizeOverdraw(partIndices, part.indexCount, vertices, vertexCount);
+  }
+
+  const size_t uniqueVertices = OptimizeVertexFetch(dst, indices, indexCount, vertices,
+                                                    vertexCount, remap);
+
+  // Parts now cover the range their first references were assigned
+  for (MeshPart& part : *parts) {
+    if (part.indexCount == 0) {
+      part.vertexBase = 0;
+      part.vertexCount = 0;
+      continue;
+    }
+    const uint32_t* first = indices + part.indexBase;
+    const uint32_t* last = first + part.indexCount;
+    const uint32_t minVertex = *std::min_element(first, last);
+    part.vertexBase = minVertex;
+    part.vertexCount = *std::max_element(first, last) - minVertex + 1;
+  }
+  return uniqueVertices;
+}
+
+uint32_t NarrowIndices(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+  // Primitive restart stays off, so 0xFFFF is an ordinary index
+  if (vertexCount > 0x10000) {
+    return sizeof(uint32_t);
+  }
+  // Writes trail the reads, byte copies keep the compiler from assuming the two don't alias
+  uint8_t* narrow = reinterpret_cast<uint8_t*>(indices);
+  for (size_t i = 0; i < indexCount; i++) {
+    const uint16_t index = static_cast<uint16_t>(indices[i]);
+    memcpy(narrow + i * sizeof(uint16_t), &index, sizeof(uint16_t));
+  }
+  return sizeof(uint16_t);
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, uint32_t cacheSize) {
+  VertexCacheStats stats = {0.0f, 0.0f};
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return stats;
+  }
+
+  CacheSimulation cache(vertexCount, cacheSize);
+  std::vector<uint8_t> referenced(vertexCount, 0);
+  size_t misses = 0;
+  size_t uniqueVertices = 0;
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    misses += cache.Miss(indices[i]);
+    if (!referenced[indices[i]]) {
+      referenced[indices[i]] = 1;
+      uniqueVertices++;
+    }
+  }
+  stats.acmr = static_cast<float>(misses) / triangleCount;
+  stats.atvr = static_cast<float>(misses) / uniqueVertices;
+  return stats;
+}
+
+OverdrawStats AnalyzeOverdraw(const uint32_t* indices, size_t indexCount,
+                              const MeshVertex* vertices, size_t vertexCount) {
+  const int kViewport = 256;
+  OverdrawStats stats = {0, 0, 0.0f};
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return stats;
+  }
+
+  glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    assert(indices[i] < vertexCount);
+    minPos = glm::min(minPos, vertices[indices[i]].pos);
+    maxPos = glm::max(maxPos, vertices[indices[i]].pos);
+  }
+  const glm::vec3 center = (minPos + maxPos) * 0.5f;
+  const glm::vec3 halfExtent = (maxPos - minPos) * 0.5f;
+  const float extent = std::max(std::max(halfExtent.x, halfExtent.y),
+                                std::max(halfExtent.z, 1e-6f));
+
+  std::vector<float> depth(kViewport * kViewport);
+  for (int axis = 0; axis < 3; axis++) {
+    for (int flip = 0; flip < 2; flip++) {
+      std::fill(depth.begin(), depth.end(), -FLT_MAX);
+
+      for (size_t t = 0; t < triangleCount; t++) {
+        // Viewer on the +z side of the rotated frame, larger z is closer. Looking from the other
+        // side is a half turn about y, which keeps counter clockwise triangles front facing.
+        glm::vec3 screen[3];
+        for (int k = 0; k < 3; k++) {
+          const glm::vec3 p = (vertices[indices[t * 3 + k]].pos - center) / extent;
+          glm::vec3 view(p[(axis + 1) % 3], p[(axis + 2) % 3], p[axis]);
+          if (flip) {
+            view.x = -view.x;
+            view.z = -view.z;
+          }
+          screen[k] = glm::vec3((view.x * 0.5f + 0.5f) * kViewport,
+                                (view.y * 0.5f + 0.5f) * kViewport, view.z);
+        }
+
+        const float area = GetEdge(screen[0], screen[1], screen[2].x, screen[2].y);
+        if (area <= 0.0f) {
+          continue;
+        }
+
+        const int x0 = std::max(0, static_cast<int>(std::floor(
+            std::min(std::min(screen[0].x, screen[1].x), screen[2].x))));
+        const int x1 = std::min(kViewport - 1, static_cast<int>(std::ceil(
+            std::max(std::max(screen[0].x, screen[1].x), screen[2].x))));
+        const int y0 = std::max(0, static_cast<int>(std::floor(
+            std::min(std::min(screen[0].y, screen[1].y), screen[2].y))));
+        const int y1 = std::min(kViewport - 1, static_cast<int>(std::ceil(
+            std::max(std::max(screen[0].y, screen[1].y), screen[2].y))));
+
+        for (int y = y0; y <= y1; y++) {
+          for (int x = x0; x <= x1; x++) {
+            const float px = x + 0.5f;
+            const float py = y + 0.5f;
+            const float w0 = GetEdge(screen[1], screen[2], px, py);
+            const float w1 = GetEdge(screen[2], screen[0], px, py);
+            const float w2 = GetEdge(screen[0], screen[1], px, py);
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+              continue;
+            }
+            const float z = (w0 * screen[0].z + w1 * screen[1].z + w2 * screen[2].z) / area;
+            float& stored = depth[y * kViewport + x];
+            if (z > stored) {
+              if (stored == -FLT_MAX) {
+                stats.pixelsCovered++;
+              }
+              stored = z;
+              stats.pixelsShaded++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (stats.pixelsCovered > 0) {
+    stats.overdraw = static_cast<float>(stats.pixelsShaded) / stats.pixelsCovered;
+  }
+  return stats;
+}
+
+} // navs namespace
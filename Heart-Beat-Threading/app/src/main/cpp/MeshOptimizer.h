@@ -0,0 +1,62 @@
+#ifndef __MESH_OPTIMIZER_HPP__
+#define __MESH_OPTIMIZER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshData.h"
+
+// Index and vertex reordering run on decoded geometry before it is packed. Every pass works on
+// triangle lists and keeps triangles inside their MeshPart.
+
+namespace navs {
+
+// Reorders the triangles of indices for post transform cache hits (Forsyth's linear speed
+// algorithm). Winding and the set of triangles are preserved.
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Reorders clusters of a cache optimized triangle list so outward facing clusters are drawn
+// first, reducing overdraw from any view direction (Sander et al., "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw"). Cache efficiency may drop by at most threshold.
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices,
+                      size_t vertexCount, float threshold = 1.05f);
+
+// Moves vertices into the order the indices first reference them and rewrites the indices.
+// Unreferenced vertices are dropped, returns how many vertices dst holds. remap, if given,
+// receives the new index of each of the vertexCount old vertices or ~0u for dropped ones, so
+// data kept beside the vertices can follow them.
+size_t OptimizeVertexFetch(MeshVertex* dst, uint32_t* indices, size_t indexCount,
+                           const MeshVertex* vertices, size_t vertexCount,
+                           uint32_t* remap = nullptr);
+
+// All of the above, part by part for the triangle passes. Part vertex ranges are recomputed.
+// dst needs room for vertexCount vertices, returns how many it holds.
+size_t OptimizeMesh(MeshVertex* dst, uint32_t* indices, size_t indexCount,
+                    const MeshVertex* vertices, size_t vertexCount, std::vector<MeshPart>* parts,
+                    uint32_t* remap = nullptr);
+
+// Rewrites 32 bit indices as 16 bit in place when every index fits, returns the index size
+uint32_t NarrowIndices(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+struct VertexCacheStats {
+  float acmr;  // transformed vertices per triangle, 0.5 is ideal for large regular meshes
+  float atvr;  // transformed vertices per vertex, 1.0 is ideal
+};
+
+// FIFO cache simulation, cacheSize matches common mobile GPUs
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, uint32_t cacheSize = 16);
+
+struct OverdrawStats {
+  uint64_t pixelsCovered;
+  uint64_t pixelsShaded;
+  float overdraw;  // shaded / covered, 1.0 is ideal
+};
+
+// Rasterizes the mesh from the six axis directions with depth test and back face culling
+OverdrawStats AnalyzeOverdraw(const uint32_t* indices, size_t indexCount,
+                              const MeshVertex* vertices, size_t vertexCount);
+
+} // navs namespace
+#endif // __MESH_OPTIMIZER_HPP__
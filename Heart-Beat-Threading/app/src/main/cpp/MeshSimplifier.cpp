@@ -0,0 +1,320 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "MeshOptimizer.h"
+
+namespace navs {
+
+namespace {
+
+// Sum of area weighted plane equations, evaluates to the weighted squared distance to them
+struct Quadric {
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double weight;
+};
+
+void AddPlane(Quadric* q, const glm::vec3& normal, float distance, float weight) {
+  const double x = normal.x, y = normal.y, z = normal.z, d = distance, w = weight;
+  q->a00 += w * x * x;
+  q->a01 += w * x * y;
+  q->a02 += w * x * z;
+  q->a11 += w * y * y;
+  q->a12 += w * y * z;
+  q->a22 += w * z * z;
+  q->b0 += w * x * d;
+  q->b1 += w * y * d;
+  q->b2 += w * z * d;
+  q->c += w * d * d;
+  q->weight += w;
+}
+
+Quadric Sum(const Quadric& a, const Quadric& b) {
+  Quadric q = {a.a00 + b.a00, a.a01 + b.a01, a.a02 + b.a02, a.a11 + b.a11, a.a12 + b.a12,
+               a.a22 + b.a22, a.b0 + b.b0,   a.b1 + b.b1,   a.b2 + b.b2,   a.c + b.c,
+               a.weight + b.weight};
+  return q;
+}
+
+// Mean squared distance of p to the planes
+double GetError(const Quadric& q, const glm::vec3& p) {
+  if (q.weight <= 0.0) {
+    return 0.0;
+  }
+  const double x = p.x, y = p.y, z = p.z;
+  const double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+                   2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+                   2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+  return std::fabs(r) / q.weight;
+}
+
+bool LessPosition(const glm::vec3& a, const glm::vec3& b) {
+  if (a.x != b.x) return a.x < b.x;
+  if (a.y != b.y) return a.y < b.y;
+  return a.z < b.z;
+}
+
+} // anonymous namespace
+
+size_t SimplifyMesh(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                    const MeshVertex* vertices, size_t vertexCount, size_t targetIndexCount,
+                    float targetError, float* resultError) {
+  std::vector<uint32_t> result(indices, indices + indexCount / 3 * 3);
+  double worstError = 0.0;
+
+  // Vertices sharing a position map to one of them, groups of more than one are seams
+  std::vector<uint32_t> canonical(vertexCount);
+  std::vector<uint8_t> locked(vertexCount, 0);
+  {
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [vertices](uint32_t a, uint32_t b) {
+      return LessPosition(vertices[a].pos, vertices[b].pos);
+    });
+    for (size_t i = 0; i < vertexCount; i++) {
+      const uint32_t vertex = order[i];
+      if (i > 0 && vertices[order[i - 1]].pos == vertices[vertex].pos) {
+        canonical[vertex] = canonical[order[i - 1]];
+        locked[canonical[vertex]] = 1;
+      } else {
+        canonical[vertex] = vertex;
+      }
+    }
+  }
+
+  // Edges not shared by exactly two triangles are open or non manifold, their ends stay put
+  {
+    std::vector<uint64_t> edges;
+    edges.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int k = 0; k < 3; k++) {
+        const uint64_t a = canonical[result[i + k]];
+        const uint64_t b = canonical[result[i + (k + 1) % 3]];
+        edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+      size_t end = i + 1;
+      while (end < edges.size() && edges[end] == edges[i]) {
+        end++;
+      }
+      if (end - i != 2) {
+        locked[edges[i] >> 32] = 1;
+        locked[edges[i] & 0xFFFFFFFF] = 1;
+      }
+      i = end;
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount);
+  memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+  for (size_t i = 0; i < result.size(); i += 3) {
+    const glm::vec3& p0 = vertices[result[i]].pos;
+    glm::vec3 normal = glm::cross(vertices[result[i + 1]].pos - p0, vertices[result[i + 2]].pos - p0);
+    const float doubleArea = glm::length(normal);
+    if (doubleArea == 0.0f) {
+      continue;
+    }
+    normal /= doubleArea;
+    const float distance = -glm::dot(normal, p0);
+    for (int k = 0; k < 3; k++) {
+      AddPlane(&quadrics[canonical[result[i + k]]], normal, distance, doubleArea * 0.5f);
+    }
+  }
+
+  const double maxError = static_cast<double>(targetError) * targetError;
+  std::vector<uint32_t> remap(vertexCount);
+  std::iota(remap.begin(), remap.end(), 0u);
+  std::vector<uint32_t> collapseTarget(vertexCount);
+  std::vector<double> collapseError(vertexCount);
+  std::vector<uint8_t> touched(vertexCount);
+  std::vector<uint32_t> adjacencyOffset(vertexCount + 1);
+  std::vector<uint32_t> adjacency;
+  std::vector<uint32_t> candidates;
+
+  // Each pass collapses a batch of non adjacent edges, cheapest first
+  while (result.size() > targetIndexCount) {
+    std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0u);
+    for (uint32_t vertex : result) {
+      adjacencyOffset[vertex + 1]++;
+    }
+    std::partial_sum(adjacencyOffset.begin(), adjacencyOffset.end(), adjacencyOffset.begin());
+    adjacency.resize(result.size());
+    {
+      std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+      for (size_t i = 0; i < result.size(); i++) {
+        adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+    }
+
+    // Cheapest neighbour of every free vertex to move onto
+    std::fill(collapseError.begin(), collapseError.end(), DBL_MAX);
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int k = 0; k < 3; k++) {
+        const uint32_t from = result[i + k];
+        if (locked[canonical[from]]) {
+          continue;
+        }
+        for (int n = 1; n < 3; n++) {
+          const uint32_t to = result[i + (k + n) % 3];
+          const double error = GetError(Sum(quadrics[from], quadrics[canonical[to]]),
+                                        vertices[to].pos);
+          if (error < collapseError[from]) {
+            collapseError[from] = error;
+            collapseTarget[from] = to;
+          }
+        }
+      }
+    }
+
+    candidates.clear();
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+      if (collapseError[vertex] <= maxError) {
+        candidates.push_back(vertex);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(), [&collapseError](uint32_t a, uint32_t b) {
+      return collapseError[a] < collapseError[b];
+    });
+
+    const size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+    size_t trianglesRemoved = 0;
+    size_t collapses = 0;
+    std::fill(touched.begin(), touched.end(), 0);
+    for (uint32_t from : candidates) {
+      if (trianglesRemoved >= trianglesToRemove) {
+        break;
+      }
+      const uint32_t to = collapseTarget[from];
+      if (touched[from] || touched[to]) {
+        continue;
+      }
+
+      // Triangles keeping both ends disappear, the others must not turn over
+      bool flips = false;
+      size_t collapsing = 0;
+      for (uint32_t a = adjacencyOffset[from]; a < adjacencyOffset[from + 1] && !flips; a++) {
+        const uint32_t* triangle = &result[adjacency[a] * 3];
+        const uint32_t v0 = remap[triangle[0]], v1 = remap[triangle[1]], v2 = remap[triangle[2]];
+        if (v0 == v1 || v1 == v2 || v0 == v2) {
+          continue;
+        }
+        if (v0 == to || v1 == to || v2 == to) {
+          collapsing++;
+          continue;
+        }
+        const glm::vec3& p0 = vertices[v0].pos;
+        const glm::vec3& p1 = vertices[v1].pos;
+        const glm::vec3& p2 = vertices[v2].pos;
+        const glm::vec3& q0 = vertices[v0 == from ? to : v0].pos;
+        const glm::vec3& q1 = vertices[v1 == from ? to : v1].pos;
+        const glm::vec3& q2 = vertices[v2 == from ? to : v2].pos;
+        flips = glm::dot(glm::cross(p1 - p0, p2 - p0), glm::cross(q1 - q0, q2 - q0)) <= 0.0f;
+      }
+      if (flips) {
+        continue;
+      }
+
+      remap[from] = to;
+      quadrics[canonical[to]] = Sum(quadrics[canonical[to]], quadrics[from]);
+      touched[from] = 1;
+      touched[to] = 1;
+      trianglesRemoved += collapsing;
+      worstError = std::max(worstError, collapseError[from]);
+      collapses++;
+    }
+    if (collapses == 0) {
+      break;
+    }
+
+    // Targets never move within a pass, so one remap step is enough
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      const uint32_t v0 = remap[result[i]], v1 = remap[result[i + 1]], v2 = remap[result[i + 2]];
+      if (v0 != v1 && v1 != v2 && v0 != v2) {
+        result[write++] = v0;
+        result[write++] = v1;
+        result[write++] = v2;
+      }
+    }
+    result.resize(write);
+  }
+
+  if (resultError != nullptr) {
+    *resultError = static_cast<float>(std::sqrt(worstError));
+  }
+  memcpy(dst, result.data(), result.size() * sizeof(uint32_t));
+  return result.size();
+}
+
+size_t GenerateLodChain(uint32_t* indices, size_t indexCount, size_t indexCapacity,
+                        const MeshVertex* vertices, size_t vertexCount,
+                        std::vector<MeshPart>* parts, std::vector<MeshLod>* lods,
+                        uint32_t maxLods) {
+  const uint32_t basePartCount = static_cast<uint32_t>(parts->size());
+  lods->clear();
+  MeshLod full = {0, basePartCount, 0, static_cast<uint32_t>(indexCount), 0.0f};
+  lods->push_back(full);
+
+  // Coarse levels may drift by up to 5% of the mesh size, selection keeps them far enough away
+  glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+  for (size_t i = 0; i < vertexCount; i++) {
+    minPos = glm::min(minPos, vertices[i].pos);
+    maxPos = glm::max(maxPos, vertices[i].pos);
+  }
+  const float maxError = vertexCount > 0 ? 0.05f * glm::length(maxPos - minPos) : 0.0f;
+
+  size_t used = indexCount;
+  for (uint32_t level = 1; level < maxLods && used + indexCount <= indexCapacity; level++) {
+    MeshLod lod = {static_cast<uint32_t>(parts->size()), 0, static_cast<uint32_t>(used), 0, 0.0f};
+    for (uint32_t p = 0; p < basePartCount; p++) {
+      // Always simplified from the full mesh so errors don't compound
+      const MeshPart source = (*parts)[p];
+      uint32_t* levelIndices = indices + used + lod.indexCount;
+      float error = 0.0f;
+      const size_t count = SimplifyMesh(levelIndices, indices + source.indexBase,
+                                        source.indexCount, vertices, vertexCount,
+                                        (source.indexCount >> level) / 3 * 3, maxError, &error);
+      OptimizeVertexCache(levelIndices, count, vertexCount);
+
+      MeshPart part = {source.vertexBase, source.vertexCount, lod.indexBase + lod.indexCount,
+                       static_cast<uint32_t>(count)};
+      parts->push_back(part);
+      lod.partCount++;
+      lod.indexCount += static_cast<uint32_t>(count);
+      lod.error = std::max(lod.error, error);
+    }
+
+    if (lod.indexCount * 4 > lods->back().indexCount * 3) {
+      parts->resize(lod.partBase);
+      break;
+    }
+    lods->push_back(lod);
+    used += lod.indexCount;
+  }
+  return used;
+}
+
+uint32_t SelectMeshLod(const MeshLod* lods, size_t lodCount, float distance, float fovY,
+                       float viewportHeight, float maxPixelError) {
+  if (distance <= 0.0f) {
+    return 0;
+  }
+  const float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f) * distance);
+  uint32_t selected = 0;
+  for (uint32_t i = 1; i < lodCount; i++) {
+    if (lods[i].error * pixelsPerUnit <= maxPixelError) {
+      selected = i;
+    }
+  }
+  return selected;
+}
+
+} // navs namespace
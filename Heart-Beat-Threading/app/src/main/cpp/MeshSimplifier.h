@@ -0,0 +1,39 @@
+#ifndef __MESH_SIMPLIFIER_HPP__
+#define __MESH_SIMPLIFIER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshData.h"
+
+// Quadric error edge collapse (Garland and Heckbert) producing index only levels of detail that
+// share the vertices of the full mesh. Vertices on open edges and on attribute seams (several
+// vertices at one position) never move, so UV and normal seams stay intact.
+
+namespace navs {
+
+const uint32_t kMaxMeshLods = 4;
+
+// Collapses edges of indices until at most targetIndexCount indices remain or the next collapse
+// would exceed targetError (model units). Writes the result to dst, which may alias indices,
+// and returns its index count. resultError receives the largest error introduced.
+size_t SimplifyMesh(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                    const MeshVertex* vertices, size_t vertexCount, size_t targetIndexCount,
+                    float targetError, float* resultError);
+
+// Turns parts into level 0 and appends up to maxLods - 1 levels after indexCount, each aiming
+// for half the triangles of the one before. Stops early when a level would not save at least a
+// quarter or the index capacity runs out. Returns the total index count.
+size_t GenerateLodChain(uint32_t* indices, size_t indexCount, size_t indexCapacity,
+                        const MeshVertex* vertices, size_t vertexCount,
+                        std::vector<MeshPart>* parts, std::vector<MeshLod>* lods,
+                        uint32_t maxLods = kMaxMeshLods);
+
+// Coarsest level whose error projects to at most maxPixelError pixels on a viewport of the given
+// height, seen at distance through a perspective projection with vertical field of view fovY
+uint32_t SelectMeshLod(const MeshLod* lods, size_t lodCount, float distance, float fovY,
+                       float viewportHeight, float maxPixelError = 1.0f);
+
+} // navs namespace
+#endif // __MESH_SIMPLIFIER_HPP__
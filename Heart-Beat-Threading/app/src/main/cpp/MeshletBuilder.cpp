@@ -0,0 +1,171 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace navs {
+
+namespace {
+
+const uint8_t kNotInMeshlet = 0xFF;
+
+// Sphere around the box of the meshlet's vertices, then a cone holding every triangle normal.
+// The apex is moved back along the axis until all triangle planes lie in front of it, which
+// lets the backface test use a single point for the whole cluster.
+MeshletBounds ComputeBounds(const MeshletData& data, const Meshlet& meshlet,
+                            const MeshVertex* vertices) {
+  MeshletBounds bounds = {};
+  const uint32_t* meshletVertices = &data.vertices[meshlet.vertexOffset];
+  const uint8_t* triangles = &data.triangles[meshlet.triangleOffset];
+
+  glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    minPos = glm::min(minPos, vertices[meshletVertices[i]].pos);
+    maxPos = glm::max(maxPos, vertices[meshletVertices[i]].pos);
+  }
+  bounds.center = (minPos + maxPos) * 0.5f;
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    bounds.radius = std::max(bounds.radius,
+                             glm::length(vertices[meshletVertices[i]].pos - bounds.center));
+  }
+
+  glm::vec3 normals[kMeshletMaxTriangles];
+  glm::vec3 corners[kMeshletMaxTriangles];
+  uint32_t normalCount = 0;
+  glm::vec3 axis(0.0f);
+  for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+    const glm::vec3& p0 = vertices[meshletVertices[triangles[t * 3 + 0]]].pos;
+    const glm::vec3& p1 = vertices[meshletVertices[triangles[t * 3 + 1]]].pos;
+    const glm::vec3& p2 = vertices[meshletVertices[triangles[t * 3 + 2]]].pos;
+    const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    const float length = glm::length(normal);
+    if (length > 0.0f) {
+      normals[normalCount] = normal / length;
+      corners[normalCount] = p0;
+      axis += normals[normalCount];
+      normalCount++;
+    }
+  }
+
+  bounds.coneCutoff = 2.0f;  // never passes the test
+  const float axisLength = glm::length(axis);
+  if (normalCount == 0 || axisLength == 0.0f) {
+    return bounds;
+  }
+  axis /= axisLength;
+
+  float minDot = 1.0f;
+  for (uint32_t i = 0; i < normalCount; i++) {
+    minDot = std::min(minDot, glm::dot(normals[i], axis));
+  }
+  // Normals spread over more than a hemisphere, no viewer sees only back faces
+  if (minDot <= 0.0f) {
+    return bounds;
+  }
+
+  float maxT = 0.0f;
+  for (uint32_t i = 0; i < normalCount; i++) {
+    const float t = glm::dot(bounds.center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+    maxT = std::max(maxT, t);
+  }
+  bounds.coneApex = bounds.center - axis * maxT;
+  bounds.coneAxis = axis;
+  // Viewers inside the cone of half angle 90 degrees minus the normal spread see only backs
+  bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  return bounds;
+}
+
+} // anonymous namespace
+
+void BuildMeshlets(const uint32_t* indices, size_t indexCount, uint32_t indexBase,
+                   const MeshVertex* vertices, size_t vertexCount, MeshletData* out) {
+  std::vector<uint8_t> localIndex(vertexCount, kNotInMeshlet);
+
+  Meshlet meshlet = {};
+  auto startMeshlet = [&](uint32_t firstIndex) {
+    meshlet = {};
+    meshlet.vertexOffset = static_cast<uint32_t>(out->vertices.size());
+    meshlet.triangleOffset = static_cast<uint32_t>(out->triangles.size());
+    meshlet.indexBase = indexBase + firstIndex;
+  };
+  auto finishMeshlet = [&]() {
+    if (meshlet.triangleCount == 0) {
+      return;
+    }
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+      localIndex[out->vertices[meshlet.vertexOffset + i]] = kNotInMeshlet;
+    }
+    // Keep the next meshlet's triangles word aligned for shaders reading them as uints
+    out->triangles.resize((out->triangles.size() + 3) & ~size_t(3), 0);
+    out->meshlets.push_back(meshlet);
+    out->bounds.push_back(ComputeBounds(*out, meshlet, vertices));
+  };
+
+  startMeshlet(0);
+  for (size_t i = 0; i + 2 < indexCount; i += 3) {
+    const uint32_t* triangle = indices + i;
+    assert(triangle[0] < vertexCount && triangle[1] < vertexCount && triangle[2] < vertexCount);
+
+    // Degenerate triangles count a repeated vertex twice, which only cuts a meshlet early
+    const uint32_t newVertices = (localIndex[triangle[0]] == kNotInMeshlet) +
+                                 (localIndex[triangle[1]] == kNotInMeshlet) +
+                                 (localIndex[triangle[2]] == kNotInMeshlet);
+    if (meshlet.vertexCount + newVertices > kMeshletMaxVertices ||
+        meshlet.triangleCount + 1 > kMeshletMaxTriangles) {
+      finishMeshlet();
+      startMeshlet(static_cast<uint32_t>(i));
+    }
+
+    for (int k = 0; k < 3; k++) {
+      uint8_t& local = localIndex[triangle[k]];
+      if (local == kNotInMeshlet) {
+        local = static_cast<uint8_t>(meshlet.vertexCount++);
+        out->vertices.push_back(triangle[k]);
+      }
+      out->triangles.push_back(local);
+    }
+    meshlet.triangleCount++;
+  }
+  finishMeshlet();
+}
+
+void ExtractFrustumPlanes(const glm::mat4& modelViewProjection, glm::vec4 planes[6]) {
+  const glm::mat4& m = modelViewProjection;
+  glm::vec4 rows[4];
+  for (int r = 0; r < 4; r++) {
+    rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+  }
+  // Gribb and Hartmann, glm::perspective maps depth to -1..1 by default
+  planes[0] = rows[3] + rows[0];
+  planes[1] = rows[3] - rows[0];
+  planes[2] = rows[3] + rows[1];
+  planes[3] = rows[3] - rows[1];
+  planes[4] = rows[3] + rows[2];
+  planes[5] = rows[3] - rows[2];
+  for (int i = 0; i < 6; i++) {
+    planes[i] /= glm::length(glm::vec3(planes[i]));
+  }
+}
+
+MeshletCullStats CullMeshlets(const MeshletData& data, const glm::mat4& modelViewProjection,
+                              const glm::vec3& cameraPosition, uint32_t* visible) {
+  MeshletCullStats stats = {0, 0, 0};
+  glm::vec4 planes[6];
+  ExtractFrustumPlanes(modelViewProjection, planes);
+
+  for (size_t i = 0; i < data.meshlets.size(); i++) {
+    const MeshletBounds& bounds = data.bounds[i];
+    if (IsMeshletBackfacing(bounds, cameraPosition)) {
+      stats.backfacing++;
+    } else if (IsMeshletOutside(bounds, planes)) {
+      stats.outside++;
+    } else {
+      visible[stats.visible++] = static_cast<uint32_t>(i);
+    }
+  }
+  return stats;
+}
+
+} // navs namespace
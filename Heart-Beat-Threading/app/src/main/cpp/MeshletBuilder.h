@@ -0,0 +1,84 @@
+#ifndef __MESHLET_BUILDER_HPP__
+#define __MESHLET_BUILDER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshData.h"
+
+// Splits triangle lists into meshlets, small clusters that can be culled on their own. Meshlets
+// are cut from the index buffer in order, so each one is also a contiguous index range that a
+// plain vkCmdDrawIndexed can draw. Meshlet and MeshletBounds are laid out to be uploaded as is
+// into std430 storage buffers for culling in a compute shader.
+
+namespace navs {
+
+const uint32_t kMeshletMaxVertices = 64;
+const uint32_t kMeshletMaxTriangles = 124;
+
+struct Meshlet {
+  uint32_t vertexOffset;    // into MeshletData::vertices
+  uint32_t triangleOffset;  // into MeshletData::triangles, 4 byte aligned
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+  uint32_t indexBase;       // first index of the meshlet in the model's index buffer
+  uint32_t pad[3];
+};
+static_assert(sizeof(Meshlet) == 32, "Meshlet no longer matches its std430 layout");
+
+struct MeshletBounds {
+  glm::vec3 center;  // bounding sphere
+  float radius;
+  // Every triangle faces away from any viewer inside the cone, see IsMeshletBackfacing
+  glm::vec3 coneApex;
+  float coneCutoff;  // > 1 when the normals spread too far for a cone
+  glm::vec3 coneAxis;
+  float pad;
+};
+static_assert(sizeof(MeshletBounds) == 48, "MeshletBounds no longer matches its std430 layout");
+
+struct MeshletData {
+  std::vector<Meshlet> meshlets;
+  std::vector<MeshletBounds> bounds;
+  std::vector<uint32_t> vertices;  // model vertex index of each meshlet vertex
+  std::vector<uint8_t> triangles;  // three meshlet local vertex indices per triangle
+};
+
+// Appends the meshlets of one triangle list, indices are expected to be in vertex cache order
+// already so consecutive triangles share vertices. indexBase is where indices start in the
+// model's index buffer.
+void BuildMeshlets(const uint32_t* indices, size_t indexCount, uint32_t indexBase,
+                   const MeshVertex* vertices, size_t vertexCount, MeshletData* out);
+
+inline bool IsMeshletBackfacing(const MeshletBounds& bounds, const glm::vec3& cameraPosition) {
+  const glm::vec3 view = bounds.coneApex - cameraPosition;
+  const float length = glm::length(view);
+  return length > 0.0f && glm::dot(view, bounds.coneAxis) >= bounds.coneCutoff * length;
+}
+
+// Planes as (normal, distance) pointing inwards, taken from a glm::perspective based matrix
+void ExtractFrustumPlanes(const glm::mat4& modelViewProjection, glm::vec4 planes[6]);
+
+inline bool IsMeshletOutside(const MeshletBounds& bounds, const glm::vec4 planes[6]) {
+  for (int i = 0; i < 6; i++) {
+    if (glm::dot(glm::vec3(planes[i]), bounds.center) + planes[i].w < -bounds.radius) {
+      return true;
+    }
+  }
+  return false;
+}
+
+struct MeshletCullStats {
+  uint32_t visible;
+  uint32_t backfacing;
+  uint32_t outside;
+};
+
+// Writes the index of every meshlet that survives to visible, which needs room for all of them.
+// cameraPosition is in model space.
+MeshletCullStats CullMeshlets(const MeshletData& data, const glm::mat4& modelViewProjection,
+                              const glm::vec3& cameraPosition, uint32_t* visible);
+
+} // navs namespace
+#endif // __MESHLET_BUILDER_HPP__
@@ -0,0 +1,127 @@
+#include "ModelCache.h"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+ModelCache::ModelCache(const char* directory) {
+  if (directory == nullptr || directory[0] == '\0') {
+    return;
+  }
+  // internalDataPath is not guaranteed to exist on first launch
+  mkdir(directory, 0700);
+  mDirectory = std::string(directory) + "/models";
+  if (mkdir(mDirectory.c_str(), 0700) != 0 && errno != EEXIST) {
+    mDirectory.clear();
+  }
+}
+
+ModelCache::~ModelCache() {
+}
+
+uint64_t ModelCache::Hash(const void* data, size_t size, uint64_t seed) {
+  // FNV-1a taking 64 bit words instead of bytes, the shift feeds high bits back down
+  const uint64_t kPrime = 0x100000001B3ull;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = seed ^ 0xCBF29CE484222325ull;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    hash = (hash ^ word) * kPrime;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ bytes[i]) * kPrime;
+  }
+  hash ^= size;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+const std::vector<uint8_t>* ModelCache::Find(const std::string& path, uint64_t key,
+                                             bool* fromDisk) {
+  *fromDisk = false;
+  auto it = mEntries.find(path);
+  if (it != mEntries.end() && it->second.key == key) {
+    return &it->second.mesh;
+  }
+
+  Entry entry;
+  entry.key = key;
+  if (mDirectory.empty() || !ReadFile(path, key, &entry.mesh)) {
+    return nullptr;
+  }
+  *fromDisk = true;
+  Entry& stored = mEntries[path];
+  stored = std::move(entry);
+  return &stored.mesh;
+}
+
+void ModelCache::Store(const std::string& path, uint64_t key, std::vector<uint8_t>&& mesh) {
+  if (!mDirectory.empty()) {
+    WriteFile(path, key, mesh);
+  }
+  Entry& entry = mEntries[path];
+  entry.key = key;
+  entry.mesh = std::move(mesh);
+}
+
+size_t ModelCache::BytesCached(void) const {
+  size_t bytes = 0;
+  for (const auto& entry : mEntries) {
+    bytes += entry.second.mesh.size();
+  }
+  return bytes;
+}
+
+std::string ModelCache::GetFilePath(const std::string& path) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016" PRIx64 ".mesh", Hash(path.data(), path.size()));
+  return mDirectory + name;
+}
+
+bool ModelCache::ReadFile(const std::string& path, uint64_t key,
+                          std::vector<uint8_t>* mesh) const {
+  FILE* file = fopen(GetFilePath(path).c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  uint64_t fileKey = 0;
+  bool read = fread(&fileKey, sizeof(fileKey), 1, file) == 1 && fileKey == key &&
+              fseek(file, 0, SEEK_END) == 0;
+  const long size = read ? ftell(file) - static_cast<long>(sizeof(fileKey)) : 0;
+  if (read && size > 0 && fseek(file, sizeof(fileKey), SEEK_SET) == 0) {
+    mesh->resize(static_cast<size_t>(size));
+    read = fread(mesh->data(), 1, mesh->size(), file) == mesh->size();
+  } else {
+    read = false;
+  }
+  fclose(file);
+  return read;
+}
+
+// Written under a temporary name first so a crash never leaves a truncated entry behind
+bool ModelCache::WriteFile(const std::string& path, uint64_t key,
+                           const std::vector<uint8_t>& mesh) const {
+  const std::string filePath = GetFilePath(path);
+  const std::string tempPath = filePath + ".tmp";
+  FILE* file = fopen(tempPath.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool written = fwrite(&key, sizeof(key), 1, file) == 1 &&
+                 fwrite(mesh.data(), 1, mesh.size(), file) == mesh.size();
+  written = fclose(file) == 0 && written;
+  if (!written || rename(tempPath.c_str(), filePath.c_str()) != 0) {
+    remove(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,46 @@
+#ifndef __MODEL_CACHE_HPP__
+#define __MODEL_CACHE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Keeps the decoded and optimized geometry of every model loaded so far as a baked mesh (see
+// BakedMesh.h), so loading it again skips parsing and the mesh passes. Entries are keyed by
+// asset path and checked against a hash of the source file and the load settings. The cache
+// outlives the Vulkan device, which is recreated with every window. With a directory each entry
+// is also written to disk and survives a restart of the app.
+class ModelCache {
+ public:
+  explicit ModelCache(const char* directory = nullptr);
+  ~ModelCache();
+
+  // 64 bit hash of data, chain calls through seed to hash several pieces
+  static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+  // Returns the mesh stored for path if it was stored under key, first looking in memory and
+  // then on disk, or nullptr. Stays valid until the next Store() for path.
+  const std::vector<uint8_t>* Find(const std::string& path, uint64_t key, bool* fromDisk);
+
+  void Store(const std::string& path, uint64_t key, std::vector<uint8_t>&& mesh);
+
+  size_t BytesCached(void) const;
+
+ private:
+  struct Entry {
+    uint64_t key;
+    std::vector<uint8_t> mesh;
+  };
+
+  // One file per asset path, holding the key followed by the mesh
+  std::string GetFilePath(const std::string& path) const;
+  bool ReadFile(const std::string& path, uint64_t key, std::vector<uint8_t>* mesh) const;
+  bool WriteFile(const std::string& path, uint64_t key, const std::vector<uint8_t>& mesh) const;
+
+  std::unordered_map<std::string, Entry> mEntries;
+  std::string mDirectory;  // empty when nothing goes to disk
+};
+
+#endif // __MODEL_CACHE_HPP__
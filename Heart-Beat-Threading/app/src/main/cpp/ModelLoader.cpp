@@ -1,85 +1,425 @@
 #include "ModelLoader.h"
 
-#include <android/asset_manager.h>
+#include <chrono>
+#include <cstring>
 
+#include "AssetIO.h"
+#include "BakedMesh.h"
+#include "GltfImporter.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 #include "VulkanUtil.h"
 
-#define TINYGLTF_IMPLEMENTATION
-#include "tiny_gltf.h"
-
 using namespace navs;
 
-ModelLoader::ModelLoader(VkPhysicalDevice pDevice, VkDevice lDevice, android_app* app) :
+ModelLoader::ModelLoader(VkPhysicalDevice pDevice, VkDevice lDevice, UploadQueue* uploadQueue,
+                         ScratchArena* scratch, WorkerPool* workers, ModelCache* cache,
+                         uint32_t queueFamilyIndex) :
     mLogicDevice(lDevice),
     mPhysicalDevice(pDevice),
-    androidAppCtx(app)
+    mUploadQueue(uploadQueue),
+    mScratch(scratch),
+    mWorkers(workers),
+    mCache(cache),
+    mQueueFamilyIndex(queueFamilyIndex)
 {
+  mUnifiedMemory = IsUnifiedMemory();
+  LOGI("ModelLoader: geometry upload path is %s",
+       mUnifiedMemory ? "direct (unified memory)" : "staged (device local)");
 }
 
 ModelLoader::~ModelLoader() {
 
 }
-#include <iostream>
-void ModelLoader::LoadFromFile(const char* filePath, Model* model)
+
+// Unified memory is when every device local heap also exposes a host visible and coherent
+// memory type. Writing geometry there directly is as fast for the GPU as a staged copy.
+bool ModelLoader::IsUnifiedMemory() {
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memoryProperties);
+
+  const VkMemoryPropertyFlags hostMapped =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  bool foundDeviceLocalHeap = false;
+  for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+    if ((memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+      continue;
+    }
+    foundDeviceLocalHeap = true;
+
+    bool heapIsMappable = false;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+      const VkMemoryType& type = memoryProperties.memoryTypes[i];
+      if (type.heapIndex == heap &&
+          (type.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) &&
+          (type.propertyFlags & hostMapped) == hostMapped) {
+        heapIsMappable = true;
+        break;
+      }
+    }
+    if (!heapIsMappable) {
+      return false;
+    }
+  }
+  return foundDeviceLocalHeap;
+}
+
+// Everything the baked result of a glTF load depends on
+static uint64_t GetCacheKey(const uint8_t* data, size_t size, const ModelLoader::Model& model) {
+  const ModelLoader::Model::CreateInfo& createInfo = model.createInfo;
+  uint64_t key = ModelCache::Hash(data, size);
+  key = ModelCache::Hash(&createInfo.center, sizeof(createInfo.center), key);
+  key = ModelCache::Hash(&createInfo.scale, sizeof(createInfo.scale), key);
+  key = ModelCache::Hash(&createInfo.uvscale, sizeof(createInfo.uvscale), key);
+  key = ModelCache::Hash(model.layout.components,
+                         model.layout.componentCount * sizeof(VertexComponent), key);
+  return ModelCache::Hash(&kBakedMeshVersion, sizeof(kBakedMeshVersion), key);
+}
+
+bool ModelLoader::LoadFromFile(const char* filePath, Model* model)
 {
-  tinygltf::Model gltfModel;
-  tinygltf::TinyGLTF gltfContext;
-  std::string baseDir;
+  auto start = std::chrono::steady_clock::now();
+
+  // The view stays open until the geometry has been copied out of it
+  AssetView file;
+  if (!OpenAsset(filePath, &file, ASSET_ACCESS_WILLNEED)) {
+    LOGE("Failed to open %s", filePath);
+    return false;
+  }
+
+  if (IsBakedMesh(file.data(), file.size())) {
+    return LoadBaked(file.data(), file.size(), filePath, model);
+  }
+
+  // Baked meshes carry no meshlets, models that want them are decoded every time
+  if (mCache == nullptr || model->createInfo.buildMeshlets) {
+    return LoadGltf(file.data(), file.size(), filePath, model, nullptr);
+  }
+
+  const uint64_t key = GetCacheKey(file.data(), file.size(), *model);
+  bool fromDisk;
+  const std::vector<uint8_t>* cached = mCache->Find(filePath, key, &fromDisk);
+  bool loaded;
+  if (cached != nullptr) {
+    loaded = LoadBaked(cached->data(), cached->size(), filePath, model);
+  } else {
+    std::vector<uint8_t> entry;
+    loaded = LoadGltf(file.data(), file.size(), filePath, model, &entry);
+    if (!entry.empty()) {
+      mCache->Store(filePath, key, std::move(entry));
+    }
+  }
+  if (!loaded) {
+    return false;
+  }
+  LOGI("%s: %s load in %.2f ms, %zu bytes cached", filePath,
+       cached == nullptr ? "cold" : fromDisk ? "warm (disk)" : "warm (memory)",
+       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+           .count(), mCache->BytesCached());
+  return true;
+}
+
+// Baked meshes are already in GPU layout, only the header is read
+bool ModelLoader::LoadBaked(const uint8_t* data, size_t size, const char* filePath, Model* model)
+{
+  const BakedMeshHeader* header = ReadBakedMesh(data, size);
+  if (header == nullptr) {
+    LOGE("%s is not a baked mesh of version %u", filePath, kBakedMeshVersion);
+    return false;
+  }
+
+  bool layoutMatches = header->componentCount == model->layout.componentCount &&
+                       header->vertexStride == model->layout.stride;
+  for (uint32_t i = 0; layoutMatches && i < header->componentCount; i++) {
+    layoutMatches = header->components[i] == model->layout.components[i];
+  }
+  if (!layoutMatches) {
+    LOGE("%s was baked for a different vertex layout, re-run MeshBaker", filePath);
+    return false;
+  }
+
+  const Model::ModelPart* parts =
+      reinterpret_cast<const Model::ModelPart*>(data + header->partOffset);
+  model->parts.assign(parts, parts + header->partCount);
+  const MeshLod* lods = reinterpret_cast<const MeshLod*>(data + header->lodOffset);
+  model->lods.assign(lods, lods + header->lodCount);
+  if (model->createInfo.buildMeshlets) {
+    LOGW("%s: meshlets are only built for glTF sources", filePath);
+  }
+  model->bounds.min = glm::make_vec3(header->boundsMin);
+  model->bounds.max = glm::make_vec3(header->boundsMax);
+  model->quantization = GetQuantizationScale(model->bounds);
+  model->vertexCount = header->vertexCount;
+  model->indexCount = header->indexCount;
+  model->indexType = header->indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16
+                                                           : VK_INDEX_TYPE_UINT32;
+  model->skeleton.joints.clear();
+  model->animations.clear();
+  model->morphTargets = MorphTargets();
+
+  UploadGeometry(model, data + header->vertexOffset,
+                 VkDeviceSize(header->vertexCount) * header->vertexStride,
+                 data + header->indexOffset, VkDeviceSize(header->indexCount) * header->indexSize);
+  return true;
+}
+
+bool ModelLoader::LoadGltf(const uint8_t* data, size_t size, const char* filePath, Model* model,
+                           std::vector<uint8_t>* cacheEntry)
+{
+  GltfImporter importer;
   std::string error;
-  std::vector<Vertex> vertexBuffer;
-  std::vector<uint32_t> indexBuffer;
+  if (!importer.Parse(data, size, &error)) {
+    LOGE("Failed to load %s: %s", filePath, error.c_str());
+    return false;
+  }
 
-  assert(androidAppCtx);
-  AAsset* file = AAssetManager_open(androidAppCtx->activity->assetManager, filePath, AASSET_MODE_BUFFER);
+  // Skinning and morphing read and write float vertices, animated models give up quantization
+  const bool animated = importer.HasSkin() || importer.GetMorphTargetCount() > 0;
+  if (animated && IsQuantizedFormat(model->layout) && model->animatedLayout.componentCount > 0) {
+    model->layout = model->animatedLayout;
+    LOGI("%s: animated, packed in %u byte float vertices", filePath, model->layout.stride);
+  }
+
+  // Decoded, optimized and interleaved copies are scratch, sized once and dropped with the arena
+  const uint32_t stride = model->layout.stride;
+  MeshVertex* decoded = mScratch->Allocate<MeshVertex>(importer.GetVertexCount());
+  MeshVertex* vertices = mScratch->Allocate<MeshVertex>(importer.GetVertexCount());
+  // Room for the full mesh and its levels of detail, which aim for half the triangles each
+  const size_t indexCapacity = importer.GetIndexCount() * 3;
+  uint32_t* indices = mScratch->Allocate<uint32_t>(indexCapacity);
+  uint8_t* interleaved = mScratch->Allocate<uint8_t>(importer.GetVertexCount() * stride);
 
-  size_t fileLength = AAsset_getLength(file);
-  assert(fileLength > 0);
-  char* fileData = new char[fileLength];
+  const Model::CreateInfo& createInfo = model->createInfo;
+  MeshTransform transform = {createInfo.scale, createInfo.center, createInfo.uvscale};
+  importer.Decode(transform, decoded, indices, &model->parts, &model->bounds, mWorkers);
 
-  AAsset_read(file, (void*)fileData, fileLength);
-  AAsset_close(file);
+  // Skinning reads and writes float vertices, quantized models are drawn in their bind pose
+  model->skeleton.joints.clear();
+  model->animations.clear();
+  SkinVertex* decodedSkin = nullptr;
+  uint32_t* remap = nullptr;
+  if (importer.HasSkin() && IsQuantizedFormat(model->layout)) {
+    LOGW("%s: skinning needs float vertices, drawing the bind pose", filePath);
+  } else if (importer.HasSkin()) {
+    importer.ImportAnimations(transform, &model->skeleton, &model->animations);
+    decodedSkin = mScratch->Allocate<SkinVertex>(importer.GetVertexCount());
+    remap = mScratch->Allocate<uint32_t>(importer.GetVertexCount());
+    importer.DecodeSkin(decodedSkin);
+    LOGI("%s: skinned, %zu joints, %zu animations", filePath, model->skeleton.joints.size(),
+         model->animations.size());
+  }
 
+  // Same for morph targets, which are kept sparse: only vertices a target moves carry deltas
+  MorphTargets& morphTargets = model->morphTargets;
+  morphTargets = MorphTargets();
+  if (importer.GetMorphTargetCount() > 0 && IsQuantizedFormat(model->layout)) {
+    LOGW("%s: morph targets need float vertices, drawing the base mesh", filePath);
+  } else if (importer.GetMorphTargetCount() > 0) {
+    importer.DecodeMorphTargets(transform, &morphTargets);
+    if (morphTargets.deltas.empty()) {
+      morphTargets = MorphTargets();
+    } else if (remap == nullptr) {
+      remap = mScratch->Allocate<uint32_t>(importer.GetVertexCount());
+    }
+  }
 
-  bool fileLoaded = gltfContext.LoadASCIIFromString(&gltfModel, &error, fileData, fileLength, baseDir);
-  assert(fileLoaded);
-  const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene];
+  // Source files rarely come in cache friendly order, meshes baked offline already went through
+  // the same passes
+  const size_t fullIndexCount = importer.GetIndexCount();
+  const VertexCacheStats cacheBefore =
+      AnalyzeVertexCache(indices, fullIndexCount, importer.GetVertexCount());
+  const size_t vertexCount = OptimizeMesh(vertices, indices, fullIndexCount, decoded,
+                                          importer.GetVertexCount(), &model->parts, remap);
+  const VertexCacheStats cacheAfter = AnalyzeVertexCache(indices, fullIndexCount, vertexCount);
+  LOGI("%s: vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", filePath, cacheBefore.acmr,
+       cacheAfter.acmr, cacheBefore.atvr, cacheAfter.atvr);
 
-  for (size_t i = 0; i < scene.nodes.size(); i++) {
-    const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-    loadNode(node, glm::mat4(1.0f), gltfModel, indexBuffer, vertexBuffer, scale);
+  if (!morphTargets.deltas.empty()) {
+    RemapMorphTargets(&morphTargets, remap);
+    // Bounds have to hold every blend of the targets, not only the base mesh
+    const MeshBounds extent = GetMorphExtent(morphTargets);
+    model->bounds.min += extent.min;
+    model->bounds.max += extent.max;
   }
 
-  delete[] fileData;
+  const size_t indexCount = GenerateLodChain(indices, fullIndexCount, indexCapacity, vertices,
+                                             vertexCount, &model->parts, &model->lods);
+  for (size_t i = 1; i < model->lods.size(); i++) {
+    LOGI("%s: LOD %zu has %u triangles (%.0f%% of the full mesh), error %f", filePath, i,
+         model->lods[i].indexCount / 3, 100.0f * model->lods[i].indexCount / fullIndexCount,
+         model->lods[i].error);
+  }
 
+  model->meshlets = MeshletData();
+  if (createInfo.buildMeshlets) {
+    const MeshLod& full = model->lods[0];
+    for (uint32_t p = full.partBase; p < full.partBase + full.partCount; p++) {
+      const MeshPart& part = model->parts[p];
+      BuildMeshlets(indices + part.indexBase, part.indexCount, part.indexBase, vertices,
+                    vertexCount, &model->meshlets);
+    }
+    LOGI("%s: %zu meshlets, %.1f vertices and %.1f triangles on average", filePath,
+         model->meshlets.meshlets.size(),
+         float(model->meshlets.vertices.size()) / model->meshlets.meshlets.size(),
+         float(fullIndexCount / 3) / model->meshlets.meshlets.size());
+  }
 
-  uint32_t vertexBufferSize = static_cast<uint32_t>(vertexBuffer.size()) * sizeof(Vertex);
-  uint32_t indexBufferSize = static_cast<uint32_t>(indexBuffer.size()) * sizeof(uint32_t);
-  model->indexCount = static_cast<uint32_t>(indexBuffer.size());
-  assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+  model->quantization = GetQuantizationScale(model->bounds);
+  model->layout.pack(vertices, vertexCount, model->quantization, interleaved);
 
-  // Vertex buffer
-  CALL_VK(CreateBuffer(
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      vertexBufferSize,
-      &model->vertices.buffer,
-      &model->vertices.memory,
-      vertexBuffer.data()));
+  if (IsQuantizedFormat(model->layout)) {
+    const size_t floatStride = sizeof(float) * (3 + 2 + 3 + 4);
+    QuantizationError quantizationError =
+        MeasureQuantizationError(vertices, vertexCount, model->quantization);
+    LOGI("%s: quantized vertices %u bytes each instead of %zu, max error position %f, "
+         "normal %.3f deg, tangent %.3f deg, uv %f", filePath, stride, floatStride,
+         quantizationError.position, quantizationError.normalDegrees,
+         quantizationError.tangentDegrees, quantizationError.uv);
+  }
 
-  // Index buffer
-  CALL_VK(CreateBuffer(
-      VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      indexBufferSize,
-      &model->indices.buffer,
-      &model->indices.memory,
-      indexBuffer.data()));
+  // Baked meshes have no room for joint influences or morph targets
+  if (cacheEntry != nullptr && decodedSkin == nullptr && morphTargets.deltas.empty()) {
+    WriteBakedMesh(vertices, vertexCount, indices, indexCount, model->parts, model->lods,
+                   model->bounds, model->layout.components, model->layout.componentCount,
+                   cacheEntry);
+  }
+
+  const uint32_t indexSize = NarrowIndices(indices, indexCount, vertexCount);
+  model->indexType = indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  model->vertexCount = static_cast<uint32_t>(vertexCount);
+  model->indexCount = static_cast<uint32_t>(indexCount);
+  UploadGeometry(model, interleaved, VkDeviceSize(model->vertexCount) * stride,
+                 indices, VkDeviceSize(model->indexCount) * indexSize);
+
+  if (decodedSkin != nullptr) {
+    // Influences follow their vertices through the fetch reordering
+    SkinVertex* skin = mScratch->Allocate<SkinVertex>(vertexCount);
+    for (size_t v = 0; v < importer.GetVertexCount(); v++) {
+      if (remap[v] != ~0u) {
+        skin[remap[v]] = decodedSkin[v];
+      }
+    }
+    UploadBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, skin, vertexCount * sizeof(SkinVertex),
+                 &model->skin.buffer, &model->skin.memory);
+  }
+
+  if (!morphTargets.deltas.empty()) {
+    UploadBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, morphTargets.vertices.data(),
+                 morphTargets.vertices.size() * sizeof(MorphVertex),
+                 &model->morphVertices.buffer, &model->morphVertices.memory);
+    UploadBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, morphTargets.deltas.data(),
+                 morphTargets.deltas.size() * sizeof(MorphDelta),
+                 &model->morphDeltas.buffer, &model->morphDeltas.memory);
+    // The shader only writes vertices that move, the rest keep the base mesh copied here
+    UploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 interleaved, VkDeviceSize(vertexCount) * stride, &model->morphed.buffer,
+                 &model->morphed.memory);
+    LOGI("%s: %u morph targets, %zu of %zu vertices move, %zu KB of deltas", filePath,
+         morphTargets.targetCount, morphTargets.GetVertexCount(), vertexCount,
+         (morphTargets.deltas.size() * sizeof(MorphDelta) +
+          morphTargets.vertices.size() * sizeof(MorphVertex)) / 1024);
+  }
+  return true;
+}
+
+void ModelLoader::CreateBox(const MeshBounds& bounds, Model* model)
+{
+  static const glm::vec3 kNormals[6] = {{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+                                        {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+                                        {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+  static const glm::vec3 kTangents[6] = {{0.0f, 0.0f, -1.0f}, {0.0f, 0.0f, 1.0f},
+                                         {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f},
+                                         {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}};
+  static const uint32_t kFaceIndices[6] = {0, 1, 2, 2, 1, 3};
+  const uint32_t vertexCount = 6 * 4;
+  const uint32_t indexCount = 6 * 6;
+
+  // Four corners per face so every face keeps its own normal, counter clockwise seen from
+  // outside like glTF
+  const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+  const glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+  MeshVertex vertices[vertexCount];
+  uint32_t indices[indexCount];
+  for (uint32_t f = 0; f < 6; f++) {
+    const glm::vec3 bitangent = glm::cross(kNormals[f], kTangents[f]);
+    for (uint32_t c = 0; c < 4; c++) {
+      MeshVertex& vertex = vertices[f * 4 + c];
+      vertex.uv = glm::vec2(float(c & 1), float(c >> 1));
+      vertex.pos = center + (kNormals[f] + kTangents[f] * (vertex.uv.x * 2.0f - 1.0f) +
+                             bitangent * (vertex.uv.y * 2.0f - 1.0f)) * extent;
+      vertex.normal = kNormals[f];
+      vertex.tangent = glm::vec4(kTangents[f], 1.0f);
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+      indices[f * 6 + i] = f * 4 + kFaceIndices[i];
+    }
+  }
+
+  model->parts.assign(1, {0, vertexCount, 0, indexCount});
+  model->lods.assign(1, {0, 1, 0, indexCount, 0.0f});
+  model->meshlets = MeshletData();
+  model->bounds = bounds;
+  model->quantization = GetQuantizationScale(bounds);
+  model->skeleton.joints.clear();
+  model->animations.clear();
+  model->morphTargets = MorphTargets();
+
+  std::vector<uint8_t> interleaved(vertexCount * model->layout.stride);
+  model->layout.pack(vertices, vertexCount, model->quantization, interleaved.data());
+  const uint32_t indexSize = NarrowIndices(indices, indexCount, vertexCount);
+  model->indexType = indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  model->vertexCount = vertexCount;
+  model->indexCount = indexCount;
+  UploadGeometry(model, interleaved.data(), interleaved.size(), indices,
+                 VkDeviceSize(indexCount) * indexSize);
+}
+
+void ModelLoader::UploadGeometry(Model* model, const void* vertexData, VkDeviceSize vertexSize,
+                                 const void* indexData, VkDeviceSize indexSize)
+{
+  assert((vertexSize > 0) && (indexSize > 0));
+
+  // The skinning and morph shaders read the base mesh straight from the vertex buffer
+  const bool computeInput = !model->skeleton.joints.empty() ||
+                            !model->morphTargets.deltas.empty();
+  const VkBufferUsageFlags vertexUsage = !computeInput
+      ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+      : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  UploadBuffer(vertexUsage, vertexData, vertexSize, &model->vertices.buffer,
+               &model->vertices.memory);
+  UploadBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexData, indexSize, &model->indices.buffer,
+               &model->indices.memory);
+}
+
+void ModelLoader::UploadBuffer(VkBufferUsageFlags usage, const void* data, VkDeviceSize size,
+                               VkBuffer* buffer, VkDeviceMemory* memory)
+{
+  if (mUnifiedMemory) {
+    // Device local memory is host visible, write the data in place
+    const VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CALL_VK(CreateBuffer(usage, memoryFlags, size, buffer, memory, data));
+  } else {
+    // Discrete memory: the copies into device local memory go through the shared staging ring
+    CALL_VK(CreateDeviceLocalBuffer(usage, size, buffer, memory, data));
+  }
+}
+
+// Creates a device local buffer and queues the upload of data into it
+VkResult ModelLoader::CreateDeviceLocalBuffer(VkBufferUsageFlags usageFlags, VkDeviceSize size,
+                                              VkBuffer *buffer, VkDeviceMemory *memory,
+                                              const void *data) {
+  CALL_VK(CreateBuffer(usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, size, buffer, memory));
+  mUploadQueue->UploadBuffer(*buffer, 0, data, size);
+  return VK_SUCCESS;
 }
 
 VkResult ModelLoader::CreateBuffer(VkBufferUsageFlags usageFlags,
                                    VkMemoryPropertyFlags memoryPropertyFlags,
                                    VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory,
-                                   void *data) {
+                                   const void *data) {
 
   // Create a vertex buffer
   VkBufferCreateInfo bufferCreateInfo{
@@ -89,7 +429,7 @@ VkResult ModelLoader::CreateBuffer(VkBufferUsageFlags usageFlags,
       .usage = usageFlags,
       .flags = 0,
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .pQueueFamilyIndices = 0, // HARDCODED since Android should have only 1 queue, should fix
+      .pQueueFamilyIndices = &mQueueFamilyIndex,
       .queueFamilyIndexCount = 1,
   };
 
@@ -110,7 +450,7 @@ VkResult ModelLoader::CreateBuffer(VkBufferUsageFlags usageFlags,
                               memoryPropertyFlags, &memAllocInfo.memoryTypeIndex));
 
   // Allocate memory for the buffer
-  CALL_VK(vkAllocateMemory(mLogicDevice, &memAllocInfo, nullptr, memory));
+  CALL_VK(AllocateTrackedMemory(mLogicDevice, &memAllocInfo, MEMORY_CATEGORY_GEOMETRY, memory));
 
   // If a pointer to the buffer data has been passed, map the buffer and copy over the data
   if (data != nullptr)
@@ -137,4 +477,4 @@ VkResult ModelLoader::CreateBuffer(VkBufferUsageFlags usageFlags,
   CALL_VK(vkBindBufferMemory(mLogicDevice, *buffer, *memory, 0));
 
   return VK_SUCCESS;
-}
\ No newline at end of file
+}
@@ -1,8 +1,6 @@
 #ifndef __MODEL_LOADER_HPP__
 #define __MODEL_LOADER_HPP__
 
-#include <android_native_app_glue.h>
-
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,34 +8,38 @@
 #include <vector>
 
 #include "vulkan_wrapper.h"
+#include "Animation.h"
+#include "UploadQueue.h"
+#include "MemoryTracker.h"
+#include "MeshData.h"
+#include "MeshletBuilder.h"
+#include "ModelCache.h"
+#include "MorphTargets.h"
+#include "ScratchArena.h"
+#include "VertexLayout.h"
+#include "WorkerPool.h"
 
 class ModelLoader {
  private:
   VkDevice mLogicDevice = nullptr;
   VkPhysicalDevice mPhysicalDevice = nullptr;
-  android_app* androidAppCtx = nullptr;
-  VkResult CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
-      VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
+  UploadQueue* mUploadQueue = nullptr;
+  ScratchArena* mScratch = nullptr;
+  WorkerPool* mWorkers = nullptr;
+  ModelCache* mCache = nullptr;
+  uint32_t mQueueFamilyIndex = 0;
 
-  struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 normal;
-    glm::vec2 uv;
-  };
-
- public:
+  // True when device local memory can also be mapped by the host (unified memory), in which
+  // case geometry is written in place instead of going through a staging buffer
+  bool mUnifiedMemory = false;
 
-  typedef enum Component {
-    VERTEX_COMPONENT_POSITION = 0x0,
-    VERTEX_COMPONENT_NORMAL = 0x1,
-    VERTEX_COMPONENT_COLOR = 0x2,
-    VERTEX_COMPONENT_UV = 0x3,
-    VERTEX_COMPONENT_TANGENT = 0x4,
-    VERTEX_COMPONENT_BITANGENT = 0x5,
-    VERTEX_COMPONENT_DUMMY_FLOAT = 0x6,
-    VERTEX_COMPONENT_DUMMY_VEC4 = 0x7
-  } Component;
+  VkResult CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
+      VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, const void *data = nullptr);
+  VkResult CreateDeviceLocalBuffer(VkBufferUsageFlags usageFlags, VkDeviceSize size,
+      VkBuffer *buffer, VkDeviceMemory *memory, const void *data);
+  bool IsUnifiedMemory();
 
+ public:
   struct Model {
     struct {
       VkBuffer buffer;
@@ -51,55 +53,49 @@ class ModelLoader {
 
     uint32_t indexCount = 0;
     uint32_t vertexCount = 0;
+    // 16 bit whenever the vertex count allows
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
 
-    struct ModelPart {
-      uint32_t vertexBase;
-      uint32_t vertexCount;
-      uint32_t indexBase;
-      uint32_t indexCount;
-    };
+    typedef navs::MeshPart ModelPart;
     std::vector<ModelPart> parts;
-
-    struct VertexLayout {
-     public:
-      /** @brief Components used to generate vertices from */
-      std::vector<Component> components;
-      VertexLayout() {};
-
-      VertexLayout(std::vector<Component> components)
-      {
-        this->components = std::move(components);
-      }
-
-      uint32_t stride()
-      {
-        uint32_t res = 0;
-        for (auto& component : components)
-        {
-          switch (component)
-          {
-            case VERTEX_COMPONENT_UV:
-              res += 2 * sizeof(float);
-              break;
-            case VERTEX_COMPONENT_DUMMY_FLOAT:
-              res += sizeof(float);
-              break;
-            case VERTEX_COMPONENT_DUMMY_VEC4:
-              res += 4 * sizeof(float);
-              break;
-            default:
-              // All components except the ones listed above are made up of 3 floats
-              res += 3 * sizeof(float);
-          }
-        }
-        return res;
-      }
-    } layout;
+    // Level 0 is the full mesh, coarser levels follow with their own parts and index ranges
+    std::vector<navs::MeshLod> lods;
+    // Clusters of the full mesh for culling, empty unless createInfo.buildMeshlets is set
+    navs::MeshletData meshlets;
+    navs::MeshBounds bounds;
+    // Restores snorm16 positions of a quantized layout, derived from bounds
+    navs::QuantizationScale quantization;
+
+    // Set from a navs::VertexLayout, e.g. HeartLayout::Format()
+    navs::VertexFormat layout;
+    // Float layout skinned and morphed glTF models are packed in when layout is quantized, their
+    // compute passes only handle floats. Without one they keep layout and their bind pose.
+    navs::VertexFormat animatedLayout = {};
+
+    // Skinned glTF models only: a navs::SkinVertex per vertex for shaders/skin.comp, which also
+    // reads the vertex buffer. Needs a layout with float position, normal and signed tangent.
+    struct {
+      VkBuffer buffer = VK_NULL_HANDLE;
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+    } skin;
+    navs::Skeleton skeleton;
+    std::vector<navs::AnimationClip> animations;
+
+    // glTF morph targets: the sparse deltas for shaders/morph.comp, which blends them into
+    // morphed, a copy of the vertex buffer drawn (or skinned) in its place. Same float layout
+    // requirement as skinning, buffers stay VK_NULL_HANDLE for models without targets.
+    navs::MorphTargets morphTargets;
+    struct {
+      VkBuffer buffer = VK_NULL_HANDLE;
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+    } morphVertices, morphDeltas, morphed;
 
     struct CreateInfo {
       glm::vec3 center;
       glm::vec3 scale;
       glm::vec2 uvscale;
+      // glTF sources only, baked meshes carry no meshlets
+      bool buildMeshlets = false;
 
       CreateInfo() {};
 
@@ -123,16 +119,51 @@ class ModelLoader {
     void destroy(VkDevice device)
     {
       vkDestroyBuffer(device, vertices.buffer, nullptr);
-      vkFreeMemory(device, vertices.memory, nullptr);
+      navs::FreeTrackedMemory(device, vertices.memory);
       vkDestroyBuffer(device, indices.buffer, nullptr);
-      vkFreeMemory(device, indices.memory, nullptr);
+      navs::FreeTrackedMemory(device, indices.memory);
+      vkDestroyBuffer(device, skin.buffer, nullptr);
+      navs::FreeTrackedMemory(device, skin.memory);
+      skin.buffer = VK_NULL_HANDLE;
+      skin.memory = VK_NULL_HANDLE;
+      vkDestroyBuffer(device, morphVertices.buffer, nullptr);
+      navs::FreeTrackedMemory(device, morphVertices.memory);
+      vkDestroyBuffer(device, morphDeltas.buffer, nullptr);
+      navs::FreeTrackedMemory(device, morphDeltas.memory);
+      vkDestroyBuffer(device, morphed.buffer, nullptr);
+      navs::FreeTrackedMemory(device, morphed.memory);
+      morphVertices.buffer = morphDeltas.buffer = morphed.buffer = VK_NULL_HANDLE;
+      morphVertices.memory = morphDeltas.memory = morphed.memory = VK_NULL_HANDLE;
     };
   };
 
 
-  ModelLoader(VkPhysicalDevice pDevice, VkDevice lDevice, android_app* app);
+  ModelLoader(VkPhysicalDevice pDevice, VkDevice lDevice, UploadQueue* uploadQueue,
+              ScratchArena* scratch, WorkerPool* workers, ModelCache* cache,
+              uint32_t queueFamilyIndex);
   ~ModelLoader();
-  void LoadFromFile(const char* filePath, Model* model);
+  // Geometry copies are queued on the UploadQueue, submit it before drawing the model. Decoded
+  // geometry comes from the ScratchArena and stays there until it is released, glTF primitives
+  // are decoded across the WorkerPool. With a ModelCache the result of a glTF load is kept
+  // baked and loaded from there the next time, cache may be nullptr; skinned and morphed models
+  // are never cached. Accepts .gltf, .glb and meshes baked by tools/MeshBaker, which are copied
+  // out of the mapping unparsed. False, with the reason logged, when the file can't be opened
+  // or read; model may hold part of the geometry then and still has to be destroyed.
+  bool LoadFromFile(const char* filePath, Model* model);
+
+  // Flat shaded box filling bounds, packed in model->layout. Stands in for a model while it
+  // streams in.
+  void CreateBox(const navs::MeshBounds& bounds, Model* model);
+
+ private:
+  // Also bakes the result into cacheEntry unless it is nullptr
+  bool LoadGltf(const uint8_t* data, size_t size, const char* filePath, Model* model,
+                std::vector<uint8_t>* cacheEntry);
+  bool LoadBaked(const uint8_t* data, size_t size, const char* filePath, Model* model);
+  void UploadGeometry(Model* model, const void* vertexData, VkDeviceSize vertexSize,
+                      const void* indexData, VkDeviceSize indexSize);
+  void UploadBuffer(VkBufferUsageFlags usage, const void* data, VkDeviceSize size,
+                    VkBuffer* buffer, VkDeviceMemory* memory);
 };
 
 
@@ -0,0 +1,219 @@
+#include "MorphPass.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "VulkanUtil.h"
+
+using namespace navs;
+
+static const uint32_t kMorphGroupSize = 64;  // local_size_x of morph.comp
+static const uint32_t kMorphBindingCount = 5;
+
+// Float offset of component in layout, or -1 when it is missing
+static int GetFloatOffset(const VertexFormat& layout, VertexComponent component) {
+  const int offset = GetComponentOffset(layout, component);
+  return offset < 0 ? -1 : offset / static_cast<int>(sizeof(float));
+}
+
+bool MorphPass::IsSupported(const ModelLoader::Model& model) {
+  const VertexFormat& layout = model.layout;
+  if (IsQuantizedFormat(layout)) {
+    return false;
+  }
+  return model.morphTargets.GetVertexCount() > 0 && model.morphed.buffer != VK_NULL_HANDLE &&
+         GetFloatOffset(layout, VERTEX_COMPONENT_POSITION) >= 0 &&
+         GetFloatOffset(layout, VERTEX_COMPONENT_NORMAL) >= 0 &&
+         GetFloatOffset(layout, VERTEX_COMPONENT_TANGENT_SIGNED) >= 0;
+}
+
+MorphPass::MorphPass(VkPhysicalDevice pDevice, VkDevice lDevice, uint32_t queueFamilyIndex,
+                     VkShaderModule shader, const ModelLoader::Model& model) :
+    mLogicDevice(lDevice),
+    mMorphedBuffer(model.morphed.buffer),
+    mTargetCount(model.morphTargets.targetCount)
+{
+  assert(IsSupported(model));
+  mParams = {
+      .vertexCount = static_cast<uint32_t>(model.morphTargets.GetVertexCount()),
+      .stride = model.layout.stride / static_cast<uint32_t>(sizeof(float)),
+      .positionOffset = static_cast<uint32_t>(GetFloatOffset(model.layout,
+                                                             VERTEX_COMPONENT_POSITION)),
+      .normalOffset = static_cast<uint32_t>(GetFloatOffset(model.layout,
+                                                           VERTEX_COMPONENT_NORMAL)),
+      .tangentOffset = static_cast<uint32_t>(GetFloatOffset(model.layout,
+                                                            VERTEX_COMPONENT_TANGENT_SIGNED)),
+  };
+
+  const VkDeviceSize weightSize = std::max(mTargetCount, 1u) * sizeof(float);
+  CreateBuffer(pDevice, queueFamilyIndex, weightSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               MEMORY_CATEGORY_UNIFORM, &mWeightBuffer, &mWeightMemory);
+  CALL_VK(vkMapMemory(mLogicDevice, mWeightMemory, 0, weightSize, 0, (void**)&mWeights));
+  std::copy(model.morphTargets.defaultWeights.begin(), model.morphTargets.defaultWeights.end(),
+            mWeights);
+
+  VkDescriptorSetLayoutBinding bindings[kMorphBindingCount];
+  for (uint32_t i = 0; i < kMorphBindingCount; i++) {
+    bindings[i] = {
+        .binding = i,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .pImmutableSamplers = nullptr,
+    };
+  }
+  VkDescriptorSetLayoutCreateInfo setLayoutInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = kMorphBindingCount,
+      .pBindings = bindings,
+  };
+  CALL_VK(vkCreateDescriptorSetLayout(mLogicDevice, &setLayoutInfo, nullptr, &mSetLayout));
+
+  VkDescriptorPoolSize poolSize{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = kMorphBindingCount,
+  };
+  VkDescriptorPoolCreateInfo poolInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .poolSizeCount = 1,
+      .pPoolSizes = &poolSize,
+      .maxSets = 1,
+  };
+  CALL_VK(vkCreateDescriptorPool(mLogicDevice, &poolInfo, nullptr, &mDescriptorPool));
+
+  VkDescriptorSetAllocateInfo allocInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = mDescriptorPool,
+      .pSetLayouts = &mSetLayout,
+      .descriptorSetCount = 1,
+  };
+  CALL_VK(vkAllocateDescriptorSets(mLogicDevice, &allocInfo, &mDescriptorSet));
+
+  const VkDescriptorBufferInfo bufferInfos[kMorphBindingCount] = {
+      {model.vertices.buffer, 0, VK_WHOLE_SIZE},
+      {model.morphVertices.buffer, 0, VK_WHOLE_SIZE},
+      {model.morphDeltas.buffer, 0, VK_WHOLE_SIZE},
+      {mWeightBuffer, 0, VK_WHOLE_SIZE},
+      {mMorphedBuffer, 0, VK_WHOLE_SIZE},
+  };
+  VkWriteDescriptorSet writes[kMorphBindingCount];
+  for (uint32_t i = 0; i < kMorphBindingCount; i++) {
+    writes[i] = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = mDescriptorSet,
+        .dstBinding = i,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &bufferInfos[i],
+    };
+  }
+  vkUpdateDescriptorSets(mLogicDevice, kMorphBindingCount, writes, 0, nullptr);
+
+  VkPushConstantRange pushConstantRange{
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = sizeof(Params),
+  };
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .setLayoutCount = 1,
+      .pSetLayouts = &mSetLayout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &pushConstantRange,
+  };
+  CALL_VK(vkCreatePipelineLayout(mLogicDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout));
+
+  VkComputePipelineCreateInfo pipelineInfo{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .stage = {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+          .module = shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+      .layout = mPipelineLayout,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0,
+  };
+  CALL_VK(vkCreateComputePipelines(mLogicDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                   &mPipeline));
+}
+
+MorphPass::~MorphPass() {
+  vkDestroyPipeline(mLogicDevice, mPipeline, nullptr);
+  vkDestroyPipelineLayout(mLogicDevice, mPipelineLayout, nullptr);
+  vkDestroyDescriptorPool(mLogicDevice, mDescriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(mLogicDevice, mSetLayout, nullptr);
+  vkUnmapMemory(mLogicDevice, mWeightMemory);
+  vkDestroyBuffer(mLogicDevice, mWeightBuffer, nullptr);
+  FreeTrackedMemory(mLogicDevice, mWeightMemory);
+}
+
+void MorphPass::Record(VkCommandBuffer cmdBuffer) {
+  // The previous frame's draw or skinning has to be done reading before the vertices change
+  vkCmdPipelineBarrier(cmdBuffer,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0,
+                       nullptr);
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1,
+                          &mDescriptorSet, 0, nullptr);
+  vkCmdPushConstants(cmdBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Params),
+                     &mParams);
+  vkCmdDispatch(cmdBuffer, (mParams.vertexCount + kMorphGroupSize - 1) / kMorphGroupSize, 1, 1);
+
+  VkBufferMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = mMorphedBuffer,
+      .offset = 0,
+      .size = VK_WHOLE_SIZE,
+  };
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void MorphPass::CreateBuffer(VkPhysicalDevice pDevice, uint32_t queueFamilyIndex,
+                             VkDeviceSize size, VkBufferUsageFlags usage,
+                             VkMemoryPropertyFlags properties, MemoryCategory category,
+                             VkBuffer* buffer, VkDeviceMemory* memory) {
+  VkBufferCreateInfo bufferInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .size = size,
+      .usage = usage,
+      .flags = 0,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .pQueueFamilyIndices = &queueFamilyIndex,
+      .queueFamilyIndexCount = 1,
+  };
+  CALL_VK(vkCreateBuffer(mLogicDevice, &bufferInfo, nullptr, buffer));
+
+  VkMemoryRequirements memReq;
+  vkGetBufferMemoryRequirements(mLogicDevice, *buffer, &memReq);
+  VkMemoryAllocateInfo memAllocInfo{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .allocationSize = memReq.size,
+      .memoryTypeIndex = 0,
+  };
+  assert(MapMemoryTypeToIndex(pDevice, memReq.memoryTypeBits, properties,
+                              &memAllocInfo.memoryTypeIndex));
+  CALL_VK(AllocateTrackedMemory(mLogicDevice, &memAllocInfo, category, memory));
+  CALL_VK(vkBindBufferMemory(mLogicDevice, *buffer, *memory, 0));
+}
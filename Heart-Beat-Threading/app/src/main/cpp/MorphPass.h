@@ -0,0 +1,64 @@
+#ifndef __MORPH_PASS_HPP__
+#define __MORPH_PASS_HPP__
+
+#include "vulkan_wrapper.h"
+#include "MemoryTracker.h"
+#include "ModelLoader.h"
+
+// Blends a model's morph targets with shaders/morph.comp into its morphed vertex buffer, which
+// is then drawn or skinned in place of the model's own. Only the vertices some target moves are
+// touched, so a frame costs one weight per target of upload and a dispatch over the sparse set.
+// Weights live in a persistently mapped buffer; frames don't overlap on the GPU, so a single copy
+// of it is enough.
+class MorphPass {
+ public:
+  // The model needs morph targets and a float layout with position, normal and signed tangent
+  MorphPass(VkPhysicalDevice pDevice, VkDevice lDevice, uint32_t queueFamilyIndex,
+            VkShaderModule shader, const ModelLoader::Model& model);
+  ~MorphPass();
+
+  // True when the model can be morphed, otherwise nothing was created
+  static bool IsSupported(const ModelLoader::Model& model);
+
+  // GetTargetCount() weights read by the next dispatch, initialized to the model's defaults
+  float* GetWeights(void) { return mWeights; }
+
+  uint32_t GetTargetCount(void) const { return mTargetCount; }
+  // Vertices the dispatch rewrites, out of the model's vertexCount
+  uint32_t GetMorphedVertexCount(void) const { return mParams.vertexCount; }
+
+  // Records the dispatch together with the barriers against the previous frame's reads of the
+  // morphed vertices and the draw or skinning dispatch that follows. Goes outside of a render
+  // pass.
+  void Record(VkCommandBuffer cmdBuffer);
+
+ private:
+  struct Params {
+    uint32_t vertexCount;
+    uint32_t stride;
+    uint32_t positionOffset;
+    uint32_t normalOffset;
+    uint32_t tangentOffset;
+  };
+
+  VkDevice mLogicDevice;
+  VkDescriptorSetLayout mSetLayout;
+  VkDescriptorPool mDescriptorPool;
+  VkDescriptorSet mDescriptorSet;
+  VkPipelineLayout mPipelineLayout;
+  VkPipeline mPipeline;
+
+  VkBuffer mWeightBuffer;
+  VkDeviceMemory mWeightMemory;
+  float* mWeights;
+  VkBuffer mMorphedBuffer;
+
+  Params mParams;
+  uint32_t mTargetCount;
+
+  void CreateBuffer(VkPhysicalDevice pDevice, uint32_t queueFamilyIndex, VkDeviceSize size,
+                    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                    navs::MemoryCategory category, VkBuffer* buffer, VkDeviceMemory* memory);
+};
+
+#endif // __MORPH_PASS_HPP__
@@ -0,0 +1,75 @@
+#include "MorphTargets.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace navs {
+
+void RemapMorphTargets(MorphTargets* targets, const uint32_t* remap) {
+  const size_t count = targets->GetVertexCount();
+  // New vertex index and the entry it came from
+  std::vector<std::pair<uint32_t, uint32_t>> order;
+  order.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t vertex = remap[targets->vertices[i].vertex];
+    if (vertex != ~0u) {
+      order.push_back(std::make_pair(vertex, static_cast<uint32_t>(i)));
+    }
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<MorphVertex> vertices;
+  std::vector<MorphDelta> deltas;
+  vertices.reserve(order.size() + 1);
+  deltas.reserve(targets->deltas.size());
+  for (const std::pair<uint32_t, uint32_t>& entry : order) {
+    const MorphVertex& source = targets->vertices[entry.second];
+    const uint32_t end = targets->vertices[entry.second + 1].firstDelta;
+    vertices.push_back({entry.first, static_cast<uint32_t>(deltas.size())});
+    deltas.insert(deltas.end(), targets->deltas.begin() + source.firstDelta,
+                  targets->deltas.begin() + end);
+  }
+  vertices.push_back({~0u, static_cast<uint32_t>(deltas.size())});
+  targets->vertices.swap(vertices);
+  targets->deltas.swap(deltas);
+}
+
+MeshBounds GetMorphExtent(const MorphTargets& targets) {
+  std::vector<MeshBounds> perTarget(targets.targetCount, {glm::vec3(0.0f), glm::vec3(0.0f)});
+  for (const MorphDelta& delta : targets.deltas) {
+    perTarget[delta.target].min = glm::min(perTarget[delta.target].min, delta.position);
+    perTarget[delta.target].max = glm::max(perTarget[delta.target].max, delta.position);
+  }
+  MeshBounds extent = {glm::vec3(0.0f), glm::vec3(0.0f)};
+  for (const MeshBounds& bounds : perTarget) {
+    extent.min += bounds.min;
+    extent.max += bounds.max;
+  }
+  return extent;
+}
+
+void ApplyMorphTargets(const MeshVertex* vertices, const MorphTargets& targets,
+                       const float* weights, MeshVertex* dst) {
+  for (size_t i = 0; i < targets.GetVertexCount(); i++) {
+    const MorphVertex& morphed = targets.vertices[i];
+    const MeshVertex& base = vertices[morphed.vertex];
+    glm::vec3 position = base.pos;
+    glm::vec3 normal = base.normal;
+    glm::vec3 tangent = glm::vec3(base.tangent);
+    for (uint32_t d = morphed.firstDelta; d < targets.vertices[i + 1].firstDelta; d++) {
+      const MorphDelta& delta = targets.deltas[d];
+      const float weight = weights[delta.target];
+      if (weight != 0.0f) {
+        position += delta.position * weight;
+        normal += delta.normal * weight;
+        tangent += delta.tangent * weight;
+      }
+    }
+    MeshVertex& vertex = dst[morphed.vertex];
+    vertex.pos = position;
+    vertex.normal = glm::normalize(normal);
+    vertex.tangent = glm::vec4(glm::normalize(tangent), base.tangent.w);
+  }
+}
+
+} // navs namespace
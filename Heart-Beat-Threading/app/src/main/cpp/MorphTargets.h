@@ -0,0 +1,58 @@
+#ifndef __MORPH_TARGETS_HPP__
+#define __MORPH_TARGETS_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshData.h"
+
+// Blend shapes stored sparsely: only vertices some target moves are listed, each with the
+// deltas of the targets that move it. The vertex is base + sum(weight[target] * delta), either
+// on the CPU with ApplyMorphTargets() or in shaders/morph.comp, which reads the same arrays.
+
+namespace navs {
+
+// Three vec4 in std430, the target index sits in the w of the position
+struct MorphDelta {
+  glm::vec3 position;
+  uint32_t target;
+  glm::vec3 normal;
+  float pad0;
+  glm::vec3 tangent;
+  float pad1;
+};
+
+// A morphed vertex, its deltas run up to the firstDelta of the next entry
+struct MorphVertex {
+  uint32_t vertex;
+  uint32_t firstDelta;
+};
+
+struct MorphTargets {
+  uint32_t targetCount = 0;
+  // Sorted by vertex and closed by an entry with vertex ~0u and firstDelta = deltas.size()
+  std::vector<MorphVertex> vertices;
+  std::vector<MorphDelta> deltas;
+  std::vector<float> defaultWeights;  // one per target
+
+  // Number of morphed vertices, not counting the closing entry
+  size_t GetVertexCount(void) const { return vertices.empty() ? 0 : vertices.size() - 1; }
+};
+
+// Moves the morphed vertices to their new index after remap (see OptimizeVertexFetch()),
+// vertices that were dropped lose their deltas
+void RemapMorphTargets(MorphTargets* targets, const uint32_t* remap);
+
+// Largest displacement of the positions in each direction with every weight in [0, 1]
+MeshBounds GetMorphExtent(const MorphTargets& targets);
+
+// Writes the morphed vertices into dst, which already holds a copy of vertices. Deltas of
+// targets with a zero weight are skipped, normals and tangents are renormalized.
+void ApplyMorphTargets(const MeshVertex* vertices, const MorphTargets& targets,
+                       const float* weights, MeshVertex* dst);
+
+} // navs namespace
+#endif // __MORPH_TARGETS_HPP__
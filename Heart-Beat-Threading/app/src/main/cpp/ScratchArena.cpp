@@ -0,0 +1,66 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#ifdef __ANDROID__
+#include "MemoryTracker.h"
+
+using namespace navs;
+#endif
+
+ScratchArena::ScratchArena(size_t blockSize) :
+    mBlockSize(blockSize)
+{
+}
+
+ScratchArena::~ScratchArena() {
+  Release();
+}
+
+void* ScratchArena::Allocate(size_t size, size_t alignment) {
+  assert((alignment & (alignment - 1)) == 0);
+
+  if (!mBlocks.empty()) {
+    Block& block = mBlocks.back();
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+    size_t offset = ((base + block.used + alignment - 1) & ~(alignment - 1)) - base;
+    if (offset + size <= block.size) {
+      block.used = offset + size;
+      mBytesAllocated += size;
+      mAllocationCount++;
+      return block.data + offset;
+    }
+  }
+
+  // Oversized requests get a block of their own, malloc already aligns to 16 bytes
+  Block block;
+  block.size = std::max(mBlockSize, size + alignment);
+  block.data = static_cast<uint8_t*>(malloc(block.size));
+  assert(block.data != nullptr);
+#ifdef __ANDROID__
+  TrackHostAllocation(MEMORY_CATEGORY_STAGING, block.size);
+#endif
+
+  uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+  size_t offset = ((base + alignment - 1) & ~(alignment - 1)) - base;
+  block.used = offset + size;
+  mBlocks.push_back(block);
+
+  mBytesAllocated += size;
+  mAllocationCount++;
+  return block.data + offset;
+}
+
+void ScratchArena::Release(void) {
+  for (Block& block : mBlocks) {
+    free(block.data);
+#ifdef __ANDROID__
+    UntrackHostAllocation(MEMORY_CATEGORY_STAGING, block.size);
+#endif
+  }
+  mBlocks.clear();
+  mBytesAllocated = 0;
+  mAllocationCount = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef __SCRATCH_ARENA_HPP__
+#define __SCRATCH_ARENA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bump allocator for load time scratch memory. Allocations are carved out of large blocks
+// and never freed individually; Release() gives every block back in one go once the assets
+// have been handed to the upload queue.
+class ScratchArena {
+ public:
+  explicit ScratchArena(size_t blockSize = 1024 * 1024);
+  ~ScratchArena();
+
+  void* Allocate(size_t size, size_t alignment = 16);
+
+  template <typename T>
+  T* Allocate(size_t count) {
+    return static_cast<T*>(Allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+  }
+
+  // Frees all blocks, every pointer handed out so far becomes invalid
+  void Release(void);
+
+  // Counters since the last Release()
+  uint32_t AllocationCount(void) const { return mAllocationCount; }
+  uint32_t BlockCount(void) const { return static_cast<uint32_t>(mBlocks.size()); }
+  size_t BytesAllocated(void) const { return mBytesAllocated; }
+
+ private:
+  struct Block {
+    uint8_t* data;
+    size_t size;
+    size_t used;
+  };
+  std::vector<Block> mBlocks;
+  size_t mBlockSize;
+  size_t mBytesAllocated = 0;
+  uint32_t mAllocationCount = 0;
+};
+
+// Lets standard containers draw from a ScratchArena. Memory is only returned on Release(), so
+// containers should be reserved up front rather than grown.
+template <typename T>
+struct ArenaAllocator {
+  typedef T value_type;
+
+  ScratchArena* arena;
+
+  explicit ArenaAllocator(ScratchArena* scratchArena) : arena(scratchArena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+  T* allocate(size_t count) { return arena->Allocate<T>(count); }
+  void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena != b.arena;
+}
+
+#endif // __SCRATCH_ARENA_HPP__
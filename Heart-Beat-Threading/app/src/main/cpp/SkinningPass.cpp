@@ -0,0 +1,231 @@
+#include "SkinningPass.h"
+
+#include <cassert>
+
+#include "VulkanUtil.h"
+
+using namespace navs;
+
+static const uint32_t kSkinningGroupSize = 64;  // local_size_x of skin.comp
+
+// Float offset of component in layout, or -1 when it is missing
+static int GetFloatOffset(const VertexFormat& layout, VertexComponent component) {
+  const int offset = GetComponentOffset(layout, component);
+  return offset < 0 ? -1 : offset / static_cast<int>(sizeof(float));
+}
+
+bool SkinningPass::IsSupported(const ModelLoader::Model& model) {
+  const VertexFormat& layout = model.layout;
+  if (IsQuantizedFormat(layout)) {
+    return false;
+  }
+  return !model.skeleton.joints.empty() && model.skin.buffer != VK_NULL_HANDLE &&
+         GetFloatOffset(layout, VERTEX_COMPONENT_POSITION) >= 0 &&
+         GetFloatOffset(layout, VERTEX_COMPONENT_NORMAL) >= 0 &&
+         GetFloatOffset(layout, VERTEX_COMPONENT_TANGENT_SIGNED) >= 0;
+}
+
+SkinningPass::SkinningPass(VkPhysicalDevice pDevice, VkDevice lDevice, uint32_t queueFamilyIndex,
+                           VkShaderModule shader, const ModelLoader::Model& model,
+                           uint32_t instanceCount) :
+    mLogicDevice(lDevice),
+    mJointCount(static_cast<uint32_t>(model.skeleton.joints.size())),
+    mInstanceCount(instanceCount)
+{
+  assert(IsSupported(model) && instanceCount > 0);
+  mParams = {
+      .vertexCount = model.vertexCount,
+      .jointCount = mJointCount,
+      .stride = model.layout.stride / static_cast<uint32_t>(sizeof(float)),
+      .positionOffset = static_cast<uint32_t>(GetFloatOffset(model.layout,
+                                                             VERTEX_COMPONENT_POSITION)),
+      .normalOffset = static_cast<uint32_t>(GetFloatOffset(model.layout,
+                                                           VERTEX_COMPONENT_NORMAL)),
+      .tangentOffset = static_cast<uint32_t>(GetFloatOffset(model.layout,
+                                                            VERTEX_COMPONENT_TANGENT_SIGNED)),
+  };
+  mInstanceSize = VkDeviceSize(model.vertexCount) * model.layout.stride;
+
+  // Palettes are rewritten every frame, the skinned vertices never leave the GPU
+  const VkDeviceSize paletteSize =
+      VkDeviceSize(instanceCount) * (mJointCount + 1) * sizeof(glm::mat4);
+  CreateBuffer(pDevice, queueFamilyIndex, paletteSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               MEMORY_CATEGORY_UNIFORM, &mPaletteBuffer, &mPaletteMemory);
+  CALL_VK(vkMapMemory(mLogicDevice, mPaletteMemory, 0, paletteSize, 0, (void**)&mPalettes));
+  for (uint32_t i = 0; i < instanceCount * (mJointCount + 1); i++) {
+    mPalettes[i] = glm::mat4(1.0f);
+  }
+  CreateBuffer(pDevice, queueFamilyIndex, mInstanceSize * instanceCount,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_GEOMETRY,
+               &mSkinnedBuffer, &mSkinnedMemory);
+
+  VkDescriptorSetLayoutBinding bindings[4];
+  for (uint32_t i = 0; i < 4; i++) {
+    bindings[i] = {
+        .binding = i,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .pImmutableSamplers = nullptr,
+    };
+  }
+  VkDescriptorSetLayoutCreateInfo setLayoutInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 4,
+      .pBindings = bindings,
+  };
+  CALL_VK(vkCreateDescriptorSetLayout(mLogicDevice, &setLayoutInfo, nullptr, &mSetLayout));
+
+  VkDescriptorPoolSize poolSize{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 4,
+  };
+  VkDescriptorPoolCreateInfo poolInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .poolSizeCount = 1,
+      .pPoolSizes = &poolSize,
+      .maxSets = 1,
+  };
+  CALL_VK(vkCreateDescriptorPool(mLogicDevice, &poolInfo, nullptr, &mDescriptorPool));
+
+  VkDescriptorSetAllocateInfo allocInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = mDescriptorPool,
+      .pSetLayouts = &mSetLayout,
+      .descriptorSetCount = 1,
+  };
+  CALL_VK(vkAllocateDescriptorSets(mLogicDevice, &allocInfo, &mDescriptorSet));
+
+  // Morph targets are applied to the bind pose first, see MorphPass
+  const VkBuffer bindPose =
+      model.morphed.buffer != VK_NULL_HANDLE ? model.morphed.buffer : model.vertices.buffer;
+  const VkDescriptorBufferInfo bufferInfos[4] = {
+      {bindPose, 0, VK_WHOLE_SIZE},
+      {model.skin.buffer, 0, VK_WHOLE_SIZE},
+      {mPaletteBuffer, 0, VK_WHOLE_SIZE},
+      {mSkinnedBuffer, 0, VK_WHOLE_SIZE},
+  };
+  VkWriteDescriptorSet writes[4];
+  for (uint32_t i = 0; i < 4; i++) {
+    writes[i] = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = mDescriptorSet,
+        .dstBinding = i,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &bufferInfos[i],
+    };
+  }
+  vkUpdateDescriptorSets(mLogicDevice, 4, writes, 0, nullptr);
+
+  VkPushConstantRange pushConstantRange{
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = sizeof(Params),
+  };
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .setLayoutCount = 1,
+      .pSetLayouts = &mSetLayout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &pushConstantRange,
+  };
+  CALL_VK(vkCreatePipelineLayout(mLogicDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout));
+
+  VkComputePipelineCreateInfo pipelineInfo{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .stage = {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+          .module = shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+      .layout = mPipelineLayout,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0,
+  };
+  CALL_VK(vkCreateComputePipelines(mLogicDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                   &mPipeline));
+}
+
+SkinningPass::~SkinningPass() {
+  vkDestroyPipeline(mLogicDevice, mPipeline, nullptr);
+  vkDestroyPipelineLayout(mLogicDevice, mPipelineLayout, nullptr);
+  vkDestroyDescriptorPool(mLogicDevice, mDescriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(mLogicDevice, mSetLayout, nullptr);
+  vkUnmapMemory(mLogicDevice, mPaletteMemory);
+  vkDestroyBuffer(mLogicDevice, mPaletteBuffer, nullptr);
+  FreeTrackedMemory(mLogicDevice, mPaletteMemory);
+  vkDestroyBuffer(mLogicDevice, mSkinnedBuffer, nullptr);
+  FreeTrackedMemory(mLogicDevice, mSkinnedMemory);
+}
+
+void SkinningPass::Record(VkCommandBuffer cmdBuffer) {
+  // The previous frame's draw has to be done reading the vertices before they are overwritten
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0,
+                       nullptr);
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1,
+                          &mDescriptorSet, 0, nullptr);
+  vkCmdPushConstants(cmdBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Params),
+                     &mParams);
+  vkCmdDispatch(cmdBuffer, (mParams.vertexCount + kSkinningGroupSize - 1) / kSkinningGroupSize,
+                mInstanceCount, 1);
+
+  VkBufferMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = mSkinnedBuffer,
+      .offset = 0,
+      .size = VK_WHOLE_SIZE,
+  };
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0,
+                       nullptr);
+}
+
+void SkinningPass::CreateBuffer(VkPhysicalDevice pDevice, uint32_t queueFamilyIndex,
+                                VkDeviceSize size, VkBufferUsageFlags usage,
+                                VkMemoryPropertyFlags properties, MemoryCategory category,
+                                VkBuffer* buffer, VkDeviceMemory* memory) {
+  VkBufferCreateInfo bufferInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .size = size,
+      .usage = usage,
+      .flags = 0,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .pQueueFamilyIndices = &queueFamilyIndex,
+      .queueFamilyIndexCount = 1,
+  };
+  CALL_VK(vkCreateBuffer(mLogicDevice, &bufferInfo, nullptr, buffer));
+
+  VkMemoryRequirements memReq;
+  vkGetBufferMemoryRequirements(mLogicDevice, *buffer, &memReq);
+  VkMemoryAllocateInfo memAllocInfo{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .allocationSize = memReq.size,
+      .memoryTypeIndex = 0,
+  };
+  assert(MapMemoryTypeToIndex(pDevice, memReq.memoryTypeBits, properties,
+                              &memAllocInfo.memoryTypeIndex));
+  CALL_VK(AllocateTrackedMemory(mLogicDevice, &memAllocInfo, category, memory));
+  CALL_VK(vkBindBufferMemory(mLogicDevice, *buffer, *memory, 0));
+}
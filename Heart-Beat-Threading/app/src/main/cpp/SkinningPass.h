@@ -0,0 +1,75 @@
+#ifndef __SKINNING_PASS_HPP__
+#define __SKINNING_PASS_HPP__
+
+#include <glm/glm.hpp>
+
+#include "vulkan_wrapper.h"
+#include "MemoryTracker.h"
+#include "ModelLoader.h"
+
+// Skins every instance of a model with shaders/skin.comp into one device local buffer, which
+// the graphics pipeline binds as its vertex buffer in place of the model's own. Palettes are
+// written by the host each frame into a persistently mapped buffer; frames don't overlap on the
+// GPU, so a single copy of it is enough.
+class SkinningPass {
+ public:
+  // The model needs a skeleton and a float layout with position, normal and signed tangent
+  SkinningPass(VkPhysicalDevice pDevice, VkDevice lDevice, uint32_t queueFamilyIndex,
+               VkShaderModule shader, const ModelLoader::Model& model, uint32_t instanceCount);
+  ~SkinningPass();
+
+  // True when the model can be skinned, otherwise nothing was created
+  static bool IsSupported(const ModelLoader::Model& model);
+
+  // GetJointCount() + 1 matrices for instance: the joint palette followed by the matrix for
+  // vertices without influences, usually the instance transform the palette was multiplied with
+  glm::mat4* GetPalette(uint32_t instance) { return mPalettes + instance * (mJointCount + 1); }
+
+  uint32_t GetJointCount(void) const { return mJointCount; }
+  uint32_t GetInstanceCount(void) const { return mInstanceCount; }
+
+  // Skinned vertices, instance i starts GetInstanceVertexOffset(i) vertices in, the vertexOffset
+  // of its draws
+  VkBuffer GetVertexBuffer(void) const { return mSkinnedBuffer; }
+  int32_t GetInstanceVertexOffset(uint32_t instance) const {
+    return static_cast<int32_t>(instance * mParams.vertexCount);
+  }
+
+  // Records the dispatch for every instance together with the barriers against the vertex
+  // input of the previous and the next draw. Goes outside of a render pass.
+  void Record(VkCommandBuffer cmdBuffer);
+
+ private:
+  struct Params {
+    uint32_t vertexCount;
+    uint32_t jointCount;
+    uint32_t stride;
+    uint32_t positionOffset;
+    uint32_t normalOffset;
+    uint32_t tangentOffset;
+  };
+
+  VkDevice mLogicDevice;
+  VkDescriptorSetLayout mSetLayout;
+  VkDescriptorPool mDescriptorPool;
+  VkDescriptorSet mDescriptorSet;
+  VkPipelineLayout mPipelineLayout;
+  VkPipeline mPipeline;
+
+  VkBuffer mPaletteBuffer;
+  VkDeviceMemory mPaletteMemory;
+  glm::mat4* mPalettes;
+  VkBuffer mSkinnedBuffer;
+  VkDeviceMemory mSkinnedMemory;
+
+  Params mParams;
+  uint32_t mJointCount;
+  uint32_t mInstanceCount;
+  VkDeviceSize mInstanceSize;
+
+  void CreateBuffer(VkPhysicalDevice pDevice, uint32_t queueFamilyIndex, VkDeviceSize size,
+                    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                    navs::MemoryCategory category, VkBuffer* buffer, VkDeviceMemory* memory);
+};
+
+#endif // __SKINNING_PASS_HPP__
@@ -0,0 +1,323 @@
+#include "TangentGenerator.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "WorkerPool.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TANGENT_SIMD_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TANGENT_SIMD_SSE
+#endif
+
+namespace navs {
+
+namespace {
+
+// Jobs are big enough that handing them out costs nothing next to the work, meshes below one
+// job never leave the calling thread
+const uint32_t kTrianglesPerJob = 4096;
+const uint32_t kVerticesPerJob = 4096;
+
+// Four lanes of float, the few operations the triangle pass needs
+#if defined(TANGENT_SIMD_NEON)
+typedef float32x4_t Float4;
+typedef uint32x4_t Mask4;
+
+inline Float4 Load(const float* p) { return vld1q_f32(p); }
+inline void Store(float* p, Float4 a) { vst1q_f32(p, a); }
+inline Float4 Splat(float a) { return vdupq_n_f32(a); }
+inline Float4 Add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 Sub(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+inline Float4 Min(Float4 a, Float4 b) { return vminq_f32(a, b); }
+inline Float4 Max(Float4 a, Float4 b) { return vmaxq_f32(a, b); }
+inline Float4 Abs(Float4 a) { return vabsq_f32(a); }
+inline Mask4 Greater(Float4 a, Float4 b) { return vcgtq_f32(a, b); }
+inline Mask4 And(Mask4 a, Mask4 b) { return vandq_u32(a, b); }
+inline Float4 Select(Mask4 mask, Float4 a, Float4 b) { return vbslq_f32(mask, a, b); }
+// Estimate refined by two Newton steps, armv7 has no vector sqrt or divide
+inline Float4 Rsqrt(Float4 a) {
+  Float4 e = vrsqrteq_f32(a);
+  e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+  return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+}
+#elif defined(TANGENT_SIMD_SSE)
+typedef __m128 Float4;
+typedef __m128 Mask4;
+
+inline Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+inline void Store(float* p, Float4 a) { _mm_storeu_ps(p, a); }
+inline Float4 Splat(float a) { return _mm_set1_ps(a); }
+inline Float4 Add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 Sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+inline Float4 Min(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+inline Float4 Max(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+inline Float4 Abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline Mask4 Greater(Float4 a, Float4 b) { return _mm_cmpgt_ps(a, b); }
+inline Mask4 And(Mask4 a, Mask4 b) { return _mm_and_ps(a, b); }
+inline Float4 Select(Mask4 mask, Float4 a, Float4 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+// Estimate refined by one Newton step
+inline Float4 Rsqrt(Float4 a) {
+  const Float4 e = _mm_rsqrt_ps(a);
+  return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), e),
+                    _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(a, e), e)));
+}
+#else
+struct Float4 {
+  float v[4];
+};
+struct Mask4 {
+  bool v[4];
+};
+
+#define TANGENT_LANES(expression) \
+  Float4 r;                       \
+  for (int i = 0; i < 4; i++) r.v[i] = (expression); \
+  return r;
+
+inline Float4 Load(const float* p) { TANGENT_LANES(p[i]) }
+inline void Store(float* p, Float4 a) { std::copy(a.v, a.v + 4, p); }
+inline Float4 Splat(float a) { TANGENT_LANES(a) }
+inline Float4 Add(Float4 a, Float4 b) { TANGENT_LANES(a.v[i] + b.v[i]) }
+inline Float4 Sub(Float4 a, Float4 b) { TANGENT_LANES(a.v[i] - b.v[i]) }
+inline Float4 Mul(Float4 a, Float4 b) { TANGENT_LANES(a.v[i] * b.v[i]) }
+inline Float4 Min(Float4 a, Float4 b) { TANGENT_LANES(std::min(a.v[i], b.v[i])) }
+inline Float4 Max(Float4 a, Float4 b) { TANGENT_LANES(std::max(a.v[i], b.v[i])) }
+inline Float4 Abs(Float4 a) { TANGENT_LANES(std::fabs(a.v[i])) }
+inline Float4 Select(Mask4 mask, Float4 a, Float4 b) { TANGENT_LANES(mask.v[i] ? a.v[i] : b.v[i]) }
+inline Float4 Rsqrt(Float4 a) { TANGENT_LANES(1.0f / std::sqrt(a.v[i])) }
+inline Mask4 Greater(Float4 a, Float4 b) {
+  Mask4 r;
+  for (int i = 0; i < 4; i++) r.v[i] = a.v[i] > b.v[i];
+  return r;
+}
+inline Mask4 And(Mask4 a, Mask4 b) {
+  Mask4 r;
+  for (int i = 0; i < 4; i++) r.v[i] = a.v[i] && b.v[i];
+  return r;
+}
+#undef TANGENT_LANES
+#endif
+
+struct Vec3x4 {
+  Float4 x, y, z;
+};
+
+inline Vec3x4 Sub(const Vec3x4& a, const Vec3x4& b) {
+  return {Sub(a.x, b.x), Sub(a.y, b.y), Sub(a.z, b.z)};
+}
+
+inline Vec3x4 Mul(const Vec3x4& a, Float4 s) {
+  return {Mul(a.x, s), Mul(a.y, s), Mul(a.z, s)};
+}
+
+inline Float4 Dot(const Vec3x4& a, const Vec3x4& b) {
+  return Add(Add(Mul(a.x, b.x), Mul(a.y, b.y)), Mul(a.z, b.z));
+}
+
+// a with its component along the unit vector n removed, then normalized. Zero vectors stay zero.
+inline Vec3x4 ProjectNormalize(const Vec3x4& a, const Vec3x4& n) {
+  const Vec3x4 projected = Sub(a, Mul(n, Dot(a, n)));
+  const Float4 lengthSquared = Dot(projected, projected);
+  const Float4 tiny = Splat(1e-30f);
+  const Float4 scale = Select(Greater(lengthSquared, tiny), Rsqrt(Max(lengthSquared, tiny)),
+                              Splat(0.0f));
+  return Mul(projected, scale);
+}
+
+// Abramowitz and Stegun 4.4.45, within 7e-5 radians, plenty for a weight
+inline Float4 Acos(Float4 x) {
+  x = Min(Max(x, Splat(-1.0f)), Splat(1.0f));
+  const Float4 a = Abs(x);
+  Float4 poly = Add(Mul(Splat(-0.0187293f), a), Splat(0.0742610f));
+  poly = Add(Mul(poly, a), Splat(-0.2121144f));
+  poly = Add(Mul(poly, a), Splat(1.5707288f));
+  const Float4 oneMinus = Sub(Splat(1.0f), a);
+  const Float4 root = Mul(oneMinus, Rsqrt(Max(oneMinus, Splat(1e-30f))));
+  const Float4 angle = Mul(root, poly);
+  return Select(Greater(Splat(0.0f), x), Sub(Splat(static_cast<float>(M_PI)), angle), angle);
+}
+
+// Vertex attributes the generator reads, one array per component
+struct VertexStreams {
+  std::vector<float> px, py, pz;
+  std::vector<float> nx, ny, nz;
+  std::vector<float> u, v;
+};
+
+// Weighted tangent of every triangle corner, corner k of triangle t is at k * stride + t. The
+// weight is the corner angle, negated when the triangle is mirrored in uv space and zero when it
+// has no usable tangent.
+struct CornerTangents {
+  size_t stride;
+  std::vector<float> x, y, z, weight;
+};
+
+// Corners of triangles [first, first + 4), first is a multiple of four. Lanes past the last
+// triangle read vertex 0 three times, which yields zero weights.
+void ProcessTriangles(const VertexStreams& streams, const uint32_t* indices,
+                      size_t triangleCount, uint32_t vertexBase, size_t first,
+                      CornerTangents* corners) {
+  // Gather the three corners of four triangles into lanes
+  alignas(16) float gathered[3][8][4];
+  for (int lane = 0; lane < 4; lane++) {
+    const size_t triangle = first + lane;
+    for (int k = 0; k < 3; k++) {
+      const uint32_t i = triangle < triangleCount ? indices[triangle * 3 + k] - vertexBase : 0;
+      gathered[k][0][lane] = streams.px[i];
+      gathered[k][1][lane] = streams.py[i];
+      gathered[k][2][lane] = streams.pz[i];
+      gathered[k][3][lane] = streams.nx[i];
+      gathered[k][4][lane] = streams.ny[i];
+      gathered[k][5][lane] = streams.nz[i];
+      gathered[k][6][lane] = streams.u[i];
+      gathered[k][7][lane] = streams.v[i];
+    }
+  }
+  Vec3x4 position[3], normal[3];
+  Float4 u[3], v[3];
+  for (int k = 0; k < 3; k++) {
+    position[k] = {Load(gathered[k][0]), Load(gathered[k][1]), Load(gathered[k][2])};
+    normal[k] = {Load(gathered[k][3]), Load(gathered[k][4]), Load(gathered[k][5])};
+    u[k] = Load(gathered[k][6]);
+    v[k] = Load(gathered[k][7]);
+  }
+
+  const Vec3x4 edge1 = Sub(position[1], position[0]);
+  const Vec3x4 edge2 = Sub(position[2], position[0]);
+  const Float4 du1 = Sub(u[1], u[0]), dv1 = Sub(v[1], v[0]);
+  const Float4 du2 = Sub(u[2], u[0]), dv2 = Sub(v[2], v[0]);
+
+  // Twice the signed uv area, its sign tells mirrored triangles apart
+  const Float4 area = Sub(Mul(du1, dv2), Mul(dv1, du2));
+  const Mask4 mappedArea = Greater(Abs(area), Splat(FLT_MIN));
+  const Float4 orientation = Select(Greater(area, Splat(0.0f)), Splat(1.0f), Splat(-1.0f));
+
+  // Direction of increasing u on the triangle, pointing along +u for mirrored triangles too
+  const Vec3x4 faceTangent = Mul(Sub(Mul(edge1, dv2), Mul(edge2, dv1)), orientation);
+
+  for (int k = 0; k < 3; k++) {
+    const Vec3x4& n = normal[k];
+    const Vec3x4 tangent = ProjectNormalize(faceTangent, n);
+    const Vec3x4 toNext = ProjectNormalize(Sub(position[(k + 1) % 3], position[k]), n);
+    const Vec3x4 toPrev = ProjectNormalize(Sub(position[(k + 2) % 3], position[k]), n);
+    const Float4 angle = Acos(Dot(toNext, toPrev));
+
+    const Mask4 valid = And(mappedArea, Greater(Dot(tangent, tangent), Splat(0.5f)));
+    const Float4 weight = Select(valid, angle, Splat(0.0f));
+    const size_t offset = k * corners->stride + first;
+    Store(&corners->x[offset], Mul(tangent.x, weight));
+    Store(&corners->y[offset], Mul(tangent.y, weight));
+    Store(&corners->z[offset], Mul(tangent.z, weight));
+    Store(&corners->weight[offset], Mul(weight, orientation));
+  }
+}
+
+// Any unit vector perpendicular to normal, for vertices no triangle gives a tangent
+glm::vec3 GetPerpendicular(const glm::vec3& normal) {
+  const glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                                    : glm::vec3(0.0f, 1.0f, 0.0f);
+  return glm::normalize(axis - normal * glm::dot(axis, normal));
+}
+
+} // anonymous namespace
+
+void GenerateTangents(MeshVertex* vertices, uint32_t vertexBase, uint32_t vertexCount,
+                      const uint32_t* indices, size_t indexCount, WorkerPool* workers) {
+  const size_t triangleCount = indexCount / 3;
+  MeshVertex* local = vertices + vertexBase;
+  auto parallelFor = [workers](size_t jobCount, const std::function<void(size_t)>& job) {
+    if (workers) {
+      workers->ParallelFor(jobCount, job);
+    } else {
+      for (size_t i = 0; i < jobCount; i++) {
+        job(i);
+      }
+    }
+  };
+
+  VertexStreams streams;
+  for (std::vector<float>* stream : {&streams.px, &streams.py, &streams.pz, &streams.nx,
+                                     &streams.ny, &streams.nz, &streams.u, &streams.v}) {
+    stream->resize(std::max(vertexCount, 1u));
+  }
+  const size_t vertexJobs = (vertexCount + kVerticesPerJob - 1) / kVerticesPerJob;
+  parallelFor(vertexJobs, [&](size_t job) {
+    const uint32_t end = std::min<uint32_t>((job + 1) * kVerticesPerJob, vertexCount);
+    for (uint32_t i = job * kVerticesPerJob; i < end; i++) {
+      streams.px[i] = local[i].pos.x;
+      streams.py[i] = local[i].pos.y;
+      streams.pz[i] = local[i].pos.z;
+      streams.nx[i] = local[i].normal.x;
+      streams.ny[i] = local[i].normal.y;
+      streams.nz[i] = local[i].normal.z;
+      streams.u[i] = local[i].uv.x;
+      streams.v[i] = local[i].uv.y;
+    }
+  });
+
+  CornerTangents corners;
+  corners.stride = (triangleCount + 3) & ~size_t(3);
+  corners.x.resize(corners.stride * 3);
+  corners.y.resize(corners.stride * 3);
+  corners.z.resize(corners.stride * 3);
+  corners.weight.resize(corners.stride * 3);
+  const size_t triangleJobs = (triangleCount + kTrianglesPerJob - 1) / kTrianglesPerJob;
+  parallelFor(triangleJobs, [&](size_t job) {
+    const size_t end = std::min((job + 1) * kTrianglesPerJob, corners.stride);
+    for (size_t first = job * kTrianglesPerJob; first < end; first += 4) {
+      ProcessTriangles(streams, indices, triangleCount, vertexBase, first, &corners);
+    }
+  });
+
+  // Corners around each vertex, so every vertex sums its own corners without sharing writes
+  std::vector<uint32_t> cornerStart(vertexCount + 1, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    cornerStart[indices[i] - vertexBase + 1]++;
+  }
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    cornerStart[i + 1] += cornerStart[i];
+  }
+  std::vector<uint32_t> vertexCorners(triangleCount * 3);
+  std::vector<uint32_t> fill(cornerStart.begin(), cornerStart.end() - 1);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (size_t k = 0; k < 3; k++) {
+      const uint32_t vertex = indices[t * 3 + k] - vertexBase;
+      vertexCorners[fill[vertex]++] = static_cast<uint32_t>(k * corners.stride + t);
+    }
+  }
+
+  parallelFor(vertexJobs, [&](size_t job) {
+    const uint32_t end = std::min<uint32_t>((job + 1) * kVerticesPerJob, vertexCount);
+    for (uint32_t i = job * kVerticesPerJob; i < end; i++) {
+      // Mirrored and unmirrored corners are summed apart, the heavier side wins
+      glm::vec3 sum[2] = {glm::vec3(0.0f), glm::vec3(0.0f)};
+      float weight[2] = {0.0f, 0.0f};
+      for (uint32_t c = cornerStart[i]; c < cornerStart[i + 1]; c++) {
+        const uint32_t corner = vertexCorners[c];
+        const float w = corners.weight[corner];
+        const int side = w < 0.0f ? 1 : 0;
+        sum[side] += glm::vec3(corners.x[corner], corners.y[corner], corners.z[corner]);
+        weight[side] += std::fabs(w);
+      }
+      const int side = weight[1] > weight[0] ? 1 : 0;
+
+      const glm::vec3& normal = local[i].normal;
+      glm::vec3 tangent = sum[side] - normal * glm::dot(sum[side], normal);
+      const float length = glm::length(tangent);
+      tangent = length > 1e-12f ? tangent / length : GetPerpendicular(normal);
+      local[i].tangent = glm::vec4(tangent, side == 1 ? -1.0f : 1.0f);
+    }
+  });
+}
+
+} // navs namespace
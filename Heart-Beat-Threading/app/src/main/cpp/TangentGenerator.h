@@ -0,0 +1,26 @@
+#ifndef __TANGENT_GENERATOR_HPP__
+#define __TANGENT_GENERATOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MeshData.h"
+
+class WorkerPool;
+
+// Tangent space for meshes that come without tangents, following MikkTSpace: every triangle's
+// tangent is the direction of increasing u, projected onto the plane of each corner's normal
+// and weighted by the corner angle. The bitangent sign comes from the winding of the triangle
+// in uv space. Unlike MikkTSpace no vertex is split, a vertex shared by mirrored and unmirrored
+// triangles takes the side with the larger total angle.
+
+namespace navs {
+
+// Fills tangent (xyz plus the bitangent sign in w) of vertices [vertexBase, vertexBase +
+// vertexCount) from the triangles in indices, which only reference that range. Triangles are
+// processed four at a time with SIMD, with a pool big meshes are split across its threads.
+void GenerateTangents(MeshVertex* vertices, uint32_t vertexBase, uint32_t vertexCount,
+                      const uint32_t* indices, size_t indexCount, WorkerPool* workers = nullptr);
+
+} // navs namespace
+#endif // __TANGENT_GENERATOR_HPP__
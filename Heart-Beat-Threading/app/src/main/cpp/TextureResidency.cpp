@@ -0,0 +1,655 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <gli/gli.hpp>
+
+#include "AssetIO.h"
+#include "AstcDecoder.h"
+#include "KtxFile.h"
+#include "MemoryTracker.h"
+#include "VulkanUtil.h"
+
+using namespace navs;
+
+// Mip levels this size and smaller stay resident once loaded
+static const uint32_t kTailExtent = 64;
+// First level of a first load: only the mip tail where the file can be read a level at a time
+static const uint32_t kMipTail = UINT32_MAX;
+
+static const VkImageUsageFlags kTrackedUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                               VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                               VK_IMAGE_USAGE_SAMPLED_BIT;
+
+TextureResidency::TextureResidency(VkPhysicalDevice pDevice, VkDevice lDevice, VkQueue queue,
+                                   uint32_t queueFamilyIndex, UploadQueue* uploadQueue,
+                                   DeletionQueue* deletionQueue, AssetStreamer* streamer,
+                                   WorkerPool* workers, VkDeviceSize budget) :
+    mPhysicalDevice(pDevice),
+    mLogicDevice(lDevice),
+    mQueue(queue),
+    mQueueFamilyIndex(queueFamilyIndex),
+    mUploadQueue(uploadQueue),
+    mDeletionQueue(deletionQueue),
+    mStreamer(streamer),
+    mWorkers(workers),
+    mBudget(budget)
+{
+  VkCommandPoolCreateInfo cmdPoolCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = mQueueFamilyIndex,
+  };
+  CALL_VK(vkCreateCommandPool(mLogicDevice, &cmdPoolCreateInfo, nullptr, &mCommandPool));
+}
+
+TextureResidency::~TextureResidency() {
+  for (Entry& entry : mEntries) {
+    DeleteTexture(&entry.texture);
+  }
+  // Eviction copies free their command buffers through the deletion queue, the pool goes last
+  VkCommandPool pool = mCommandPool;
+  mDeletionQueue->Push([pool](VkDevice device) {
+    vkDestroyCommandPool(device, pool, nullptr);
+  });
+}
+
+uint32_t TextureResidency::Request(const std::string& path, VkFormat format,
+                                   const uint8_t placeholder[4]) {
+  auto found = mIds.find(path);
+  if (found != mIds.end()) {
+    return found->second;
+  }
+
+  const uint32_t id = static_cast<uint32_t>(mEntries.size());
+  Entry entry = {};
+  entry.path = path;
+  entry.fileFormat = format;
+  entry.format = format;
+
+  // Check for optimal tiling supportability, ASTC falls back to decoding on the CPU
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, format, &props);
+  if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) &&
+      IsAstcFormat(format)) {
+    entry.format = static_cast<VkFormat>(GetAstcDecodedFormat(format));
+    vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, entry.format, &props);
+    LOGW("%s: ASTC can't be sampled, decoding it to RGBA8", path.c_str());
+  }
+  assert(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+  CreateSolidTexture(placeholder, &entry.texture);
+  mEntries.push_back(entry);
+  mIds[path] = id;
+
+  StreamLevels(id, kMipTail, 0);
+  return id;
+}
+
+void TextureResidency::Touch(uint32_t id, uint64_t frame) {
+  Entry& entry = mEntries[id];
+  entry.lastUsed = frame;
+  if (!entry.loading && !entry.imageBytes.empty() && entry.firstLevel == 0) {
+    mStats.hits++;
+  } else {
+    mStats.misses++;
+  }
+}
+
+bool TextureResidency::Update(uint64_t frame) {
+  // Loads that arrived may have taken the textures over budget, anything can go then
+  MakeRoom(0, UINT64_MAX);
+
+  for (uint32_t id = 0; id < mEntries.size(); id++) {
+    Entry& entry = mEntries[id];
+    if (entry.lastUsed != frame || entry.loading || entry.failed || entry.imageBytes.empty() ||
+        entry.firstLevel == 0) {
+      continue;
+    }
+    // As many levels as fit, the old image is counted until the new one replaces it
+    for (uint32_t level = 0; level < entry.firstLevel; level++) {
+      if (MakeRoom(entry.imageBytes[level], frame)) {
+        StreamLevels(id, level, entry.imageBytes[level]);
+        break;
+      }
+    }
+  }
+
+  const bool changed = mChanged;
+  mChanged = false;
+  return changed;
+}
+
+void TextureResidency::LogStats(void) const {
+  const uint64_t uses = mStats.hits + mStats.misses;
+  LOGI("Textures: %zu tracked, %.2f of %.2f MB resident", mEntries.size(),
+       mResidentBytes / (1024.0 * 1024.0), mBudget / (1024.0 * 1024.0));
+  LOGI("Textures: %llu hits, %llu misses (%.1f%% hit), %llu mip levels evicted (%.2f MB), "
+       "%llu reloads", (unsigned long long)mStats.hits, (unsigned long long)mStats.misses,
+       uses ? 100.0 * mStats.hits / uses : 0.0, (unsigned long long)mStats.evictions,
+       mStats.evictedBytes / (1024.0 * 1024.0), (unsigned long long)mStats.reloads);
+}
+
+static uint32_t GetTailLevel(uint32_t width, uint32_t height, uint32_t levelCount) {
+  for (uint32_t i = 0; i < levelCount; i++) {
+    if (std::max(width >> i, height >> i) <= kTailExtent) {
+      return i;
+    }
+  }
+  return levelCount - 1;
+}
+
+// Appends the copy of a level of size bytes, split into bands of whole block rows when it is
+// larger than maxSize. Only the formats KtxFile knows the blocks of can be split.
+static void AddLevelRegions(const VkBufferImageCopy& level, VkDeviceSize size, VkFormat format,
+                            VkDeviceSize maxSize, std::vector<VkBufferImageCopy>* regions) {
+  uint32_t blockWidth = 1, blockHeight = 1, blockBytes = 1;
+  if (size <= maxSize || !GetKtxBlockInfo(format, &blockWidth, &blockHeight, &blockBytes)) {
+    regions->push_back(level);
+    return;
+  }
+  const uint32_t blockRows = (level.imageExtent.height + blockHeight - 1) / blockHeight;
+  const VkDeviceSize rowSize = size / blockRows;
+  const uint32_t bandRows = static_cast<uint32_t>(std::max<VkDeviceSize>(1, maxSize / rowSize));
+
+  for (uint32_t row = 0; row < blockRows; row += bandRows) {
+    VkBufferImageCopy band = level;
+    band.bufferOffset = level.bufferOffset + row * rowSize;
+    band.imageOffset.y = row * blockHeight;
+    band.imageExtent.height = std::min(bandRows * blockHeight,
+                                       level.imageExtent.height - band.imageOffset.y);
+    regions->push_back(band);
+  }
+}
+
+// Loads levels from load->firstLevel down into a new image, on the streaming thread
+bool TextureResidency::LoadLevels(const std::string& path, Load* load) {
+  Texture* texture = &load->texture;
+
+  // Map the file, both paths below read straight out of the mapping. KTX2 levels are read on
+  // their own, smallest first.
+  const bool ktx2 = path.size() > 5 && path.compare(path.size() - 5, 5, ".ktx2") == 0;
+  AssetView file;
+  if (!OpenAsset(path.c_str(), &file, ktx2 ? ASSET_ACCESS_RANDOM : ASSET_ACCESS_SEQUENTIAL)) {
+    LOGE("Failed to open %s", path.c_str());
+    return false;
+  }
+  bool levelsLoaded = IsKtx2(file.data(), file.size()) ? LoadKtx2Levels(file, load)
+                                                       : LoadGliLevels(file, load);
+  file.Close();
+  if (!levelsLoaded) {
+    LOGE("Failed to load %s", path.c_str());
+    return false;
+  }
+
+  texture->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  CreateView(texture);
+  return true;
+}
+
+// Uploads every level on its own straight from the file, or from its decompressed or decoded
+// contents, so each is staged once read
+bool TextureResidency::LoadKtx2Levels(const AssetView& file, Load* load) {
+  Texture* texture = &load->texture;
+  KtxTexture ktx;
+  if (!ReadKtx2(file.data(), file.size(), &ktx) ||
+      ktx.vkFormat != static_cast<uint32_t>(load->fileFormat)) {
+    return false;
+  }
+  const bool decode = load->fileFormat != texture->format;
+
+  load->levelCount = static_cast<uint32_t>(ktx.levels.size());
+  load->width = ktx.width;
+  load->height = ktx.height;
+  load->tailLevel = GetTailLevel(ktx.width, ktx.height, load->levelCount);
+  if (load->firstLevel == kMipTail) {
+    load->firstLevel = load->tailLevel;
+  }
+  const uint32_t firstLevel = load->firstLevel;
+  assert(firstLevel <= load->tailLevel);
+
+  texture->width = ktx.levels[firstLevel].width;
+  texture->height = ktx.levels[firstLevel].height;
+  texture->mipLevels = load->levelCount - firstLevel;
+  load->bytes = CreateImage(texture, kTrackedUsage);
+
+  std::vector<uint8_t> storage;
+  std::vector<uint8_t> decoded;
+  for (uint32_t i = load->levelCount; i-- > firstLevel;) {
+    // Levels staged so far are copied anyway, the image goes once they have been
+    const uint8_t* level = GetKtxLevel(file.data(), ktx, i, &storage);
+    if (level == nullptr) {
+      return false;
+    }
+    VkDeviceSize size = ktx.levels[i].uncompressedSize;
+    if (decode) {
+      decoded.resize(4 * size_t(ktx.levels[i].width) * ktx.levels[i].height);
+      if (!DecodeAstc(load->fileFormat, level, ktx.levels[i].width, ktx.levels[i].height,
+                      decoded.data(), mWorkers)) {
+        LOGE("Failed to decode ASTC level %u", i);
+        return false;
+      }
+      level = decoded.data();
+      size = decoded.size();
+    }
+    const VkBufferImageCopy region = {
+        .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .imageSubresource.mipLevel = i - firstLevel,
+        .imageSubresource.baseArrayLayer = 0,
+        .imageSubresource.layerCount = 1,
+        .imageExtent.width = ktx.levels[i].width,
+        .imageExtent.height = ktx.levels[i].height,
+        .imageExtent.depth = 1,
+        .bufferOffset = 0,
+    };
+    std::vector<VkBufferImageCopy> regions;
+    AddLevelRegions(region, size, texture->format, mUploadQueue->GetMaxRegionSize(), &regions);
+    mUploadQueue->UploadImage(texture->image, level, size, regions);
+  }
+  return true;
+}
+
+// Decodes the whole file with gli, then uploads the levels from firstLevel on in one go
+bool TextureResidency::LoadGliLevels(const AssetView& file, Load* load) {
+  Texture* texture = &load->texture;
+  const bool decode = load->fileFormat != texture->format;
+  gli::texture2d imageData(gli::load(reinterpret_cast<const char*>(file.data()), file.size()));
+  if (imageData.empty()) {
+    return false;
+  }
+  TrackHostAllocation(MEMORY_CATEGORY_TEXTURE, imageData.size());
+
+  load->levelCount = static_cast<uint32_t>(imageData.levels());
+  load->width = static_cast<uint32_t>(imageData[0].extent().x);
+  load->height = static_cast<uint32_t>(imageData[0].extent().y);
+  load->tailLevel = GetTailLevel(load->width, load->height, load->levelCount);
+  if (load->firstLevel == kMipTail) {
+    load->firstLevel = 0;
+  }
+  const uint32_t firstLevel = load->firstLevel;
+  assert(firstLevel <= load->tailLevel);
+
+  texture->width = static_cast<uint32_t>(imageData[firstLevel].extent().x);
+  texture->height = static_cast<uint32_t>(imageData[firstLevel].extent().y);
+  texture->mipLevels = load->levelCount - firstLevel;
+
+  // Setup buffer copy regions for each mip level from firstLevel on, of the RGBA8 levels in
+  // decoded if the device can't sample the file's format. Levels too large to stage at once
+  // are copied in bands.
+  std::vector<VkBufferImageCopy> bufferCopyRegions;
+  std::vector<uint8_t> decoded;
+  size_t skipped = 0;
+  uint32_t offset = 0;
+
+  for (uint32_t i = 0; i < load->levelCount; i++) {
+    if (i < firstLevel) {
+      skipped += imageData[i].size();
+      continue;
+    }
+    VkBufferImageCopy bufferCopyRegion = {
+        .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .imageSubresource.mipLevel = i - firstLevel,
+        .imageSubresource.baseArrayLayer = 0,
+        .imageSubresource.layerCount = 1,
+        .imageExtent.width = static_cast<uint32_t>(imageData[i].extent().x),
+        .imageExtent.height = static_cast<uint32_t>(imageData[i].extent().y),
+        .imageExtent.depth = 1,
+        .bufferOffset = offset,
+    };
+
+    uint32_t size = static_cast<uint32_t>(imageData[i].size());
+    if (decode) {
+      const uint32_t width = bufferCopyRegion.imageExtent.width;
+      const uint32_t height = bufferCopyRegion.imageExtent.height;
+      size = 4 * width * height;
+      decoded.resize(offset + size);
+      if (!DecodeAstc(load->fileFormat, static_cast<const uint8_t*>(imageData[i].data()), width,
+                      height, decoded.data() + offset, mWorkers)) {
+        LOGE("Failed to decode ASTC level %u", i);
+        UntrackHostAllocation(MEMORY_CATEGORY_TEXTURE, imageData.size());
+        return false;
+      }
+    }
+    AddLevelRegions(bufferCopyRegion, size, texture->format, mUploadQueue->GetMaxRegionSize(),
+                    &bufferCopyRegions);
+    offset += size;
+  }
+
+  load->bytes = CreateImage(texture, kTrackedUsage);
+
+  // Stage the levels in the shared ring, the copy and the transition to shader read go out
+  // with the next batch submitted by the upload queue
+  if (decode) {
+    mUploadQueue->UploadImage(texture->image, decoded.data(), decoded.size(), bufferCopyRegions);
+  } else {
+    mUploadQueue->UploadImage(texture->image, static_cast<uint8_t*>(imageData.data()) + skipped,
+                              imageData.size() - skipped, bufferCopyRegions);
+  }
+
+  UntrackHostAllocation(MEMORY_CATEGORY_TEXTURE, imageData.size());
+  return true;
+}
+
+// Streams the texture in from firstLevel on, bytes are reserved for its image until then
+void TextureResidency::StreamLevels(uint32_t id, uint32_t firstLevel, VkDeviceSize bytes) {
+  Entry& entry = mEntries[id];
+  entry.loading = true;
+  entry.loadingBytes = bytes;
+  mResidentBytes += bytes;
+
+  Load* load = new Load();
+  load->texture.type = VK_IMAGE_TYPE_2D;
+  load->texture.format = entry.format;
+  load->fileFormat = entry.fileFormat;
+  load->firstLevel = firstLevel;
+  const std::string path = entry.path;
+  mStreamer->Request(path.c_str(), [=]() {
+    return LoadLevels(path, load);
+  }, [=]() {
+    Entry& loaded = mEntries[id];
+    const bool reload = !loaded.imageBytes.empty();
+    if (!reload) {
+      // Image sizes of every level the texture may start at, for the budget
+      loaded.width = load->width;
+      loaded.height = load->height;
+      loaded.levelCount = load->levelCount;
+      loaded.tailLevel = load->tailLevel;
+      for (uint32_t level = 0; level <= loaded.tailLevel; level++) {
+        loaded.imageBytes.push_back(GetImageBytes(loaded, level));
+      }
+    }
+    mResidentBytes += load->bytes - loaded.bytes - loaded.loadingBytes;
+    DeleteTexture(&loaded.texture);
+    loaded.texture = load->texture;
+    loaded.bytes = load->bytes;
+    loaded.firstLevel = load->firstLevel;
+    loaded.loading = false;
+    loaded.loadingBytes = 0;
+    mStats.reloads += reload ? 1 : 0;
+    mChanged = true;
+    delete load;
+  }, [=]() {
+    // Failed, or the streamer went first; the texture keeps what it had either way
+    Entry& dropped = mEntries[id];
+    mResidentBytes -= dropped.loadingBytes;
+    dropped.loading = false;
+    dropped.loadingBytes = 0;
+    dropped.failed = true;
+    DeleteTexture(&load->texture);
+    delete load;
+  });
+}
+
+// Replaces the texture's image by one starting at firstLevel, the levels it keeps are copied
+// over on the graphics queue ahead of the next frame
+void TextureResidency::EvictLevels(Entry* entry, uint32_t firstLevel) {
+  assert(firstLevel > entry->firstLevel && firstLevel <= entry->tailLevel);
+  Texture* old = &entry->texture;
+  Texture texture = *old;
+  texture.width = std::max(1u, entry->width >> firstLevel);
+  texture.height = std::max(1u, entry->height >> firstLevel);
+  texture.mipLevels = entry->levelCount - firstLevel;
+  const VkDeviceSize bytes = CreateImage(&texture, kTrackedUsage);
+  const uint32_t skipped = firstLevel - entry->firstLevel;
+
+  VkCommandBufferAllocateInfo cmdAllocInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = mCommandPool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VkCommandBuffer cmdBuffer;
+  CALL_VK(vkAllocateCommandBuffers(mLogicDevice, &cmdAllocInfo, &cmdBuffer));
+  VkCommandBufferBeginInfo cmdBeginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
+  CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+
+  VkImageMemoryBarrier barriers[2] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .pNext = nullptr,
+          .srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+          .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = old->image,
+          .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, skipped, texture.mipLevels, 0, 1},
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .pNext = nullptr,
+          .srcAccessMask = 0,
+          .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = texture.image,
+          .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1},
+      },
+  };
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+  std::vector<VkImageCopy> regions(texture.mipLevels);
+  for (uint32_t i = 0; i < texture.mipLevels; i++) {
+    regions[i] = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, skipped + i, 0, 1},
+        .srcOffset = {0, 0, 0},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+        .dstOffset = {0, 0, 0},
+        .extent = {std::max(1u, texture.width >> i), std::max(1u, texture.height >> i), 1},
+    };
+  }
+  vkCmdCopyImage(cmdBuffer, old->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()),
+                 regions.data());
+
+  barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                       &barriers[1]);
+  CALL_VK(vkEndCommandBuffer(cmdBuffer));
+
+  // Runs before the frame submitted next on the same queue, which the barrier orders it with
+  VkSubmitInfo submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = nullptr,
+      .pWaitDstStageMask = nullptr,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &cmdBuffer,
+      .signalSemaphoreCount = 0,
+      .pSignalSemaphores = nullptr,
+  };
+  CALL_VK(vkQueueSubmit(mQueue, 1, &submitInfo, VK_NULL_HANDLE));
+  VkCommandPool pool = mCommandPool;
+  mDeletionQueue->Push([pool, cmdBuffer](VkDevice device) {
+    vkFreeCommandBuffers(device, pool, 1, &cmdBuffer);
+  });
+
+  mStats.evictions += skipped;
+  mStats.evictedBytes += entry->bytes - bytes;
+  mResidentBytes -= entry->bytes - bytes;
+
+  DeleteTexture(old);
+  CreateView(&texture);
+  entry->texture = texture;
+  entry->bytes = bytes;
+  entry->firstLevel = firstLevel;
+  mChanged = true;
+}
+
+bool TextureResidency::MakeRoom(VkDeviceSize bytes, uint64_t usedFrame) {
+  while (mResidentBytes + bytes > mBudget) {
+    Entry* victim = nullptr;
+    for (Entry& entry : mEntries) {
+      if (entry.loading || entry.imageBytes.empty() || entry.firstLevel >= entry.tailLevel ||
+          entry.lastUsed >= usedFrame) {
+        continue;
+      }
+      if (victim == nullptr || entry.lastUsed < victim->lastUsed) {
+        victim = &entry;
+      }
+    }
+    if (victim == nullptr) {
+      return false;
+    }
+
+    // Drop as many of its levels as it takes in one copy, down to the tail at most
+    const VkDeviceSize others = mResidentBytes - victim->bytes;
+    uint32_t level = victim->firstLevel + 1;
+    while (level < victim->tailLevel && others + victim->imageBytes[level] + bytes > mBudget) {
+      level++;
+    }
+    EvictLevels(victim, level);
+  }
+  return true;
+}
+
+// Device memory of the entry's image if it started at firstLevel, from an image never bound
+VkDeviceSize TextureResidency::GetImageBytes(const Entry& entry, uint32_t firstLevel) {
+  Texture texture = {};
+  texture.type = VK_IMAGE_TYPE_2D;
+  texture.format = entry.format;
+  texture.width = std::max(1u, entry.width >> firstLevel);
+  texture.height = std::max(1u, entry.height >> firstLevel);
+  texture.mipLevels = entry.levelCount - firstLevel;
+  VkImageCreateInfo imageCreateInfo = GetImageCreateInfo(texture, kTrackedUsage);
+
+  VkImage image;
+  CALL_VK(vkCreateImage(mLogicDevice, &imageCreateInfo, nullptr, &image));
+  VkMemoryRequirements memReqs;
+  vkGetImageMemoryRequirements(mLogicDevice, image, &memReqs);
+  vkDestroyImage(mLogicDevice, image, nullptr);
+  return memReqs.size;
+}
+
+VkImageCreateInfo TextureResidency::GetImageCreateInfo(const Texture& texture,
+                                                       VkImageUsageFlags usage) const {
+  return VkImageCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .pNext = nullptr,
+      .imageType = texture.type,
+      .format = texture.format,
+      .extent = {texture.width, texture.height, 1},
+      .mipLevels = texture.mipLevels,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 1,
+      .pQueueFamilyIndices = &mQueueFamilyIndex,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .flags = 0,
+  };
+}
+
+// Device local, optimal tiled image and memory for the size, format and mip levels in texture
+VkDeviceSize TextureResidency::CreateImage(Texture* texture, VkImageUsageFlags usage) {
+  VkImageCreateInfo imageCreateInfo = GetImageCreateInfo(*texture, usage);
+  CALL_VK(vkCreateImage(mLogicDevice, &imageCreateInfo, nullptr, &texture->image));
+
+  VkMemoryRequirements memReqs;
+  vkGetImageMemoryRequirements(mLogicDevice, texture->image, &memReqs);
+
+  VkMemoryAllocateInfo memAllocInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .allocationSize = memReqs.size,
+      .memoryTypeIndex = 0,
+  };
+  assert(MapMemoryTypeToIndex(mPhysicalDevice, memReqs.memoryTypeBits,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAllocInfo.memoryTypeIndex));
+
+  CALL_VK(AllocateTrackedMemory(mLogicDevice, &memAllocInfo, MEMORY_CATEGORY_TEXTURE,
+                                &texture->memory));
+  CALL_VK(vkBindImageMemory(mLogicDevice, texture->image, texture->memory, 0));
+  return memReqs.size;
+}
+
+// Sampler and view the shaders read texture through
+void TextureResidency::CreateView(Texture* texture) {
+  const VkSamplerCreateInfo sampler = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .pNext = nullptr,
+      .magFilter = VK_FILTER_NEAREST,
+      .minFilter = VK_FILTER_NEAREST,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .mipLodBias = 0.0f,
+      .maxAnisotropy = 1,
+      .compareOp = VK_COMPARE_OP_NEVER,
+      .minLod = 0.0f,
+      .maxLod = (float)texture->mipLevels,
+      .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+      .unnormalizedCoordinates = VK_FALSE,
+  };
+  CALL_VK(vkCreateSampler(mLogicDevice, &sampler, nullptr, &texture->sampler));
+
+  VkImageViewCreateInfo view = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .pNext = nullptr,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = texture->format,
+      .components =
+          {
+              VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+              VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A,
+          },
+      .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mipLevels, 0, 1},
+      .flags = 0,
+      .image = texture->image,
+  };
+
+  CALL_VK(vkCreateImageView(mLogicDevice, &view, nullptr, &texture->view));
+}
+
+void TextureResidency::CreateSolidTexture(const uint8_t texel[4], Texture* texture) {
+  texture->type = VK_IMAGE_TYPE_2D;
+  texture->format = VK_FORMAT_R8G8B8A8_UNORM;
+  texture->width = 1;
+  texture->height = 1;
+  texture->mipLevels = 1;
+  CreateImage(texture, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+  const std::vector<VkBufferImageCopy> region = {{
+      .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .imageSubresource.mipLevel = 0,
+      .imageSubresource.baseArrayLayer = 0,
+      .imageSubresource.layerCount = 1,
+      .imageExtent.width = 1,
+      .imageExtent.height = 1,
+      .imageExtent.depth = 1,
+      .bufferOffset = 0,
+  }};
+  mUploadQueue->UploadImage(texture->image, texel, 4, region);
+  texture->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  CreateView(texture);
+}
+
+void TextureResidency::DeleteTexture(Texture* texture) {
+  mDeletionQueue->DestroySampler(texture->sampler);
+  mDeletionQueue->DestroyImageView(texture->view);
+  mDeletionQueue->DestroyImage(texture->image);
+  mDeletionQueue->FreeMemory(texture->memory);
+  texture->sampler = VK_NULL_HANDLE;
+  texture->view = VK_NULL_HANDLE;
+  texture->image = VK_NULL_HANDLE;
+  texture->memory = VK_NULL_HANDLE;
+}
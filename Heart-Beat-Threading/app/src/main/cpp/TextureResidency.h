@@ -0,0 +1,167 @@
+#ifndef __TEXTURE_RESIDENCY_HPP__
+#define __TEXTURE_RESIDENCY_HPP__
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan_wrapper.h"
+#include "AssetIO.h"
+#include "AssetStreamer.h"
+#include "DeletionQueue.h"
+#include "UploadQueue.h"
+
+class WorkerPool;
+
+struct Texture {
+  VkSampler sampler;
+  VkImage image;
+  VkImageLayout layout;
+  VkDeviceMemory memory;
+  VkImageView view;
+  VkImageType type;
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipLevels;
+  uint32_t layerCount;
+};
+
+// Owns every texture loaded from a file, tracked by asset path, and keeps the device memory
+// they use under a budget. A texture is resident from some mip level down to its smallest one.
+// When the budget is exceeded the textures used least recently lose their largest levels, the
+// image is recreated without them and the remaining levels are copied over on the GPU. A
+// texture used again with levels missing has them reloaded from its file on the streaming
+// thread, as far as the budget allows without evicting anything used that frame. KTX2 files
+// first load only their mip tail, a few kilobytes, and fill in the rest the same way. ASTC
+// textures the device can't sample are decoded to RGBA8 as they load, split across workers.
+//
+// The public interface runs on the render thread, between frames, and so do the publish and
+// discard callbacks of every load, the only places loads touch mEntries and the budget. The
+// loads themselves, LoadLevels() and what it calls, run on the streaming thread. They only fill
+// in their own Load and may use what is safe to share: CreateImage() and CreateView() on the
+// device, mUploadQueue, mWorkers (reserved for the streaming thread) and the memory tracker.
+// Nothing guards mEntries, mIds, mStats, mBudget or mResidentBytes, they must not touch those.
+class TextureResidency {
+ public:
+  struct Stats {
+    // Uses that found every mip level resident, and those that didn't
+    uint64_t hits;
+    uint64_t misses;
+    // Mip levels evicted and the device memory that freed
+    uint64_t evictions;
+    uint64_t evictedBytes;
+    uint64_t reloads;
+  };
+
+  // queue and queueFamilyIndex are the graphics queue textures are sampled on. workers decode
+  // on the streaming thread and must not be used by any other thread meanwhile.
+  TextureResidency(VkPhysicalDevice pDevice, VkDevice lDevice, VkQueue queue,
+                   uint32_t queueFamilyIndex, UploadQueue* uploadQueue,
+                   DeletionQueue* deletionQueue, AssetStreamer* streamer, WorkerPool* workers,
+                   VkDeviceSize budget);
+  ~TextureResidency();
+
+  // Returns the id of the texture at path, streaming it in on first request. It is a single
+  // texel of placeholder until then. format is that of the file, the texture's own may differ.
+  uint32_t Request(const std::string& path, VkFormat format, const uint8_t placeholder[4]);
+
+  // Stays valid until the next Update()
+  const Texture& Get(uint32_t id) const { return mEntries[id].texture; }
+
+  // Marks the texture as used by frame
+  void Touch(uint32_t id, uint64_t frame);
+
+  // Evicts down to the budget and starts reloads for textures used in frame. Returns true when
+  // any texture was replaced since the last call, descriptors referring to it must be rewritten.
+  bool Update(uint64_t frame);
+
+  void SetBudget(VkDeviceSize budget) { mBudget = budget; }
+  VkDeviceSize GetBudget(void) const { return mBudget; }
+  VkDeviceSize ResidentBytes(void) const { return mResidentBytes; }
+  const Stats& GetStats(void) const { return mStats; }
+  void LogStats(void) const;
+
+  // Untracked textures, e.g. placeholders, uploaded with the next batch
+  void CreateSolidTexture(const uint8_t texel[4], Texture* texture);
+  // Releases the texture once the current frame has retired
+  void DeleteTexture(Texture* texture);
+
+ private:
+  struct Entry {
+    std::string path;
+    // Of the file, and of the image: RGBA8 when decoded from an ASTC format the device lacks
+    VkFormat fileFormat;
+    VkFormat format;
+    // Of the file, known once it has loaded
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    // Levels from here on are the mip tail, small enough to always keep
+    uint32_t tailLevel;
+    // Device memory of an image starting at each level up to the tail, empty until loaded
+    std::vector<VkDeviceSize> imageBytes;
+
+    // A placeholder until loaded, the levels from firstLevel to the smallest one after that
+    Texture texture;
+    uint32_t firstLevel;
+    // Device memory of texture's image, 0 for the placeholder
+    VkDeviceSize bytes;
+    uint64_t lastUsed;
+    // A load is streaming, its image replaces texture once published
+    bool loading;
+    VkDeviceSize loadingBytes;
+    // A load failed, texture stays what it is
+    bool failed;
+  };
+
+  // What the streaming thread loaded of a file
+  struct Load {
+    Texture texture;
+    VkFormat fileFormat;
+    VkDeviceSize bytes;
+    uint32_t firstLevel;
+    // Of the file
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t tailLevel;
+  };
+
+  // Streaming thread only, see above. False, with the reason logged, when the file can't be
+  // read.
+  bool LoadLevels(const std::string& path, Load* load);
+  bool LoadKtx2Levels(const AssetView& file, Load* load);
+  bool LoadGliLevels(const AssetView& file, Load* load);
+  void StreamLevels(uint32_t id, uint32_t firstLevel, VkDeviceSize bytes);
+  void EvictLevels(Entry* entry, uint32_t firstLevel);
+  // Evicts least recently used levels of textures not used since usedFrame until bytes more
+  // fit the budget. False when that wasn't enough.
+  bool MakeRoom(VkDeviceSize bytes, uint64_t usedFrame);
+  VkDeviceSize GetImageBytes(const Entry& entry, uint32_t firstLevel);
+
+  VkImageCreateInfo GetImageCreateInfo(const Texture& texture, VkImageUsageFlags usage) const;
+  // Returns the size of the memory bound to the image
+  VkDeviceSize CreateImage(Texture* texture, VkImageUsageFlags usage);
+  void CreateView(Texture* texture);
+
+  VkPhysicalDevice mPhysicalDevice;
+  VkDevice mLogicDevice;
+  VkQueue mQueue;
+  uint32_t mQueueFamilyIndex;
+  VkCommandPool mCommandPool;
+  UploadQueue* mUploadQueue;
+  DeletionQueue* mDeletionQueue;
+  AssetStreamer* mStreamer;
+  WorkerPool* mWorkers;
+
+  std::vector<Entry> mEntries;
+  std::unordered_map<std::string, uint32_t> mIds;
+  VkDeviceSize mBudget;
+  // Of loaded textures, plus the images of loads still streaming
+  VkDeviceSize mResidentBytes = 0;
+  bool mChanged = false;
+  Stats mStats = {};
+};
+
+#endif // __TEXTURE_RESIDENCY_HPP__
@@ -0,0 +1,470 @@
+#include "UploadQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "VulkanUtil.h"
+#include "MemoryTracker.h"
+
+using namespace navs;
+
+// Stages and accesses that may read what was uploaded
+static const VkPipelineStageFlags kReadStages =
+    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+static const VkAccessFlags kBufferReadAccess =
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+    VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+// Drops level from the ends of range when exclude is set, false if nothing is left
+static bool ExcludeLevel(VkImageSubresourceRange* range, bool exclude, uint32_t level) {
+  if (!exclude) {
+    return true;
+  }
+  if (level == range->baseMipLevel) {
+    range->baseMipLevel++;
+  }
+  range->levelCount--;
+  return range->levelCount > 0;
+}
+
+UploadQueue::UploadQueue(VkPhysicalDevice pDevice, VkDevice lDevice, VkQueue transferQueue,
+                         uint32_t transferFamilyIndex, VkQueue graphicsQueue,
+                         uint32_t graphicsFamilyIndex, VkDeviceSize ringSize) :
+    mLogicDevice(lDevice),
+    mTransferQueue(transferQueue),
+    mTransferFamily(transferFamilyIndex),
+    mGraphicsQueue(graphicsQueue),
+    mGraphicsFamily(graphicsFamilyIndex),
+    mRingSize(ringSize),
+    mOwnerThread(std::this_thread::get_id())
+{
+  VkCommandPoolCreateInfo cmdPoolCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = mTransferFamily,
+  };
+  CALL_VK(vkCreateCommandPool(mLogicDevice, &cmdPoolCreateInfo, nullptr, &mCommandPool));
+  if (HasTransferQueue()) {
+    cmdPoolCreateInfo.queueFamilyIndex = mGraphicsFamily;
+    CALL_VK(vkCreateCommandPool(mLogicDevice, &cmdPoolCreateInfo, nullptr, &mAcquirePool));
+  }
+  LOGI("UploadQueue: copies run on %s", HasTransferQueue() ? "a dedicated transfer queue"
+                                                           : "the graphics queue");
+
+  // Copy offsets must respect the device preference and the largest compressed block size
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(pDevice, &properties);
+  mAlignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+
+  VkBufferCreateInfo bufferCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .size = mRingSize,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      .flags = 0,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .pQueueFamilyIndices = &mTransferFamily,
+      .queueFamilyIndexCount = 1,
+  };
+  CALL_VK(vkCreateBuffer(mLogicDevice, &bufferCreateInfo, nullptr, &mRingBuffer));
+
+  VkMemoryRequirements memReq;
+  vkGetBufferMemoryRequirements(mLogicDevice, mRingBuffer, &memReq);
+
+  VkMemoryAllocateInfo memAllocInfo{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .allocationSize = memReq.size,
+      .memoryTypeIndex = 0,
+  };
+  assert(MapMemoryTypeToIndex(pDevice, memReq.memoryTypeBits,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &memAllocInfo.memoryTypeIndex));
+  CALL_VK(AllocateTrackedMemory(mLogicDevice, &memAllocInfo, MEMORY_CATEGORY_STAGING, &mRingMemory));
+  CALL_VK(vkBindBufferMemory(mLogicDevice, mRingBuffer, mRingMemory, 0));
+
+  // Mapped for the whole lifetime of the queue
+  CALL_VK(vkMapMemory(mLogicDevice, mRingMemory, 0, mRingSize, 0, (void**)&mRingData));
+}
+
+UploadQueue::~UploadQueue() {
+  Flush();
+
+  vkUnmapMemory(mLogicDevice, mRingMemory);
+  vkDestroyBuffer(mLogicDevice, mRingBuffer, nullptr);
+  FreeTrackedMemory(mLogicDevice, mRingMemory);
+  vkDestroyCommandPool(mLogicDevice, mCommandPool, nullptr);
+  if (mAcquirePool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(mLogicDevice, mAcquirePool, nullptr);
+  }
+}
+
+// Returns the physical ring offset of size free bytes, waiting on the GPU if the ring is full
+VkDeviceSize UploadQueue::Allocate(VkDeviceSize size, std::unique_lock<std::mutex>& lock) {
+  assert(size <= mRingSize);
+
+  while (true) {
+    VkDeviceSize start = (mHead + mAlignment - 1) / mAlignment * mAlignment;
+    // An allocation never straddles the end of the ring, skip ahead to the start instead
+    if (start % mRingSize + size > mRingSize) {
+      start = (start / mRingSize + 1) * mRingSize;
+    }
+    if (start + size - mTail <= mRingSize) {
+      mHead = start + size;
+      return start % mRingSize;
+    }
+
+    // Out of space. Wait for the oldest submission first, the queued copies only have to go
+    // out once nothing older is left to retire. Only the owner waits on the fence, holding the
+    // lock for a whole batch would stall its Submit() and Collect().
+    if (!mInFlight.empty() && std::this_thread::get_id() == mOwnerThread) {
+      WaitOldest();
+    } else if (!mInFlight.empty()) {
+      const uint64_t retired = mSubmitCount - mInFlight.size();
+      mRetired.wait(lock, [&]() { return mSubmitCount - mInFlight.size() != retired; });
+    } else if (!mBufferCopies.empty() || !mImageCopies.empty()) {
+      if (std::this_thread::get_id() == mOwnerThread) {
+        SubmitLocked();
+      } else {
+        const uint64_t submitCount = mSubmitCount;
+        mSubmitted.wait(lock, [&]() { return mSubmitCount != submitCount; });
+      }
+    } else {
+      // Nothing owns the ring, restart at its beginning
+      mHead = mTail = (mHead / mRingSize + 1) * mRingSize;
+    }
+  }
+}
+
+void UploadQueue::UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data,
+                               VkDeviceSize size) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  // Large buffers are staged in pieces so they never need the whole ring at once
+  const VkDeviceSize maxChunk = mRingSize / 4;
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+
+  for (VkDeviceSize copied = 0; copied < size;) {
+    VkDeviceSize chunk = std::min(maxChunk, size - copied);
+    VkDeviceSize ringOffset = Allocate(chunk, lock);
+    memcpy(mRingData + ringOffset, src + copied, chunk);
+
+    BufferCopy copy;
+    copy.buffer = dstBuffer;
+    copy.region.srcOffset = ringOffset;
+    copy.region.dstOffset = dstOffset + copied;
+    copy.region.size = chunk;
+    // Chunks that went out with earlier batches are covered by the release of the last one
+    copy.releaseOffset = dstOffset;
+    copy.releaseSize = copied + chunk == size ? size : 0;
+    mBufferCopies.push_back(copy);
+
+    copied += chunk;
+  }
+}
+
+void UploadQueue::UploadImage(VkImage image, const void* data, VkDeviceSize size,
+                              const std::vector<VkBufferImageCopy>& regions) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  uint64_t batch = mSubmitCount - 1;
+  size_t copyIndex = 0;
+
+  for (size_t i = 0; i < regions.size(); i++) {
+    VkDeviceSize regionEnd = (i + 1 < regions.size()) ? regions[i + 1].bufferOffset : size;
+    VkDeviceSize regionSize = regionEnd - regions[i].bufferOffset;
+    assert(regionSize <= GetMaxRegionSize());
+
+    VkDeviceSize ringOffset = Allocate(regionSize, lock);
+    if (batch != mSubmitCount) {
+      // First region of this image in the current batch. If the ring filled up part way
+      // through, the regions staged so far went out with the previous batch. Other threads
+      // may have queued copies while Allocate() waited, so this one isn't necessarily last.
+      ImageCopy copy;
+      copy.image = image;
+      copy.firstLevelBegun = i > 0 && regions[i - 1].imageSubresource.mipLevel ==
+                                          regions[i].imageSubresource.mipLevel;
+      mImageCopies.push_back(copy);
+      copyIndex = mImageCopies.size() - 1;
+      batch = mSubmitCount;
+    }
+    memcpy(mRingData + ringOffset, src + regions[i].bufferOffset, regionSize);
+
+    VkBufferImageCopy region = regions[i];
+    region.bufferOffset = ringOffset;
+    mImageCopies[copyIndex].regions.push_back(region);
+    mImageCopies[copyIndex].lastLevelOpen = i + 1 < regions.size() &&
+        regions[i + 1].imageSubresource.mipLevel == region.imageSubresource.mipLevel;
+  }
+}
+
+void UploadQueue::Submit(void) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  SubmitLocked();
+}
+
+VkCommandBuffer UploadQueue::BeginCommandBuffer(VkCommandPool pool) {
+  VkCommandBufferAllocateInfo cmdAllocInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VkCommandBuffer cmdBuffer;
+  CALL_VK(vkAllocateCommandBuffers(mLogicDevice, &cmdAllocInfo, &cmdBuffer));
+
+  VkCommandBufferBeginInfo cmdBeginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
+  CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+  return cmdBuffer;
+}
+
+void UploadQueue::SubmitLocked(void) {
+  assert(std::this_thread::get_id() == mOwnerThread);
+  if (mBufferCopies.empty() && mImageCopies.empty()) {
+    return;
+  }
+
+  Submission submission;
+  submission.ringEnd = mHead;
+  submission.acquireCmdBuffer = VK_NULL_HANDLE;
+  submission.cmdBuffer = BeginCommandBuffer(mCommandPool);
+
+  // Ownership moves from the transfer to the graphics family when they differ
+  const uint32_t srcFamily = HasTransferQueue() ? mTransferFamily : VK_QUEUE_FAMILY_IGNORED;
+  const uint32_t dstFamily = HasTransferQueue() ? mGraphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+  // Move the mip levels of every image into TRANSFER_DST in one barrier batch, copy, then
+  // release them all to the shaders in a second batch. A level split into bands is only moved
+  // with its first band and released with its last, later batches wait on the earlier copies.
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  std::vector<VkImageMemoryBarrier> releaseBarriers;
+  VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  for (const ImageCopy& copy : mImageCopies) {
+    uint32_t baseMip = copy.regions[0].imageSubresource.mipLevel;
+    uint32_t endMip = baseMip + 1;
+    for (const VkBufferImageCopy& region : copy.regions) {
+      baseMip = std::min(baseMip, region.imageSubresource.mipLevel);
+      endMip = std::max(endMip, region.imageSubresource.mipLevel + 1);
+    }
+    VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = copy.image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseMip, endMip - baseMip, 0, 1},
+    };
+    const uint32_t firstLevel = copy.regions.front().imageSubresource.mipLevel;
+    if (ExcludeLevel(&barrier.subresourceRange, copy.firstLevelBegun, firstLevel)) {
+      imageBarriers.push_back(barrier);
+    }
+    if (copy.firstLevelBegun) {
+      VkImageMemoryBarrier continued = barrier;
+      continued.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      continued.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      continued.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, firstLevel, 1, 0, 1};
+      imageBarriers.push_back(continued);
+      waitStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseMip, endMip - baseMip, 0, 1};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    if (ExcludeLevel(&barrier.subresourceRange, copy.lastLevelOpen,
+                     copy.regions.back().imageSubresource.mipLevel)) {
+      releaseBarriers.push_back(barrier);
+    }
+  }
+  if (!imageBarriers.empty()) {
+    vkCmdPipelineBarrier(submission.cmdBuffer, waitStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                         nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()),
+                         imageBarriers.data());
+  }
+
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+  for (const BufferCopy& copy : mBufferCopies) {
+    vkCmdCopyBuffer(submission.cmdBuffer, mRingBuffer, copy.buffer, 1, &copy.region);
+    if (copy.releaseSize == 0) {
+      continue;
+    }
+    const VkBufferMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = kBufferReadAccess,
+        .srcQueueFamilyIndex = srcFamily,
+        .dstQueueFamilyIndex = dstFamily,
+        .buffer = copy.buffer,
+        .offset = copy.releaseOffset,
+        .size = copy.releaseSize,
+    };
+    bufferBarriers.push_back(barrier);
+  }
+  for (const ImageCopy& copy : mImageCopies) {
+    vkCmdCopyBufferToImage(submission.cmdBuffer, mRingBuffer, copy.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(copy.regions.size()), copy.regions.data());
+  }
+  // A transfer queue can't name the graphics stages, its release only has to finish the copies
+  vkCmdPipelineBarrier(submission.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       HasTransferQueue() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : kReadStages,
+                       0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()),
+                       bufferBarriers.data(), static_cast<uint32_t>(releaseBarriers.size()),
+                       releaseBarriers.data());
+  CALL_VK(vkEndCommandBuffer(submission.cmdBuffer));
+
+  VkFenceCreateInfo fenceInfo{
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+  };
+  CALL_VK(vkCreateFence(mLogicDevice, &fenceInfo, nullptr, &submission.fence));
+
+  VkSubmitInfo submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = nullptr,
+      .pWaitDstStageMask = nullptr,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &submission.cmdBuffer,
+      .signalSemaphoreCount = 0,
+      .pSignalSemaphores = nullptr,
+  };
+
+  if (!HasTransferQueue()) {
+    CALL_VK(vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, submission.fence));
+  } else {
+    CALL_VK(vkQueueSubmit(mTransferQueue, 1, &submitInfo, submission.fence));
+
+    // The graphics queue acquires what the transfer queue released with the same barriers. It
+    // is recorded now but only submitted once the copies have signaled, so frames waiting on
+    // the graphics queue never wait for the copies as well.
+    for (VkBufferMemoryBarrier& barrier : bufferBarriers) {
+      barrier.srcAccessMask = 0;
+    }
+    for (VkImageMemoryBarrier& barrier : releaseBarriers) {
+      barrier.srcAccessMask = 0;
+    }
+    submission.acquireCmdBuffer = BeginCommandBuffer(mAcquirePool);
+    vkCmdPipelineBarrier(submission.acquireCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         kReadStages, 0, 0, nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                         static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data());
+    CALL_VK(vkEndCommandBuffer(submission.acquireCmdBuffer));
+  }
+
+  mInFlight.push_back(submission);
+  mSubmitCount++;
+  mBufferCopies.clear();
+  mImageCopies.clear();
+  mSubmitted.notify_all();
+}
+
+void UploadQueue::Flush(void) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  SubmitLocked();
+  while (!mInFlight.empty()) {
+    WaitOldest();
+  }
+  CollectAcquires(true);
+}
+
+void UploadQueue::Collect(void) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  while (!mInFlight.empty() &&
+         vkGetFenceStatus(mLogicDevice, mInFlight.front().fence) == VK_SUCCESS) {
+    Retire(mInFlight.front());
+    mInFlight.pop_front();
+  }
+  CollectAcquires(false);
+}
+
+uint64_t UploadQueue::GetTicket(void) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  // Queued copies go out with the next submission
+  const bool queued = !mBufferCopies.empty() || !mImageCopies.empty();
+  return mSubmitCount + (queued ? 1 : 0);
+}
+
+bool UploadQueue::IsComplete(uint64_t ticket) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mRetireCount >= ticket;
+}
+
+void UploadQueue::WaitOldest(void) {
+  assert(std::this_thread::get_id() == mOwnerThread && !mInFlight.empty());
+  CALL_VK(vkWaitForFences(mLogicDevice, 1, &mInFlight.front().fence, VK_TRUE, UINT64_MAX));
+  Retire(mInFlight.front());
+  mInFlight.pop_front();
+}
+
+void UploadQueue::Retire(const Submission& submission) {
+  vkDestroyFence(mLogicDevice, submission.fence, nullptr);
+  vkFreeCommandBuffers(mLogicDevice, mCommandPool, 1, &submission.cmdBuffer);
+  mTail = submission.ringEnd;
+  if (submission.acquireCmdBuffer == VK_NULL_HANDLE) {
+    mRetireCount++;
+  } else {
+    mAcquires.push_back({submission.acquireCmdBuffer, VK_NULL_HANDLE});
+  }
+  mRetired.notify_all();
+}
+
+// Submits the acquires of retired copies and completes those that have executed, in order
+void UploadQueue::CollectAcquires(bool wait) {
+  assert(std::this_thread::get_id() == mOwnerThread);
+  for (Acquire& acquire : mAcquires) {
+    if (acquire.fence != VK_NULL_HANDLE) {
+      continue;
+    }
+    VkFenceCreateInfo fenceInfo{
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+    };
+    CALL_VK(vkCreateFence(mLogicDevice, &fenceInfo, nullptr, &acquire.fence));
+    // The release was seen complete on its fence, so there is nothing left to wait on
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = nullptr,
+        .pWaitDstStageMask = nullptr,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &acquire.cmdBuffer,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = nullptr,
+    };
+    CALL_VK(vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, acquire.fence));
+  }
+
+  while (!mAcquires.empty()) {
+    Acquire& acquire = mAcquires.front();
+    if (wait) {
+      CALL_VK(vkWaitForFences(mLogicDevice, 1, &acquire.fence, VK_TRUE, UINT64_MAX));
+    } else if (vkGetFenceStatus(mLogicDevice, acquire.fence) != VK_SUCCESS) {
+      break;
+    }
+    vkDestroyFence(mLogicDevice, acquire.fence, nullptr);
+    vkFreeCommandBuffers(mLogicDevice, mAcquirePool, 1, &acquire.cmdBuffer);
+    mAcquires.pop_front();
+    mRetireCount++;
+  }
+}
@@ -0,0 +1,144 @@
+#ifndef __UPLOAD_QUEUE_HPP__
+#define __UPLOAD_QUEUE_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vulkan_wrapper.h"
+
+// Single persistently mapped staging ring shared by every loader. Loaders copy their data
+// into the ring and queue the buffer or image copy; Submit() records everything queued so far
+// into one command buffer. Each submission is tracked with a fence and its part of the ring is
+// only reused once that fence has signaled.
+//
+// Copies run on a transfer queue, which may be a dedicated transfer family (a DMA engine) that
+// works alongside rendering. Everything copied there is released to the graphics family; once
+// the copies' fence has signaled their ring space is reused and a second command buffer
+// acquires them on the graphics queue, tracked by a fence of its own. With a single family the
+// copies go to the graphics queue.
+//
+// Uploads may be staged from any thread. Submit(), Flush() and Collect() belong to the thread
+// that created the queue, the only one to use the VkQueues and to wait on fences. A staging
+// thread that runs out of ring space waits for that thread's next Collect() to retire a
+// submission, or with nothing in flight for its next Submit(), without holding the lock.
+class UploadQueue {
+ public:
+  // transferQueue may be graphicsQueue. Resources uploaded into must be created exclusive to
+  // the graphics family.
+  UploadQueue(VkPhysicalDevice pDevice, VkDevice lDevice, VkQueue transferQueue,
+              uint32_t transferFamilyIndex, VkQueue graphicsQueue, uint32_t graphicsFamilyIndex,
+              VkDeviceSize ringSize);
+  ~UploadQueue();
+
+  // Stages data and queues a copy into dstBuffer at dstOffset
+  void UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data,
+                    VkDeviceSize size);
+
+  // Stages the mip levels described by regions and queues their copy into image. Every region
+  // is a whole mip level or one of consecutive row bands covering it, at most
+  // GetMaxRegionSize() bytes, its bufferOffset relative to data; regions are sorted by offset,
+  // with the last one ending at size. Only those mip levels are written and they must not be in
+  // use, they are left in SHADER_READ_ONLY_OPTIMAL layout once the copy has executed.
+  void UploadImage(VkImage image, const void* data, VkDeviceSize size,
+                   const std::vector<VkBufferImageCopy>& regions);
+
+  // Largest image region that can be staged, larger mip levels have to be split into bands
+  VkDeviceSize GetMaxRegionSize(void) const { return mRingSize / 4; }
+
+  // Records all queued copies into a single command buffer and submits it
+  void Submit(void);
+
+  // True when copies run on a transfer family of their own
+  bool HasTransferQueue(void) const { return mTransferFamily != mGraphicsFamily; }
+
+  // Submits and blocks until every upload so far has completed
+  void Flush(void);
+
+  // Recycles the ring space of submissions the GPU has finished with and hands their uploads to
+  // the graphics queue, call once per frame
+  void Collect(void);
+
+  // Ticket for everything staged so far, complete once all of it has been copied
+  uint64_t GetTicket(void);
+
+  // True once the copies of ticket have executed, as of the last Collect()
+  bool IsComplete(uint64_t ticket);
+
+ private:
+  VkDevice mLogicDevice;
+  VkQueue mTransferQueue;
+  uint32_t mTransferFamily;
+  VkQueue mGraphicsQueue;
+  uint32_t mGraphicsFamily;
+  VkCommandPool mCommandPool;
+  // Graphics family pool for the acquire half of ownership transfers
+  VkCommandPool mAcquirePool = VK_NULL_HANDLE;
+
+  VkBuffer mRingBuffer;
+  VkDeviceMemory mRingMemory;
+  uint8_t* mRingData;
+  VkDeviceSize mRingSize;
+  VkDeviceSize mAlignment;
+
+  // Ring positions grow monotonically, the physical offset is position % mRingSize.
+  // [mTail, mHead) is the part of the ring still owned by queued or in flight copies.
+  VkDeviceSize mHead = 0;
+  VkDeviceSize mTail = 0;
+  uint64_t mSubmitCount = 0;
+  uint64_t mRetireCount = 0;
+
+  // Guards the ring positions, queued copies and submissions; mSubmitted and mRetired wake
+  // staging threads
+  std::mutex mMutex;
+  std::condition_variable mSubmitted;
+  std::condition_variable mRetired;
+  std::thread::id mOwnerThread;
+
+  struct BufferCopy {
+    VkBuffer buffer;
+    VkBufferCopy region;
+    // Range of the whole upload, handed to the graphics queue with its last chunk; 0 otherwise
+    VkDeviceSize releaseOffset;
+    VkDeviceSize releaseSize;
+  };
+  // Regions of one image staged for the same batch. A mip level split into bands may span
+  // batches, it stays in TRANSFER_DST_OPTIMAL on the transfer queue until its last band.
+  struct ImageCopy {
+    VkImage image;
+    std::vector<VkBufferImageCopy> regions;
+    // The first region's level was begun by an earlier batch
+    bool firstLevelBegun;
+    // The last region's level has bands left for a later batch
+    bool lastLevelOpen;
+  };
+  std::vector<BufferCopy> mBufferCopies;
+  std::vector<ImageCopy> mImageCopies;
+
+  struct Submission {
+    VkFence fence;
+    VkCommandBuffer cmdBuffer;
+    // Only with a transfer family, the acquire recorded for the graphics queue
+    VkCommandBuffer acquireCmdBuffer;
+    VkDeviceSize ringEnd;
+  };
+  std::deque<Submission> mInFlight;
+
+  // Acquires of retired copies, fence is VK_NULL_HANDLE until submitted
+  struct Acquire {
+    VkCommandBuffer cmdBuffer;
+    VkFence fence;
+  };
+  std::deque<Acquire> mAcquires;
+
+  VkDeviceSize Allocate(VkDeviceSize size, std::unique_lock<std::mutex>& lock);
+  void SubmitLocked(void);
+  VkCommandBuffer BeginCommandBuffer(VkCommandPool pool);
+  void WaitOldest(void);
+  void Retire(const Submission& submission);
+  void CollectAcquires(bool wait);
+};
+
+#endif // __UPLOAD_QUEUE_HPP__
@@ -0,0 +1,79 @@
+#ifndef __VERTEX_INPUT_HPP__
+#define __VERTEX_INPUT_HPP__
+
+#include <vector>
+
+#include "vulkan_wrapper.h"
+#include "VertexLayout.h"
+
+namespace navs {
+
+// Vulkan format of each component type, a component without one fails to compile
+template <typename C>
+struct VertexAttributeFormat;
+
+template <>
+struct VertexAttributeFormat<Position> {
+  static const VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<Normal> {
+  static const VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<UV> {
+  static const VkFormat value = VK_FORMAT_R32G32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<Tangent> {
+  static const VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<SignedTangent> {
+  static const VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<Bitangent> {
+  static const VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<QuantizedPosition> {
+  static const VkFormat value = VK_FORMAT_R16G16B16A16_SNORM;
+};
+
+template <>
+struct VertexAttributeFormat<OctNormal> {
+  static const VkFormat value = VK_FORMAT_R16G16_SNORM;
+};
+
+template <>
+struct VertexAttributeFormat<OctTangent> {
+  static const VkFormat value = VK_FORMAT_R16G16_SNORM;
+};
+
+template <>
+struct VertexAttributeFormat<HalfUV> {
+  static const VkFormat value = VK_FORMAT_R16G16_SFLOAT;
+};
+
+// One attribute per component, locations follow declaration order
+template <typename... Components>
+std::vector<VkVertexInputAttributeDescription> GetVertexAttributes(
+    VertexLayout<Components...>, uint32_t binding) {
+  typedef VertexLayout<Components...> Layout;
+  return {{
+      .location = Layout::template Location<Components>(),
+      .binding = binding,
+      .format = VertexAttributeFormat<Components>::value,
+      .offset = Layout::template Offset<Components>(),
+  }...};
+}
+
+} // navs namespace
+#endif // __VERTEX_INPUT_HPP__
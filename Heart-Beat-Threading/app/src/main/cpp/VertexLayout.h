@@ -0,0 +1,234 @@
+#ifndef __VERTEX_LAYOUT_HPP__
+#define __VERTEX_LAYOUT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MeshData.h"
+
+// Compile time vertex layouts. A layout is declared once as a list of component types, e.g.
+//
+//   typedef VertexLayout<Position, UV, Normal> SimpleLayout;
+//
+// and yields the packed vertex struct, its stride, every component's location and offset and a
+// branch free packing routine. VertexInput.h turns a layout into Vulkan attribute descriptions.
+
+namespace navs {
+
+// Component types, Get() selects or encodes the decoded value the component is packed from
+struct Position {
+  typedef glm::vec3 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_POSITION;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) { return vertex.pos; }
+};
+
+struct Normal {
+  typedef glm::vec3 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_NORMAL;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) { return vertex.normal; }
+};
+
+struct UV {
+  typedef glm::vec2 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_UV;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) { return vertex.uv; }
+};
+
+struct Tangent {
+  typedef glm::vec3 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_TANGENT;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) {
+    return glm::vec3(vertex.tangent);
+  }
+};
+
+// Tangent with the bitangent sign in w, replaces a separate Bitangent
+struct SignedTangent {
+  typedef glm::vec4 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_TANGENT_SIGNED;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) { return vertex.tangent; }
+};
+
+struct Bitangent {
+  typedef glm::vec3 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_BITANGENT;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) {
+    return GetBitangent(vertex);
+  }
+};
+
+// Quantized components, decoded again by heart_quant.vert
+struct Snorm16x4 {
+  int16_t v[4];
+};
+
+struct Snorm16x2 {
+  int16_t v[2];
+};
+
+struct Half2 {
+  uint16_t v[2];
+};
+
+// Snorm16 inside the mesh bounds, w carries the bitangent sign so the bitangent itself can be
+// rebuilt from the normal and tangent
+struct QuantizedPosition {
+  typedef Snorm16x4 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_POSITION_SNORM16;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale& quantization) {
+    const glm::vec3 q = (vertex.pos - quantization.offset) / quantization.scale;
+    Type packed = {{EncodeSnorm16(q.x), EncodeSnorm16(q.y), EncodeSnorm16(q.z),
+                    EncodeSnorm16(GetBitangentSign(vertex))}};
+    return packed;
+  }
+};
+
+struct OctNormal {
+  typedef Snorm16x2 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_NORMAL_OCT16;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) {
+    const glm::vec2 oct = EncodeOctahedral(vertex.normal);
+    Type packed = {{EncodeSnorm16(oct.x), EncodeSnorm16(oct.y)}};
+    return packed;
+  }
+};
+
+struct OctTangent {
+  typedef Snorm16x2 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_TANGENT_OCT16;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) {
+    const glm::vec2 oct = EncodeOctahedral(glm::vec3(vertex.tangent));
+    Type packed = {{EncodeSnorm16(oct.x), EncodeSnorm16(oct.y)}};
+    return packed;
+  }
+};
+
+struct HalfUV {
+  typedef Half2 Type;
+  static const VertexComponent kComponent = VERTEX_COMPONENT_UV_HALF;
+  static Type Get(const MeshVertex& vertex, const QuantizationScale&) {
+    Type packed = {{EncodeHalf(vertex.uv.x), EncodeHalf(vertex.uv.y)}};
+    return packed;
+  }
+};
+
+// Type erased view of a layout for code that only knows it at runtime (ModelLoader, baked files)
+struct VertexFormat {
+  const VertexComponent* components;
+  uint32_t componentCount;
+  uint32_t stride;
+  void (*pack)(const MeshVertex* vertices, size_t count, const QuantizationScale& quantization,
+               uint8_t* dst);
+};
+
+// Byte offset of component within a vertex of format, or -1 when the format lacks it
+inline int GetComponentOffset(const VertexFormat& format, VertexComponent component) {
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < format.componentCount; i++) {
+    if (format.components[i] == component) {
+      return static_cast<int>(offset);
+    }
+    offset += GetComponentSize(format.components[i]);
+  }
+  return -1;
+}
+
+// True when any component of format only decodes with the mesh bounds or in the shader
+inline bool IsQuantizedFormat(const VertexFormat& format) {
+  for (uint32_t i = 0; i < format.componentCount; i++) {
+    if (IsQuantizedComponent(format.components[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Packed storage, one member per component in declaration order
+template <typename... Components>
+struct PackedVertex;
+
+template <typename C>
+struct PackedVertex<C> {
+  typename C::Type value;
+
+  void Pack(const MeshVertex& vertex, const QuantizationScale& quantization) {
+    value = C::Get(vertex, quantization);
+  }
+};
+
+template <typename C, typename... Rest>
+struct PackedVertex<C, Rest...> {
+  typename C::Type value;
+  PackedVertex<Rest...> rest;
+
+  void Pack(const MeshVertex& vertex, const QuantizationScale& quantization) {
+    value = C::Get(vertex, quantization);
+    rest.Pack(vertex, quantization);
+  }
+};
+
+// Position of C in the component list, fails to compile if C is not part of it
+template <typename C, typename... Components>
+struct ComponentIndex;
+
+template <typename C, typename... Rest>
+struct ComponentIndex<C, C, Rest...> {
+  static const uint32_t value = 0;
+  static const uint32_t offset = 0;
+};
+
+template <typename C, typename First, typename... Rest>
+struct ComponentIndex<C, First, Rest...> {
+  static const uint32_t value = 1 + ComponentIndex<C, Rest...>::value;
+  static const uint32_t offset = sizeof(typename First::Type) + ComponentIndex<C, Rest...>::offset;
+};
+
+template <typename... Components>
+struct ComponentSize;
+
+template <>
+struct ComponentSize<> {
+  static const uint32_t value = 0;
+};
+
+template <typename C, typename... Rest>
+struct ComponentSize<C, Rest...> {
+  static const uint32_t value = sizeof(typename C::Type) + ComponentSize<Rest...>::value;
+};
+
+template <typename... Components>
+struct VertexLayout {
+  typedef PackedVertex<Components...> Vertex;
+
+  static const uint32_t kComponentCount = sizeof...(Components);
+  static const uint32_t kStride = sizeof(Vertex);
+  static_assert(kStride == ComponentSize<Components...>::value,
+                "vertex components must pack without padding");
+
+  template <typename C>
+  static constexpr uint32_t Location() { return ComponentIndex<C, Components...>::value; }
+
+  template <typename C>
+  static constexpr uint32_t Offset() { return ComponentIndex<C, Components...>::offset; }
+
+  static const VertexComponent* GetComponents(void) {
+    static const VertexComponent components[] = {Components::kComponent...};
+    return components;
+  }
+
+  static void Pack(const MeshVertex* vertices, size_t count,
+                   const QuantizationScale& quantization, uint8_t* dst) {
+    Vertex* out = reinterpret_cast<Vertex*>(dst);
+    for (size_t i = 0; i < count; i++) {
+      out[i].Pack(vertices[i], quantization);
+    }
+  }
+
+  static VertexFormat Format(void) {
+    VertexFormat format = {GetComponents(), kComponentCount, kStride, &Pack};
+    return format;
+  }
+};
+
+} // navs namespace
+#endif // __VERTEX_LAYOUT_HPP__
@@ -4,16 +4,29 @@
 #include <cstring>
 #include <vector>
 #include <array>
+#include <chrono>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <gli/gli.hpp>
-
 #include "VulkanUtil.h"
+#include "AssetIO.h"
+#include "AssetStreamer.h"
+#include "DeletionQueue.h"
+#include "IndirectDraws.h"
+#include "MeshSimplifier.h"
 #include "ModelLoader.h"
+#include "UploadQueue.h"
+#include "VertexInput.h"
+#include "MemoryTracker.h"
+#include "ModelCache.h"
+#include "MorphPass.h"
+#include "ScratchArena.h"
+#include "SkinningPass.h"
+#include "TextureResidency.h"
+#include "WorkerPool.h"
 #include "ValidationLayers.h"
 
 using namespace navs;
@@ -31,6 +44,13 @@ struct VulkanDeviceInfo {
 
   VkSurfaceKHR surface_;
   VkQueue queue_;
+  // Valid bits of the timestamps queue_ writes, 0 when it can't write any
+  uint32_t timestampValidBits_;
+  // Dedicated transfer queue for uploads, the graphics queue when there is none
+  VkQueue transferQueue_;
+  uint32_t transferQueueFamilyIndex_;
+  // Optional features that were available and got enabled
+  VkPhysicalDeviceFeatures features_;
 } device;
 
 struct VulkanSwapchainInfo {
@@ -84,17 +104,32 @@ struct {
   glm::mat4 modelMatrix;
   glm::mat4 normal;
   glm::vec4 lightPos = glm::vec4(0.5f,-2.5f, 4.0f, 1.0f);
+  // Only read by heart_quant.vert, restores positions from the mesh bounds
+  glm::vec4 posScale = glm::vec4(1.0f);
+  glm::vec4 posOffset = glm::vec4(0.0f);
 } uboVS;
 
 float zoom = -6.0f;
+const float kFieldOfView = 60.0f;  // vertical, in degrees
 glm::vec3 rotation = glm::vec3(0.0f, 0.0f, 0.0f);
 
-struct Vertex {
-  glm::vec3 pos;
-  glm::vec3 normal;
-  glm::vec2 uv;
-  glm::vec3 color;
-};
+// Vertex layout consumed by heart.vert, locations follow the component order
+typedef VertexLayout<Position, UV, Normal, SignedTangent> HeartLayout;
+static_assert(HeartLayout::Location<Position>() == 0 && HeartLayout::Location<UV>() == 1 &&
+              HeartLayout::Location<Normal>() == 2 && HeartLayout::Location<SignedTangent>() == 3,
+              "HeartLayout does not match the inputs of heart.vert");
+
+// 20 instead of 48 bytes per vertex, decoded by heart_quant.vert
+typedef VertexLayout<QuantizedPosition, HalfUV, OctNormal, OctTangent> HeartQuantizedLayout;
+static_assert(HeartQuantizedLayout::Location<QuantizedPosition>() == 0 &&
+              HeartQuantizedLayout::Location<HalfUV>() == 1 &&
+              HeartQuantizedLayout::Location<OctNormal>() == 2 &&
+              HeartQuantizedLayout::Location<OctTangent>() == 3,
+              "HeartQuantizedLayout does not match the inputs of heart_quant.vert");
+
+// Comment out to draw the heart with full float vertices. Skinned and morphed models are drawn
+// with them either way.
+#define QUANTIZED_VERTICES
 
 struct {
   VkPipelineVertexInputStateCreateInfo inputState;
@@ -102,32 +137,71 @@ struct {
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 } vertices;
 
-struct Texture {
-  VkSampler sampler;
-  VkImage image;
-  VkImageLayout layout;
-  VkDeviceMemory memory;
-  VkImageView view;
-  VkImageType type;
-  VkFormat format;
-  uint32_t width;
-  uint32_t height;
-  uint32_t mipLevels;
-  uint32_t layerCount;
-};
-
-struct Texture heartMainTexture {
-    .type = VK_IMAGE_TYPE_2D,
-    .format = VK_FORMAT_ASTC_8x8_UNORM_BLOCK,
-};
-
-struct Texture heartNormalTexture {
-    .type = VK_IMAGE_TYPE_2D,
-    .format = VK_FORMAT_ASTC_8x8_UNORM_BLOCK,
-};
+// Textures stream in from their files and are evicted a mip level at a time when over budget,
+// single texels of these are drawn until they first arrive
+TextureResidency* textures = nullptr;
+const VkDeviceSize kTextureBudget = 16 * 1024 * 1024;
+uint32_t heartMainTexture;
+uint32_t heartNormalTexture;
+const uint8_t kPlaceholderColor[4] = {176, 48, 48, 255};
+const uint8_t kFlatNormal[4] = {128, 128, 255, 255};
+
+UploadQueue* uploadQueue;
+// Loads the heart and its textures after the first frame, placeholders are drawn until then
+AssetStreamer* assetStreamer = nullptr;
+std::chrono::steady_clock::time_point loadStart;
+// Load time scratch memory for decoded geometry, released once InitVulkan() is done with it
+ScratchArena* loadArena;
+// One thread per core for decoding assets, idle once loading is done
+WorkerPool* loadWorkers;
+const VkDeviceSize kStagingRingSize = 4 * 1024 * 1024;
 
 ModelLoader* modelLoader;
+// Decoded models, kept across window recreation and on disk across app restarts
+ModelCache* modelCache = nullptr;
+// Objects are released here once the last frame that used them has retired
+DeletionQueue* deletionQueue;
+uint64_t frameNumber = 0;
 struct ModelLoader::Model heartModel;
+// Level of detail the command buffers were recorded with
+uint32_t heartLod = 0;
+
+// Indirect draws of every part of every level of detail, each level is a range of them
+IndirectDraws* heartDraws = nullptr;
+struct DrawRange {
+  uint32_t first;
+  uint32_t count;
+};
+std::vector<DrawRange> heartLodDraws;
+
+// Skins heartModel on the GPU when it comes with a skeleton, nullptr otherwise. Instances are
+// laid out on a grid and play the first animation, each a little behind the one before.
+SkinningPass* skinningPass = nullptr;
+const uint32_t kSkinnedInstances = 16;
+const uint32_t kSkinnedInstancesPerRow = 4;
+const float kSkinnedInstanceDelay = 0.1f;  // seconds
+std::vector<JointPose> skinPose;
+std::chrono::steady_clock::time_point animationStart;
+
+// Blends heartModel's morph targets when it has any, nullptr otherwise. The first target
+// follows the heartbeat, the others stay at the weights the model came with.
+MorphPass* morphPass = nullptr;
+const float kHeartRate = 72.0f;  // beats per minute
+
+// GPU timestamps around the model draw and the morph and skinning dispatches, averaged and
+// logged every kDrawTimingFrames together with the CPU time spent on palettes. Off, with no
+// query pool, when the graphics queue has no timestamps.
+struct {
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  float timestampPeriod;
+  uint64_t timestampMask;
+  double accumulatedMs = 0.0;
+  double accumulatedVertexPassMs = 0.0;
+  double accumulatedPaletteMs = 0.0;
+  uint32_t frames = 0;
+} drawTiming;
+const uint32_t kTimestampsPerFrame = 4;
+const uint32_t kDrawTimingFrames = 300;
 
 struct TouchPos {
   int32_t x;
@@ -136,6 +210,7 @@ struct TouchPos {
 bool touchDown = false;
 double touchTimer = 0.0;
 int64_t lastTapTime = 0;
+const int64_t kDoubleTapNs = 300000000;
 float rotationSpeed = 1.0f;
 /*
  * SetImageLayout():
@@ -218,7 +293,7 @@ void updateUniformBuffers(void) {
   uboVS.modelMatrix = glm::rotate(uboVS.modelMatrix, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
   uboVS.modelMatrix = glm::rotate(uboVS.modelMatrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
-  glm::mat4 projectionMatrix = glm::perspective(glm::radians(60.0f),
+  glm::mat4 projectionMatrix = glm::perspective(glm::radians(kFieldOfView),
                                                 (float)(swapchain.displaySize.width) / (float)swapchain.displaySize.height,
                                                 0.01f, 256.0f);
 
@@ -227,6 +302,8 @@ void updateUniformBuffers(void) {
   uboVS.MVP = projectionMatrix * viewMatrix * uboVS.modelMatrix;
 
   uboVS.normal = glm::inverseTranspose(uboVS.modelMatrix);
+  uboVS.posScale = glm::vec4(heartModel.quantization.scale, 1.0f);
+  uboVS.posOffset = glm::vec4(heartModel.quantization.offset, 0.0f);
 
   uint8_t *pData;
   CALL_VK(vkMapMemory(device.logic_, uniformBuffer.memory, 0, sizeof(uboVS), 0, (void **)&pData));
@@ -234,6 +311,16 @@ void updateUniformBuffers(void) {
   vkUnmapMemory(device.logic_, uniformBuffer.memory);
 }
 
+// Coarsest level of detail whose simplification error stays under a pixel at the current zoom
+uint32_t SelectHeartLod(void) {
+  const glm::vec3 center = (heartModel.bounds.min + heartModel.bounds.max) * 0.5f;
+  const float radius = glm::length(heartModel.bounds.max - heartModel.bounds.min) * 0.5f;
+  // The heart rotates about the origin, measure to the closest point it can reach
+  const float distance = -zoom - glm::length(center) - radius;
+  return SelectMeshLod(heartModel.lods.data(), heartModel.lods.size(), distance,
+                       glm::radians(kFieldOfView), (float)swapchain.displaySize.height);
+}
+
 VkBool32 getSupportedDepthFormat(VkFormat *depthFormat)
 {
   // Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -261,207 +348,20 @@ VkBool32 getSupportedDepthFormat(VkFormat *depthFormat)
   return false;
 }
 
-
-VkResult LoadTextureFromFile(const char* filePath, struct Texture* texture) {
-
-  // Check for optimal tiling supportability
-  VkFormatProperties props;
-  vkGetPhysicalDeviceFormatProperties(device.physical_, texture->format, &props);
-  assert(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
-
-  // Read the file:
-  AAsset* file = AAssetManager_open(androidAppCtx->activity->assetManager, filePath,
-                                    AASSET_MODE_BUFFER);
-  size_t fileLength = AAsset_getLength(file);
-  char* fileContent = new char[fileLength];
-  AAsset_read(file, fileContent, fileLength);
-  AAsset_close(file);
-
-  gli::texture2d imageData(gli::load((const char*)fileContent, fileLength));
-  assert(!imageData.empty());
-
-  texture->width = static_cast<uint32_t>(imageData[0].extent().x);
-  texture->height = static_cast<uint32_t>(imageData[0].extent().y);
-  texture->mipLevels = static_cast<uint32_t>(imageData.levels());
-
-  // Create a host-visible staging buffer that contains the raw image data
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingMemory;
-
-  VkBufferCreateInfo bufferCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .size = imageData.size(),
-      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-  };
-  CALL_VK(vkCreateBuffer(device.logic_, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-
-  VkMemoryRequirements memReqs;
-  vkGetImageMemoryRequirements(device.logic_, stagingBuffer, &memReqs);
-
-  VkMemoryAllocateInfo memAllocInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .pNext = nullptr,
-      .allocationSize = memReqs.size,
-      .memoryTypeIndex = 0,
-  };
-  assert(MapMemoryTypeToIndex(device.physical_, memReqs.memoryTypeBits,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                              &memAllocInfo.memoryTypeIndex));
-
-  CALL_VK(vkAllocateMemory(device.logic_, &memAllocInfo, nullptr, &stagingMemory));
-  CALL_VK(vkBindBufferMemory(device.logic_, stagingBuffer, stagingMemory, 0));
-
-
-  // Copy texture data into staging buffer
-  uint8_t *data;
-  CALL_VK(vkMapMemory(device.logic_, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-  memcpy(data, imageData.data(), imageData.size());
-  vkUnmapMemory(device.logic_, stagingMemory);
-
-  // Setup buffer copy regions for each mip level, but only 1 for now
-  std::vector<VkBufferImageCopy> bufferCopyRegions;
-  uint32_t offset = 0;
-
-  for (uint32_t i = 0; i < texture->mipLevels; i++)
-  {
-    VkBufferImageCopy bufferCopyRegion = {
-        .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .imageSubresource.mipLevel = i,
-        .imageSubresource.baseArrayLayer = 0,
-        .imageSubresource.layerCount = 1,
-        .imageExtent.width = static_cast<uint32_t>(imageData[i].extent().x),
-        .imageExtent.height = static_cast<uint32_t>(imageData[i].extent().y),
-        .imageExtent.depth = 1,
-        .bufferOffset = offset,
-    };
-
-    bufferCopyRegions.push_back(bufferCopyRegion);
-
-    offset += static_cast<uint32_t>(imageData[i].size());
+// Bytes a depth/stencil texel takes when written out to memory
+uint32_t getDepthFormatSize(VkFormat depthFormat)
+{
+  switch (depthFormat) {
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return 5;
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+      return 4;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+      return 3;
+    default:
+      return 2;
   }
-
-
-
-  // Create optimal tiled target image
-  VkImageCreateInfo imageCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-      .pNext = nullptr,
-      .imageType = texture->type,
-      .format = texture->format,
-      .extent = {texture->width, texture->height, 1},
-      .mipLevels = texture->mipLevels,
-      .arrayLayers = 1,
-      .samples = VK_SAMPLE_COUNT_1_BIT,
-      .tiling = VK_IMAGE_TILING_OPTIMAL,
-      .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .queueFamilyIndexCount = 1,
-      .pQueueFamilyIndices = &device.queueFamilyIndex_,
-      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .flags = 0,
-  };
-
-  CALL_VK(vkCreateImage(device.logic_, &imageCreateInfo, nullptr, &texture->image));
-
-  vkGetImageMemoryRequirements(device.logic_, texture->image, &memReqs);
-  memAllocInfo.allocationSize = memReqs.size;
-
-  assert(MapMemoryTypeToIndex(device.physical_, memReqs.memoryTypeBits,
-                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAllocInfo.memoryTypeIndex));
-
-  CALL_VK(vkAllocateMemory(device.logic_, &memAllocInfo, nullptr, &texture->memory));
-  CALL_VK(vkBindImageMemory(device.logic_, texture->image, texture->memory, 0));
-
-  // Create copy commandbuffer
-  VkCommandPoolCreateInfo cmdPoolCreateInfo{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-      .queueFamilyIndex = device.queueFamilyIndex_,
-  };
-
-  VkCommandPool cmdPool;
-  CALL_VK(vkCreateCommandPool(device.logic_, &cmdPoolCreateInfo, nullptr,
-                              &cmdPool));
-
-  VkCommandBuffer copyCmd;
-  const VkCommandBufferAllocateInfo cmd = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .pNext = nullptr,
-      .commandPool = cmdPool,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 1,
-  };
-
-  CALL_VK(vkAllocateCommandBuffers(device.logic_, &cmd, &copyCmd));
-  VkCommandBufferBeginInfo cmdBufInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-      .pNext = nullptr,
-      .flags = 0,
-      .pInheritanceInfo = nullptr};
-
-  CALL_VK(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-
-  // transitions image out of UNDEFINED type
-  SetImageLayout(copyCmd, texture->image, texture->mipLevels,
-                 VK_IMAGE_LAYOUT_UNDEFINED,
-                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // VK_PIPELINE_STAGE_HOST_BIT
-                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT); // VK_PIPELINE_STAGE_TRANSFER_BIT
-
-  // Copy the layers and mip levels from the staging buffer to the optimal tiled image
-  vkCmdCopyBufferToImage(
-      copyCmd,
-      stagingBuffer,
-      texture->image,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      static_cast<uint32_t>(bufferCopyRegions.size()),
-      bufferCopyRegions.data());
-
-  // Change texture image layout to shader read after all faces have been copied
-  texture->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  SetImageLayout(copyCmd, texture->image, texture->mipLevels,
-                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                 texture->layout,
-                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, // VK_PIPELINE_STAGE_TRANSFER_BIT
-                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);// VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
-
-
-  CALL_VK(vkEndCommandBuffer(copyCmd));
-
-  VkFenceCreateInfo fenceInfo = {
-      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = 0,
-  };
-  VkFence fence;
-  CALL_VK(vkCreateFence(device.logic_, &fenceInfo, nullptr, &fence));
-
-  VkSubmitInfo submitInfo = {
-      .pNext = nullptr,
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .waitSemaphoreCount = 0,
-      .pWaitSemaphores = nullptr,
-      .pWaitDstStageMask = nullptr,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &copyCmd,
-      .signalSemaphoreCount = 0,
-      .pSignalSemaphores = nullptr,
-  };
-  CALL_VK(vkQueueSubmit(device.queue_, 1, &submitInfo, fence));
-  CALL_VK(vkWaitForFences(device.logic_, 1, &fence, VK_TRUE, 100000000));
-  vkDestroyFence(device.logic_, fence, nullptr);
-
-  vkFreeCommandBuffers(device.logic_, cmdPool, 1, &copyCmd);
-  vkDestroyCommandPool(device.logic_, cmdPool, nullptr);
-
-  vkDestroyImage(device.logic_, stagingBuffer, nullptr);
-  vkFreeMemory(device.logic_, stagingMemory, nullptr);
-
-  return VK_SUCCESS;
 }
 
 // Create vulkan device
@@ -555,42 +455,75 @@ void CreateVulkanDevice(ANativeWindow *platformWindow) {
   }
   assert(queueFamilyIndex < queueFamilyCount);
   device.queueFamilyIndex_ = queueFamilyIndex;
+  device.timestampValidBits_ = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+
+  // A transfer only family is a copy engine of its own, uploads there overlap with rendering.
+  // Uploads copy whole mip levels, which any image transfer granularity allows.
+  device.transferQueueFamilyIndex_ = queueFamilyIndex;
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    const VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      device.transferQueueFamilyIndex_ = i;
+      break;
+    }
+  }
 
   // Create a logical device (vulkan device)
   float priorities[] = {
       1.0f,
   };
-  VkDeviceQueueCreateInfo queueCreateInfo{
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = 0,
-      .queueCount = 1,
-      .queueFamilyIndex = queueFamilyIndex,
-      .pQueuePriorities = priorities,
+  VkDeviceQueueCreateInfo queueCreateInfos[2]{
+      {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .queueCount = 1,
+          .queueFamilyIndex = queueFamilyIndex,
+          .pQueuePriorities = priorities,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .queueCount = 1,
+          .queueFamilyIndex = device.transferQueueFamilyIndex_,
+          .pQueuePriorities = priorities,
+      },
   };
+  const uint32_t queueCreateInfoCount =
+      device.transferQueueFamilyIndex_ != queueFamilyIndex ? 2 : 1;
+
+  // Indirect draws use these when present, see IndirectDraws
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(device.physical_, &supportedFeatures);
+  memset(&device.features_, 0, sizeof(device.features_));
+  device.features_.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  device.features_.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
   VkDeviceCreateInfo deviceCreateInfo{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
       .pNext = nullptr,
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &queueCreateInfo,
+      .queueCreateInfoCount = queueCreateInfoCount,
+      .pQueueCreateInfos = queueCreateInfos,
 #ifdef VALIDATION_LAYERS
       .enabledLayerCount = layerAndExt.DevLayerCount(),
       .ppEnabledLayerNames = static_cast<const char *const *>(layerAndExt.DevLayerNames()),
       .enabledExtensionCount = layerAndExt.DevExtCount(),
       .ppEnabledExtensionNames = static_cast<const char *const *>(layerAndExt.DevExtNames()),
-      .pEnabledFeatures = nullptr
+      .pEnabledFeatures = &device.features_
 #else
   .enabledLayerCount = 0,
   .ppEnabledLayerNames = nullptr,
   .enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
   .ppEnabledExtensionNames = device_extensions.data(),
-  .pEnabledFeatures = nullptr,
+  .pEnabledFeatures = &device.features_,
 #endif
   };
 
   CALL_VK(vkCreateDevice(device.physical_, &deviceCreateInfo, nullptr, &device.logic_));
   vkGetDeviceQueue(device.logic_, device.queueFamilyIndex_, 0, &device.queue_);
+  vkGetDeviceQueue(device.logic_, device.transferQueueFamilyIndex_, 0, &device.transferQueue_);
 }
 
 void CreateSwapChain(void) {
@@ -737,7 +670,8 @@ void CreateDepthStencil(void) {
       .arrayLayers = 1,
       .samples = VK_SAMPLE_COUNT_1_BIT,
       .tiling = VK_IMAGE_TILING_OPTIMAL,
-      .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+      // Depth is never read back, so it can live entirely in tile memory
+      .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
       .flags = 0,
   };
 
@@ -772,12 +706,32 @@ void CreateDepthStencil(void) {
   CALL_VK(vkCreateImage(device.logic_, &image, nullptr, &depthStencil.image));
   vkGetImageMemoryRequirements(device.logic_, depthStencil.image, &memReqs);
   memAllocInfo.allocationSize = memReqs.size;
-  assert(MapMemoryTypeToIndex(device.physical_, memReqs.memoryTypeBits,
-                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAllocInfo.memoryTypeIndex));
 
-  CALL_VK(vkAllocateMemory(device.logic_, &memAllocInfo, nullptr, &depthStencil.mem));
+  // Prefer lazily allocated memory, tilers only back it if the attachment ever leaves tile memory
+  bool lazilyAllocated = MapMemoryTypeToIndex(device.physical_, memReqs.memoryTypeBits,
+                                              VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                              &memAllocInfo.memoryTypeIndex);
+  if (!lazilyAllocated) {
+    assert(MapMemoryTypeToIndex(device.physical_, memReqs.memoryTypeBits,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAllocInfo.memoryTypeIndex));
+  }
+
+  CALL_VK(AllocateTrackedMemory(device.logic_, &memAllocInfo, MEMORY_CATEGORY_ATTACHMENT,
+                                &depthStencil.mem));
   CALL_VK(vkBindImageMemory(device.logic_, depthStencil.image, depthStencil.mem, 0));
 
+  VkDeviceSize committedBytes = memReqs.size;
+  if (lazilyAllocated) {
+    vkGetDeviceMemoryCommitment(device.logic_, depthStencil.mem, &committedBytes);
+  }
+  LOGI("Depth attachment: %s memory, %llu of %llu bytes committed",
+       lazilyAllocated ? "lazily allocated" : "device local",
+       (unsigned long long)committedBytes, (unsigned long long)memReqs.size);
+  // The render pass discards depth at the end, so this much is no longer written out per frame
+  LOGI("Depth store skipped: %u KB per frame",
+       swapchain.displaySize.width * swapchain.displaySize.height *
+       getDepthFormatSize(depthStencil.format) / 1024);
+
   depthStencilView.image = depthStencil.image;
   CALL_VK(vkCreateImageView(device.logic_, &depthStencilView, nullptr, &depthStencil.view));
 }
@@ -798,7 +752,7 @@ void CreateRenderPass(void) {
   attachments[1].format = depthStencil.format;
   attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
   attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
   attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -886,86 +840,19 @@ void CreateFrameBuffers(void) {
   }
 }
 
-void CreateTexture(const char* filePath, struct Texture* texture) {
-  LoadTextureFromFile(filePath, texture);
-
-  const VkSamplerCreateInfo sampler = {
-      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-      .pNext = nullptr,
-      .magFilter = VK_FILTER_NEAREST,
-      .minFilter = VK_FILTER_NEAREST,
-      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
-      .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-      .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-      .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-      .mipLodBias = 0.0f,
-      .maxAnisotropy = 1,
-      .compareOp = VK_COMPARE_OP_NEVER,
-      .minLod = 0.0f,
-      .maxLod = (float)texture->mipLevels,
-      .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
-      .unnormalizedCoordinates = VK_FALSE,
-  };
-  CALL_VK(vkCreateSampler(device.logic_, &sampler, nullptr, &texture->sampler));
-
-  VkImageViewCreateInfo view = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-      .pNext = nullptr,
-      .viewType = VK_IMAGE_VIEW_TYPE_2D,
-      .format = texture->format,
-      .components =
-          {
-              VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
-              VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A,
-          },
-      .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mipLevels, 0, 1},
-      .flags = 0,
-      .image = texture->image,
-  };
-
-  CALL_VK(vkCreateImageView(device.logic_, &view, nullptr, &texture->view));
-}
-
 void CreateVertexDescriptions() {
   // Binding description
   vertices.bindingDescriptions.resize(1);
   vertices.bindingDescriptions[0].binding = 0;
-  vertices.bindingDescriptions[0].stride = heartModel.layout.stride();
+  vertices.bindingDescriptions[0].stride = heartModel.layout.stride;
   vertices.bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-  // Attribute descriptions
-  // Describes memory layout and shader positions
-  vertices.attributeDescriptions.resize(5); // TODO hardcoded
-  // Location 0 : Position
-  vertices.attributeDescriptions[0].binding = 0;
-  vertices.attributeDescriptions[0].location = 0;
-  vertices.attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  vertices.attributeDescriptions[0].offset = 0;
-
-  // Location 1 : Texture coordinates
-  vertices.attributeDescriptions[1].binding = 0;
-  vertices.attributeDescriptions[1].location = 1;
-  vertices.attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
-  vertices.attributeDescriptions[1].offset = sizeof(float) * 3;
-
-  // Location 2 : Normal
-  vertices.attributeDescriptions[2].binding = 0;
-  vertices.attributeDescriptions[2].location = 2;
-  vertices.attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
-  vertices.attributeDescriptions[2].offset = sizeof(float) * 5;
-
-  // Location 3 : Tangent
-  vertices.attributeDescriptions[3].binding = 0;
-  vertices.attributeDescriptions[3].location = 3;
-  vertices.attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-  vertices.attributeDescriptions[3].offset = sizeof(float) * 8;
-
-  // Location 3 : BiTangent
-  vertices.attributeDescriptions[4].binding = 0;
-  vertices.attributeDescriptions[4].location = 4;
-  vertices.attributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-  vertices.attributeDescriptions[4].offset = sizeof(float) * 11;
-
+  // Attribute descriptions, generated from the same layout the loader packs with
+  if (IsQuantizedFormat(heartModel.layout)) {
+    vertices.attributeDescriptions = GetVertexAttributes(HeartQuantizedLayout(), 0);
+  } else {
+    vertices.attributeDescriptions = GetVertexAttributes(HeartLayout(), 0);
+  }
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{
       .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
@@ -1009,7 +896,8 @@ void CreateUniformBuffer(void) {
                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                        &memAllocInfo.memoryTypeIndex));
 
-  CALL_VK(vkAllocateMemory(device.logic_, &memAllocInfo, nullptr, &uniformBuffer.memory));
+  CALL_VK(AllocateTrackedMemory(device.logic_, &memAllocInfo, MEMORY_CATEGORY_UNIFORM,
+                                &uniformBuffer.memory));
 
   CALL_VK(vkBindBufferMemory(device.logic_, uniformBuffer.buffer, uniformBuffer.memory, 0));
 
@@ -1047,9 +935,19 @@ void CreateDescriptorSetLayout(void) {
       .pImmutableSamplers = nullptr
   };
 
+  // IndirectDraws::DrawData of every draw, indexed by gl_InstanceIndex
+  VkDescriptorSetLayoutBinding drawDataSetLayoutBinding {
+      .binding = 3,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+      .pImmutableSamplers = nullptr
+  };
+
   setLayoutBindings.push_back(vertexSetLayoutBinding);
   setLayoutBindings.push_back(mainSamplerSetLayoutBinding);
   setLayoutBindings.push_back(normalSamplerSetLayoutBinding);
+  setLayoutBindings.push_back(drawDataSetLayoutBinding);
 
   VkDescriptorSetLayoutCreateInfo descriptorLayout{
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -1084,29 +982,31 @@ void CreatePipelineLayout(void) {
 }
 
 VkResult LoadShaderFromFile(const char* filePath, VkShaderModule* shaderOut) {
-  // Read the file
-  assert(androidAppCtx);
-  AAsset* file = AAssetManager_open(androidAppCtx->activity->assetManager, filePath, AASSET_MODE_BUFFER);
-  size_t fileLength = AAsset_getLength(file);
-  assert(fileLength > 0);
-
-  char* fileContent = new char[fileLength];
-
-  AAsset_read(file, fileContent, fileLength);
-  AAsset_close(file);
+  AssetView file;
+  bool fileOpened = OpenAsset(filePath, &file, ASSET_ACCESS_SEQUENTIAL);
+  assert(fileOpened);
+  assert(file.size() % sizeof(uint32_t) == 0);
+
+  // pCode has to be 4 byte aligned. Views of APK entries start wherever the entry sits in the
+  // archive, so SPIR-V is only used in place when it happens to be aligned.
+  const uint32_t* code = reinterpret_cast<const uint32_t*>(file.data());
+  std::vector<uint32_t> alignedCode;
+  if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0) {
+    alignedCode.resize(file.size() / sizeof(uint32_t));
+    memcpy(alignedCode.data(), file.data(), alignedCode.size() * sizeof(uint32_t));
+    code = alignedCode.data();
+  }
 
   VkShaderModuleCreateInfo shaderModuleCreateInfo{
       .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
       .pNext = nullptr,
-      .codeSize = fileLength,
-      .pCode = (const uint32_t*)fileContent,
+      .codeSize = file.size(),
+      .pCode = code,
       .flags = 0,
   };
   VkResult result = vkCreateShaderModule( device.logic_, &shaderModuleCreateInfo, nullptr, shaderOut);
   assert(result == VK_SUCCESS);
 
-  delete[] fileContent;
-
   return result;
 }
 
@@ -1184,7 +1084,11 @@ void CreateGraphicsPipeline(void) {
       .pDynamicStates = dynamicStateEnables.data()};
 
   VkShaderModule vertexShader, fragmentShader;
-  LoadShaderFromFile("shaders/heart.vert.spv", &vertexShader);
+  if (IsQuantizedFormat(heartModel.layout)) {
+    LoadShaderFromFile("shaders/heart_quant.vert.spv", &vertexShader);
+  } else {
+    LoadShaderFromFile("shaders/heart.vert.spv", &vertexShader);
+  }
   LoadShaderFromFile("shaders/heart.frag.spv", &fragmentShader);
 
   // Specify vertex and fragment shader stages
@@ -1240,9 +1144,173 @@ void CreateGraphicsPipeline(void) {
 
 void DeleteGraphicsPipeline(void) {
   if (gfxPipeline == VK_NULL_HANDLE) return;
-  vkDestroyPipeline(device.logic_, gfxPipeline, nullptr);
-  vkDestroyPipelineCache(device.logic_, pipelineCache, nullptr);
-  vkDestroyPipelineLayout(device.logic_, pipelineLayout, nullptr);
+  deletionQueue->DestroyPipeline(gfxPipeline);
+  deletionQueue->DestroyPipelineCache(pipelineCache);
+  deletionQueue->DestroyPipelineLayout(pipelineLayout);
+  gfxPipeline = VK_NULL_HANDLE;
+  pipelineCache = VK_NULL_HANDLE;
+  pipelineLayout = VK_NULL_HANDLE;
+}
+
+void CreateDrawTimingQueries(void) {
+  if (device.timestampValidBits_ == 0) {
+    LOGW("Graphics queue has no timestamps, GPU timings are not logged");
+    return;
+  }
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device.physical_, &properties);
+  drawTiming.timestampPeriod = properties.limits.timestampPeriod;
+  drawTiming.timestampMask = device.timestampValidBits_ >= 64
+      ? ~uint64_t(0) : (uint64_t(1) << device.timestampValidBits_) - 1;
+
+  VkQueryPoolCreateInfo queryPoolInfo{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = kTimestampsPerFrame * swapchain.length,
+      .pipelineStatistics = 0,
+  };
+  CALL_VK(vkCreateQueryPool(device.logic_, &queryPoolInfo, nullptr, &drawTiming.queryPool));
+}
+
+// Reads back the draw timestamps of the frame that just finished on the GPU
+void CollectDrawTiming(uint32_t frameIndex) {
+  if (drawTiming.queryPool == VK_NULL_HANDLE) return;
+  // The vertex pass pair is only written when there is a morph or skinning pass
+  const bool vertexPasses = morphPass != nullptr || skinningPass != nullptr;
+  const uint32_t queryCount = vertexPasses ? 4 : 2;
+  uint64_t timestamps[kTimestampsPerFrame];
+  VkResult result = vkGetQueryPoolResults(device.logic_, drawTiming.queryPool,
+                                          kTimestampsPerFrame * frameIndex, queryCount,
+                                          sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                          VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) return;
+
+  drawTiming.accumulatedMs +=
+      ((timestamps[1] - timestamps[0]) & drawTiming.timestampMask) *
+      drawTiming.timestampPeriod / 1000000.0;
+  if (vertexPasses) {
+    drawTiming.accumulatedVertexPassMs +=
+        ((timestamps[3] - timestamps[2]) & drawTiming.timestampMask) *
+        drawTiming.timestampPeriod / 1000000.0;
+  }
+  if (++drawTiming.frames == kDrawTimingFrames) {
+    LOGI("Model draw: %.3f ms/frame on GPU (%u vertices, %u indices, %u draws)",
+         drawTiming.accumulatedMs / drawTiming.frames, heartModel.vertexCount,
+         heartModel.indexCount, heartLodDraws[heartLod].count);
+    if (vertexPasses) {
+      LOGI("Vertex passes: %.3f ms/frame on GPU",
+           drawTiming.accumulatedVertexPassMs / drawTiming.frames);
+    }
+    if (morphPass) {
+      LOGI("Morphing: %u targets, %u of %u vertices, %zu bytes of weights per frame",
+           morphPass->GetTargetCount(), morphPass->GetMorphedVertexCount(),
+           heartModel.vertexCount, morphPass->GetTargetCount() * sizeof(float));
+    }
+    if (skinningPass) {
+      LOGI("Skinning: palettes %.3f ms/frame on CPU (%u instances, %u joints, %u vertices "
+           "each)", drawTiming.accumulatedPaletteMs / drawTiming.frames,
+           skinningPass->GetInstanceCount(), skinningPass->GetJointCount(),
+           heartModel.vertexCount);
+    }
+    drawTiming.accumulatedMs = 0.0;
+    drawTiming.accumulatedVertexPassMs = 0.0;
+    drawTiming.accumulatedPaletteMs = 0.0;
+    drawTiming.frames = 0;
+  }
+}
+
+void CreateMorphPass(void) {
+  if (!MorphPass::IsSupported(heartModel)) {
+    return;
+  }
+  VkShaderModule morphShader;
+  LoadShaderFromFile("shaders/morph.comp.spv", &morphShader);
+  morphPass = new MorphPass(device.physical_, device.logic_, device.queueFamilyIndex_,
+                            morphShader, heartModel);
+  vkDestroyShaderModule(device.logic_, morphShader, nullptr);
+  animationStart = std::chrono::steady_clock::now();
+}
+
+// Drives the first morph target with a lub-dub pulse, two quick contractions per beat
+void UpdateMorphWeights(void) {
+  const float time = std::chrono::duration<float>(std::chrono::steady_clock::now() -
+                                                  animationStart).count();
+  const float phase = glm::fract(time * kHeartRate / 60.0f);
+  const float lub = glm::exp(-glm::pow((phase - 0.10f) / 0.05f, 2.0f));
+  const float dub = 0.6f * glm::exp(-glm::pow((phase - 0.30f) / 0.05f, 2.0f));
+  morphPass->GetWeights()[0] = glm::max(lub, dub);
+}
+
+void CreateSkinningPass(void) {
+  if (!SkinningPass::IsSupported(heartModel)) {
+    return;
+  }
+  VkShaderModule skinShader;
+  LoadShaderFromFile("shaders/skin.comp.spv", &skinShader);
+  skinningPass = new SkinningPass(device.physical_, device.logic_, device.queueFamilyIndex_,
+                                  skinShader, heartModel, kSkinnedInstances);
+  vkDestroyShaderModule(device.logic_, skinShader, nullptr);
+  skinPose.resize(heartModel.skeleton.joints.size());
+  animationStart = std::chrono::steady_clock::now();
+}
+
+// Samples the animation of every instance and writes its palette, placed on the grid
+void UpdateSkinning(void) {
+  auto start = std::chrono::steady_clock::now();
+  const float time = std::chrono::duration<float>(start - animationStart).count();
+  const glm::vec3 size = heartModel.bounds.max - heartModel.bounds.min;
+  const uint32_t rows = (kSkinnedInstances + kSkinnedInstancesPerRow - 1) /
+                        kSkinnedInstancesPerRow;
+  const uint32_t jointCount = skinningPass->GetJointCount();
+
+  for (uint32_t i = 0; i < skinningPass->GetInstanceCount(); i++) {
+    const glm::vec3 cell(float(i % kSkinnedInstancesPerRow) - 0.5f * (kSkinnedInstancesPerRow - 1),
+                         float(i / kSkinnedInstancesPerRow) - 0.5f * (rows - 1), 0.0f);
+    const glm::mat4 instanceMatrix = glm::translate(glm::mat4(1.0f), cell * size * 1.25f);
+
+    glm::mat4* palette = skinningPass->GetPalette(i);
+    if (heartModel.animations.empty()) {
+      for (uint32_t j = 0; j < jointCount; j++) {
+        skinPose[j] = heartModel.skeleton.joints[j].rest;
+      }
+    } else {
+      SampleAnimation(heartModel.skeleton, heartModel.animations[0],
+                      time - i * kSkinnedInstanceDelay, skinPose.data());
+    }
+    ComputeJointPalette(heartModel.skeleton, skinPose.data(), palette);
+    for (uint32_t j = 0; j < jointCount; j++) {
+      palette[j] = instanceMatrix * palette[j];
+    }
+    palette[jointCount] = instanceMatrix;
+  }
+  drawTiming.accumulatedPaletteMs += std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// One draw per part of every level of detail and skinned instance
+void CreateHeartDraws(void) {
+  const uint32_t instanceCount = skinningPass ? skinningPass->GetInstanceCount() : 1;
+  uint32_t capacity = 0;
+  for (const MeshLod& lod : heartModel.lods) {
+    capacity += lod.partCount * instanceCount;
+  }
+  heartDraws = new IndirectDraws(device.physical_, device.logic_, device.queueFamilyIndex_,
+                                 capacity, device.features_);
+
+  heartLodDraws.clear();
+  for (const MeshLod& lod : heartModel.lods) {
+    const DrawRange range = {heartDraws->GetDrawCount(), lod.partCount * instanceCount};
+    for (uint32_t instance = 0; instance < instanceCount; instance++) {
+      const int32_t vertexOffset =
+          skinningPass ? skinningPass->GetInstanceVertexOffset(instance) : 0;
+      for (uint32_t p = lod.partBase; p < lod.partBase + lod.partCount; p++) {
+        heartDraws->Add(heartModel.parts[p], vertexOffset, 1);
+      }
+    }
+    heartLodDraws.push_back(range);
+  }
 }
 
 void CreateSyncronization(void) {
@@ -1269,8 +1337,14 @@ void CreateDescriptorPool(void) {
       .descriptorCount = 2,
   };
 
+  VkDescriptorPoolSize descriptorPoolStorage{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+  };
+
   poolSizes.push_back(descriptorPoolUniform);
   poolSizes.push_back(descriptorPoolSample);
+  poolSizes.push_back(descriptorPoolStorage);
 
   VkDescriptorPoolCreateInfo descriptorPoolInfo{
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -1282,26 +1356,20 @@ void CreateDescriptorPool(void) {
   CALL_VK(vkCreateDescriptorPool(device.logic_, &descriptorPoolInfo, nullptr, &descriptorPool));
 }
 
-void CreateDescriptorSet(void) {
-
-  VkDescriptorSetAllocateInfo allocInfo{
-      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-      .descriptorPool = descriptorPool,
-      .pSetLayouts = &descriptorSetLayout,
-      .descriptorSetCount = 1,
-  };
-
-  CALL_VK(vkAllocateDescriptorSets(device.logic_, &allocInfo, &descriptorSet));
-
+// Points the descriptor set at the current textures and draw data. Only between frames, the
+// command buffers have to be recorded again afterwards.
+void UpdateDescriptorSet(void) {
+  const Texture& mainTexture = textures->Get(heartMainTexture);
+  const Texture& normalTexture = textures->Get(heartNormalTexture);
   VkDescriptorImageInfo texMainDescriptor = {
-      .sampler = heartMainTexture.sampler,
-      .imageView = heartMainTexture.view,
-      .imageLayout = heartMainTexture.layout,
+      .sampler = mainTexture.sampler,
+      .imageView = mainTexture.view,
+      .imageLayout = mainTexture.layout,
   };
   VkDescriptorImageInfo texNormalDescriptor = {
-      .sampler = heartNormalTexture.sampler,
-      .imageView = heartNormalTexture.view,
-      .imageLayout = heartNormalTexture.layout,
+      .sampler = normalTexture.sampler,
+      .imageView = normalTexture.view,
+      .imageLayout = normalTexture.layout,
   };
 
   std::vector<VkWriteDescriptorSet> writeDescriptorSets;
@@ -1332,13 +1400,37 @@ void CreateDescriptorSet(void) {
   };
 
 
+  VkDescriptorBufferInfo drawDataDescriptor = heartDraws->GetDrawDataDescriptor();
+  VkWriteDescriptorSet writeDescriptorSetDrawData{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = descriptorSet,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .dstBinding = 3,
+      .pBufferInfo = &drawDataDescriptor,
+      .descriptorCount = 1,
+  };
+
   writeDescriptorSets.push_back(writeDescriptorSetUniform);
   writeDescriptorSets.push_back(writeDescriptorSetSampler);
   writeDescriptorSets.push_back(writeDescriptorSetNormalSampler);
+  writeDescriptorSets.push_back(writeDescriptorSetDrawData);
 
   vkUpdateDescriptorSets(device.logic_, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 }
 
+void CreateDescriptorSet(void) {
+
+  VkDescriptorSetAllocateInfo allocInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = descriptorPool,
+      .pSetLayouts = &descriptorSetLayout,
+      .descriptorSetCount = 1,
+  };
+
+  CALL_VK(vkAllocateDescriptorSets(device.logic_, &allocInfo, &descriptorSet));
+  UpdateDescriptorSet();
+}
+
 void BuildCommandBuffers(void) {
 
   // Command for all buffers
@@ -1370,6 +1462,30 @@ void BuildCommandBuffers(void) {
     // We start by creating and declare the "beginning" our command buffer
     CALL_VK(vkBeginCommandBuffer(render.cmdBuffe[i], &cmdBufferBeginInfo));
 
+    const bool timed = drawTiming.queryPool != VK_NULL_HANDLE;
+    if (timed) {
+      vkCmdResetQueryPool(render.cmdBuffe[i], drawTiming.queryPool, kTimestampsPerFrame * i,
+                          kTimestampsPerFrame);
+    }
+
+    // Vertices are morphed, then skinned, before the render pass; the draws below read the
+    // result
+    if (morphPass || skinningPass) {
+      if (timed) {
+        vkCmdWriteTimestamp(render.cmdBuffe[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            drawTiming.queryPool, kTimestampsPerFrame * i + 2);
+      }
+      if (morphPass) {
+        morphPass->Record(render.cmdBuffe[i]);
+      }
+      if (skinningPass) {
+        skinningPass->Record(render.cmdBuffe[i]);
+      }
+      if (timed) {
+        vkCmdWriteTimestamp(render.cmdBuffe[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            drawTiming.queryPool, kTimestampsPerFrame * i + 3);
+      }
+    }
 
     // Now we start a renderpass. Any draw command has to be recorded in a
     // renderpass
@@ -1398,13 +1514,23 @@ void BuildCommandBuffers(void) {
 
     vkCmdBindPipeline(render.cmdBuffe[i], VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline);
 
-    VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(render.cmdBuffe[i], 0, 1,  &heartModel.vertices.buffer, &offset);
-
     // Bind triangle index buffer
-    vkCmdBindIndexBuffer(render.cmdBuffe[i], heartModel.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindIndexBuffer(render.cmdBuffe[i], heartModel.indices.buffer, 0, heartModel.indexType);
 
-    vkCmdDrawIndexed(render.cmdBuffe[i], heartModel.indexCount, 1, 0, 0, 0);
+    if (timed) {
+      vkCmdWriteTimestamp(render.cmdBuffe[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          drawTiming.queryPool, kTimestampsPerFrame * i);
+    }
+    VkDeviceSize offset = 0;
+    VkBuffer vertexBuffer = skinningPass ? skinningPass->GetVertexBuffer()
+        : morphPass ? heartModel.morphed.buffer : heartModel.vertices.buffer;
+    vkCmdBindVertexBuffers(render.cmdBuffe[i], 0, 1, &vertexBuffer, &offset);
+    heartDraws->Record(render.cmdBuffe[i], heartLodDraws[heartLod].first,
+                       heartLodDraws[heartLod].count);
+    if (timed) {
+      vkCmdWriteTimestamp(render.cmdBuffe[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          drawTiming.queryPool, kTimestampsPerFrame * i + 1);
+    }
 
     vkCmdEndRenderPass(render.cmdBuffe[i]);
 
@@ -1413,6 +1539,60 @@ void BuildCommandBuffers(void) {
 
 }
 
+// Replaces the drawn model and everything built for it. Runs between frames, when the queue
+// is idle and nothing reads the old model any more.
+void SetHeartModel(const ModelLoader::Model& model) {
+  delete skinningPass;
+  skinningPass = nullptr;
+  delete morphPass;
+  morphPass = nullptr;
+  delete heartDraws;
+  heartDraws = nullptr;
+  heartModel.destroy(device.logic_);
+
+  // Animated models come in float vertices when the placeholder was quantized
+  const bool layoutChanged = model.layout.stride != heartModel.layout.stride;
+  heartModel = model;
+  if (layoutChanged) {
+    deletionQueue->DestroyPipeline(gfxPipeline);
+    CreateVertexDescriptions();
+    CreateGraphicsPipeline();
+  }
+  CreateMorphPass();
+  CreateSkinningPass();
+  CreateHeartDraws();
+  UpdateDescriptorSet();
+  heartLod = SelectHeartLod();
+  BuildCommandBuffers();
+}
+
+// Loads filePath on the streaming thread, heartModel stays what it is until then and for good
+// if the load fails
+void StreamHeartModel(const char* filePath) {
+  ModelLoader::Model* loaded = new ModelLoader::Model();
+  loaded->layout = heartModel.layout;
+  loaded->animatedLayout = HeartLayout::Format();
+  loaded->createInfo = heartModel.createInfo;
+  assetStreamer->Request(filePath, [=]() {
+    bool modelLoaded = modelLoader->LoadFromFile(filePath, loaded);
+    // Only model loads use the scratch arena, everything decoded has been staged by now
+    LOGI("Scratch arena served %u allocations (%zu bytes) from %u blocks on %u threads",
+         loadArena->AllocationCount(), loadArena->BytesAllocated(), loadArena->BlockCount(),
+         loadWorkers->ThreadCount());
+    loadArena->Release();
+    return modelLoaded;
+  }, [=]() {
+    SetHeartModel(*loaded);
+    delete loaded;
+    LOGI("Assets loaded in %.2f ms", std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - loadStart).count());
+    DumpMemoryUsage();
+  }, [=]() {
+    loaded->destroy(device.logic_);
+    delete loaded;
+  });
+}
+
 // InitVulkan:
 //   Initialize Vulkan Context when android application window is created
 //   upon return, vulkan is ready to draw frames
@@ -1424,9 +1604,20 @@ bool InitVulkan(android_app* app) {
     return false;
   }
 
+  SetAssetManager(app->activity->assetManager);
   CreateVulkanDevice(app->window);
 
-  modelLoader = new ModelLoader(device.physical_, device.logic_, androidAppCtx);
+  deletionQueue = new DeletionQueue(device.logic_);
+  uploadQueue = new UploadQueue(device.physical_, device.logic_, device.transferQueue_,
+                                device.transferQueueFamilyIndex_, device.queue_,
+                                device.queueFamilyIndex_, kStagingRingSize);
+  loadArena = new ScratchArena();
+  loadWorkers = new WorkerPool();
+  if (modelCache == nullptr) {
+    modelCache = new ModelCache(app->activity->internalDataPath);
+  }
+  modelLoader = new ModelLoader(device.physical_, device.logic_, uploadQueue, loadArena,
+                                loadWorkers, modelCache, device.queueFamilyIndex_);
 
   CreateSwapChain();
   CreateCommandPool();
@@ -1435,33 +1626,55 @@ bool InitVulkan(android_app* app) {
   CreateRenderPass();
   CreateFrameBuffers();
 
-  // Setup model and load it in
-  heartModel.layout = std::vector<ModelLoader::Component>(
-      {ModelLoader::VERTEX_COMPONENT_POSITION,
-       ModelLoader::VERTEX_COMPONENT_UV,
-       ModelLoader::VERTEX_COMPONENT_NORMAL,
-       ModelLoader::VERTEX_COMPONENT_TANGENT,
-       ModelLoader::VERTEX_COMPONENT_BITANGENT,
-      });
+  loadStart = std::chrono::steady_clock::now();
+  assetStreamer = new AssetStreamer(uploadQueue);
+  textures = new TextureResidency(device.physical_, device.logic_, device.queue_,
+                                  device.queueFamilyIndex_, uploadQueue, deletionQueue,
+                                  assetStreamer, loadWorkers, kTextureBudget);
+
+  // Setup model and stream it in, a flat colored box of the size the model is scaled to is
+  // drawn until it arrives
+#ifdef QUANTIZED_VERTICES
+  heartModel.layout = HeartQuantizedLayout::Format();
+#else
+  heartModel.layout = HeartLayout::Format();
+#endif
   heartModel.createInfo = ModelLoader::Model::CreateInfo(1.0f, 1.0f, 0.0f);
-  modelLoader->LoadFromFile("models/heart/Heart_2.dae", &heartModel);
+  const ModelLoader::Model::CreateInfo& createInfo = heartModel.createInfo;
+  const MeshBounds placeholderBounds = {createInfo.center - createInfo.scale * 0.5f,
+                                        createInfo.center + createInfo.scale * 0.5f};
+  modelLoader->CreateBox(placeholderBounds, &heartModel);
+  StreamHeartModel("models/heart/Heart_2.dae");
+
+  heartMainTexture = textures->Request("models/heart/heart_astc_8x8_main.ktx2",
+                                       VK_FORMAT_ASTC_8x8_UNORM_BLOCK, kPlaceholderColor);
+  heartNormalTexture = textures->Request("models/heart/heart_astc_8x8_normal.ktx2",
+                                         VK_FORMAT_ASTC_8x8_UNORM_BLOCK, kFlatNormal);
 
-  CreateTexture("models/heart/heart_astc_8x8_main.ktx", &heartMainTexture);
-  CreateTexture("models/heart/heart_astc_8x8_normal.ktx", &heartNormalTexture);
+  // The placeholders go to the GPU in one batch, ordered before the first frame
+  uploadQueue->Submit();
 
   CreateVertexDescriptions();
   CreateUniformBuffer();
   CreateDescriptorSetLayout();
   CreatePipelineLayout();
   CreateGraphicsPipeline();
+  CreateMorphPass();
+  CreateSkinningPass();
+  CreateHeartDraws();
   CreateSyncronization();
+  CreateDrawTimingQueries();
   CreateDescriptorPool();
   CreateDescriptorSet();
 
-
-
+  heartLod = SelectHeartLod();
   BuildCommandBuffers();
 
+  // Only the placeholders are in, the rest streams in while frames are drawn
+  LOGI("First frame ready in %.2f ms, streaming %zu assets", std::chrono::duration<double,
+       std::milli>(std::chrono::steady_clock::now() - loadStart).count(),
+       assetStreamer->Pending());
+
   device.initialized_ = true;
   return true;
 }
@@ -1471,6 +1684,13 @@ bool InitVulkan(android_app* app) {
 bool IsVulkanReady(void) { return device.initialized_; }
 
 void DeleteVulkan(void) {
+  // Assets still streaming are dropped, what was loaded of them is released here
+  delete assetStreamer;
+  assetStreamer = nullptr;
+
+  // Nothing is in flight after this, so the deferred destroys can all run below
+  CALL_VK(vkDeviceWaitIdle(device.logic_));
+
   vkFreeCommandBuffers(device.logic_, render.cmdPool,
                        render.cmdBuffe.size(), render.cmdBuffe.data());
 
@@ -1478,9 +1698,38 @@ void DeleteVulkan(void) {
   vkDestroyRenderPass(device.logic_, render.renderPass, nullptr);
   DeleteSwapChain();
   DeleteGraphicsPipeline();
+  vkDestroyQueryPool(device.logic_, drawTiming.queryPool, nullptr);
+  drawTiming.queryPool = VK_NULL_HANDLE;
+  delete skinningPass;
+  skinningPass = nullptr;
+  delete morphPass;
+  morphPass = nullptr;
+  delete heartDraws;
+  heartDraws = nullptr;
+
+  textures->LogStats();
+  delete textures;
+  textures = nullptr;
+  deletionQueue->DestroyBuffer(uniformBuffer.buffer);
+  deletionQueue->FreeMemory(uniformBuffer.memory);
+  deletionQueue->DestroyImageView(depthStencil.view);
+  deletionQueue->DestroyImage(depthStencil.image);
+  deletionQueue->FreeMemory(depthStencil.mem);
+  deletionQueue->DestroyDescriptorPool(descriptorPool);
+  deletionQueue->DestroyDescriptorSetLayout(descriptorSetLayout);
+  descriptorPool = VK_NULL_HANDLE;
+  vkDestroySemaphore(device.logic_, render.semaphore, nullptr);
+  vkDestroySemaphore(device.logic_, swapchain.semaphore, nullptr);
 
   delete modelLoader;
+  delete loadWorkers;
+  delete loadArena;
+  delete uploadQueue;
   heartModel.destroy(device.logic_);
+  delete deletionQueue;
+
+  DumpMemoryUsage();
+  ReportMemoryLeaks();
 
   vkDestroyDevice(device.logic_, nullptr);
   vkDestroyInstance(device.instance_, nullptr);
@@ -1489,8 +1738,35 @@ void DeleteVulkan(void) {
 }
 
 bool VulkanDrawFrame(void) {
+  deletionQueue->SetFrame(++frameNumber);
+  // May replace the model or its textures, before the level of detail is picked for it
+  assetStreamer->Poll();
+  // Both textures are sampled every frame, evictions and finished loads replace their images
+  textures->Touch(heartMainTexture, frameNumber);
+  textures->Touch(heartNormalTexture, frameNumber);
+  if (textures->Update(frameNumber)) {
+    UpdateDescriptorSet();
+    BuildCommandBuffers();
+  }
+
+  // The last frame left the queue idle, so no command buffer is in flight to re-record
+  uint32_t lod = SelectHeartLod();
+  if (lod != heartLod) {
+    const uint32_t fullTriangles = heartModel.lods[0].indexCount / 3;
+    const uint32_t lodTriangles = heartModel.lods[lod].indexCount / 3;
+    LOGI("Heart LOD %u -> %u at zoom %.2f: %u of %u triangles, %.0f%% fewer", heartLod, lod,
+         zoom, lodTriangles, fullTriangles, 100.0f * (fullTriangles - lodTriangles) / fullTriangles);
+    heartLod = lod;
+    BuildCommandBuffers();
+  }
 
   updateUniformBuffers();
+  if (morphPass) {
+    UpdateMorphWeights();
+  }
+  if (skinningPass) {
+    UpdateSkinning();
+  }
 
   uint32_t nextIndex;
   // Get the framebuffer index we should draw in
@@ -1512,6 +1788,9 @@ bool VulkanDrawFrame(void) {
   CALL_VK(vkQueueSubmit(device.queue_, 1, &submit_info, VK_NULL_HANDLE));
 
   CALL_VK(vkQueueWaitIdle(device.queue_));
+  CollectDrawTiming(nextIndex);
+  uploadQueue->Collect();
+  deletionQueue->Collect(frameNumber);
 
   VkResult result;
   VkPresentInfoKHR presentInfo{
@@ -1557,7 +1836,15 @@ int32_t handle_input(android_app* app, AInputEvent* event) {
 
         switch (action) {
           case AMOTION_EVENT_ACTION_UP: {
-            lastTapTime = AMotionEvent_getEventTime(event);
+            // Double tap dumps the current memory usage
+            int64_t tapTime = AMotionEvent_getEventTime(event);
+            if (tapTime - lastTapTime < kDoubleTapNs) {
+              DumpMemoryUsage();
+              if (textures) {
+                textures->LogStats();
+              }
+            }
+            lastTapTime = tapTime;
             touchPos.x = AMotionEvent_getX(event, 0);
             touchPos.y = AMotionEvent_getY(event, 0);
             touchTimer = 0.0;
@@ -1624,4 +1911,7 @@ void android_main(struct android_app* app) {
       VulkanDrawFrame();
     }
   } while (app->destroyRequested == 0);
+
+  delete modelCache;
+  modelCache = nullptr;
 }
@@ -0,0 +1,80 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(uint32_t threadCount) :
+    mNextJob(0)
+{
+  for (uint32_t i = 1; i < std::max(threadCount, 1u); i++) {
+    mThreads.emplace_back(&WorkerPool::WorkerLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mWorkReady.notify_all();
+  for (std::thread& thread : mThreads) {
+    thread.join();
+  }
+}
+
+uint32_t WorkerPool::DefaultThreadCount(void) {
+  // hardware_concurrency() may return 0 when it can't tell
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void WorkerPool::RunJobs(const std::function<void(size_t)>& job, size_t jobCount) {
+  for (size_t i = mNextJob.fetch_add(1); i < jobCount; i = mNextJob.fetch_add(1)) {
+    job(i);
+  }
+}
+
+void WorkerPool::WorkerLoop(void) {
+  uint64_t generation = 0;
+  std::unique_lock<std::mutex> lock(mMutex);
+  for (;;) {
+    mWorkReady.wait(lock, [&]() { return mStop || mGeneration != generation; });
+    if (mStop) {
+      return;
+    }
+    generation = mGeneration;
+    const std::function<void(size_t)>* job = mJob;
+    const size_t jobCount = mJobCount;
+
+    lock.unlock();
+    RunJobs(*job, jobCount);
+    lock.lock();
+
+    if (++mWorkersDone == mThreads.size()) {
+      mWorkDone.notify_one();
+    }
+  }
+}
+
+void WorkerPool::ParallelFor(size_t jobCount, const std::function<void(size_t)>& job) {
+  if (mThreads.empty() || jobCount <= 1) {
+    for (size_t i = 0; i < jobCount; i++) {
+      job(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mJob = &job;
+    mJobCount = jobCount;
+    mNextJob = 0;
+    mWorkersDone = 0;
+    mGeneration++;
+  }
+  mWorkReady.notify_all();
+
+  RunJobs(job, jobCount);
+
+  std::unique_lock<std::mutex> lock(mMutex);
+  mWorkDone.wait(lock, [&]() { return mWorkersDone == mThreads.size(); });
+  mJob = nullptr;
+}
@@ -0,0 +1,50 @@
+#ifndef __WORKER_POOL_HPP__
+#define __WORKER_POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for load time work that splits into independent jobs. ParallelFor()
+// hands job indices out through an atomic counter, the calling thread takes jobs as well and
+// returns once all of them have finished. Only one ParallelFor() runs at a time.
+class WorkerPool {
+ public:
+  // threadCount includes the calling thread, 1 runs every job inline
+  explicit WorkerPool(uint32_t threadCount = DefaultThreadCount());
+  ~WorkerPool();
+
+  // One thread per core
+  static uint32_t DefaultThreadCount(void);
+
+  uint32_t ThreadCount(void) const { return static_cast<uint32_t>(mThreads.size()) + 1; }
+
+  // Calls job(i) once for every i in [0, jobCount)
+  void ParallelFor(size_t jobCount, const std::function<void(size_t)>& job);
+
+ private:
+  void WorkerLoop(void);
+  void RunJobs(const std::function<void(size_t)>& job, size_t jobCount);
+
+  std::vector<std::thread> mThreads;
+  std::mutex mMutex;
+  std::condition_variable mWorkReady;
+  std::condition_variable mWorkDone;
+
+  // Guarded by mMutex. Every worker checks in once per generation, so the job can't be replaced
+  // while a late worker still reads it.
+  const std::function<void(size_t)>* mJob = nullptr;
+  size_t mJobCount = 0;
+  uint64_t mGeneration = 0;
+  uint32_t mWorkersDone = 0;
+  bool mStop = false;
+
+  std::atomic<size_t> mNextJob;
+};
+
+#endif // __WORKER_POOL_HPP__
@@ -10,6 +10,7 @@ layout (location = 0) in vec2 inUV;
 layout (location = 1) in vec3 inLightVec;
 layout (location = 2) in vec3 inLightVecB;
 layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec4 inTint;
 
 layout (location = 0) out vec4 outFragColor;
 
@@ -20,7 +21,7 @@ void main()
     float ambient = 0.25;
     vec3 specularColor = vec3(1.0, 0.8, 0.8);
 
-	vec3 color = texture(colorMap, inUV).rgb;
+	vec3 color = texture(colorMap, inUV).rgb * inTint.rgb;
 	vec3 normal = normalize((texture(normalMap, inUV).rgb - 0.5) * 2.0);
 
     float distSqr = dot(inLightVecB, inLightVecB);
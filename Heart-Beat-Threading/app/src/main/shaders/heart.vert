@@ -3,11 +3,11 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-layout (location = 0) in vec3 inPos;
+layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec2 inUV;
-layout (location = 2) in vec3 inNormal;
-layout (location = 3) in vec3 inTangent;
-layout (location = 4) in vec3 inBiTangent;
+layout (location = 2) in vec3 inNormalAttribute;
+// Bitangent sign in w
+layout (location = 3) in vec4 inTangentSign;
 
 layout (binding = 0) uniform UBO
 {
@@ -17,10 +17,19 @@ layout (binding = 0) uniform UBO
 	vec4 lightPos;
 } ubo;
 
+// IndirectDraws::DrawData, every draw's firstInstance points at its own
+struct DrawData
+{
+	mat4 transform;
+	vec4 tint;
+};
+layout (std430, binding = 3) readonly buffer Draws { DrawData draws[]; };
+
 layout (location = 0) out vec2 outUV;
 layout (location = 1) out vec3 outLightVec;
 layout (location = 2) out vec3 outLightVecB;
 layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec4 outTint;
 
 out gl_PerVertex
 {
@@ -29,6 +38,13 @@ out gl_PerVertex
 
 void main()
 {
+	DrawData draw = draws[gl_InstanceIndex];
+	vec3 inPos = vec3(draw.transform * vec4(inPosition, 1.0));
+	vec3 inNormal = mat3(draw.transform) * inNormalAttribute;
+	vec3 inTangent = mat3(draw.transform) * inTangentSign.xyz;
+	vec3 inBiTangent = cross(inNormal, inTangent) * (inTangentSign.w < 0.0 ? -1.0 : 1.0);
+	outTint = draw.tint;
+
 	outUV = inUV;
 	gl_Position = ubo.MVP * vec4(inPos, 1.0);
 
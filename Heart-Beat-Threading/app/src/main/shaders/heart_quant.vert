@@ -0,0 +1,82 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Same as heart.vert for the quantized vertex layout: snorm16 position inside the mesh bounds
+// with the bitangent sign in w, half float uv, octahedral snorm16 normal and tangent
+layout (location = 0) in vec4 inPosSign;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec2 inNormalOct;
+layout (location = 3) in vec2 inTangentOct;
+
+layout (binding = 0) uniform UBO
+{
+	mat4 MVP;
+	mat4 model;
+	mat4 normal;
+	vec4 lightPos;
+	vec4 posScale;
+	vec4 posOffset;
+} ubo;
+
+// IndirectDraws::DrawData, every draw's firstInstance points at its own
+struct DrawData
+{
+	mat4 transform;
+	vec4 tint;
+};
+layout (std430, binding = 3) readonly buffer Draws { DrawData draws[]; };
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec3 outLightVec;
+layout (location = 2) out vec3 outLightVecB;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec4 outTint;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+
+void main()
+{
+	DrawData draw = draws[gl_InstanceIndex];
+	vec3 inPos = vec3(draw.transform *
+	                  vec4(inPosSign.xyz * ubo.posScale.xyz + ubo.posOffset.xyz, 1.0));
+	vec3 inNormal = mat3(draw.transform) * decodeOctahedral(inNormalOct);
+	vec3 inTangent = mat3(draw.transform) * decodeOctahedral(inTangentOct);
+	vec3 inBiTangent = cross(inNormal, inTangent) * (inPosSign.w < 0.0 ? -1.0 : 1.0);
+	outTint = draw.tint;
+
+	outUV = inUV;
+	gl_Position = ubo.MVP * vec4(inPos, 1.0);
+
+	vec3 pos = vec3(ubo.model *  vec4(inPos, 1.0));
+    // (t)angent-(b)inormal-(n)ormal matrix
+    mat3 tbnMatrix;
+    tbnMatrix[0] =  mat3(ubo.normal) * inTangent;
+    tbnMatrix[1] =  mat3(ubo.normal) * inBiTangent;
+    tbnMatrix[2] =  mat3(ubo.normal) * inNormal;
+
+	outLightVec.xyz = vec3(ubo.lightPos.xyz - pos) * tbnMatrix;
+
+	vec3 lightDist = ubo.lightPos.xyz - inPos;
+	outLightVecB.x = dot(inTangent, lightDist);
+	outLightVecB.y = dot(inBiTangent, lightDist);
+	outLightVecB.z = dot(inNormal, lightDist);
+
+	outViewVec.x = dot(inTangent, inPos);
+	outViewVec.y = dot(inBiTangent, inPos);
+	outViewVec.z = dot(inNormal, inPos);
+
+	outViewVec = -pos;
+}
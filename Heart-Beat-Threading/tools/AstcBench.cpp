@@ -0,0 +1,111 @@
+// Decodes an ASTC texture to RGBA8 the way TextureResidency does on devices that can't sample
+// ASTC, and times it.
+//
+//   AstcBench <input.ktx|input.ktx2> [--out decoded.ktx2] [--runs n]
+//
+// Every level is decoded on one thread, then on a worker pool of every core; the best of n runs
+// (10 by default) is reported for each. --out writes the decoded levels as an RGBA8 KTX2 file.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "AstcDecoder.h"
+#include "BenchUtil.h"
+#include "KtxFile.h"
+#include "WorkerPool.h"
+
+using namespace navs;
+
+// Decodes every level of texture into decoded, levels one after the other
+static double DecodeLevels(const std::vector<uint8_t>& file, const KtxTexture& texture,
+                           WorkerPool* workers, std::vector<uint8_t>* decoded) {
+  std::vector<uint8_t> storage;
+  const auto start = std::chrono::steady_clock::now();
+  size_t offset = 0;
+  for (uint32_t i = 0; i < texture.levels.size(); i++) {
+    const KtxLevel& level = texture.levels[i];
+    const uint8_t* blocks = GetKtxLevel(file.data(), texture, i, &storage);
+    if (blocks == nullptr) {
+      return -1.0;
+    }
+    DecodeAstc(texture.vkFormat, blocks, level.width, level.height, decoded->data() + offset,
+               workers);
+    offset += size_t(4) * level.width * level.height;
+  }
+  return MillisecondsSince(start);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <input.ktx|input.ktx2> [--out decoded.ktx2] [--runs n]\n",
+            argv[0]);
+    return 1;
+  }
+  const char* inputPath = argv[1];
+  const char* outputPath = nullptr;
+  int runs = 10;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--out") == 0) {
+      outputPath = argv[i + 1];
+    } else if (strcmp(argv[i], "--runs") == 0) {
+      runs = std::max(1, atoi(argv[i + 1]));
+    }
+  }
+
+  std::vector<uint8_t> file;
+  KtxTexture texture;
+  if (!ReadFile(inputPath, &file) ||
+      !(IsKtx2(file.data(), file.size()) ? ReadKtx2(file.data(), file.size(), &texture)
+                                         : ReadKtx1(file.data(), file.size(), &texture)) ||
+      !IsAstcFormat(texture.vkFormat)) {
+    fprintf(stderr, "%s is not an ASTC texture\n", inputPath);
+    return 1;
+  }
+
+  // Decoded levels, laid out for writing them back out
+  KtxTexture rgba = texture;
+  rgba.vkFormat = GetAstcDecodedFormat(texture.vkFormat);
+  rgba.supercompression = KTX_SUPERCOMPRESSION_NONE;
+  size_t texelCount = 0;
+  for (KtxLevel& level : rgba.levels) {
+    level.offset = 4 * texelCount;
+    level.size = level.uncompressedSize = 4 * uint64_t(level.width) * level.height;
+    texelCount += size_t(level.width) * level.height;
+  }
+  std::vector<uint8_t> decoded(4 * texelCount);
+
+  WorkerPool workers;
+  double singleMs = 1e9;
+  double pooledMs = 1e9;
+  for (int run = 0; run < runs; run++) {
+    singleMs = std::min(singleMs, DecodeLevels(file, texture, nullptr, &decoded));
+    pooledMs = std::min(pooledMs, DecodeLevels(file, texture, &workers, &decoded));
+  }
+  if (singleMs < 0.0 || pooledMs < 0.0) {
+    fprintf(stderr, "can't read the levels of %s, built without NAVS_HAVE_ZSTD?\n", inputPath);
+    return 1;
+  }
+
+  printf("%ux%u, %zu levels, format %u to %u\n", texture.width, texture.height,
+         texture.levels.size(), texture.vkFormat, rgba.vkFormat);
+  printf("  1 thread   %8.3f ms, %7.1f Mtexels/s\n", singleMs, texelCount / singleMs / 1e3);
+  printf("  %-2u threads %8.3f ms, %7.1f Mtexels/s, %.2fx\n", workers.ThreadCount(), pooledMs,
+         texelCount / pooledMs / 1e3, singleMs / pooledMs);
+
+  if (outputPath != nullptr) {
+    std::vector<uint8_t> blob;
+    FILE* output = fopen(outputPath, "wb");
+    if (!WriteKtx2(rgba, decoded.data(), 0, &blob) || output == nullptr ||
+        fwrite(blob.data(), 1, blob.size(), output) != blob.size()) {
+      fprintf(stderr, "could not write %s\n", outputPath);
+      if (output) fclose(output);
+      return 1;
+    }
+    fclose(output);
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "BenchUtil.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace navs {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+bool ReadFile(const char* path, std::vector<uint8_t>* data) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  data->resize(ftell(file));
+  fseek(file, 0, SEEK_SET);
+  const bool read = fread(data->data(), 1, data->size(), file) == data->size();
+  fclose(file);
+  return read;
+}
+
+std::vector<uint8_t> WriteGlb(const std::string& json, const std::vector<uint8_t>& bin) {
+  const size_t jsonSize = (json.size() + 3) & ~size_t(3);
+  const size_t binSize = (bin.size() + 3) & ~size_t(3);
+  const uint32_t header[5] = {0x46546C67, 2, uint32_t(12 + 8 + jsonSize + 8 + binSize),
+                              uint32_t(jsonSize), 0x4E4F534A};
+  const uint32_t binHeader[2] = {uint32_t(binSize), 0x004E4942};
+
+  // Sized once, the JSON is padded with spaces and the buffer with zeros
+  std::vector<uint8_t> glb(sizeof(header) + jsonSize + sizeof(binHeader) + binSize, 0);
+  uint8_t* out = glb.data();
+  memcpy(out, header, sizeof(header));
+  out += sizeof(header);
+  memcpy(out, json.data(), json.size());
+  memset(out + json.size(), ' ', jsonSize - json.size());
+  out += jsonSize;
+  memcpy(out, binHeader, sizeof(binHeader));
+  out += sizeof(binHeader);
+  if (!bin.empty()) {
+    memcpy(out, bin.data(), bin.size());
+  }
+  return glb;
+}
+
+} // navs namespace
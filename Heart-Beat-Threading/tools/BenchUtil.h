@@ -0,0 +1,31 @@
+#ifndef __BENCH_UTIL_HPP__
+#define __BENCH_UTIL_HPP__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers shared by the host tools
+namespace navs {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start);
+
+// Reads the whole file at path into data
+bool ReadFile(const char* path, std::vector<uint8_t>* data);
+
+// Appends values to a binary chunk being assembled, returns the byte offset they start at
+template <typename T>
+size_t Append(std::vector<uint8_t>* bin, const std::vector<T>& values) {
+  const size_t offset = bin->size();
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+  bin->insert(bin->end(), bytes, bytes + values.size() * sizeof(T));
+  return offset;
+}
+
+// Binary glTF of a JSON chunk and the buffer it describes as buffer 0, both padded to 4 bytes
+std::vector<uint8_t> WriteGlb(const std::string& json, const std::vector<uint8_t>& bin);
+
+} // navs namespace
+#endif // __BENCH_UTIL_HPP__
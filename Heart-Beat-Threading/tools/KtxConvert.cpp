@@ -0,0 +1,154 @@
+// Converts a KTX1 texture into the KTX2 container TextureResidency reads a level at a time.
+//
+//   KtxConvert <input.ktx> <output.ktx2> [--zstd level] [--runs n]
+//
+// --zstd supercompresses every level, only when built with zstd (NAVS_HAVE_ZSTD). The output is
+// read back and checked level by level against the input. Both files are then compared by size
+// and by time to first texel: how long until the smallest mip level is in memory, ready to be
+// staged. The KTX1 file goes the way gli loads it, the whole file is read and every level
+// copied out. From the KTX2 file only the header, the level index and the smallest level are
+// read, then decompressed if need be. Files are read with stdio on every run, so the page cache
+// is warm after the first; the best of n runs (10 by default) is reported.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "KtxFile.h"
+
+using namespace navs;
+
+// Reads size bytes at offset into the same place of data
+static bool ReadRange(FILE* file, uint64_t offset, uint64_t size, std::vector<uint8_t>* data) {
+  return fseek(file, static_cast<long>(offset), SEEK_SET) == 0 &&
+         fread(data->data() + offset, 1, size, file) == size;
+}
+
+// Whole file read and every level copied out, returns the bytes read
+static size_t FirstTexelKtx1(const char* path, std::vector<uint8_t>* levels) {
+  std::vector<uint8_t> data;
+  KtxTexture texture;
+  if (!ReadFile(path, &data) || !ReadKtx1(data.data(), data.size(), &texture)) {
+    return 0;
+  }
+  levels->clear();
+  for (const KtxLevel& level : texture.levels) {
+    levels->insert(levels->end(), data.begin() + level.offset,
+                   data.begin() + level.offset + level.size);
+  }
+  return data.size();
+}
+
+// Header, level index and smallest level read into file sized data, returns the bytes read
+static size_t FirstTexelKtx2(const char* path, std::vector<uint8_t>* data,
+                             std::vector<uint8_t>* storage) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return 0;
+  }
+  size_t bytesRead = 0;
+  KtxTexture texture;
+  uint32_t levelCount;
+  if (ReadRange(file, 0, kKtx2HeaderSize, data)) {
+    memcpy(&levelCount, data->data() + 40, sizeof(levelCount));
+    const uint64_t indexSize = std::max(1u, levelCount) * 3 * sizeof(uint64_t);
+    if (levelCount <= 32 && ReadRange(file, kKtx2HeaderSize, indexSize, data) &&
+        ReadKtx2(data->data(), data->size(), &texture)) {
+      const uint32_t smallest = static_cast<uint32_t>(texture.levels.size() - 1);
+      const KtxLevel& level = texture.levels[smallest];
+      if (ReadRange(file, level.offset, level.size, data) &&
+          GetKtxLevel(data->data(), texture, smallest, storage) != nullptr) {
+        bytesRead = kKtx2HeaderSize + indexSize + level.size;
+      }
+    }
+  }
+  fclose(file);
+  return bytesRead;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <input.ktx> <output.ktx2> [--zstd level] [--runs n]\n", argv[0]);
+    return 1;
+  }
+  const char* inputPath = argv[1];
+  const char* outputPath = argv[2];
+  int zstdLevel = 0;
+  int runs = 10;
+  for (int i = 3; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--zstd") == 0) {
+      zstdLevel = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--runs") == 0) {
+      runs = std::max(1, atoi(argv[i + 1]));
+    }
+  }
+
+  std::vector<uint8_t> input;
+  KtxTexture texture;
+  if (!ReadFile(inputPath, &input) || !ReadKtx1(input.data(), input.size(), &texture)) {
+    fprintf(stderr, "%s is not a KTX1 texture of a supported format\n", inputPath);
+    return 1;
+  }
+
+  std::vector<uint8_t> blob;
+  if (!WriteKtx2(texture, input.data(), zstdLevel, &blob)) {
+    fprintf(stderr, "can't write format %u%s\n", texture.vkFormat,
+            zstdLevel != 0 ? " with zstd, built without NAVS_HAVE_ZSTD?" : "");
+    return 1;
+  }
+  FILE* output = fopen(outputPath, "wb");
+  if (output == nullptr || fwrite(blob.data(), 1, blob.size(), output) != blob.size()) {
+    fprintf(stderr, "could not write %s\n", outputPath);
+    if (output) fclose(output);
+    return 1;
+  }
+  fclose(output);
+
+  // Every level has to come back as it went in
+  KtxTexture written;
+  std::vector<uint8_t> storage;
+  bool verified = ReadKtx2(blob.data(), blob.size(), &written) &&
+                  written.levels.size() == texture.levels.size();
+  for (uint32_t i = 0; verified && i < written.levels.size(); i++) {
+    const uint8_t* level = GetKtxLevel(blob.data(), written, i, &storage);
+    verified = level != nullptr &&
+               memcmp(level, input.data() + texture.levels[i].offset,
+                      texture.levels[i].size) == 0;
+  }
+  if (!verified) {
+    fprintf(stderr, "%s doesn't read back as %s\n", outputPath, inputPath);
+    return 1;
+  }
+
+  double ktx1Ms = 1e9;
+  double ktx2Ms = 1e9;
+  size_t ktx1Bytes = 0;
+  size_t ktx2Bytes = 0;
+  std::vector<uint8_t> levels;
+  std::vector<uint8_t> data(blob.size());
+  for (int run = 0; run < runs; run++) {
+    auto start = std::chrono::steady_clock::now();
+    ktx1Bytes = FirstTexelKtx1(inputPath, &levels);
+    ktx1Ms = std::min(ktx1Ms, MillisecondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    ktx2Bytes = FirstTexelKtx2(outputPath, &data, &storage);
+    ktx2Ms = std::min(ktx2Ms, MillisecondsSince(start));
+  }
+
+  printf("%ux%u, %zu levels, format %u\n", texture.width, texture.height,
+         texture.levels.size(), texture.vkFormat);
+  printf("  KTX1 %-5s %8zu bytes, first texel after %8zu bytes read in %.3f ms\n", "",
+         input.size(), ktx1Bytes, ktx1Ms);
+  printf("  KTX2 %-5s %8zu bytes, first texel after %8zu bytes read in %.3f ms\n",
+         zstdLevel != 0 ? "zstd" : "", blob.size(), ktx2Bytes, ktx2Ms);
+  printf("  KTX2 size %+.1f%%, time to first texel %+.1f%%\n",
+         100.0 * (double(blob.size()) - input.size()) / input.size(),
+         100.0 * (ktx2Ms - ktx1Ms) / ktx1Ms);
+  return 0;
+}
@@ -0,0 +1,350 @@
+// Times glTF decoding on a growing number of worker threads.
+//
+//   LoadBench [input.gltf|glb] [--meshes n] [--grid n] [--runs n] [--threads n] [--no-tangents]
+//             [--arena]
+//
+// Without an input a scene of n meshes (64 by default) is generated in memory, each a grid of
+// n by n quads (64 by default) with normals, uvs and tangents, spread over a two level node
+// hierarchy; --no-tangents leaves the tangents out so Decode() has to generate them. Decode()
+// runs on 1, 2, 4... threads up to one per core or the given maximum, the best of the given
+// number of runs (5 by default) is reported together with the speedup over a single thread.
+// Every threaded result is checked against the single threaded one.
+//
+// --arena instead runs the whole of ModelLoader::LoadGltf() short of the upload (parse, decode,
+// vertex cache and fetch optimization, LOD chain, packing) on all threads, once with its scratch
+// arrays from the heap and once from a ScratchArena, and reports the best load time of each
+// together with the heap allocations (operator new) and arena allocations and blocks of a load.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "AssetIO.h"
+#include "BenchUtil.h"
+#include "GltfImporter.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ScratchArena.h"
+#include "VertexLayout.h"
+#include "WorkerPool.h"
+
+using namespace navs;
+
+// Counts every operator new, which is where std containers and tinygltf get their memory from
+static std::atomic<uint64_t> gHeapAllocations(0);
+
+void* operator new(size_t size) {
+  gHeapAllocations++;
+  void* memory = malloc(size > 0 ? size : 1);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void* memory) noexcept {
+  free(memory);
+}
+
+static void AppendFloats(std::vector<uint8_t>* bin, std::initializer_list<float> values) {
+  for (float value : values) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    bin->insert(bin->end(), bytes, bytes + sizeof(value));
+  }
+}
+
+// Binary glTF with meshCount grid meshes, every node under one of eight group nodes
+static std::vector<uint8_t> BuildScene(uint32_t meshCount, uint32_t gridSize, bool tangents) {
+  const uint32_t side = gridSize + 1;
+  const uint32_t vertexCount = side * side;
+  const uint32_t indexCount = gridSize * gridSize * 6;
+
+  std::vector<uint8_t> bin;
+  std::string views, accessors, meshes, nodes;
+  size_t viewCount = 0;
+  // One buffer view and one accessor over it, both get the same index
+  auto addView = [&](size_t offset, size_t length, const char* accessor) {
+    const size_t view = viewCount++;
+    views += std::string(views.empty() ? "" : ",") + "{\"buffer\":0,\"byteOffset\":" +
+             std::to_string(offset) + ",\"byteLength\":" + std::to_string(length) + "}";
+    accessors += std::string(accessors.empty() ? "" : ",") + "{\"bufferView\":" +
+                 std::to_string(view) + "," + accessor + "}";
+    return view;
+  };
+
+  const std::string count = std::to_string(vertexCount);
+  for (uint32_t m = 0; m < meshCount; m++) {
+    size_t start = bin.size();
+    for (uint32_t y = 0; y < side; y++) {
+      for (uint32_t x = 0; x < side; x++) {
+        // A gentle bump so no two normals are the same
+        const float u = float(x) / gridSize, v = float(y) / gridSize;
+        AppendFloats(&bin, {u, v, 0.1f * u * (1.0f - u) * v * (1.0f - v)});
+      }
+    }
+    const size_t positions = addView(start, bin.size() - start,
+        ("\"componentType\":5126,\"count\":" + count + ",\"type\":\"VEC3\"").c_str());
+    start = bin.size();
+    for (uint32_t i = 0; i < vertexCount; i++) {
+      AppendFloats(&bin, {0.0f, 0.0f, 1.0f});
+    }
+    const size_t normals = addView(start, bin.size() - start,
+        ("\"componentType\":5126,\"count\":" + count + ",\"type\":\"VEC3\"").c_str());
+    start = bin.size();
+    for (uint32_t y = 0; y < side; y++) {
+      for (uint32_t x = 0; x < side; x++) {
+        AppendFloats(&bin, {float(x) / gridSize, float(y) / gridSize});
+      }
+    }
+    const size_t uvs = addView(start, bin.size() - start,
+        ("\"componentType\":5126,\"count\":" + count + ",\"type\":\"VEC2\"").c_str());
+    size_t tangentAccessor = 0;
+    if (tangents) {
+      start = bin.size();
+      for (uint32_t i = 0; i < vertexCount; i++) {
+        AppendFloats(&bin, {1.0f, 0.0f, 0.0f, 1.0f});
+      }
+      tangentAccessor = addView(start, bin.size() - start,
+          ("\"componentType\":5126,\"count\":" + count + ",\"type\":\"VEC4\"").c_str());
+    }
+    start = bin.size();
+    for (uint32_t y = 0; y < gridSize; y++) {
+      for (uint32_t x = 0; x < gridSize; x++) {
+        const uint32_t corner = y * side + x;
+        const uint32_t quad[6] = {corner, corner + 1, corner + side,
+                                  corner + 1, corner + side + 1, corner + side};
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(quad);
+        bin.insert(bin.end(), bytes, bytes + sizeof(quad));
+      }
+    }
+    const size_t indices = addView(start, bin.size() - start,
+        ("\"componentType\":5125,\"count\":" + std::to_string(indexCount) +
+         ",\"type\":\"SCALAR\"").c_str());
+
+    meshes += std::string(m ? "," : "") + "{\"primitives\":[{\"attributes\":{\"POSITION\":" +
+              std::to_string(positions) + ",\"NORMAL\":" + std::to_string(normals) +
+              ",\"TEXCOORD_0\":" + std::to_string(uvs) +
+              (tangents ? ",\"TANGENT\":" + std::to_string(tangentAccessor) : "") +
+              "},\"indices\":" + std::to_string(indices) + ",\"mode\":4}]}";
+  }
+
+  const uint32_t groupCount = 8;
+  std::string groupChildren[groupCount];
+  for (uint32_t m = 0; m < meshCount; m++) {
+    std::string& children = groupChildren[m % groupCount];
+    children += std::string(children.empty() ? "" : ",") + std::to_string(groupCount + m);
+  }
+  for (uint32_t g = 0; g < groupCount; g++) {
+    nodes += std::string(g ? "," : "") + "{\"translation\":[0," + std::to_string(g) +
+             ",0],\"children\":[" + groupChildren[g] + "]}";
+  }
+  for (uint32_t m = 0; m < meshCount; m++) {
+    nodes += ",{\"mesh\":" + std::to_string(m) + ",\"translation\":[" +
+             std::to_string(m / groupCount) + ",0,0],\"scale\":[0.9,0.9,0.9]}";
+  }
+
+  std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[";
+  for (uint32_t g = 0; g < groupCount; g++) {
+    json += std::string(g ? "," : "") + std::to_string(g);
+  }
+  json += "]}],\"nodes\":[" + nodes + "],\"meshes\":[" + meshes + "],\"accessors\":[" +
+          accessors + "],\"bufferViews\":[" + views + "],\"buffers\":[{\"byteLength\":" +
+          std::to_string(bin.size()) + "}]}";
+  return WriteGlb(json, bin);
+}
+
+// The layout the heart is drawn with
+typedef VertexLayout<Position, UV, Normal, SignedTangent> BenchLayout;
+
+// ModelLoader::LoadGltf() up to the upload for a model without skin or morph targets. Scratch
+// arrays are carved out of scratch when given and are one heap allocation each otherwise.
+// Returns the size of the packed geometry.
+static size_t LoadModel(const uint8_t* data, size_t size, ScratchArena* scratch,
+                        WorkerPool* workers) {
+  std::vector<std::unique_ptr<uint8_t[]>> heap;
+  heap.reserve(4);
+  auto allocate = [&](size_t bytes) -> uint8_t* {
+    if (scratch != nullptr) {
+      return static_cast<uint8_t*>(scratch->Allocate(bytes));
+    }
+    heap.emplace_back(new uint8_t[bytes]);
+    return heap.back().get();
+  };
+
+  GltfImporter importer;
+  std::string error;
+  if (!importer.Parse(data, size, &error)) {
+    return 0;
+  }
+
+  const VertexFormat layout = BenchLayout::Format();
+  const size_t indexCapacity = importer.GetIndexCount() * 3;
+  MeshVertex* decoded = reinterpret_cast<MeshVertex*>(
+      allocate(importer.GetVertexCount() * sizeof(MeshVertex)));
+  MeshVertex* vertices = reinterpret_cast<MeshVertex*>(
+      allocate(importer.GetVertexCount() * sizeof(MeshVertex)));
+  uint32_t* indices = reinterpret_cast<uint32_t*>(allocate(indexCapacity * sizeof(uint32_t)));
+  uint8_t* interleaved = allocate(importer.GetVertexCount() * layout.stride);
+
+  MeshTransform transform = {glm::vec3(1.0f), glm::vec3(0.0f), glm::vec2(1.0f)};
+  std::vector<MeshPart> parts;
+  std::vector<MeshLod> lods;
+  MeshBounds bounds;
+  importer.Decode(transform, decoded, indices, &parts, &bounds, workers);
+  const size_t fullIndexCount = importer.GetIndexCount();
+  const size_t vertexCount = OptimizeMesh(vertices, indices, fullIndexCount, decoded,
+                                          importer.GetVertexCount(), &parts);
+  const size_t indexCount = GenerateLodChain(indices, fullIndexCount, indexCapacity, vertices,
+                                             vertexCount, &parts, &lods);
+  layout.pack(vertices, vertexCount, GetQuantizationScale(bounds), interleaved);
+  const uint32_t indexSize = NarrowIndices(indices, indexCount, vertexCount);
+  return vertexCount * layout.stride + indexCount * indexSize;
+}
+
+// Best load time over runs with and without the arena
+static int CompareScratch(const uint8_t* data, size_t size, uint32_t runs, uint32_t threads) {
+  WorkerPool workers(threads);
+  ScratchArena arena;
+  printf("  scratch    load ms  heap allocs  arena allocs  arena blocks\n");
+  size_t heapSize = 0;
+  for (int useArena = 0; useArena < 2; useArena++) {
+    ScratchArena* scratch = useArena ? &arena : nullptr;
+    double bestMs = 0.0;
+    uint64_t heapAllocations = 0;
+    uint32_t arenaAllocations = 0, arenaBlocks = 0;
+    size_t loadedSize = 0;
+    for (uint32_t run = 0; run < runs; run++) {
+      const uint64_t allocationsBefore = gHeapAllocations;
+      auto start = std::chrono::steady_clock::now();
+      loadedSize = LoadModel(data, size, scratch, &workers);
+      arenaAllocations = arena.AllocationCount();
+      arenaBlocks = arena.BlockCount();
+      arena.Release();
+      const double ms = MillisecondsSince(start);
+      heapAllocations = gHeapAllocations - allocationsBefore;
+      bestMs = run == 0 ? ms : std::min(bestMs, ms);
+    }
+    if (useArena) {
+      printf("    arena  %9.3f  %11llu  %12u  %12u%s\n", bestMs,
+             static_cast<unsigned long long>(heapAllocations), arenaAllocations, arenaBlocks,
+             loadedSize == heapSize ? "" : "  OUTPUT DIFFERS");
+      if (loadedSize != heapSize) {
+        return 1;
+      }
+    } else {
+      printf("     heap  %9.3f  %11llu  %12s  %12s\n", bestMs,
+             static_cast<unsigned long long>(heapAllocations), "-", "-");
+      heapSize = loadedSize;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  const char* inputPath = nullptr;
+  uint32_t meshCount = 64;
+  uint32_t gridSize = 64;
+  uint32_t runs = 5;
+  uint32_t maxThreads = WorkerPool::DefaultThreadCount();
+  bool tangents = true;
+  bool arena = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--meshes") == 0 && i + 1 < argc) {
+      meshCount = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+      gridSize = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      maxThreads = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (strcmp(argv[i], "--no-tangents") == 0) {
+      tangents = false;
+    } else if (strcmp(argv[i], "--arena") == 0) {
+      arena = true;
+    } else if (argv[i][0] != '-' && inputPath == nullptr) {
+      inputPath = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [input.gltf|glb] [--meshes n] [--grid n] [--runs n] "
+              "[--threads n] [--no-tangents] [--arena]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  AssetView input;
+  std::vector<uint8_t> generated;
+  const uint8_t* data;
+  size_t size;
+  if (inputPath) {
+    SetAssetRoot(inputPath[0] == '/' ? "" : ".");
+    if (!OpenAsset(inputPath, &input, ASSET_ACCESS_WILLNEED)) {
+      fprintf(stderr, "could not open %s\n", inputPath);
+      return 1;
+    }
+    data = input.data();
+    size = input.size();
+  } else {
+    generated = BuildScene(std::max(meshCount, 1u), std::max(gridSize, 1u), tangents);
+    data = generated.data();
+    size = generated.size();
+  }
+
+  GltfImporter importer;
+  std::string error;
+  auto start = std::chrono::steady_clock::now();
+  if (!importer.Parse(data, size, &error)) {
+    fprintf(stderr, "could not parse: %s\n", error.c_str());
+    return 1;
+  }
+  const double parseMs = MillisecondsSince(start);
+
+  MeshTransform transform = {glm::vec3(1.0f), glm::vec3(0.0f), glm::vec2(1.0f)};
+  std::vector<MeshVertex> reference(importer.GetVertexCount());
+  std::vector<uint32_t> referenceIndices(importer.GetIndexCount());
+  std::vector<MeshVertex> vertices(reference.size());
+  std::vector<uint32_t> indices(referenceIndices.size());
+  std::vector<MeshPart> parts;
+  MeshBounds bounds;
+  importer.Decode(transform, reference.data(), referenceIndices.data(), &parts, &bounds);
+
+  printf("%s: %zu bytes, %zu parts, %zu vertices, %zu triangles, parsed in %.3f ms\n",
+         inputPath ? inputPath : "generated scene", size, parts.size(), reference.size(),
+         referenceIndices.size() / 3, parseMs);
+  if (arena) {
+    return CompareScratch(data, size, runs, maxThreads);
+  }
+  printf("  threads  decode ms  speedup\n");
+
+  double singleMs = 0.0;
+  for (uint32_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+    WorkerPool workers(threads);
+    double bestMs = 0.0;
+    for (uint32_t run = 0; run < runs; run++) {
+      start = std::chrono::steady_clock::now();
+      importer.Decode(transform, vertices.data(), indices.data(), &parts, &bounds, &workers);
+      const double ms = MillisecondsSince(start);
+      bestMs = run == 0 ? ms : std::min(bestMs, ms);
+    }
+    if (threads == 1) {
+      singleMs = bestMs;
+    }
+    const bool same =
+        memcmp(vertices.data(), reference.data(), vertices.size() * sizeof(MeshVertex)) == 0 &&
+        memcmp(indices.data(), referenceIndices.data(), indices.size() * sizeof(uint32_t)) == 0;
+    printf("  %7u  %9.3f  %6.2fx%s\n", threads, bestMs, singleMs / bestMs,
+           same ? "" : "  OUTPUT DIFFERS");
+    if (!same) {
+      return 1;
+    }
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+  return 0;
+}
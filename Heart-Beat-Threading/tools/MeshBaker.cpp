@@ -0,0 +1,194 @@
+// Converts a glTF or binary glTF into the baked mesh format loaded by ModelLoader.
+//
+//   MeshBaker <input.gltf|glb> <output.mesh> [--scale s] [--layout pos,uv,normal,tangent4]
+//             [--no-optimize] [--lods n]
+//
+// The layout has to match Model::layout of the app, the default is the one of the heart. The
+// quantized heart layout is qpos,halfuv,octnormal,octtangent; its error is reported on bake.
+// tangent4 carries the bitangent sign in w, tangent and bitangent are plain vec3s.
+// Geometry goes through the same MeshOptimizer passes ModelLoader runs on glTF files and gets
+// up to n levels of detail, 4 by default, 1 keeps the full mesh only.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AssetIO.h"
+#include "BakedMesh.h"
+#include "BenchUtil.h"
+#include "GltfImporter.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+using namespace navs;
+
+static bool ParseComponent(const std::string& name, VertexComponent* component) {
+  static const struct {
+    const char* name;
+    VertexComponent component;
+  } kComponents[] = {
+      {"pos", VERTEX_COMPONENT_POSITION},     {"normal", VERTEX_COMPONENT_NORMAL},
+      {"color", VERTEX_COMPONENT_COLOR},      {"uv", VERTEX_COMPONENT_UV},
+      {"tangent", VERTEX_COMPONENT_TANGENT},  {"bitangent", VERTEX_COMPONENT_BITANGENT},
+      {"float", VERTEX_COMPONENT_DUMMY_FLOAT}, {"vec4", VERTEX_COMPONENT_DUMMY_VEC4},
+      {"qpos", VERTEX_COMPONENT_POSITION_SNORM16}, {"octnormal", VERTEX_COMPONENT_NORMAL_OCT16},
+      {"octtangent", VERTEX_COMPONENT_TANGENT_OCT16}, {"halfuv", VERTEX_COMPONENT_UV_HALF},
+      {"tangent4", VERTEX_COMPONENT_TANGENT_SIGNED},
+  };
+  for (const auto& entry : kComponents) {
+    if (name == entry.name) {
+      *component = entry.component;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool ParseLayout(const char* list, std::vector<VertexComponent>* layout) {
+  layout->clear();
+  std::string names(list);
+  size_t start = 0;
+  while (start <= names.size()) {
+    size_t end = names.find(',', start);
+    if (end == std::string::npos) end = names.size();
+    VertexComponent component;
+    if (!ParseComponent(names.substr(start, end - start), &component)) {
+      return false;
+    }
+    layout->push_back(component);
+    start = end + 1;
+  }
+  return !layout->empty() && layout->size() <= kBakedMeshMaxComponents;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <input.gltf|glb> <output.mesh> [--scale s] [--layout list] "
+            "[--no-optimize] [--lods n]\n", argv[0]);
+    return 1;
+  }
+  const char* inputPath = argv[1];
+  const char* outputPath = argv[2];
+
+  MeshTransform transform = {glm::vec3(1.0f), glm::vec3(0.0f), glm::vec2(1.0f)};
+  std::vector<VertexComponent> layout = {VERTEX_COMPONENT_POSITION, VERTEX_COMPONENT_UV,
+                                         VERTEX_COMPONENT_NORMAL,
+                                         VERTEX_COMPONENT_TANGENT_SIGNED};
+  bool optimize = true;
+  uint32_t maxLods = kMaxMeshLods;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+      transform.scale = glm::vec3(static_cast<float>(atof(argv[++i])));
+    } else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+      if (!ParseLayout(argv[++i], &layout)) {
+        fprintf(stderr, "invalid layout %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--no-optimize") == 0) {
+      optimize = false;
+    } else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc) {
+      maxLods = static_cast<uint32_t>(std::max(atoi(argv[++i]), 1));
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  // Paths are taken as given, not relative to the app assets
+  SetAssetRoot(inputPath[0] == '/' ? "" : ".");
+
+  auto start = std::chrono::steady_clock::now();
+  AssetView input;
+  if (!OpenAsset(inputPath, &input, ASSET_ACCESS_WILLNEED)) {
+    fprintf(stderr, "could not open %s\n", inputPath);
+    return 1;
+  }
+
+  GltfImporter importer;
+  std::string error;
+  if (!importer.Parse(input.data(), input.size(), &error)) {
+    fprintf(stderr, "could not parse %s: %s\n", inputPath, error.c_str());
+    return 1;
+  }
+  std::vector<MeshVertex> vertices(importer.GetVertexCount());
+  std::vector<uint32_t> indices(importer.GetIndexCount());
+  std::vector<MeshPart> parts;
+  MeshBounds bounds;
+  importer.Decode(transform, vertices.data(), indices.data(), &parts, &bounds);
+  const double importMs = MillisecondsSince(start);
+
+  VertexCacheStats cacheBefore = AnalyzeVertexCache(indices.data(), indices.size(),
+                                                    vertices.size());
+  VertexCacheStats cacheAfter = cacheBefore;
+  if (optimize) {
+    std::vector<MeshVertex> optimized(vertices.size());
+    optimized.resize(OptimizeMesh(optimized.data(), indices.data(), indices.size(),
+                                  vertices.data(), vertices.size(), &parts));
+    vertices.swap(optimized);
+    cacheAfter = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+  }
+
+  // Same index budget ModelLoader gives the chain
+  const size_t fullIndexCount = indices.size();
+  std::vector<MeshLod> lods;
+  indices.resize(fullIndexCount * 3);
+  indices.resize(GenerateLodChain(indices.data(), fullIndexCount, indices.size(),
+                                  vertices.data(), vertices.size(), &parts, &lods, maxLods));
+
+  bool quantized = false;
+  for (VertexComponent component : layout) {
+    quantized |= IsQuantizedComponent(component);
+  }
+  QuantizationError quantizationError = {0.0f, 0.0f, 0.0f, 0.0f};
+  if (quantized) {
+    quantizationError = MeasureQuantizationError(vertices.data(), vertices.size(),
+                                                 GetQuantizationScale(bounds));
+  }
+
+  std::vector<uint8_t> blob;
+  WriteBakedMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), parts, lods,
+                 bounds, layout.data(), layout.size(), &blob);
+
+  FILE* output = fopen(outputPath, "wb");
+  if (output == nullptr || fwrite(blob.data(), 1, blob.size(), output) != blob.size()) {
+    fprintf(stderr, "could not write %s\n", outputPath);
+    if (output) fclose(output);
+    return 1;
+  }
+  fclose(output);
+
+  // What the runtime does with the baked file: map it and validate the header
+  start = std::chrono::steady_clock::now();
+  SetAssetRoot(outputPath[0] == '/' ? "" : ".");
+  AssetView baked;
+  bool bakedValid = OpenAsset(outputPath, &baked, ASSET_ACCESS_WILLNEED) &&
+                    ReadBakedMesh(baked.data(), baked.size()) != nullptr;
+  const double bakedMs = MillisecondsSince(start);
+  if (!bakedValid) {
+    fprintf(stderr, "%s failed validation\n", outputPath);
+    return 1;
+  }
+
+  printf("%s: %zu vertices, %zu indices, %zu parts, %zu bytes\n", outputPath, vertices.size(),
+         indices.size(), parts.size(), blob.size());
+  printf("  glTF parse + decode %.3f ms, baked map + validate %.3f ms\n", importMs, bakedMs);
+  printf("  vertex cache ACMR %.3f -> %.3f, %u bit indices (MeshBench has the full report)\n",
+         cacheBefore.acmr, cacheAfter.acmr,
+         reinterpret_cast<const BakedMeshHeader*>(blob.data())->indexSize * 8);
+  for (size_t i = 1; i < lods.size(); i++) {
+    printf("  LOD %zu: %u triangles (%.0f%%), error %g\n", i, lods[i].indexCount / 3,
+           100.0f * lods[i].indexCount / fullIndexCount, lods[i].error);
+  }
+  if (quantized) {
+    const float diagonal = glm::length(bounds.max - bounds.min);
+    printf("  quantization error: position %g (%.5f%% of the diagonal), normal %.3f deg, "
+           "tangent %.3f deg, uv %g\n", quantizationError.position,
+           100.0f * quantizationError.position / diagonal, quantizationError.normalDegrees,
+           quantizationError.tangentDegrees, quantizationError.uv);
+  }
+  return 0;
+}
@@ -0,0 +1,186 @@
+// Measures the load time geometry passes on a glTF or binary glTF, e.g. the heart model.
+//
+//   MeshBench <input.gltf|glb> [--cache n] [--height pixels]
+//
+// Reports vertex cache ACMR/ATVR (FIFO of n entries, 16 by default) and overdraw from the six
+// axis views after each MeshOptimizer pass, along with the time the pass took. Then builds the
+// level of detail chain and shows which level the app would draw at a range of zoom values on a
+// display of the given height (1920 by default), and how many triangles that saves. Last the
+// full mesh is split into meshlets, which are culled from cameras all around it.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "AssetIO.h"
+#include "BenchUtil.h"
+#include "GltfImporter.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+
+using namespace navs;
+
+static void PrintStats(const char* stage, double milliseconds, const uint32_t* indices,
+                       size_t indexCount, const MeshVertex* vertices, size_t vertexCount,
+                       uint32_t cacheSize) {
+  const VertexCacheStats cache = AnalyzeVertexCache(indices, indexCount, vertexCount, cacheSize);
+  const OverdrawStats overdraw = AnalyzeOverdraw(indices, indexCount, vertices, vertexCount);
+  printf("  %-14s %9.3f ms   ACMR %.3f   ATVR %.3f   overdraw %.3f\n", stage, milliseconds,
+         cache.acmr, cache.atvr, overdraw.overdraw);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <input.gltf|glb> [--cache n] [--height pixels]\n", argv[0]);
+    return 1;
+  }
+  const char* inputPath = argv[1];
+  uint32_t cacheSize = 16;
+  float viewportHeight = 1920.0f;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      cacheSize = static_cast<uint32_t>(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+      viewportHeight = static_cast<float>(atof(argv[++i]));
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  SetAssetRoot(inputPath[0] == '/' ? "" : ".");
+  AssetView input;
+  if (!OpenAsset(inputPath, &input, ASSET_ACCESS_WILLNEED)) {
+    fprintf(stderr, "could not open %s\n", inputPath);
+    return 1;
+  }
+  GltfImporter importer;
+  std::string error;
+  if (!importer.Parse(input.data(), input.size(), &error)) {
+    fprintf(stderr, "could not parse %s: %s\n", inputPath, error.c_str());
+    return 1;
+  }
+
+  MeshTransform transform = {glm::vec3(1.0f), glm::vec3(0.0f), glm::vec2(1.0f)};
+  std::vector<MeshVertex> vertices(importer.GetVertexCount());
+  std::vector<uint32_t> indices(importer.GetIndexCount());
+  std::vector<MeshPart> parts;
+  MeshBounds bounds;
+  importer.Decode(transform, vertices.data(), indices.data(), &parts, &bounds);
+
+  printf("%s: %zu vertices, %zu triangles, %zu parts\n", inputPath, vertices.size(),
+         indices.size() / 3, parts.size());
+  PrintStats("source order", 0.0, indices.data(), indices.size(), vertices.data(),
+             vertices.size(), cacheSize);
+
+  // The passes OptimizeMesh runs, one at a time
+  auto start = std::chrono::steady_clock::now();
+  for (const MeshPart& part : parts) {
+    OptimizeVertexCache(&indices[part.indexBase], part.indexCount, vertices.size());
+  }
+  PrintStats("vertex cache", MillisecondsSince(start), indices.data(), indices.size(),
+             vertices.data(), vertices.size(), cacheSize);
+
+  start = std::chrono::steady_clock::now();
+  for (const MeshPart& part : parts) {
+    OptimizeOverdraw(&indices[part.indexBase], part.indexCount, vertices.data(),
+                     vertices.size());
+  }
+  PrintStats("overdraw", MillisecondsSince(start), indices.data(), indices.size(),
+             vertices.data(), vertices.size(), cacheSize);
+
+  start = std::chrono::steady_clock::now();
+  std::vector<MeshVertex> fetched(vertices.size());
+  fetched.resize(OptimizeVertexFetch(fetched.data(), indices.data(), indices.size(),
+                                     vertices.data(), vertices.size()));
+  PrintStats("vertex fetch", MillisecondsSince(start), indices.data(), indices.size(),
+             fetched.data(), fetched.size(), cacheSize);
+
+  const size_t fullIndexCount = indices.size();
+  std::vector<MeshLod> lods;
+  start = std::chrono::steady_clock::now();
+  indices.resize(fullIndexCount * 3);
+  indices.resize(GenerateLodChain(indices.data(), fullIndexCount, indices.size(), fetched.data(),
+                                  fetched.size(), &parts, &lods));
+  printf("  LOD chain      %9.3f ms\n", MillisecondsSince(start));
+  for (size_t i = 0; i < lods.size(); i++) {
+    printf("    LOD %zu  %7u triangles  error %g\n", i, lods[i].indexCount / 3, lods[i].error);
+  }
+
+  // Same camera as VulkanMain: 60 degree vertical field of view, heart at distance -zoom
+  const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+  const float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+  const float zooms[] = {-3.0f, -6.0f, -12.0f, -24.0f, -48.0f, -96.0f};
+  printf("  zoom    LOD  triangles  saved (%.0f pixel high display)\n", viewportHeight);
+  for (float zoom : zooms) {
+    const float distance = -zoom - glm::length(center) - radius;
+    const uint32_t lod = SelectMeshLod(lods.data(), lods.size(), distance,
+                                       60.0f * static_cast<float>(M_PI) / 180.0f, viewportHeight);
+    printf("  %6.1f  %3u  %9u  %4.0f%%\n", zoom, lod, lods[lod].indexCount / 3,
+           100.0f * (lods[0].indexCount - lods[lod].indexCount) / lods[0].indexCount);
+  }
+
+  start = std::chrono::steady_clock::now();
+  MeshletData meshlets;
+  for (uint32_t p = lods[0].partBase; p < lods[0].partBase + lods[0].partCount; p++) {
+    BuildMeshlets(&indices[parts[p].indexBase], parts[p].indexCount, parts[p].indexBase,
+                  fetched.data(), fetched.size(), &meshlets);
+  }
+  const size_t meshletCount = meshlets.meshlets.size();
+  printf("  meshlets       %9.3f ms   %zu meshlets, %.1f vertices and %.1f triangles each\n",
+         MillisecondsSince(start), meshletCount, float(meshlets.vertices.size()) / meshletCount,
+         float(lods[0].indexCount / 3) / meshletCount);
+
+  // Cameras on the axes and diagonals, one set seeing everything and one zoomed in close
+  std::vector<glm::vec3> directions;
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      for (int z = -1; z <= 1; z++) {
+        if ((x != 0) + (y != 0) + (z != 0) == 1 || (x != 0 && y != 0 && z != 0)) {
+          directions.push_back(glm::normalize(glm::vec3(float(x), float(y), float(z))));
+        }
+      }
+    }
+  }
+  std::vector<uint32_t> visible(meshletCount);
+  const struct {
+    float distanceScale;
+    float fovDegrees;
+  } cameras[] = {{3.0f, 60.0f}, {1.5f, 20.0f}};
+  for (const auto& camera : cameras) {
+    MeshletCullStats total = {0, 0, 0};
+    double cullMs = 0.0;
+    for (const glm::vec3& direction : directions) {
+      const glm::vec3 eye = center + direction * (radius * camera.distanceScale);
+      const glm::vec3 up = std::fabs(direction.y) > 0.9f ? glm::vec3(0.0f, 0.0f, 1.0f)
+                                                          : glm::vec3(0.0f, 1.0f, 0.0f);
+      const glm::mat4 viewProjection =
+          glm::perspective(camera.fovDegrees * static_cast<float>(M_PI) / 180.0f, 1.0f, 0.01f,
+                           256.0f) *
+          glm::lookAt(eye, center, up);
+      start = std::chrono::steady_clock::now();
+      const MeshletCullStats stats = CullMeshlets(meshlets, viewProjection, eye, visible.data());
+      cullMs += MillisecondsSince(start);
+      total.visible += stats.visible;
+      total.backfacing += stats.backfacing;
+      total.outside += stats.outside;
+    }
+    const float views = static_cast<float>(directions.size() * meshletCount);
+    printf("  %zu views at %.1fx radius, %2.0f deg: %4.1f%% back facing, %4.1f%% off screen, "
+           "%.3f ms per view\n", directions.size(), camera.distanceScale, camera.fovDegrees,
+           100.0f * total.backfacing / views, 100.0f * total.outside / views,
+           cullMs / directions.size());
+  }
+
+  const uint32_t indexSize = NarrowIndices(indices.data(), indices.size(), fetched.size());
+  printf("  %u bit indices, %zu index bytes instead of %zu\n", indexSize * 8,
+         indices.size() * indexSize, indices.size() * sizeof(uint32_t));
+  return 0;
+}
@@ -0,0 +1,231 @@
+// Times morph target blending on the CPU, the work shaders/morph.comp does at runtime, and
+// compares the sparse delta storage against dense per-target arrays.
+//
+//   MorphBench [input.gltf|glb] [--rings n] [--segments n] [--targets n] [--cap degrees]
+//              [--frames n]
+//
+// Without an input a sphere of rings by segments vertices (128 by 128 by default) is generated
+// in memory with a number of position targets (8 by default), each pushing out a cap of the
+// given half angle (40 by default) around its own point of the equator. The model goes through
+// GltfImporter like at runtime. For 1 up to every target active the best frame out of the given
+// number (50 by default) is reported, together with what a frame uploads: the weight vector the
+// shader needs against the morphed vertices a CPU blend would have to send.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AssetIO.h"
+#include "BenchUtil.h"
+#include "GltfImporter.h"
+#include "MorphTargets.h"
+
+using namespace navs;
+
+// Binary glTF of a unit sphere with targetCount bulges. The position deltas of every target are
+// also returned densely in deltas, target after target, to check the importer against.
+static std::vector<uint8_t> BuildSphere(uint32_t rings, uint32_t segments, uint32_t targetCount,
+                                        float capDegrees, std::vector<glm::vec3>* deltas) {
+  const float kPi = 3.14159265f;
+  const float capCos = std::cos(capDegrees * kPi / 180.0f);
+  const uint32_t vertexCount = rings * segments;
+
+  std::vector<float> positions, uvs;
+  std::vector<uint32_t> indices;
+  for (uint32_t r = 0; r < rings; r++) {
+    const float theta = kPi * (r + 0.5f) / rings;
+    for (uint32_t s = 0; s < segments; s++) {
+      const float phi = 2.0f * kPi * s / segments;
+      positions.insert(positions.end(), {std::sin(theta) * std::cos(phi), std::cos(theta),
+                                         std::sin(theta) * std::sin(phi)});
+      uvs.insert(uvs.end(), {float(s) / segments, float(r) / (rings - 1)});
+    }
+  }
+  for (uint32_t r = 0; r + 1 < rings; r++) {
+    for (uint32_t s = 0; s < segments; s++) {
+      const uint32_t a = r * segments + s;
+      const uint32_t b = r * segments + (s + 1) % segments;
+      indices.insert(indices.end(), {a, b, a + segments, b, b + segments, a + segments});
+    }
+  }
+
+  deltas->assign(size_t(targetCount) * vertexCount, glm::vec3(0.0f));
+  std::vector<std::vector<float>> targets(targetCount);
+  for (uint32_t t = 0; t < targetCount; t++) {
+    const float phi = 2.0f * kPi * t / targetCount;
+    const glm::vec3 center(std::cos(phi), 0.0f, std::sin(phi));
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      const glm::vec3 normal(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+      const float falloff = std::max(glm::dot(normal, center) - capCos, 0.0f) / (1.0f - capCos);
+      const glm::vec3 delta = normal * 0.25f * falloff * falloff;
+      (*deltas)[size_t(t) * vertexCount + v] = delta;
+      targets[t].insert(targets[t].end(), {delta.x, delta.y, delta.z});
+    }
+  }
+
+  std::vector<uint8_t> bin;
+  std::string views, accessors;
+  size_t viewCount = 0;
+  // One buffer view and one accessor over it, both get the same index
+  auto addView = [&](size_t offset, const std::string& accessor) {
+    views += std::string(views.empty() ? "" : ",") + "{\"buffer\":0,\"byteOffset\":" +
+             std::to_string(offset) + ",\"byteLength\":" + std::to_string(bin.size() - offset) +
+             "}";
+    accessors += std::string(accessors.empty() ? "" : ",") + "{\"bufferView\":" +
+                 std::to_string(viewCount) + "," + accessor + "}";
+    return std::to_string(viewCount++);
+  };
+  auto accessor = [](int componentType, size_t count, const char* type) {
+    return "\"componentType\":" + std::to_string(componentType) + ",\"count\":" +
+           std::to_string(count) + ",\"type\":\"" + type + "\"";
+  };
+
+  const std::string position = addView(Append(&bin, positions),
+                                       accessor(5126, vertexCount, "VEC3"));
+  const std::string uv = addView(Append(&bin, uvs), accessor(5126, vertexCount, "VEC2"));
+  const std::string index = addView(Append(&bin, indices),
+                                    accessor(5125, indices.size(), "SCALAR"));
+  std::string targetList, weights;
+  for (uint32_t t = 0; t < targetCount; t++) {
+    const std::string target = addView(Append(&bin, targets[t]),
+                                       accessor(5126, vertexCount, "VEC3"));
+    targetList += std::string(t ? "," : "") + "{\"POSITION\":" + target + "}";
+    weights += std::string(t ? "," : "") + "0";
+  }
+
+  // Normals are left to the importer's default so the deltas only touch positions
+  std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,"
+      "\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+      "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":" + position +
+      ",\"TEXCOORD_0\":" + uv + "},\"indices\":" + index + ",\"mode\":4,\"targets\":[" +
+      targetList + "]}],\"weights\":[" + weights + "]}],"
+      "\"accessors\":[" + accessors + "],\"bufferViews\":[" + views + "],"
+      "\"buffers\":[{\"byteLength\":" + std::to_string(bin.size()) + "}]}";
+  return WriteGlb(json, bin);
+}
+
+int main(int argc, char** argv) {
+  const char* inputPath = nullptr;
+  uint32_t rings = 128;
+  uint32_t segments = 128;
+  uint32_t targetCount = 8;
+  float capDegrees = 40.0f;
+  uint32_t frames = 50;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--rings") == 0 && i + 1 < argc) {
+      rings = std::max(static_cast<uint32_t>(atoi(argv[++i])), 2u);
+    } else if (strcmp(argv[i], "--segments") == 0 && i + 1 < argc) {
+      segments = std::max(static_cast<uint32_t>(atoi(argv[++i])), 3u);
+    } else if (strcmp(argv[i], "--targets") == 0 && i + 1 < argc) {
+      targetCount = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (strcmp(argv[i], "--cap") == 0 && i + 1 < argc) {
+      capDegrees = std::min(std::max(static_cast<float>(atof(argv[++i])), 1.0f), 180.0f);
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (argv[i][0] != '-' && inputPath == nullptr) {
+      inputPath = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [input.gltf|glb] [--rings n] [--segments n] [--targets n] "
+              "[--cap degrees] [--frames n]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  AssetView input;
+  std::vector<uint8_t> generated;
+  std::vector<glm::vec3> expected;
+  const uint8_t* data;
+  size_t size;
+  if (inputPath) {
+    SetAssetRoot(inputPath[0] == '/' ? "" : ".");
+    if (!OpenAsset(inputPath, &input, ASSET_ACCESS_WILLNEED)) {
+      fprintf(stderr, "could not open %s\n", inputPath);
+      return 1;
+    }
+    data = input.data();
+    size = input.size();
+  } else {
+    generated = BuildSphere(rings, segments, targetCount, capDegrees, &expected);
+    data = generated.data();
+    size = generated.size();
+  }
+
+  GltfImporter importer;
+  std::string error;
+  if (!importer.Parse(data, size, &error)) {
+    fprintf(stderr, "could not parse: %s\n", error.c_str());
+    return 1;
+  }
+  if (importer.GetMorphTargetCount() == 0) {
+    fprintf(stderr, "%s has no morph targets\n", inputPath);
+    return 1;
+  }
+
+  MeshTransform transform = {glm::vec3(1.0f), glm::vec3(0.0f), glm::vec2(1.0f)};
+  const size_t vertexCount = importer.GetVertexCount();
+  std::vector<MeshVertex> vertices(vertexCount);
+  std::vector<uint32_t> indices(importer.GetIndexCount());
+  std::vector<MeshPart> parts;
+  MeshBounds bounds;
+  MorphTargets morphTargets;
+  importer.Decode(transform, vertices.data(), indices.data(), &parts, &bounds);
+  importer.DecodeMorphTargets(transform, &morphTargets);
+  const uint32_t targetTotal = morphTargets.targetCount;
+  const size_t morphedCount = morphTargets.GetVertexCount();
+
+  // Every target at full weight has to land where the dense deltas of the generator put it
+  std::vector<float> weights(targetTotal, 1.0f);
+  std::vector<MeshVertex> morphed(vertices);
+  ApplyMorphTargets(vertices.data(), morphTargets, weights.data(), morphed.data());
+  float blendError = 0.0f;
+  for (size_t v = 0; v < vertexCount && !expected.empty(); v++) {
+    glm::vec3 position = vertices[v].pos;
+    for (uint32_t t = 0; t < targetTotal; t++) {
+      position += expected[size_t(t) * vertexCount + v];
+    }
+    blendError = std::max(blendError, glm::length(morphed[v].pos - position));
+  }
+
+  // Dense storage is what glTF and most runtimes keep: a position, normal and tangent delta for
+  // every vertex of every target
+  const size_t denseBytes = size_t(targetTotal) * vertexCount * 3 * sizeof(glm::vec3);
+  const size_t sparseBytes = morphTargets.deltas.size() * sizeof(MorphDelta) +
+                             morphTargets.vertices.size() * sizeof(MorphVertex);
+  const MeshBounds extent = GetMorphExtent(morphTargets);
+  printf("%s: %zu vertices, %u targets, %zu morphed vertices (%.1f%%), %.2f deltas each\n",
+         inputPath ? inputPath : "generated sphere", vertexCount, targetTotal, morphedCount,
+         100.0 * morphedCount / vertexCount,
+         morphedCount ? double(morphTargets.deltas.size()) / morphedCount : 0.0);
+  printf("  storage KB: sparse %.1f, dense %.1f; bounds grow by (%.2f %.2f %.2f) / "
+         "(%.2f %.2f %.2f)\n", sparseBytes / 1024.0, denseBytes / 1024.0, extent.min.x,
+         extent.min.y, extent.min.z, extent.max.x, extent.max.y, extent.max.z);
+  if (!expected.empty()) {
+    printf("  all targets at full weight, max position error %g\n", blendError);
+  }
+  printf("  active targets  blend ms  Mvertices/s  upload bytes (weights / CPU blended "
+         "vertices)\n");
+
+  // The runtime blends float position, uv, normal and signed tangent
+  const size_t vertexBytes = sizeof(float) * (3 + 2 + 3 + 4);
+  for (uint32_t active = 1; active <= targetTotal; active++) {
+    double blendMs = 0.0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      for (uint32_t t = 0; t < targetTotal; t++) {
+        weights[t] = t < active ? 0.5f + 0.5f * std::sin(0.1f * frame + t) : 0.0f;
+      }
+      auto start = std::chrono::steady_clock::now();
+      ApplyMorphTargets(vertices.data(), morphTargets, weights.data(), morphed.data());
+      const double ms = MillisecondsSince(start);
+      blendMs = frame == 0 ? ms : std::min(blendMs, ms);
+    }
+    printf("  %14u  %8.3f  %11.1f  %zu / %zu\n", active, blendMs,
+           morphedCount / (blendMs * 1000.0), targetTotal * sizeof(float),
+           morphedCount * vertexBytes);
+  }
+  return 0;
+}
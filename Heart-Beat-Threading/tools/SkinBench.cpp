@@ -0,0 +1,290 @@
+// Times skeletal animation on the CPU: keyframe sampling into joint palettes and linear blend
+// skinning of every instance, the work shaders/skin.comp takes off the CPU at runtime.
+//
+//   SkinBench [input.gltf|glb] [--joints n] [--rings n] [--segments n] [--instances n]
+//             [--frames n] [--threads n]
+//
+// Without an input a tube of rings by segments vertices (64 by 64 by default) is generated in
+// memory, bent by a chain of joints (16 by default) that each sway back and forth. The model
+// goes through GltfImporter like at runtime. Every instance plays the first animation at its own
+// time. For 1, 4, 16... instances up to the given maximum (256 by default) the best frame out of
+// the given number (20 by default) is reported for palettes, single threaded skinning and
+// skinning on a WorkerPool, together with the bytes a frame of CPU skinned vertices would have
+// to upload against the palettes the skinning shader needs instead.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+#include "AssetIO.h"
+#include "BenchUtil.h"
+#include "GltfImporter.h"
+#include "WorkerPool.h"
+
+using namespace navs;
+
+// Binary glTF of a tube along y skinned to a chain of joints, with one animation rotating every
+// joint about z
+static std::vector<uint8_t> BuildTube(uint32_t jointCount, uint32_t rings, uint32_t segments) {
+  const float kPi = 3.14159265f;
+  const float height = 4.0f;
+  const float jointLength = height / jointCount;
+  const uint32_t vertexCount = rings * segments;
+
+  std::vector<float> positions, normals, uvs, weights;
+  std::vector<uint16_t> joints;
+  std::vector<uint32_t> indices;
+  for (uint32_t r = 0; r < rings; r++) {
+    const float y = height * r / (rings - 1);
+    // Blend between the two joints closest to the ring
+    const float bone = std::min(y / jointLength, jointCount - 0.501f);
+    const uint32_t first = std::min(static_cast<uint32_t>(bone), jointCount - 1);
+    const uint32_t second = std::min(first + 1, jointCount - 1);
+    const float blend = second == first ? 0.0f : bone - first;
+    for (uint32_t s = 0; s < segments; s++) {
+      const float angle = 2.0f * kPi * s / segments;
+      positions.insert(positions.end(), {0.3f * std::cos(angle), y, 0.3f * std::sin(angle)});
+      normals.insert(normals.end(), {std::cos(angle), 0.0f, std::sin(angle)});
+      uvs.insert(uvs.end(), {float(s) / segments, float(r) / (rings - 1)});
+      joints.insert(joints.end(), {uint16_t(first), uint16_t(second), 0, 0});
+      weights.insert(weights.end(), {1.0f - blend, blend, 0.0f, 0.0f});
+    }
+  }
+  for (uint32_t r = 0; r + 1 < rings; r++) {
+    for (uint32_t s = 0; s < segments; s++) {
+      const uint32_t a = r * segments + s;
+      const uint32_t b = r * segments + (s + 1) % segments;
+      indices.insert(indices.end(), {a, a + segments, b, b, a + segments, b + segments});
+    }
+  }
+
+  std::vector<float> inverseBinds;
+  for (uint32_t j = 0; j < jointCount; j++) {
+    inverseBinds.insert(inverseBinds.end(), {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+                                             0, -(j * jointLength), 0, 1});
+  }
+  const uint32_t keyCount = 31;
+  std::vector<float> times;
+  for (uint32_t k = 0; k < keyCount; k++) {
+    times.push_back(2.0f * k / (keyCount - 1));
+  }
+
+  std::vector<uint8_t> bin;
+  std::string views, accessors;
+  size_t viewCount = 0;
+  // One buffer view and one accessor over it, both get the same index
+  auto addView = [&](size_t offset, const std::string& accessor) {
+    views += std::string(views.empty() ? "" : ",") + "{\"buffer\":0,\"byteOffset\":" +
+             std::to_string(offset) + ",\"byteLength\":" + std::to_string(bin.size() - offset) +
+             "}";
+    accessors += std::string(accessors.empty() ? "" : ",") + "{\"bufferView\":" +
+                 std::to_string(viewCount) + "," + accessor + "}";
+    return std::to_string(viewCount++);
+  };
+  auto accessor = [](int componentType, size_t count, const char* type) {
+    return "\"componentType\":" + std::to_string(componentType) + ",\"count\":" +
+           std::to_string(count) + ",\"type\":\"" + type + "\"";
+  };
+
+  const std::string position = addView(Append(&bin, positions),
+                                       accessor(5126, vertexCount, "VEC3"));
+  const std::string normal = addView(Append(&bin, normals), accessor(5126, vertexCount, "VEC3"));
+  const std::string uv = addView(Append(&bin, uvs), accessor(5126, vertexCount, "VEC2"));
+  const std::string joint = addView(Append(&bin, joints), accessor(5123, vertexCount, "VEC4"));
+  const std::string weight = addView(Append(&bin, weights), accessor(5126, vertexCount, "VEC4"));
+  const std::string index = addView(Append(&bin, indices),
+                                    accessor(5125, indices.size(), "SCALAR"));
+  const std::string inverseBind = addView(Append(&bin, inverseBinds),
+                                          accessor(5126, jointCount, "MAT4"));
+  const std::string time = addView(Append(&bin, times), accessor(5126, keyCount, "SCALAR"));
+
+  // Node 0 holds the mesh, joint j is node j + 1 and the child of the joint before it
+  std::string nodes = "{\"mesh\":0,\"skin\":0}";
+  std::string skinJoints, channels, samplers;
+  for (uint32_t j = 0; j < jointCount; j++) {
+    nodes += ",{\"translation\":[0," + std::to_string(j ? jointLength : 0.0f) + ",0]" +
+             (j + 1 < jointCount ? ",\"children\":[" + std::to_string(j + 2) + "]" : "") + "}";
+    skinJoints += std::string(j ? "," : "") + std::to_string(j + 1);
+
+    std::vector<float> rotations;
+    for (uint32_t k = 0; k < keyCount; k++) {
+      const float angle = 0.15f * std::sin(kPi * times[k] + 0.4f * j);
+      rotations.insert(rotations.end(), {0.0f, 0.0f, std::sin(angle), std::cos(angle)});
+    }
+    const std::string rotation = addView(Append(&bin, rotations),
+                                         accessor(5126, keyCount, "VEC4"));
+    channels += std::string(j ? "," : "") + "{\"sampler\":" + std::to_string(j) +
+                ",\"target\":{\"node\":" + std::to_string(j + 1) + ",\"path\":\"rotation\"}}";
+    samplers += std::string(j ? "," : "") + "{\"input\":" + time + ",\"output\":" + rotation +
+                ",\"interpolation\":\"LINEAR\"}";
+  }
+
+  std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,"
+      "\"scenes\":[{\"nodes\":[0,1]}],\"nodes\":[" + nodes + "],"
+      "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":" + position +
+      ",\"NORMAL\":" + normal + ",\"TEXCOORD_0\":" + uv + ",\"JOINTS_0\":" + joint +
+      ",\"WEIGHTS_0\":" + weight + "},\"indices\":" + index + ",\"mode\":4}]}],"
+      "\"skins\":[{\"inverseBindMatrices\":" + inverseBind + ",\"joints\":[" + skinJoints +
+      "]}],\"animations\":[{\"channels\":[" + channels + "],\"samplers\":[" + samplers + "]}],"
+      "\"accessors\":[" + accessors + "],\"bufferViews\":[" + views + "],"
+      "\"buffers\":[{\"byteLength\":" + std::to_string(bin.size()) + "}]}";
+  return WriteGlb(json, bin);
+}
+
+int main(int argc, char** argv) {
+  const char* inputPath = nullptr;
+  uint32_t jointCount = 16;
+  uint32_t rings = 64;
+  uint32_t segments = 64;
+  uint32_t maxInstances = 256;
+  uint32_t frames = 20;
+  uint32_t threads = WorkerPool::DefaultThreadCount();
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--joints") == 0 && i + 1 < argc) {
+      jointCount = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (strcmp(argv[i], "--rings") == 0 && i + 1 < argc) {
+      rings = std::max(static_cast<uint32_t>(atoi(argv[++i])), 2u);
+    } else if (strcmp(argv[i], "--segments") == 0 && i + 1 < argc) {
+      segments = std::max(static_cast<uint32_t>(atoi(argv[++i])), 3u);
+    } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+      maxInstances = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = std::max(static_cast<uint32_t>(atoi(argv[++i])), 1u);
+    } else if (argv[i][0] != '-' && inputPath == nullptr) {
+      inputPath = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [input.gltf|glb] [--joints n] [--rings n] [--segments n] "
+              "[--instances n] [--frames n] [--threads n]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  AssetView input;
+  std::vector<uint8_t> generated;
+  const uint8_t* data;
+  size_t size;
+  if (inputPath) {
+    SetAssetRoot(inputPath[0] == '/' ? "" : ".");
+    if (!OpenAsset(inputPath, &input, ASSET_ACCESS_WILLNEED)) {
+      fprintf(stderr, "could not open %s\n", inputPath);
+      return 1;
+    }
+    data = input.data();
+    size = input.size();
+  } else {
+    generated = BuildTube(jointCount, rings, segments);
+    data = generated.data();
+    size = generated.size();
+  }
+
+  GltfImporter importer;
+  std::string error;
+  if (!importer.Parse(data, size, &error)) {
+    fprintf(stderr, "could not parse: %s\n", error.c_str());
+    return 1;
+  }
+  if (!importer.HasSkin()) {
+    fprintf(stderr, "%s has no skin\n", inputPath);
+    return 1;
+  }
+
+  MeshTransform transform = {glm::vec3(1.0f), glm::vec3(0.0f), glm::vec2(1.0f)};
+  const size_t vertexCount = importer.GetVertexCount();
+  std::vector<MeshVertex> vertices(vertexCount);
+  std::vector<uint32_t> indices(importer.GetIndexCount());
+  std::vector<SkinVertex> skin(vertexCount);
+  std::vector<MeshPart> parts;
+  MeshBounds bounds;
+  Skeleton skeleton;
+  std::vector<AnimationClip> clips;
+  importer.Decode(transform, vertices.data(), indices.data(), &parts, &bounds);
+  importer.DecodeSkin(skin.data());
+  importer.ImportAnimations(transform, &skeleton, &clips);
+  if (clips.empty()) {
+    fprintf(stderr, "%s has no animation of its skin\n", inputPath);
+    return 1;
+  }
+  const AnimationClip& clip = clips[0];
+  const size_t jointTotal = skeleton.joints.size();
+
+  // The rest pose of a well formed file puts every vertex where the bind pose has it
+  std::vector<JointPose> pose(jointTotal);
+  std::vector<glm::mat4> restPalette(jointTotal);
+  std::vector<MeshVertex> skinned(vertexCount);
+  for (size_t j = 0; j < jointTotal; j++) {
+    pose[j] = skeleton.joints[j].rest;
+  }
+  ComputeJointPalette(skeleton, pose.data(), restPalette.data());
+  SkinVertices(vertices.data(), skin.data(), vertexCount, restPalette.data(), skinned.data());
+  float restError = 0.0f;
+  for (size_t v = 0; v < vertexCount; v++) {
+    restError = std::max(restError, glm::length(skinned[v].pos - vertices[v].pos));
+  }
+
+  printf("%s: %zu vertices, %zu joints, %zu channels, %.2f s clip, rest pose error %g\n",
+         inputPath ? inputPath : "generated tube", vertexCount, jointTotal,
+         clip.channels.size(), clip.duration, restError);
+  printf("  instances  palettes ms  skin ms (1 thread)  skin ms (%u threads)  Mvertices/s  "
+         "upload KB (CPU skinned / palettes)\n", threads);
+
+  // The runtime skins float position, uv, normal and signed tangent
+  const size_t vertexBytes = sizeof(float) * (3 + 2 + 3 + 4);
+  WorkerPool workers(threads);
+  for (uint32_t instances = 1;; instances = std::min(instances * 4, maxInstances)) {
+    std::vector<glm::mat4> palettes(instances * jointTotal);
+    std::vector<MeshVertex> output(vertexCount * instances);
+    double paletteMs = 0.0, serialMs = 0.0, threadedMs = 0.0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      const float time = frame / 60.0f;
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < instances; i++) {
+        SampleAnimation(skeleton, clip, time - 0.1f * i, pose.data());
+        ComputeJointPalette(skeleton, pose.data(), &palettes[i * jointTotal]);
+      }
+      const double ms = MillisecondsSince(start);
+      paletteMs = frame == 0 ? ms : std::min(paletteMs, ms);
+
+      start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < instances; i++) {
+        SkinVertices(vertices.data(), skin.data(), vertexCount, &palettes[i * jointTotal],
+                     &output[i * vertexCount]);
+      }
+      const double skinMs = MillisecondsSince(start);
+      serialMs = frame == 0 ? skinMs : std::min(serialMs, skinMs);
+
+      // Instances are independent, big meshes are also split into chunks
+      const size_t chunkSize = 16384;
+      const size_t chunksPerInstance = (vertexCount + chunkSize - 1) / chunkSize;
+      start = std::chrono::steady_clock::now();
+      workers.ParallelFor(instances * chunksPerInstance, [&](size_t job) {
+        const size_t instance = job / chunksPerInstance;
+        const size_t first = (job % chunksPerInstance) * chunkSize;
+        const size_t count = std::min(chunkSize, vertexCount - first);
+        SkinVertices(&vertices[first], &skin[first], count, &palettes[instance * jointTotal],
+                     &output[instance * vertexCount + first]);
+      });
+      const double threadMs = MillisecondsSince(start);
+      threadedMs = frame == 0 ? threadMs : std::min(threadedMs, threadMs);
+    }
+
+    const double vertexUploadKb = double(instances) * vertexCount * vertexBytes / 1024.0;
+    const double paletteUploadKb =
+        double(instances) * (jointTotal + 1) * sizeof(glm::mat4) / 1024.0;
+    printf("  %9u  %11.3f  %18.3f  %*.3f  %11.1f  %.0f / %.1f\n", instances, paletteMs,
+           serialMs, 19 + (threads > 9 ? 1 : 0), threadedMs,
+           instances * vertexCount / (std::min(serialMs, threadedMs) * 1000.0), vertexUploadKb,
+           paletteUploadKb);
+    if (instances == maxInstances) {
+      break;
+    }
+  }
+  return 0;
+}